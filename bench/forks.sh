@@ -0,0 +1,45 @@
+#!/bin/sh
+# Fork count benchmark
+#
+# Runs a loop calling basename, dirname, printf, test, echo, true and read
+# in the shell under test, once with the builtins and once with the same
+# utilities from /usr/bin, and counts processes created on the way through
+# /proc/sys/kernel/ns_last_pid. Other processes started meanwhile on the
+# machine are counted too
+#
+# usage: bench/forks.sh [shell] [iterations]
+
+shell=${1:-build/cyprsh}
+count=${2:-500}
+script=$(mktemp) || exit 1
+input=$(mktemp) || exit 1
+trap 'rm -f "$script" "$input"' EXIT
+echo 'first line of input' > "$input"
+
+# $1 label, then commands used for test basename dirname printf echo true false
+run() {
+    label=$1
+    cat > "$script" <<SCRIPT
+read first < /proc/sys/kernel/ns_last_pid
+i=0
+while $2 \$i -lt $count; do
+    path=/usr/src/project/file\$i.c
+    $3 "\$path" .c
+    $4 "\$path"
+    $5 '%s %d\n' "\$path" \$i
+    $6 "\$path"
+    if $2 -n "\$path"; then $7; else $8; fi
+    read line < $input
+    i=\$((i + 1))
+done > /dev/null
+read last < /proc/sys/kernel/ns_last_pid
+echo \$((last - first))
+SCRIPT
+    start=$(date +%s%N)
+    processes=$("$shell" "$script") || exit 1
+    end=$(date +%s%N)
+    echo "forks: $label: $count iterations, $processes processes, $(( (end - start) / 1000000 )) ms"
+}
+
+run builtins test basename dirname printf echo true false
+run utilities /usr/bin/test /usr/bin/basename /usr/bin/dirname /usr/bin/printf /bin/echo /bin/true /bin/false
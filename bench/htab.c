@@ -0,0 +1,122 @@
+/**
+ * HashTable throughput benchmark
+ *
+ * Inserts n variable names into an empty table, then looks all of them up
+ * and looks up as many names which are not in the table, for n from 100 to
+ * 100k. Only hashTableCtor/Insert/GetValue/Dtor are used so the program
+ * also builds against older layouts of the table (make bench HTAB_BASE=rev)
+ *
+ * usage: bench_htab [label]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "data_structures/htab.h"
+
+// operations of every measurement, smaller tables are filled several times
+#define BENCH_OPERATIONS 2000000U
+// longest generated name
+#define BENCH_NAME_SIZE 24U
+
+
+/**
+ * @brief       Returns monotonic time in seconds
+ */
+static double bench_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+} // bench_now
+
+
+/**
+ * @brief       Generates count names with prefix, names are BENCH_NAME_SIZE bytes apart
+ * @return      malloc'd names, NULL on malloc failure
+ */
+static char* bench_names(const char* prefix, uint32_t count) {
+    char* names = (char*) malloc((size_t)count * BENCH_NAME_SIZE);
+    if(names == NULL) {
+        return NULL;
+    }
+    for(uint32_t i = 0; i < count; i++) {
+        snprintf(names + (size_t)i * BENCH_NAME_SIZE, BENCH_NAME_SIZE, "%s_%u", prefix, i * 2654435761U);
+    }
+    return names;
+} // bench_names
+
+
+/**
+ * @brief       Measures insert, hit and miss throughput of table with count names
+ *
+ * @param label name of the table layout in the report
+ * @param count number of names in the table
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+static StatusEnum bench_size(const char* label, uint32_t count) {
+    char* names = bench_names("VAR", count);
+    char* missing = bench_names("NOT", count);
+    if(names == NULL || missing == NULL) {
+        free(names);
+        free(missing);
+        return ERROR_MALLOC_FAILURE;
+    }
+
+    uint32_t rounds = (BENCH_OPERATIONS + count - 1) / count;
+    double insert_time = 0.0;
+    double hit_time = 0.0;
+    double miss_time = 0.0;
+    uint64_t found = 0;
+    StatusEnum st = SUCCESS;
+    for(uint32_t round = 0; round < rounds && st == SUCCESS; round++) {
+        HashTable table;
+        st = hashTableCtor(&table);
+        if(st != SUCCESS) {
+            break;
+        }
+
+        double start = bench_now();
+        for(uint32_t i = 0; i < count && st == SUCCESS; i++) {
+            st = hashTableInsert(&table, names + (size_t)i * BENCH_NAME_SIZE, "value");
+        }
+        double inserted = bench_now();
+        char* value;
+        for(uint32_t i = 0; i < count; i++) {
+            found += (hashTableGetValue(&table, names + (size_t)i * BENCH_NAME_SIZE, &value) == SUCCESS);
+        }
+        double hit = bench_now();
+        for(uint32_t i = 0; i < count; i++) {
+            found += (hashTableGetValue(&table, missing + (size_t)i * BENCH_NAME_SIZE, &value) == SUCCESS);
+        }
+        double miss = bench_now();
+
+        insert_time += inserted - start;
+        hit_time += hit - inserted;
+        miss_time += miss - hit;
+        hashTableDtor(&table);
+    }
+    free(names);
+    free(missing);
+    ERR_CHECK(st);
+
+    double operations = (double)rounds * count;
+    if(found != operations) {
+        fprintf(stderr, "bench_htab: %llu lookups succeeded, expected %.0f\n", (unsigned long long)found, operations);
+    }
+    printf("%s: %6u names  insert %6.1f  hit %6.1f  miss %6.1f  Mops/s\n", label, count,
+           operations / insert_time / 1e6, operations / hit_time / 1e6, operations / miss_time / 1e6);
+    return SUCCESS;
+} // bench_size
+
+
+int main(int argc, char** argv) {
+    static const uint32_t sizes[] = {100, 1000, 10000, 100000};
+    const char* label = (argc > 1) ? argv[1] : "htab";
+    for(uint32_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        if(bench_size(label, sizes[i]) != SUCCESS) {
+            fprintf(stderr, "bench_htab: cannot allocate memory\n");
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,114 @@
+/**
+ * HashTable reassignment benchmark
+ *
+ * Reassigns a few variables millions of times as loops of scripts do and
+ * counts malloc, calloc and realloc calls per assignment. The program is
+ * linked with -Wl,--wrap for these functions, allocations of the table go
+ * through the counting wrappers below
+ *
+ * usage: bench_htab_assign [label]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "data_structures/htab.h"
+
+// reassigned variables
+#define ASSIGN_NAMES 8U
+// assignments of every variable in one phase
+#define ASSIGN_ROUNDS 1000000U
+// longest value of the varying length phase
+#define ASSIGN_VALUE_SIZE 96U
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* pointer, size_t size);
+
+static uint64_t allocations = 0;
+
+
+void* __wrap_malloc(size_t size) {
+    allocations++;
+    return __real_malloc(size);
+}
+
+
+void* __wrap_calloc(size_t count, size_t size) {
+    allocations++;
+    return __real_calloc(count, size);
+}
+
+
+void* __wrap_realloc(void* pointer, size_t size) {
+    allocations++;
+    return __real_realloc(pointer, size);
+}
+
+
+/**
+ * @brief       Returns monotonic time in seconds
+ */
+static double assign_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+} // assign_now
+
+
+/**
+ * @brief       Reassigns ASSIGN_NAMES variables ASSIGN_ROUNDS times and reports
+ *              allocations and time per assignment
+ *
+ * @param label layout name in the report
+ * @param phase what the values are
+ * @param varying 0 assigns counters, 1 assigns values of 1 to ASSIGN_VALUE_SIZE bytes
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+static StatusEnum assign_phase(const char* label, const char* phase, uint8_t varying) {
+    static const char* names[ASSIGN_NAMES] = {"i", "line", "count", "file", "name", "total", "x", "status"};
+    char value[ASSIGN_VALUE_SIZE + 1];
+    memset(value, 'v', ASSIGN_VALUE_SIZE);
+
+    HashTable table;
+    StatusEnum st = hashTableCtor(&table);
+    for(uint32_t i = 0; i < ASSIGN_NAMES && st == SUCCESS; i++) {
+        st = hashTableInsert(&table, names[i], "0");
+    }
+
+    uint64_t before = allocations;
+    double start = assign_now();
+    for(uint32_t round = 0; round < ASSIGN_ROUNDS && st == SUCCESS; round++) {
+        for(uint32_t i = 0; i < ASSIGN_NAMES && st == SUCCESS; i++) {
+            if(varying) {
+                uint32_t length = 1 + (round * 7919U + i * 104729U) % ASSIGN_VALUE_SIZE;
+                value[length] = '\0';
+                st = hashTableInsert(&table, names[i], value);
+                value[length] = 'v';
+            }
+            else {
+                snprintf(value, sizeof(value), "%u", round);
+                st = hashTableInsert(&table, names[i], value);
+            }
+        }
+    }
+    double elapsed = assign_now() - start;
+    uint64_t count = allocations - before;
+    hashTableDtor(&table);
+    ERR_CHECK(st);
+
+    double assignments = (double)ASSIGN_ROUNDS * ASSIGN_NAMES;
+    printf("%s: %s: %.0f assignments, %llu allocations, %.6f per assignment, %.1f ns each\n", label, phase,
+           assignments, (unsigned long long)count, (double)count / assignments, elapsed * 1e9 / assignments);
+    return SUCCESS;
+} // assign_phase
+
+
+int main(int argc, char** argv) {
+    const char* label = (argc > 1) ? argv[1] : "assign";
+    if(assign_phase(label, "counters", 0U) != SUCCESS || assign_phase(label, "1-96 byte values", 1U) != SUCCESS) {
+        fprintf(stderr, "bench_htab_assign: cannot allocate memory\n");
+        return 1;
+    }
+    return 0;
+}
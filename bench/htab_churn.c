@@ -0,0 +1,129 @@
+/**
+ * HashTable set/unset stress test
+ *
+ * Keeps a set of long lived names in the table and runs 10M cycles which
+ * insert and remove a new temporary name, as a loop of `tmp_$i=...; unset
+ * tmp_$i` would. After every million cycles lookup latency of the long lived
+ * names and of missing names is measured together with the table size, they
+ * stay flat as tombstones are compacted instead of piling up
+ *
+ * usage: bench_htab_churn [cycles]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "data_structures/htab.h"
+
+// cycles run when no count is given
+#define CHURN_CYCLES 10000000U
+// cycles between two latency measurements
+#define CHURN_WINDOW 1000000U
+// long lived names looked up by the measurements
+#define CHURN_NAMES 1000U
+// lookups of one measurement, hits and misses each
+#define CHURN_LOOKUPS 200000U
+// longest generated name
+#define CHURN_NAME_SIZE 24U
+
+
+/**
+ * @brief       Returns monotonic time in seconds
+ */
+static double churn_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+} // churn_now
+
+
+/**
+ * @brief       Fills names with count names of prefix, CHURN_NAME_SIZE bytes apart
+ */
+static void churn_names(char* names, const char* prefix, uint32_t count) {
+    for(uint32_t i = 0; i < count; i++) {
+        snprintf(names + i * CHURN_NAME_SIZE, CHURN_NAME_SIZE, "%s_%u", prefix, i);
+    }
+} // churn_names
+
+
+/**
+ * @brief       Measures lookup latency of long lived and missing names
+ *
+ * @param table table with the long lived names
+ * @param names long lived names
+ * @param missing names which are not in the table
+ * @param hit   output ns per lookup of present name
+ * @param miss  output ns per lookup of missing name
+ * @return      SUCCESS, ERROR_DEFAULT when a lookup gives wrong answer
+ */
+static StatusEnum churn_measure(HashTablePtr table, const char* names, const char* missing,
+                                double* hit, double* miss) {
+    char* value;
+    StatusEnum st = SUCCESS;
+
+    double start = churn_now();
+    for(uint32_t i = 0; i < CHURN_LOOKUPS; i++) {
+        if(hashTableGetValue(table, names + (i % CHURN_NAMES) * CHURN_NAME_SIZE, &value) != SUCCESS) {
+            st = ERROR_DEFAULT;
+        }
+    }
+    double middle = churn_now();
+    for(uint32_t i = 0; i < CHURN_LOOKUPS; i++) {
+        if(hashTableGetValue(table, missing + (i % CHURN_NAMES) * CHURN_NAME_SIZE, &value) == SUCCESS) {
+            st = ERROR_DEFAULT;
+        }
+    }
+    double end = churn_now();
+
+    *hit = (middle - start) * 1e9 / CHURN_LOOKUPS;
+    *miss = (end - middle) * 1e9 / CHURN_LOOKUPS;
+    return st;
+} // churn_measure
+
+
+int main(int argc, char** argv) {
+    uint32_t cycles = (argc > 1) ? (uint32_t) strtoul(argv[1], NULL, 10) : CHURN_CYCLES;
+    static char names[CHURN_NAMES * CHURN_NAME_SIZE];
+    static char missing[CHURN_NAMES * CHURN_NAME_SIZE];
+    char name[CHURN_NAME_SIZE];
+    churn_names(names, "VAR", CHURN_NAMES);
+    churn_names(missing, "NOT", CHURN_NAMES);
+
+    HashTable table;
+    StatusEnum st = hashTableCtor(&table);
+    for(uint32_t i = 0; i < CHURN_NAMES && st == SUCCESS; i++) {
+        st = hashTableInsert(&table, names + i * CHURN_NAME_SIZE, "value");
+    }
+
+    double hit;
+    double miss;
+    if(st == SUCCESS) {
+        st = churn_measure(&table, names, missing, &hit, &miss);
+        printf("churn: %10u cycles  hit %5.1f ns  miss %5.1f ns  capacity %7u  tombstones %7u\n",
+               0U, hit, miss, table.capacity, table.deletedSize);
+    }
+
+    double start = churn_now();
+    for(uint32_t cycle = 1; cycle <= cycles && st == SUCCESS; cycle++) {
+        snprintf(name, sizeof(name), "TMP_%u", cycle);
+        st = hashTableInsert(&table, name, "temporary");
+        if(st == SUCCESS) {
+            st = hashTableRemove(&table, name);
+        }
+        if(st == SUCCESS && (cycle % CHURN_WINDOW == 0 || cycle == cycles)) {
+            st = churn_measure(&table, names, missing, &hit, &miss);
+            printf("churn: %10u cycles  hit %5.1f ns  miss %5.1f ns  capacity %7u  tombstones %7u\n",
+                   cycle, hit, miss, table.capacity, table.deletedSize);
+        }
+    }
+    double elapsed = churn_now() - start;
+    hashTableDtor(&table);
+
+    if(st != SUCCESS) {
+        fprintf(stderr, "bench_htab_churn: failed with status %d\n", st);
+        return 1;
+    }
+    printf("churn: %u set/unset cycles in %.2f s\n", cycles, elapsed);
+    return 0;
+}
@@ -0,0 +1,141 @@
+/**
+ * Lexer throughput benchmark
+ *
+ * Tokenizes a generated multi-megabyte script (or the script given as the
+ * first argument) with get_token() and reports tokens per second
+ *
+ * usage: bench_lexer [script]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "lexer/lexer.h"
+
+// size of the generated script
+#define BENCH_SCRIPT_SIZE (8U * 1024U * 1024U)
+// passes over the script, the best one is reported
+#define BENCH_ROUNDS 5U
+
+// representative lines of the generated script
+static const char* bench_lines[] = {
+    "for file in *.c src/*.h; do\n",
+    "    name=\"${file%.c}\" count=$((count + 1))\n",
+    "    if [ -f \"$file\" ] && grep -q 'main(' \"$file\" 2>/dev/null; then\n",
+    "        echo \"found: $name\" >> /tmp/out.txt; cat <&3 | cut -d: -f1\n",
+    "    elif test \"$x\" != 'a b c' || false; then printf '%s\\n' \\$literal; fi\n",
+    "done # trailing comment with 'quotes' and | operators\n",
+    "case $1 in start|stop) run_$1 \"$@\" & ;; *) exit 2;; esac\n",
+    "value=$(basename \"$path\") && { echo `date` ; } > log 2>&1\n",
+};
+
+
+/**
+ * @brief       Returns monotonic time in seconds
+ */
+static double bench_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+} // bench_now
+
+
+/**
+ * @brief       Builds script of BENCH_SCRIPT_SIZE bytes from bench_lines
+ * @return      malloc'd script, NULL on malloc failure
+ */
+static char* bench_generate(size_t* length) {
+    char* script = (char*) malloc(BENCH_SCRIPT_SIZE);
+    if(script == NULL) {
+        return NULL;
+    }
+
+    size_t used = 0;
+    uint32_t line = 0;
+    while(1) {
+        const char* text = bench_lines[line % (sizeof(bench_lines) / sizeof(bench_lines[0]))];
+        size_t text_length = strlen(text);
+        if(used + text_length > BENCH_SCRIPT_SIZE) {
+            break;
+        }
+        memcpy(script + used, text, text_length);
+        used += text_length;
+        line++;
+    }
+    *length = used;
+    return script;
+} // bench_generate
+
+
+/**
+ * @brief       Reads whole file
+ * @return      malloc'd content, NULL when the file can't be read
+ */
+static char* bench_read(const char* path, size_t* length) {
+    FILE* file = fopen(path, "rb");
+    if(file == NULL) {
+        return NULL;
+    }
+    char* content = NULL;
+    size_t capacity = 0;
+    *length = 0;
+    while(1) {
+        if(*length == capacity) {
+            capacity = (capacity == 0) ? 65536U : capacity * 2;
+            char* grown = (char*) realloc(content, capacity);
+            if(grown == NULL) {
+                free(content);
+                fclose(file);
+                return NULL;
+            }
+            content = grown;
+        }
+        size_t count = fread(content + *length, 1, capacity - *length, file);
+        if(count == 0) {
+            break;
+        }
+        *length += count;
+    }
+    fclose(file);
+    return content;
+} // bench_read
+
+
+int main(int argc, char** argv) {
+    size_t length = 0;
+    char* script = (argc > 1) ? bench_read(argv[1], &length) : bench_generate(&length);
+    if(script == NULL) {
+        fprintf(stderr, "bench_lexer: cannot load script\n");
+        return 1;
+    }
+
+    uint64_t tokens = 0;
+    double best = 0.0;
+    for(uint32_t round = 0; round < BENCH_ROUNDS; round++) {
+        Lexer lexer;
+        if(lexer_init(&lexer, script, length) != SUCCESS) {
+            fprintf(stderr, "bench_lexer: script is too large\n");
+            return 1;
+        }
+
+        double start = bench_now();
+        Token token;
+        tokens = 0;
+        do {
+            if(get_token(&lexer, &token) != SUCCESS) {
+                fprintf(stderr, "bench_lexer: lexing failed at offset %u\n", token.offset);
+                return 1;
+            }
+            tokens++;
+        } while(token.type != TOKEN_EOF);
+        double elapsed = bench_now() - start;
+        if(round == 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+
+    printf("lexer: %zu bytes, %llu tokens, %.2f ms\n", length, (unsigned long long)tokens, best * 1e3);
+    printf("lexer: %.1f Mtokens/s, %.1f MB/s\n", (double)tokens / best / 1e6, (double)length / best / 1e6);
+    free(script);
+    return 0;
+}
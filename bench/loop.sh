@@ -0,0 +1,38 @@
+#!/bin/sh
+# While loop benchmark
+#
+# Runs a loop of 1M iterations in the shell under test with the same
+# commands padded by a comment and a never taken branch of growing length.
+# The body is parsed and compiled once, so the cost per iteration does not
+# depend on its text
+#
+# usage: bench/loop.sh [shell] [iterations]
+
+shell=${1:-build/cyprsh}
+count=${2:-1000000}
+script=$(mktemp) || exit 1
+trap 'rm -f "$script"' EXIT
+
+for padding in 0 1024 16384; do
+    comment=$(printf '%*s' "$padding" '' | tr ' ' 'x')
+    {
+        echo 'i=0'
+        echo "while [ \$i -lt $count ]; do"
+        echo "    # $comment"
+        echo '    i=$((i + 1))'
+        echo "    if [ \$i -lt 0 ]; then echo '$comment'; fi"
+        echo 'done'
+    } > "$script"
+
+    # best of three runs, the machine may be busy
+    nanos=
+    for run in 1 2 3; do
+        start=$(date +%s%N)
+        "$shell" "$script" || exit 1
+        end=$(date +%s%N)
+        if [ -z "$nanos" ] || [ $((end - start)) -lt "$nanos" ]; then
+            nanos=$((end - start))
+        fi
+    done
+    echo "loop: body padded by $padding bytes: $count iterations in $((nanos / 1000000)) ms, $((nanos / count)) ns per iteration"
+done
@@ -0,0 +1,38 @@
+#!/bin/sh
+# Spawn rate benchmark
+#
+# Runs an external command in a loop of the shell under test, once in a
+# small shell and once after the shell grew a 64 MiB local variable. With
+# posix_spawn both rates stay close, fork would have to copy the page tables
+#
+# usage: bench/spawn.sh [shell] [count]
+
+shell=${1:-build/cyprsh}
+count=${2:-5000}
+script=$(mktemp) || exit 1
+trap 'rm -f "$script"' EXIT
+
+run() {
+    start=$(date +%s%N)
+    "$shell" "$script" || exit 1
+    end=$(date +%s%N)
+    micros=$(( (end - start) / 1000 ))
+    echo "spawn: $1: $count commands in $((micros / 1000)) ms, $((count * 1000000 / micros)) spawns/s"
+}
+
+cat > "$script" <<SCRIPT
+i=0
+while [ \$i -lt $count ]; do /bin/true; i=\$((i + 1)); done
+SCRIPT
+run "small shell"
+
+cat > "$script" <<SCRIPT
+grow() {
+    local big=aaaaaaaa i=0
+    while [ \$i -lt 23 ]; do big=\$big\$big; i=\$((i + 1)); done
+    i=0
+    while [ \$i -lt $count ]; do /bin/true; i=\$((i + 1)); done
+}
+grow
+SCRIPT
+run "64 MiB shell"
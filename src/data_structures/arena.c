@@ -0,0 +1,217 @@
+/**
+ * Bump pointer arena for objects which live for one command line
+ */
+
+#include "arena.h"
+
+
+/**
+ * @brief       Allocates a new arena block
+ *
+ * @param capacity usable size of the block
+ * @return      new block, NULL on malloc failure
+ */
+static ArenaBlockPtr arenaBlockNew(size_t capacity) {
+    ArenaBlockPtr block = (ArenaBlockPtr) malloc(sizeof(ArenaBlock) + capacity);
+    if(block == NULL) {
+        return NULL;
+    }
+    block->next = NULL;
+    block->capacity = capacity;
+    block->used = 0;
+    return block;
+} // arenaBlockNew
+
+
+/**
+ * @brief       Initializes arena and allocates its first block
+ *
+ * @param arena pointer to Arena structure which is passed by address
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE if first block can't be allocated
+ */
+StatusEnum arenaCtor(ArenaPtr arena) {
+    return arenaCtorSize(arena, ARENA_BLOCK_SIZE);
+} // arenaCtor
+
+
+/**
+ * @brief       Initializes arena with blocks of given size
+ *
+ *              Small arenas with lifetime of their own (one per function body)
+ *              would waste most of ARENA_BLOCK_SIZE
+ *
+ * @param arena pointer to Arena structure which is passed by address
+ * @param block_size capacity of the first and following blocks
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE if first block can't be allocated
+ */
+StatusEnum arenaCtorSize(ArenaPtr arena, size_t block_size) {
+    if(arena == NULL) {
+        return ERROR_DEFAULT;
+    }
+
+    arena->block_size = block_size;
+    arena->first = arenaBlockNew(block_size);
+    if(arena->first == NULL) {
+        arena->current = NULL;
+        return ERROR_MALLOC_FAILURE;
+    }
+    arena->current = arena->first;
+    return SUCCESS;
+} // arenaCtorSize
+
+
+/**
+ * @brief       Frees all blocks of the arena, arena must be reinitialized before reuse
+ *
+ * @param arena arena which will be destroyed
+ */
+void arenaDtor(ArenaPtr arena) {
+    if(arena == NULL) {
+        return;
+    }
+
+    ArenaBlockPtr block = arena->first;
+    while(block != NULL) {
+        ArenaBlockPtr next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->first = NULL;
+    arena->current = NULL;
+} // arenaDtor
+
+
+/**
+ * @brief       Allocates aligned memory from the arena
+ *
+ *              Bumps offset in current block, moves to next kept block or
+ *              mallocs new one when current block is full
+ *
+ * @param arena arena to allocate from
+ * @param size  number of bytes
+ * @return      pointer to memory valid until arenaReset(), NULL on malloc failure
+ */
+void* arenaAlloc(ArenaPtr arena, size_t size) {
+    if(arena == NULL || arena->current == NULL) {
+        return NULL;
+    }
+
+    // round up so the next allocation stays aligned
+    size = (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+
+    ArenaBlockPtr block = arena->current;
+    while(block->capacity - block->used < size) {
+        // reuse blocks kept from previous commands
+        if(block->next != NULL) {
+            block = block->next;
+            block->used = 0;
+            continue;
+        }
+
+        size_t capacity = (size > arena->block_size) ? size : arena->block_size;
+        ArenaBlockPtr new_block = arenaBlockNew(capacity);
+        if(new_block == NULL) {
+            return NULL;
+        }
+        block->next = new_block;
+        block = new_block;
+    }
+
+    arena->current = block;
+    void* memory = (char*) block->data + block->used;
+    block->used += size;
+    return memory;
+} // arenaAlloc
+
+
+/**
+ * @brief       Copies length bytes of src into arena and NUL terminates them
+ *
+ * @param arena arena to allocate from
+ * @param src   source bytes (do not have to be NUL terminated)
+ * @param length number of bytes to copy
+ * @return      NUL terminated copy, NULL on malloc failure
+ */
+char* arenaStrndup(ArenaPtr arena, const char* src, size_t length) {
+    char* copy = (char*) arenaAlloc(arena, length + 1);
+    if(copy == NULL) {
+        return NULL;
+    }
+    memcpy(copy, src, length);
+    copy[length] = '\0';
+    return copy;
+} // arenaStrndup
+
+
+/**
+ * @brief       Frees blocks malloc'd for one request bigger than block_size after block
+ *
+ *              Blocks of ordinary size stay for reuse, a huge word or here
+ *              document must not hold its memory for the life of the arena
+ */
+static void arenaTrim(ArenaPtr arena, ArenaBlockPtr block) {
+    ArenaBlockPtr* link = &block->next;
+    while(*link != NULL) {
+        ArenaBlockPtr next = *link;
+        if(next->capacity > arena->block_size) {
+            *link = next->next;
+            free(next);
+        }
+        else {
+            link = &next->next;
+        }
+    }
+} // arenaTrim
+
+
+/**
+ * @brief       Releases all allocations
+ *
+ *              Rewinds to the first block, blocks of ordinary size are kept
+ *              and reused by following allocations, oversized ones are freed
+ *
+ * @param arena arena which will be reset
+ */
+void arenaReset(ArenaPtr arena) {
+    if(arena == NULL || arena->first == NULL) {
+        return;
+    }
+    arenaTrim(arena, arena->first);
+    // later blocks are reset lazily when arenaAlloc moves into them
+    arena->first->used = 0;
+    arena->current = arena->first;
+} // arenaReset
+
+
+/**
+ * @brief       Remembers current position of the arena
+ *
+ * @param arena arena whose position is taken
+ * @return      mark for arenaRelease()
+ */
+ArenaMark arenaMark(ArenaPtr arena) {
+    ArenaMark mark = {arena->current, (arena->current != NULL) ? arena->current->used : 0};
+    return mark;
+} // arenaMark
+
+
+/**
+ * @brief       Releases everything allocated since mark was taken
+ *
+ *              Marks must be released in reverse order of taking them, this
+ *              lets loop iterations drop their words without resetting the
+ *              whole command line. Takes O(1) unless blocks follow the marked
+ *              one, oversized blocks among them are freed
+ *
+ * @param arena arena which will be rewound
+ * @param mark  position returned by arenaMark()
+ */
+void arenaRelease(ArenaPtr arena, ArenaMark mark) {
+    if(arena == NULL || mark.block == NULL) {
+        return;
+    }
+    arenaTrim(arena, mark.block);
+    // blocks after the marked one are reset lazily as in arenaReset()
+    mark.block->used = mark.used;
+    arena->current = mark.block;
+} // arenaRelease
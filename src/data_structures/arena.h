@@ -0,0 +1,122 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../utils/error.h"
+
+// default size of one arena block, bigger requests get a block of their own
+#define ARENA_BLOCK_SIZE (64U * 1024U)
+// every allocation is aligned for any object type
+#define ARENA_ALIGNMENT (sizeof(max_align_t))
+
+
+//
+typedef struct arena_block {
+    struct arena_block* next;
+    size_t capacity;        // usable bytes in data
+    size_t used;            // bytes handed out since last reset
+    max_align_t data[];     // aligned start of memory
+} ArenaBlock, *ArenaBlockPtr;
+
+
+/*  Bump pointer allocator with per command lifetime, all objects of one
+    command line (tokens, AST, expanded words, argv) are released at once
+    by arenaReset(), ordinary blocks are kept so the next command does not malloc */
+typedef struct arena {
+    ArenaBlockPtr first;
+    ArenaBlockPtr current;  // block allocations are served from
+    size_t block_size;      // capacity of blocks malloc'd for ordinary requests
+} Arena, *ArenaPtr;
+
+
+// position in arena, everything allocated after it can be released at once
+typedef struct arena_mark {
+    ArenaBlockPtr block;
+    size_t used;
+} ArenaMark;
+
+
+/**
+ * @brief       Initializes arena and allocates its first block
+ *
+ * @param arena pointer to Arena structure which is passed by address
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE if first block can't be allocated
+ */
+StatusEnum arenaCtor(ArenaPtr arena);
+
+/**
+ * @brief       Initializes arena with blocks of given size
+ *
+ *              Small arenas with lifetime of their own (one per function body)
+ *              would waste most of ARENA_BLOCK_SIZE
+ *
+ * @param arena pointer to Arena structure which is passed by address
+ * @param block_size capacity of the first and following blocks
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE if first block can't be allocated
+ */
+StatusEnum arenaCtorSize(ArenaPtr arena, size_t block_size);
+
+/**
+ * @brief       Frees all blocks of the arena, arena must be reinitialized before reuse
+ *
+ * @param arena arena which will be destroyed
+ */
+void arenaDtor(ArenaPtr arena);
+
+/**
+ * @brief       Allocates aligned memory from the arena
+ *
+ *              Bumps offset in current block, moves to next kept block or
+ *              mallocs new one when current block is full
+ *
+ * @param arena arena to allocate from
+ * @param size  number of bytes
+ * @return      pointer to memory valid until arenaReset(), NULL on malloc failure
+ */
+void* arenaAlloc(ArenaPtr arena, size_t size);
+
+/**
+ * @brief       Copies length bytes of src into arena and NUL terminates them
+ *
+ * @param arena arena to allocate from
+ * @param src   source bytes (do not have to be NUL terminated)
+ * @param length number of bytes to copy
+ * @return      NUL terminated copy, NULL on malloc failure
+ */
+char* arenaStrndup(ArenaPtr arena, const char* src, size_t length);
+
+/**
+ * @brief       Releases all allocations
+ *
+ *              Rewinds to the first block, blocks of ordinary size are kept
+ *              and reused by following allocations, oversized ones are freed
+ *
+ * @param arena arena which will be reset
+ */
+void arenaReset(ArenaPtr arena);
+
+/**
+ * @brief       Remembers current position of the arena
+ *
+ * @param arena arena whose position is taken
+ * @return      mark for arenaRelease()
+ */
+ArenaMark arenaMark(ArenaPtr arena);
+
+/**
+ * @brief       Releases everything allocated since mark was taken
+ *
+ *              Marks must be released in reverse order of taking them, this
+ *              lets loop iterations drop their words without resetting the
+ *              whole command line. Takes O(1) unless blocks follow the marked
+ *              one, oversized blocks among them are freed
+ *
+ * @param arena arena which will be rewound
+ * @param mark  position returned by arenaMark()
+ */
+void arenaRelease(ArenaPtr arena, ArenaMark mark);
+
+#endif
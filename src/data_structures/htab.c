@@ -8,9 +8,18 @@
 #define LOAD_FACTOR_NUM 11
 #define LOAD_FACTOR_DENUM 16
 
+// table shrinks when fewer than 3/16 of slots are used (well below 11/16)
+#define SHRINK_FACTOR_NUM 3
+#define SHRINK_FACTOR_DENUM 16
+
+/*  rehash in place while live items leave at least 1/32 of the slots below
+    the load limit for new items, tombstones then can't make the table grow */
+#define REHASH_HEADROOM_DENUM 32
+
 // closest lower prime number to UINT32MAX used as upper boundary for hashtable size
 #define CLOSEST_UMAX32_PRIME 4294967291U
 
+#ifndef HTAB_SWISS
 /*  Hash table prime number capacities which will be
     used for resizing the created hashtable(s),
     hashtable will be resized to next index when its
@@ -23,6 +32,37 @@ static const uint32_t hashtable_prime_capacities[] = {
     31, 61, 127, 193, 389, 769, 1543,
     3079, 6151, 12289, 24593, 49157, 98317
 };
+#endif
+
+#ifdef HTAB_SWISS
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*  Group probing engine (-DHTAB_SWISS), states hold one control byte per slot,
+    FULL slots store 7 low bits of the hash so 16 slots are filtered at once */
+#define CTRL_EMPTY   0x80U
+#define CTRL_DELETED 0xFEU
+#define HTAB_GROUP_WIDTH 16U
+// first capacity, power of two and multiple of group width
+#define HTAB_SWISS_MIN_CAPACITY 32U
+// group engine can be filled up to 7/8
+#define SWISS_LOAD_FACTOR_NUM 7
+#define SWISS_LOAD_FACTOR_DENUM 8
+
+#define SLOT_IS_FULL(table, index) ((table)->states[index] < CTRL_EMPTY)
+#define SLOT_IS_DELETED(table, index) ((table)->states[index] == CTRL_DELETED)
+#else
+#define SLOT_IS_FULL(table, index) ((table)->states[index] == ITEM_STATE_FULL)
+#define SLOT_IS_DELETED(table, index) ((table)->states[index] == ITEM_STATE_DELETED)
+#endif
+
+static int32_t hashTableFindIndex(HashTablePtr table, const char* key, uint32_t hash);
+#ifndef HTAB_SWISS
+static StatusEnum hashTableNextPrime(uint32_t* num);
+static uint32_t closestHigherPrime(uint32_t num);
+static uint8_t isPrime(uint32_t n);
+#endif
 
 
 /**
@@ -64,12 +104,394 @@ uint32_t hash2(const char *key) {
 } // hash2
 
 
+/**
+ * @brief       Allocates slot arrays for capacity, all slots are EMPTY
+ *
+ *              Items, hashes and states share one allocation, items first
+ *              so every array is naturally aligned
+ *
+ * @param table table whose data, hashes and states are set
+ * @param capacity number of slots
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+static StatusEnum hashTableAllocSlots(HashTablePtr table, uint32_t capacity) {
+    size_t items_size = sizeof(HashTableItem) * (size_t)capacity;
+    size_t hashes_size = sizeof(uint32_t) * (size_t)capacity;
+
+    char* block = (char*) malloc(items_size + hashes_size + capacity);
+    if(block == NULL) {
+        return ERROR_MALLOC_FAILURE;
+    }
+
+    table->data = (HashTableItemPtr) block;
+    table->hashes = (uint32_t*) (block + items_size);
+    table->states = (uint8_t*) (block + items_size + hashes_size);
+    table->capacity = capacity;
+    table->deletedSize = 0;
+    // items and hashes of empty slots are never read
+#ifdef HTAB_SWISS
+    memset(table->states, CTRL_EMPTY, capacity);
+#else
+    memset(table->states, ITEM_STATE_EMPTY, capacity);
+#endif
+    return SUCCESS;
+} // hashTableAllocSlots
+
+
+#ifdef HTAB_SWISS
+
+/**
+ * @brief       Returns bitmask of slots in group whose control byte equals value
+ *
+ * @param ctrl  first control byte of 16 slot group
+ * @param value control byte which is searched
+ * @return      bit i set when ctrl[i] == value
+ */
+static inline uint32_t groupMatch(const uint8_t* ctrl, uint8_t value) {
+#if defined(__SSE2__)
+    __m128i group = _mm_loadu_si128((const __m128i*) ctrl);
+    return (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char) value)));
+#else
+    uint32_t mask = 0;
+    for(uint32_t i = 0; i < HTAB_GROUP_WIDTH; i++) {
+        mask |= (uint32_t)(ctrl[i] == value) << i;
+    }
+    return mask;
+#endif
+} // groupMatch
+
+
+/**
+ * @brief       Returns bitmask of EMPTY or DELETED slots in group (high bit set)
+ *
+ * @param ctrl  first control byte of 16 slot group
+ * @return      bit i set when slot i is free
+ */
+static inline uint32_t groupMatchFree(const uint8_t* ctrl) {
+#if defined(__SSE2__)
+    return (uint32_t) _mm_movemask_epi8(_mm_loadu_si128((const __m128i*) ctrl));
+#else
+    uint32_t mask = 0;
+    for(uint32_t i = 0; i < HTAB_GROUP_WIDTH; i++) {
+        mask |= (uint32_t)(ctrl[i] >> 7) << i;
+    }
+    return mask;
+#endif
+} // groupMatchFree
+
+
+/**
+ * @brief       Returns capacity of a new table
+ */
+static inline uint32_t hashTableFirstCapacity(void) {
+    return HTAB_SWISS_MIN_CAPACITY;
+} // hashTableFirstCapacity
+
+
+/**
+ * @brief       Doubles power of two capacity
+ * @return      SUCCESS, ERROR_INT_OVERFLOW
+ */
+static StatusEnum hashTableNextCapacity(uint32_t* capacity) {
+    if(*capacity > UINT32_MAX / 2) {
+        return ERROR_INT_OVERFLOW;
+    }
+    *capacity *= 2;
+    return SUCCESS;
+} // hashTableNextCapacity
+
+
+/**
+ * @brief       Halves power of two capacity, never below the first capacity
+ */
+static void hashTableShrinkCapacity(uint32_t* capacity) {
+    *capacity /= 2;
+    if(*capacity < HTAB_SWISS_MIN_CAPACITY) {
+        *capacity = HTAB_SWISS_MIN_CAPACITY;
+    }
+} // hashTableShrinkCapacity
+
+
+/**
+ * @brief       Checks whether one more item would exceed the load factor,
+ *              DELETED slots count as used as they lengthen probes too
+ */
+static inline uint8_t hashTableOverloaded(HashTablePtr table) {
+    return ((uint64_t)(table->currentSize + table->deletedSize + 1) * SWISS_LOAD_FACTOR_DENUM >
+            (uint64_t)table->capacity * SWISS_LOAD_FACTOR_NUM) ? 1U : 0U;
+} // hashTableOverloaded
+
+
+/**
+ * @brief       Tells whether live items alone need a bigger table
+ */
+static inline uint8_t hashTableCrowded(HashTablePtr table) {
+    return ((uint64_t)(table->currentSize + table->capacity / REHASH_HEADROOM_DENUM) * SWISS_LOAD_FACTOR_DENUM >
+            (uint64_t)table->capacity * SWISS_LOAD_FACTOR_NUM) ? 1U : 0U;
+} // hashTableCrowded
+
+
+/**
+ * @brief       Finds first free slot in probe sequence of hash (used by resize)
+ */
+static uint32_t hashTableFindFree(HashTablePtr table, uint32_t hash) {
+    uint32_t group_mask = table->capacity / HTAB_GROUP_WIDTH - 1;
+    uint32_t group = (hash >> 7) & group_mask;
+
+    // triangular probing visits every group of power of two count
+    for(uint32_t probe = 1; ; probe++) {
+        uint32_t free_slots = groupMatchFree(table->states + group * HTAB_GROUP_WIDTH);
+        if(free_slots != 0) {
+            return group * HTAB_GROUP_WIDTH + (uint32_t)__builtin_ctz(free_slots);
+        }
+        group = (group + probe) & group_mask;
+    }
+} // hashTableFindFree
+
+
+/**
+ * @brief       Finds corresponding index of key in hashmap
+ *
+ *              Group probing, the 7bit tag of hash is compared against 16 control
+ *              bytes at once and only matching slots compare stored hash and key.
+ *              Probing stops at the first group which has an EMPTY slot
+ *
+ * @param table Hash table in which the index will be searched for
+ * @param key   String that corresponds to the index
+ * @param hash  hash1 of key
+ * @return      Int position(index) where key should be inserted or is located(insertion/deletion)
+ *              -1 if index is not found
+ */
+static int32_t hashTableFindIndex(HashTablePtr table, const char* key, uint32_t hash) {
+    uint32_t group_mask = table->capacity / HTAB_GROUP_WIDTH - 1;
+    uint32_t group = (hash >> 7) & group_mask;
+    uint8_t tag = (uint8_t)(hash & 0x7FU);
+    int32_t insert_index = -1;
+
+    for(uint32_t probe = 1; probe <= group_mask + 1; probe++) {
+        const uint8_t* ctrl = table->states + group * HTAB_GROUP_WIDTH;
+        uint32_t base = group * HTAB_GROUP_WIDTH;
+
+        uint32_t matches = groupMatch(ctrl, tag);
+        while(matches != 0) {
+            uint32_t index = base + (uint32_t)__builtin_ctz(matches);
+            if(table->hashes[index] == hash && strcmp(key, table->data[index].key) == 0) {
+                return (int32_t)index;
+            }
+            matches &= matches - 1;
+        }
+
+        // first free slot on the way is where the key would be inserted
+        if(insert_index == -1) {
+            uint32_t free_slots = groupMatchFree(ctrl);
+            if(free_slots != 0) {
+                insert_index = (int32_t)(base + (uint32_t)__builtin_ctz(free_slots));
+            }
+        }
+        if(groupMatch(ctrl, CTRL_EMPTY) != 0) {
+            return insert_index;
+        }
+        group = (group + probe) & group_mask;
+    }
+    return insert_index;
+} // hashTableFindIndex
+
+
+/**
+ * @brief       Marks slot FULL with tag of hash
+ */
+static inline void hashTableMarkFull(HashTablePtr table, uint32_t index, uint32_t hash) {
+    table->hashes[index] = hash;
+    table->states[index] = (uint8_t)(hash & 0x7FU);
+} // hashTableMarkFull
+
+
+/**
+ * @brief       Frees slot of removed item
+ *
+ *              Slot becomes EMPTY again when its group still has an EMPTY slot,
+ *              then no probe sequence ever continued past this group
+ */
+static inline void hashTableMarkDeleted(HashTablePtr table, uint32_t index) {
+    const uint8_t* ctrl = table->states + (index & ~(HTAB_GROUP_WIDTH - 1));
+    if(groupMatch(ctrl, CTRL_EMPTY) != 0) {
+        table->states[index] = CTRL_EMPTY;
+    }
+    else {
+        table->states[index] = CTRL_DELETED;
+        table->deletedSize++;
+    }
+} // hashTableMarkDeleted
+
+#else
+
+/**
+ * @brief       Computes probe step of double hashing from stored hash
+ *
+ *              Second hash is derived from the first one (mixed high bits) so
+ *              only one 32bit hash has to be stored per item and resize never
+ *              rehashes keys
+ *
+ * @param hash  stored hash1 of key
+ * @param capacity prime capacity of the table
+ * @return      step in range 1 .. capacity - 1
+ */
+static inline uint32_t hashTableStep(uint32_t hash, uint32_t capacity) {
+    uint32_t mixed = hash * 0x9E3779B1U;
+    mixed ^= mixed >> 15;
+    return (mixed % (capacity - 1)) + 1;
+} // hashTableStep
+
+
+/**
+ * @brief       Returns capacity of a new table
+ */
+static inline uint32_t hashTableFirstCapacity(void) {
+    return hashtable_prime_capacities[0];
+} // hashTableFirstCapacity
+
+
+/**
+ * @brief       Moves capacity to the next prime
+ * @return      SUCCESS, ERROR_INT_OVERFLOW
+ */
+static StatusEnum hashTableNextCapacity(uint32_t* capacity) {
+    return hashTableNextPrime(capacity);
+} // hashTableNextCapacity
+
+
+/**
+ * @brief       Moves capacity to a prime about half of it
+ *
+ *              Largest prime from hashtable_prime_capacities below capacity,
+ *              capacities above the array get closest prime above half of them
+ */
+static void hashTableShrinkCapacity(uint32_t* capacity) {
+    uint32_t count = sizeof(hashtable_prime_capacities) / sizeof(hashtable_prime_capacities[0]);
+    uint32_t target = *capacity / 2;
+
+    if(target > hashtable_prime_capacities[count - 1]) {
+        *capacity = closestHigherPrime(target);
+        return;
+    }
+    uint32_t i = count;
+    while(i > 1 && hashtable_prime_capacities[i - 1] >= *capacity) {
+        i--;
+    }
+    *capacity = hashtable_prime_capacities[i - 1];
+} // hashTableShrinkCapacity
+
+
+/**
+ * @brief       Checks whether one more item would exceed the load factor,
+ *              tombstones count as used as they lengthen probes too
+ */
+static inline uint8_t hashTableOverloaded(HashTablePtr table) {
+    return ((uint64_t)(table->currentSize + table->deletedSize + 1) * LOAD_FACTOR_DENUM >=
+            (uint64_t)table->capacity * LOAD_FACTOR_NUM) ? 1U : 0U;
+} // hashTableOverloaded
+
+
+/**
+ * @brief       Tells whether live items alone need a bigger table
+ */
+static inline uint8_t hashTableCrowded(HashTablePtr table) {
+    return ((uint64_t)(table->currentSize + table->capacity / REHASH_HEADROOM_DENUM) * LOAD_FACTOR_DENUM >=
+            (uint64_t)table->capacity * LOAD_FACTOR_NUM) ? 1U : 0U;
+} // hashTableCrowded
+
+
+/**
+ * @brief       Finds first EMPTY slot in probe sequence of hash (used by resize)
+ */
+static uint32_t hashTableFindFree(HashTablePtr table, uint32_t hash) {
+    uint32_t index = hash % table->capacity;
+    uint32_t step = hashTableStep(hash, table->capacity);
+    while(table->states[index] != ITEM_STATE_EMPTY) {
+        index += step;
+        if(index >= table->capacity) {
+            index -= table->capacity;
+        }
+    }
+    return index;
+} // hashTableFindFree
+
+
+/**
+ * @brief       Finds corresponding index of key in hashmap
+ *          
+ *              Function that calculates corresponding index of key based on its hash,
+ *              if position is FULL or DESTROYED it moves to next index until it finds a open one.
+ *              If key is already in hashtable it returns the index where its located. Probes
+ *              only read the compact state and hash arrays, key memory is touched only when
+ *              stored hash matches
+ *
+ * @param table Hash table in which the index will be searched for
+ * @param key   String that corresponds to the index
+ * @param hash  hash1 of key
+ * @return      Int position(index) where key should be inserted or is located(insertion/deletion)
+ *              -1 if index is not found
+ */
+static int32_t hashTableFindIndex(HashTablePtr table, const char* key, uint32_t hash) {
+    uint32_t capacity = table->capacity;
+    uint32_t table_index = hash % capacity;
+    uint32_t step = hashTableStep(hash, capacity);
+    int32_t first_deleted = -1;
+
+    // loop through every index of table (guaranteed because of a prime number)
+    for(uint32_t i = 0; i < capacity; i++) {
+        uint8_t state = table->states[table_index];
+
+        // if its not in hashtable replace it with first occurence
+        if(state == ITEM_STATE_EMPTY) {
+            return (first_deleted != -1 ? first_deleted : (int32_t)table_index);
+        }
+
+        if(state == ITEM_STATE_DELETED) {
+            if(first_deleted == -1) {
+                first_deleted = table_index;
+            }
+        }
+        // if its found return it
+        else if(table->hashes[table_index] == hash && strcmp(key, table->data[table_index].key) == 0) {
+            return table_index;
+        }
+
+        // next index without multiplication overflow
+        table_index += step;
+        if(table_index >= capacity) {
+            table_index -= capacity;
+        }
+    }
+    return first_deleted; // -1 when index is not found
+} // hashTableFindIndex
+
+
+/**
+ * @brief       Marks slot FULL and stores hash of its key
+ */
+static inline void hashTableMarkFull(HashTablePtr table, uint32_t index, uint32_t hash) {
+    table->hashes[index] = hash;
+    table->states[index] = ITEM_STATE_FULL;
+} // hashTableMarkFull
+
+
+/**
+ * @brief       Leaves tombstone in slot of removed item
+ */
+static inline void hashTableMarkDeleted(HashTablePtr table, uint32_t index) {
+    table->states[index] = ITEM_STATE_DELETED;
+    table->deletedSize++;
+} // hashTableMarkDeleted
+
+#endif
+
+
 /**
  * @brief       Initializes open adressing resizable hashtable
  *              
  *              Function inits a resizable open addressing hashtable,
- *              allocates array for items, sets all indexes to ITEM_STATE_OPEN
- *              and all pointers to NULL
+ *              allocates slot arrays and sets all states to ITEM_STATE_EMPTY
  * 
  * @param table pointer to HashTable structure which is passed by address
  * @return      int enum 0 on success, 3 on malloc failure(not eough memory)   
@@ -81,22 +503,9 @@ StatusEnum hashTableCtor(HashTablePtr table) {
 
     memset(table, 0, sizeof(*table));
 
-    // initialize hashtable
-    table->capacity = hashtable_prime_capacities[0]; // select first prime number from array
+    // initialize hashtable, select first capacity of the engine
     table->currentSize = 0;
-    table->data = (HashTableItemPtr) malloc(sizeof(HashTableItem) * table->capacity);
-    if(table->data == NULL) {
-        return ERROR_MALLOC_FAILURE;
-    }
-
-    // reset all array positions, set them to EMPTY
-    for(uint32_t i = 0; i < table->capacity; i++) {
-        table->data[i].state = ITEM_STATE_EMPTY;
-        table->data[i].key = NULL;
-        table->data[i].value = NULL;
-    }
-
-    return SUCCESS;
+    return hashTableAllocSlots(table, hashTableFirstCapacity());
 } // hashTableInit
 
 
@@ -117,16 +526,17 @@ void hashTableDtor(HashTablePtr table) {
 
     // loop through whole hashtable and free occupied indexes
     for(uint32_t i = 0; i < table->capacity; i++) {
-        HashTableItemPtr item = &(table->data[i]);
-        if(item->state == ITEM_STATE_FULL) {
-            free(item->key);
-            free(item->value);
+        // key and value share one block
+        if(SLOT_IS_FULL(table, i)) {
+            free(table->data[i].key);
         } // if
     } // for
 
-    // free table->data allocated array
+    // slot arrays are one allocation starting at data
     free(table->data);
     table->data = NULL;
+    table->hashes = NULL;
+    table->states = NULL;
     // optional
     table->currentSize = 0;
     table->capacity = 0;
@@ -134,13 +544,34 @@ void hashTableDtor(HashTablePtr table) {
 } // HashTableDispose
 
 
+/**
+ * @brief       Rounds size of growing value up to its size class
+ *
+ *              Powers of two from HTAB_VALUE_MIN_CLASS, multiples of
+ *              HTAB_VALUE_MAX_CLASS above it, so a value growing a little
+ *              on every assignment reallocates only now and then
+ */
+static uint32_t hashTableValueClass(uint32_t size) {
+    if(size > HTAB_VALUE_MAX_CLASS) {
+        uint64_t rounded = ((uint64_t)size + HTAB_VALUE_MAX_CLASS - 1) / HTAB_VALUE_MAX_CLASS * HTAB_VALUE_MAX_CLASS;
+        return (rounded > UINT32_MAX - HTAB_VALUE_MAX_CLASS) ? size : (uint32_t)rounded;
+    }
+    uint32_t capacity = HTAB_VALUE_MIN_CLASS;
+    while(capacity < size) {
+        capacity *= 2;
+    }
+    return capacity;
+} // hashTableValueClass
+
+
 /**
  * @brief       Inserts a item into hashtable based on hashed key
  *      
  *              Function for inserting item into hashtable based on hashed value of "key".
- *              If item with same key is already in hashtable the value of item is replaced
- *              and old one is trashed, If function has allocation failure or hash indexing failure
- *              corresponding exit values are returned otherwise 0(SUCCESS) is returned
+ *              If item with same key is already in hashtable the value of item is replaced,
+ *              in place when it fits into the block of the key. If function has allocation
+ *              failure or hash indexing failure corresponding exit values are returned
+ *              otherwise 0(SUCCESS) is returned
  * 
  * @param table Pointer to hashtabnle structure in which item will be inserted
  * @param key   String value based on which position in the hashtable is decided
@@ -149,6 +580,28 @@ void hashTableDtor(HashTablePtr table) {
  * @return      Int error exit codes if errors happen or success(0)
  */
 StatusEnum hashTableInsert(HashTablePtr table, const char* key, const char* value) {
+    if(value == NULL) {
+        return ERROR_DEFAULT;
+    }
+    // value is stored with its '\0'
+    return hashTableInsertBytes(table, key, value, strlen(value) + 1);
+} // hashTableInsert
+
+
+/**
+ * @brief       Inserts item whose value is a block of bytes instead of a string
+ *
+ *              Same as hashTableInsert() but value_size bytes are copied, this lets
+ *              tables map names to small structures (pointers of functions etc.).
+ *              Value is not aligned, it has to be read with memcpy()
+ *
+ * @param table hashtable in which item will be inserted
+ * @param key   string key
+ * @param value bytes associated with the key
+ * @param value_size number of bytes of value
+ * @return      SUCCESS, ERROR_DEFAULT, ERROR_MALLOC_FAILURE, ERROR_INDEX_OUT_OF_BOUNDS
+ */
+StatusEnum hashTableInsertBytes(HashTablePtr table, const char* key, const void* value, uint32_t value_size) {
 
     if(table == NULL || table->data == NULL || key == NULL || value == NULL) {
         return ERROR_DEFAULT;
@@ -158,147 +611,122 @@ StatusEnum hashTableInsert(HashTablePtr table, const char* key, const char* valu
         increase size to closest higher prime number
     */
 
-    if((table->currentSize + 1) * LOAD_FACTOR_DENUM >= table->capacity * LOAD_FACTOR_NUM) {
+    if(hashTableOverloaded(table)) {
         StatusEnum st = hashTableResize(table);
         ERR_CHECK(st);
     }
 
-    int32_t index = hashTableFindIndex(table, key);
+    uint32_t hash = hash1(key);
+    int32_t index = hashTableFindIndex(table, key, hash);
     if(index == -1) {
         return ERROR_INDEX_OUT_OF_BOUNDS;
     }
 
     HashTableItemPtr item = &(table->data[index]);
 
-    /* allocate block on heap, `+ 2` for two \0 characters, one for key one for value */
+    // reassigned key keeps its block while the value fits, value may point into it
+    uint8_t full = SLOT_IS_FULL(table, index) ? 1U : 0U;
+    if(full && value_size <= item->capacity) {
+        memmove(item->value, value, value_size);
+        item->flags &= HTAB_ITEM_USER_FLAGS;
+        return SUCCESS;
+    }
+
+    /* allocate block on heap, `+ 1` for \0 of key, value brings its own.
+       Only a value which outgrew its block gets slack, most keys are set once */
     uint32_t key_length = strlen(key);
-    uint32_t value_length = strlen(value); 
-    char* block = (char*) malloc(key_length + value_length + 2);
+    uint32_t capacity = full ? hashTableValueClass(value_size) : value_size;
+    char* block = (char*) malloc(key_length + capacity + 1);
 
     if (block == NULL)
         return ERROR_MALLOC_FAILURE;
     // copy key into allocated block
     memcpy(block, key, key_length);
     block[key_length] = '\0';
-    // copy value with '\0'
-    memcpy(block + key_length + 1, value, value_length + 1);
+    // copy value right after the key
+    memcpy(block + key_length + 1, value, value_size);
     
-    if(item->state == ITEM_STATE_FULL) {
+    if(full) {
         free(item->key);
+        item->flags &= HTAB_ITEM_USER_FLAGS;
     }
     else {
+        item->flags = 0;
+        if(SLOT_IS_DELETED(table, index)) {
+            table->deletedSize--;
+        }
         table->currentSize++;
     }
 
     // move pointers
     item->key = block;
     item->value = block + key_length + 1;
-    item->state = ITEM_STATE_FULL;
+    item->capacity = capacity;
+    hashTableMarkFull(table, index, hash);
     return SUCCESS;
-} // hashTableInsert
+} // hashTableInsertBytes
 
 
 /**
- * @brief       Resizes hash table to higher prime number and redistributes items
- *          
- *              FUnction increases the size of the hashtable to the next prime number
- *              while also re-inserting all FULL item indexes (DELETED and EMPTY indexes 
- *              are ignored)
- *              
- * 
- * @param table Pointer to hashtable which will be resized to next size
- * @return      error exit code 3 if allocation fails or 0 (SUCCESS)
+ * @brief       Moves all items into fresh slot arrays of given capacity
+ *
+ *              Tombstones are dropped on the way, stored hashes are reused so
+ *              keys are neither hashed nor compared
+ *
+ * @param table hashtable which will be rehashed
+ * @param capacity new capacity, must fit all items
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE (table is left untouched)
  */
-StatusEnum hashTableResize(HashTablePtr table) {
-    uint32_t old_capacity = table->capacity;
-
-    StatusEnum st = hashTableNextPrime(&(table->capacity));
-    ERR_CHECK(st);
+static StatusEnum hashTableRehash(HashTablePtr table, uint32_t capacity) {
+    HashTable old_table = *table;
 
-    HashTableItemPtr new_data = malloc(sizeof(HashTableItem) * table->capacity);
-    if(new_data == NULL) {
-        table->capacity = old_capacity;
-        return ERROR_MALLOC_FAILURE;
+    StatusEnum st = hashTableAllocSlots(table, capacity);
+    if(st != SUCCESS) {
+        *table = old_table;
+        return st;
     }
 
-    HashTableItemPtr old_data = table->data;
-    // default state to all new indexes
-    table->data = new_data;
-    for (uint32_t i = 0; i < table->capacity; i++) {
-        table->data[i].state = ITEM_STATE_EMPTY;
-        table->data[i].key = NULL;
-        table->data[i].value = NULL;
-    }
-
-    // reenter all full indexes
+    // reenter all full indexes, keys are unique so first free slot is the place
+    for(uint32_t i = 0; i < old_table.capacity; i++) {
+        if(!SLOT_IS_FULL(&old_table, i)) {
+            continue;
+        }
 
-    uint32_t new_table_index;
-    for(uint32_t i = 0; i < old_capacity; i++) {
-        if(old_data[i].state == ITEM_STATE_FULL) {
-            new_table_index = hashTableFindIndex(table, old_data[i].key);
+        uint32_t hash = old_table.hashes[i];
+        uint32_t index = hashTableFindFree(table, hash);
 
-            // indexing error
-            if(new_table_index == -1) {
-                free(new_data);
-                table->data = old_data;
-                table->capacity = old_capacity;
-                return ERROR_INDEX_OUT_OF_BOUNDS;
-            }
-            // move pointers to correct positions
-            table->data[new_table_index].state = ITEM_STATE_FULL;
-            table->data[new_table_index].key = old_data[i].key;
-            table->data[new_table_index].value = old_data[i].value;
-        } // if
+        // move pointers to correct positions
+        table->data[index] = old_table.data[i];
+        hashTableMarkFull(table, index, hash);
     } // for
 
-    free(old_data);
+    free(old_table.data);
     return SUCCESS;
-} // hashTableResize
+} // hashTableRehash
 
 
 /**
- * @brief       Finds corresponding index of key in hashmap
+ * @brief       Resizes hash table to higher prime number and redistributes items
  *          
- *              Function that calculates corresponding index of key based on its two hashes,
- *              if position is FULL or DESTROYED it moves to next index until it finds a open one.
- *              If key is already in hashtable it returns the index where its located
- *
- * @param table Hash table in which the index will be searched for
- * @param key   String that corresponds to the index
- * @return      Int position(index) where key should be inserted or is located(insertion/deletion)
- *              -1 if index is not found
+ *              FUnction increases the size of the hashtable to the next prime number
+ *              while also re-inserting all FULL item indexes (DELETED and EMPTY indexes 
+ *              are ignored). Stored hashes are reused, keys are neither hashed nor compared.
+ *              When the live items alone still leave room below the load limit the
+ *              table is only rehashed in place, which drops tombstones without growing
+ *              
+ * 
+ * @param table Pointer to hashtable which will be resized to next size
+ * @return      error exit code 3 if allocation fails or 0 (SUCCESS)
  */
-static int32_t hashTableFindIndex(HashTablePtr table, const char* key) {
-    int32_t table_index;
-
-    // calculate hashes of key
-    uint32_t base_index = hash1(key) % table->capacity;
-    uint32_t step = (hash2(key) % (table->capacity - 1)) + 1;
-    int32_t first_deleted = -1;
-    // loop through every index of table (guaranteed because of a prime number)
-    for(uint32_t i = 0; i < table->capacity; i++) {
-        // calculate the correct index
-        table_index = (base_index + i * step) % table->capacity;
-
-        HashTableItemPtr item = &(table->data[table_index]);
+StatusEnum hashTableResize(HashTablePtr table) {
+    uint32_t new_capacity = table->capacity;
 
-        if(item->state == ITEM_STATE_DELETED) {
-            if(first_deleted == -1) {
-                first_deleted = table_index;
-            }
-        }
-        // if its not in hashtable replace it with first occurence
-        if(item->state == ITEM_STATE_EMPTY) {
-            return (first_deleted != -1 ? first_deleted : table_index);
-        }
-    
-        // if its found return it
-        if(item->state == ITEM_STATE_FULL && strcmp(key, item->key) == 0) {
-            return table_index;
-        }
+    if(hashTableCrowded(table)) {
+        StatusEnum st = hashTableNextCapacity(&new_capacity);
+        ERR_CHECK(st);
     }
-    return -1; // index not found
-} // hashTableFindIndex
+    return hashTableRehash(table, new_capacity);
+} // hashTableResize
 
 
 /**
@@ -306,7 +734,7 @@ static int32_t hashTableFindIndex(HashTablePtr table, const char* key) {
  * 
  *              Function that removes an item from hashtable (frees all allocated structures) 
  *              based on the hash of input key. If no index is found or the index is empty 
- *              function does nothing.
+ *              function does nothing. Table shrinks when less than 3/16 of it is used.
  * 
  * @param table hashmap which holds indexes
  * @param key   key based on which index will be deleted
@@ -317,31 +745,39 @@ StatusEnum hashTableRemove(HashTablePtr table, const char* key) {
         return ERROR_DEFAULT;
     }
 
-    int32_t index = hashTableFindIndex(table, key);
+    int32_t index = hashTableFindIndex(table, key, hash1(key));
 
     // index was not found
     if(index == -1) {
         return SUCCESS;
     }
 
-    HashTableItemPtr item = &(table->data[index]);
     // index was deleted or empty
-    if(item->state == ITEM_STATE_DELETED || item->state == ITEM_STATE_EMPTY) {
+    if(!SLOT_IS_FULL(table, index)) {
         return SUCCESS;
     }
+
     // free one block
-    if(item->key != NULL) {
-        free(item->key);
-    }
+    HashTableItemPtr item = &(table->data[index]);
+    free(item->key);
 
     item->key = NULL;
     item->value = NULL;
     table->currentSize--;
-    item->state = ITEM_STATE_DELETED;
+    hashTableMarkDeleted(table, index);
+
+    // shrink when mostly empty, failure only means the table stays bigger
+    if(table->capacity > hashTableFirstCapacity() &&
+       (uint64_t)table->currentSize * SHRINK_FACTOR_DENUM < (uint64_t)table->capacity * SHRINK_FACTOR_NUM) {
+        uint32_t new_capacity = table->capacity;
+        hashTableShrinkCapacity(&new_capacity);
+        hashTableRehash(table, new_capacity);
+    }
     return SUCCESS;
 } // hashTableRemove 
 
 
+#ifndef HTAB_SWISS
 /**
  *  @brief      Finds next higher prime of input num from hashtable_prime_capacities
  *
@@ -443,32 +879,139 @@ static uint8_t isPrime(uint32_t n) {
     }
     return 1U;
 } // isPrime
+#endif
 
 
 /**
- * @brief
- * 
- * @param
- * @param
- * @param
- * @return
+ * @brief       Writes text of number stored by hashTableSetNumber() into the value
+ *
+ *              Text which fits into the value capacity is written in place,
+ *              otherwise the key block is reallocated
+ *
+ * @param item  item with HTAB_ITEM_STALE
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE (item keeps its old text)
+ */
+static StatusEnum hashTableWriteNumber(HashTableItemPtr item) {
+    char text[24];
+    uint32_t length = (uint32_t) snprintf(text, sizeof(text), "%lld", (long long)item->number);
+    if(length + 1 > item->capacity) {
+        size_t key_length = (size_t)(item->value - item->key) - 1;
+        uint32_t capacity = hashTableValueClass(length + 1);
+        char* block = (char*) realloc(item->key, key_length + 1 + capacity);
+        if(block == NULL) {
+            return ERROR_MALLOC_FAILURE;
+        }
+        item->key = block;
+        item->value = block + key_length + 1;
+        item->capacity = capacity;
+    }
+    memcpy(item->value, text, length + 1);
+    item->flags &= ~HTAB_ITEM_STALE;
+    return SUCCESS;
+} // hashTableWriteNumber
+
+
+/**
+ * @brief       Finds item stored under key
+ *
+ *              Lets callers read and set the number of a value without
+ *              copying it, item is valid until the table is modified.
+ *              Value text of an item with HTAB_ITEM_STALE is out of date
+ *
+ * @param table hashtable which is searched
+ * @param key   key of the searched item
+ * @return      item, NULL if key is not in table
  */
-StatusEnum hashTableGetValue(HashTablePtr table, char* key, char** value) {
+HashTableItemPtr hashTableFindItem(HashTablePtr table, const char* key) {
     if(key == NULL || table == NULL || table->data == NULL) {
-        return ERROR_DEFAULT;
+        return NULL;
     }
-    //// find index
-    uint32_t index = hashTableFindIndex(table, key);
-    if(index == -1) {
-        return ERROR_INDEX_OUT_OF_BOUNDS;
+    int32_t index = hashTableFindIndex(table, key, hash1(key));
+    if(index == -1 || !SLOT_IS_FULL(table, index)) {
+        return NULL;
     }
+    return &table->data[index];
+} // hashTableFindItem
 
-    
-    HashTableItemPtr item = &(table->data[index]);
-    if(item->state == ITEM_STATE_EMPTY || item->state == ITEM_STATE_DELETED) {
-        return ERROR_DEFAULT;
+
+/**
+ * @brief       Stores number as the value of item, its text is written lazily
+ *
+ *              Nothing is formatted or allocated until the value is read
+ *              as text by hashTableGetValue() or hashTableIterate()
+ *
+ * @param item  item of a string value found by hashTableFindItem()
+ * @param number new value
+ */
+void hashTableSetNumber(HashTableItemPtr item, int64_t number) {
+    item->number = number;
+    item->flags = (item->flags & HTAB_ITEM_USER_FLAGS) | HTAB_ITEM_NUMBER | HTAB_ITEM_STALE;
+} // hashTableSetNumber
+
+
+/**
+ * @brief       Returns text of item found by hashTableFindItem()
+ *
+ * @param item  item of the table
+ * @param value output pointer to value stored in the table (not a copy)
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE when the text of a number could not be written
+ */
+StatusEnum hashTableItemValue(HashTableItemPtr item, char** value) {
+    if(item->flags & HTAB_ITEM_STALE) {
+        StatusEnum st = hashTableWriteNumber(item);
+        ERR_CHECK(st);
     }
-    // returning the value
     *value = item->value;
     return SUCCESS;
-}
\ No newline at end of file
+} // hashTableItemValue
+
+
+/**
+ * @brief       Looks up value stored under key
+ *
+ * @param table hashtable which is searched
+ * @param key   key of the searched item
+ * @param value output pointer to value stored in the table (not a copy)
+ * @return      SUCCESS, ERROR_DEFAULT if key is not in table, ERROR_MALLOC_FAILURE
+ *              when the text of a number could not be written
+ */
+StatusEnum hashTableGetValue(HashTablePtr table, const char* key, char** value) {
+    if(key == NULL || table == NULL || table->data == NULL) {
+        return ERROR_DEFAULT;
+    }
+    //// find index, missing key is reported the same way whether probing ended or not
+    int32_t index = hashTableFindIndex(table, key, hash1(key));
+    if(index == -1 || !SLOT_IS_FULL(table, index)) {
+        return ERROR_DEFAULT;
+    }
+    return hashTableItemValue(&table->data[index], value);
+} // hashTableGetValue
+
+
+/**
+ * @brief       Iterates over items of hashtable
+ *
+ *              Start with position 0, order of items is the order of slots,
+ *              table must not be modified while iterating
+ *
+ * @param table hashtable to iterate
+ * @param position iteration cursor, updated by every call
+ * @param key   output key of next item
+ * @param value output value of next item
+ * @return      1 when item was returned, 0 when there are no more items
+ */
+uint8_t hashTableIterate(HashTablePtr table, uint32_t* position, char** key, char** value) {
+    while(*position < table->capacity) {
+        uint32_t index = (*position)++;
+        if(SLOT_IS_FULL(table, index)) {
+            // on allocation failure the old text is returned
+            if(table->data[index].flags & HTAB_ITEM_STALE) {
+                hashTableWriteNumber(&table->data[index]);
+            }
+            *key = table->data[index].key;
+            *value = table->data[index].value;
+            return 1U;
+        }
+    }
+    return 0U;
+} // hashTableIterate
@@ -1,3 +1,6 @@
+#ifndef HTAB_H
+#define HTAB_H
+
 #include "../utils/strings.h"
 #include "../utils/error.h"
 
@@ -9,18 +12,38 @@ typedef enum {
 } HtabState;
 
 
-//
+// item flags, a value may carry the integer it stands for
+#define HTAB_ITEM_NUMBER    0x01U   // number holds the value
+#define HTAB_ITEM_STALE     0x02U   // value text is older than number, it is written on the next read
+// flags left to the owner of the table, replacing the value keeps them
+#define HTAB_ITEM_USER_FLAGS 0xFF00U
+
+// values which outgrow their block get the next power of two from this size on
+#define HTAB_VALUE_MIN_CLASS 16U
+// above this size values grow in multiples of it instead of doubling
+#define HTAB_VALUE_MAX_CLASS 4096U
+
+/*  Key and value share one block, the value part may be larger than the
+    value so reassigning a key reuses the block while the new value fits */
 typedef struct {
     char* key;
     char* value;
-    HtabState state;
+    int64_t number;             // valid with HTAB_ITEM_NUMBER
+    uint32_t flags;             // HTAB_ITEM_NUMBER, HTAB_ITEM_STALE, HTAB_ITEM_USER_FLAGS
+    uint32_t capacity;          // bytes available for value in the block
 } HashTableItem, *HashTableItemPtr;
 
 
-//
+/*  Split layout, probing reads only the byte per slot state array and the
+    stored 32bit hashes, items (key memory) are touched on hash match only.
+    Built with -DHTAB_SWISS the table uses power of two capacity and group
+    probing, states then hold control bytes (7bit hash tag when FULL) */
 typedef struct hashtable {
-    HashTableItemPtr data;
+    HashTableItemPtr data;      // key/value pointers, start of the slot allocation
+    uint32_t* hashes;           // hash1 of key for every FULL slot
+    uint8_t* states;            // HtabState (or control byte) of every slot
     uint32_t currentSize;
+    uint32_t deletedSize;       // DELETED slots (tombstones)
     uint32_t capacity;
 } HashTable, *HashTablePtr;
 
@@ -43,8 +66,7 @@ uint32_t hash2(const char *key);
  * @brief       Initializes open adressing resizable hashtable
  *              
  *              Function inits a resizable open addressing hashtable,
- *              allocates array for items, sets all indexes to ITEM_STATE_OPEN
- *              and all pointers to NULL
+ *              allocates slot arrays and sets all states to ITEM_STATE_EMPTY
  * 
  * @param table pointer to HashTable structure which is passed by address
  * @return      int enum 0 on success, 3 on malloc failure(not eough memory)   
@@ -67,9 +89,10 @@ void hashTableDtor(HashTablePtr table);
  * @brief       Inserts a item into hashtable based on hashed key
  *      
  *              Function for inserting item into hashtable based on hashed value of "key".
- *              If item with same key is already in hashtable the value of item is replaced
- *              and old one is trashed, If function has allocation failure or hash indexing failure
- *              corresponding exit values are returned otherwise 0(SUCCESS) is returned
+ *              If item with same key is already in hashtable the value of item is replaced,
+ *              in place when it fits into the block of the key. If function has allocation
+ *              failure or hash indexing failure corresponding exit values are returned
+ *              otherwise 0(SUCCESS) is returned
  * 
  * @param table Pointer to hashtabnle structure in which item will be inserted
  * @param key   String value based on which position in the hashtable is decided
@@ -79,12 +102,29 @@ void hashTableDtor(HashTablePtr table);
  */
 StatusEnum hashTableInsert(HashTablePtr table, const char* key, const char* value);
 
+/**
+ * @brief       Inserts item whose value is a block of bytes instead of a string
+ *
+ *              Same as hashTableInsert() but value_size bytes are copied, this lets
+ *              tables map names to small structures (pointers of functions etc.).
+ *              Value is not aligned, it has to be read with memcpy()
+ *
+ * @param table hashtable in which item will be inserted
+ * @param key   string key
+ * @param value bytes associated with the key
+ * @param value_size number of bytes of value
+ * @return      SUCCESS, ERROR_DEFAULT, ERROR_MALLOC_FAILURE, ERROR_INDEX_OUT_OF_BOUNDS
+ */
+StatusEnum hashTableInsertBytes(HashTablePtr table, const char* key, const void* value, uint32_t value_size);
+
 /**
  * @brief       Resizes hash table to higher prime number and redistributes items
  *          
  *              FUnction increases the size of the hashtable to the next prime number
  *              while also re-inserting all FULL item indexes (DELETED and EMPTY indexes 
- *              are ignored)
+ *              are ignored). Stored hashes are reused, keys are neither hashed nor compared.
+ *              When the live items alone still leave room below the load limit the
+ *              table is only rehashed in place, which drops tombstones without growing
  *              
  * 
  * @param table Pointer to hashtable which will be resized to next size
@@ -92,26 +132,12 @@ StatusEnum hashTableInsert(HashTablePtr table, const char* key, const char* valu
  */
 StatusEnum hashTableResize(HashTablePtr table);
 
-/**
- * @brief       Finds corresponding index of key in hashmap
- *          
- *              Function that calculates corresponding index of key based on its two hashes,
- *              if position is FULL or DESTROYED it moves to next index until it finds a open one.
- *              If key is already in hashtable it returns the index where its located
- *
- * @param table Hash table in which the index will be searched for
- * @param key   String that corresponds to the index
- * @return      Int position(index) where key should be inserted or is located(insertion/deletion)
- *              -1 if index is not found
- */
-static int32_t hashTableFindIndex(HashTablePtr table, const char* key);
-
 /**
  * @brief       Deletes an item from hashtable based on the input key
  * 
  *              Function that removes an item from hashtable (frees all allocated structures) 
  *              based on the hash of input key. If no index is found or the index is empty 
- *              function does nothing.
+ *              function does nothing. Table shrinks when less than 3/16 of it is used.
  * 
  * @param table hashmap which holds indexes
  * @param key   key based on which index will be deleted
@@ -120,30 +146,61 @@ static int32_t hashTableFindIndex(HashTablePtr table, const char* key);
 StatusEnum hashTableRemove(HashTablePtr table, const char* key);
 
 /**
- *  @brief      Finds next higher prime of input num from hashtable_prime_capacities
+ * @brief       Finds item stored under key
  *
- *              Function thaht finds the next higher prime number from input number and 
- *              hashtable_prime_capacities, looking up next primes with binary search, 
- *              if the number needs to be higher or is already higher it looks one up by
- *              by looping       
- * 
- *  @param  num num based on which next size of hashtable will be decided
- *  @return     int default error 1 if passed a NULL, 3 if integer overflow happens
+ *              Lets callers read and set the number of a value without
+ *              copying it, item is valid until the table is modified.
+ *              Value text of an item with HTAB_ITEM_STALE is out of date
+ *
+ * @param table hashtable which is searched
+ * @param key   key of the searched item
+ * @return      item, NULL if key is not in table
+ */
+HashTableItemPtr hashTableFindItem(HashTablePtr table, const char* key);
+
+/**
+ * @brief       Stores number as the value of item, its text is written lazily
+ *
+ *              Nothing is formatted or allocated until the value is read
+ *              as text by hashTableGetValue() or hashTableIterate()
+ *
+ * @param item  item of a string value found by hashTableFindItem()
+ * @param number new value
  */
-static StatusEnum hashTableNextPrime(uint32_t* num);
+void hashTableSetNumber(HashTableItemPtr item, int64_t number);
 
 /**
- * @brief  Finds the smallest prime number greater than num
+ * @brief       Returns text of item found by hashTableFindItem()
  *
- * @param  num  Starting value for the prime search
- * @return The closest prime number > num
+ * @param item  item of the table
+ * @param value output pointer to value stored in the table (not a copy)
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE when the text of a number could not be written
  */
-static uint32_t closestHigherPrime(uint32_t num);
+StatusEnum hashTableItemValue(HashTableItemPtr item, char** value);
 
 /**
- * @brief  Tests whether a number is prime
+ * @brief       Looks up value stored under key
  *
- * @param  n  Number to test
- * @return 1 if n is prime, 0 otherwise
+ * @param table hashtable which is searched
+ * @param key   key of the searched item
+ * @param value output pointer to value stored in the table (not a copy)
+ * @return      SUCCESS, ERROR_DEFAULT if key is not in table, ERROR_MALLOC_FAILURE
+ *              when the text of a number could not be written
  */
-static uint8_t isPrime(uint32_t n);
\ No newline at end of file
+StatusEnum hashTableGetValue(HashTablePtr table, const char* key, char** value);
+
+/**
+ * @brief       Iterates over items of hashtable
+ *
+ *              Start with position 0, order of items is the order of slots,
+ *              table must not be modified while iterating
+ *
+ * @param table hashtable to iterate
+ * @param position iteration cursor, updated by every call
+ * @param key   output key of next item
+ * @param value output value of next item
+ * @return      1 when item was returned, 0 when there are no more items
+ */
+uint8_t hashTableIterate(HashTablePtr table, uint32_t* position, char** key, char** value);
+
+#endif
@@ -0,0 +1,316 @@
+/**
+ * Evaluation of arithmetic expansion
+ *
+ * Programs compiled by the parser run on a fixed value stack, nothing is
+ * allocated unless a variable holds an expression instead of a number
+ */
+
+#include <string.h>
+#include "arithmetic.h"
+#include "variables.h"
+#include "../shell.h"
+
+// $name values of a program are kept on the C stack up to this count
+#define ARITH_LOCAL_PARAMS 8U
+
+// variables evaluated as expressions right now
+static uint32_t recursion_depth = 0;
+
+
+/**
+ * @brief       Parses value which is a plain number with optional sign and blanks
+ *
+ * @param text  NUL terminated value
+ * @param value output number
+ * @return      1 for plain number, 0 otherwise (also for empty text)
+ */
+static uint8_t plain_number(const char* text, int64_t* value) {
+    while(*text == ' ' || *text == '\t' || *text == '\n') {
+        text++;
+    }
+    uint8_t negative = (*text == '-') ? 1U : 0U;
+    if(*text == '-' || *text == '+') {
+        text++;
+    }
+    const char* end = text + strlen(text);
+    const char* p = arith_parse_number(text, end, value);
+    if(p == NULL) {
+        return 0U;
+    }
+    while(*p == ' ' || *p == '\t' || *p == '\n') {
+        p++;
+    }
+    if(*p != '\0') {
+        return 0U;
+    }
+    if(negative) {
+        *value = (int64_t)(0 - (uint64_t)*value);
+    }
+    return 1U;
+} // plain_number
+
+
+/**
+ * @brief       Reads number of variable, a plain number in its text is cached in the item
+ * @return      1 for number, 0 when the variable is unset or its text is not a plain number
+ */
+static uint8_t variable_number(HashTableItemPtr item, int64_t* number) {
+    if(item == NULL) {
+        return 0U;
+    }
+    if(item->flags & HTAB_ITEM_NUMBER) {
+        *number = item->number;
+        return 1U;
+    }
+    if(!plain_number(item->value, number)) {
+        return 0U;
+    }
+    item->number = *number;
+    item->flags |= HTAB_ITEM_NUMBER;
+    return 1U;
+} // variable_number
+
+
+/**
+ * @brief       Reads $name or $1 used in expression
+ * @return      1 for plain number, 0 when the text has to be substituted
+ */
+static uint8_t param_number(ShellStatePtr shell, const char* name, int64_t* number) {
+    if(*name < '0' || *name > '9') {
+        return variable_number(shell_find_variable(shell, name), number);
+    }
+    uint64_t index = 0;
+    for(const char* p = name; *p != '\0' && index <= UINT32_MAX; p++) {
+        index = index * 10 + (uint64_t)(*p - '0');
+    }
+    if(index == 0) {
+        return (shell->script_name != NULL) ? plain_number(shell->script_name, number) : 0U;
+    }
+    return (index <= shell->positional_count) ? plain_number(shell->positional[index - 1], number) : 0U;
+} // param_number
+
+
+/**
+ * @brief       Reads variable used by name, its value may be an expression itself
+ */
+static StatusEnum load_variable(ShellStatePtr shell, const char* name, int64_t* result) {
+    HashTableItemPtr item = shell_find_variable(shell, name);
+    *result = 0;
+    if(item == NULL || variable_number(item, result)) {
+        return SUCCESS;
+    }
+    const char* value = item->value;
+    const char* p = value;
+    while(*p == ' ' || *p == '\t' || *p == '\n') {
+        p++;
+    }
+    if(*p == '\0') {
+        return SUCCESS;
+    }
+
+    if(recursion_depth >= ARITH_RECURSION_MAX) {
+        print_error("%s: expression recursion level exceeded", name);
+        return ERROR_FATAL_EXPANSION;
+    }
+    // assignments inside the expression may replace the stored value
+    char* text = arenaStrndup(&shell->command_arena, value, strlen(value));
+    if(text == NULL) {
+        return ERROR_MALLOC_FAILURE;
+    }
+    recursion_depth++;
+    StatusEnum st = arith_evaluate(shell, text, strlen(text), result);
+    recursion_depth--;
+    return st;
+} // load_variable
+
+
+/**
+ * @brief       Runs compiled arithmetic expression
+ *
+ *              Variables hold numbers or expressions which are evaluated in
+ *              turn, unset and empty ones are 0. Operations wrap around
+ *              in 64 bits, shift counts are taken modulo 64
+ *
+ * @param shell shell state
+ * @param program compiled expression
+ * @param result output value
+ * @param textual output 1 when a $name of the expression does not hold a plain
+ *              number, the text has to be expanded and compiled instead. Nothing
+ *              was evaluated then
+ * @return      SUCCESS, ERROR_FATAL_EXPANSION on division by zero and similar
+ *              errors (reported to stderr), ERROR_MALLOC_FAILURE
+ */
+StatusEnum arith_run(ShellStatePtr shell, ArithProgramPtr program, int64_t* result, uint8_t* textual) {
+    *textual = 0U;
+
+    // $name is replaced by its text before evaluation, so all of them are read first
+    int64_t local_params[ARITH_LOCAL_PARAMS];
+    int64_t* params = local_params;
+    if(program->param_count > ARITH_LOCAL_PARAMS) {
+        params = (int64_t*) arenaAlloc(&shell->command_arena, sizeof(int64_t) * program->param_count);
+        if(params == NULL) {
+            return ERROR_MALLOC_FAILURE;
+        }
+    }
+    for(uint32_t i = 0; i < program->length && program->param_count > 0; i++) {
+        ArithInstructionPtr instruction = &program->code[i];
+        if(instruction->op != ARITH_PARAM) {
+            continue;
+        }
+        if(!param_number(shell, instruction->name, &params[instruction->arg])) {
+            *textual = 1U;
+            return SUCCESS;
+        }
+    }
+
+    int64_t stack[ARITH_STACK_SIZE];
+    uint32_t top = 0;
+    uint32_t pc = 0;
+    StatusEnum st;
+    while(pc < program->length) {
+        ArithInstructionPtr instruction = &program->code[pc++];
+        switch(instruction->op) {
+            case ARITH_PUSH:
+                stack[top++] = instruction->value;
+                break;
+            case ARITH_LOAD:
+                st = load_variable(shell, instruction->name, &stack[top]);
+                ERR_CHECK(st);
+                top++;
+                break;
+            case ARITH_PARAM:
+                stack[top++] = params[instruction->arg];
+                break;
+            case ARITH_STORE:
+                st = shell_set_number(shell, instruction->name, stack[top - 1]);
+                ERR_CHECK(st);
+                break;
+            case ARITH_DUP:
+                stack[top] = stack[top - 1];
+                top++;
+                break;
+            case ARITH_POP:
+                top--;
+                break;
+            case ARITH_NEG:
+                stack[top - 1] = (int64_t)(0 - (uint64_t)stack[top - 1]);
+                break;
+            case ARITH_NOT:
+                stack[top - 1] = !stack[top - 1];
+                break;
+            case ARITH_BITNOT:
+                stack[top - 1] = ~stack[top - 1];
+                break;
+            case ARITH_BOOL:
+                stack[top - 1] = (stack[top - 1] != 0);
+                break;
+            case ARITH_AND:
+                if(stack[top - 1] == 0) {
+                    pc = instruction->arg;
+                }
+                else {
+                    top--;
+                }
+                break;
+            case ARITH_OR:
+                if(stack[top - 1] != 0) {
+                    stack[top - 1] = 1;
+                    pc = instruction->arg;
+                }
+                else {
+                    top--;
+                }
+                break;
+            case ARITH_JUMP:
+                pc = instruction->arg;
+                break;
+            case ARITH_JUMP_IF_ZERO:
+                top--;
+                if(stack[top] == 0) {
+                    pc = instruction->arg;
+                }
+                break;
+            default:
+                top--;
+                if(!arith_apply(instruction->op, stack[top - 1], stack[top], &stack[top - 1])) {
+                    print_error("%.*s: %s", (int)program->source_length, program->source,
+                                (instruction->op == ARITH_POW) ? "exponent less than 0" : "division by 0");
+                    return ERROR_FATAL_EXPANSION;
+                }
+                break;
+        }
+    }
+    *result = stack[top - 1];
+    return SUCCESS;
+} // arith_run
+
+
+/**
+ * @brief       Compiles and runs expression whose expansions are already done
+ *
+ * @param shell shell state
+ * @param text  expression
+ * @param length length of text
+ * @param result output value
+ * @return      SUCCESS, ERROR_FATAL_EXPANSION on syntax and evaluation errors
+ *              (reported to stderr), ERROR_MALLOC_FAILURE
+ */
+StatusEnum arith_evaluate(ShellStatePtr shell, const char* text, size_t length, int64_t* result) {
+    ArenaMark mark = arenaMark(&shell->command_arena);
+    ArithProgramPtr program = NULL;
+    uint8_t textual = 0U;
+    StatusEnum st = arith_compile(text, length, &shell->command_arena, &program);
+    if(st == SUCCESS) {
+        st = arith_run(shell, program, result, &textual);
+    }
+    arenaRelease(&shell->command_arena, mark);
+
+    // $ left after expansion came from a value, it is not expanded again
+    if(st == ERROR_SHELL_MISUSE || (st == ERROR_DEFAULT && program == NULL) || (st == SUCCESS && textual)) {
+        print_error("%.*s: arithmetic syntax error", (int)length, text);
+        return ERROR_FATAL_EXPANSION;
+    }
+    return st;
+} // arith_evaluate
+
+
+/**
+ * @brief       Assigns NAME=$(( )) word made of one compiled expansion as a number
+ *
+ *              The result is kept as the number of the variable, so a counter
+ *              updated by i=$((i+1)) is never formatted or parsed in the loop
+ *
+ * @param shell shell state
+ * @param word  assignment word of the syntax tree
+ * @param done  output 1 when the variable was assigned, 0 when the word has to
+ *              be expanded as usual
+ * @return      SUCCESS, ERROR_FATAL_EXPANSION on evaluation errors (reported to
+ *              stderr), ERROR_MALLOC_FAILURE
+ */
+StatusEnum arith_assign(ShellStatePtr shell, WordPtr word, uint8_t* done) {
+    *done = 0U;
+    ArithExpansionPtr expansion = word->arithmetic;
+    if(expansion == NULL || expansion->next != NULL) {
+        return SUCCESS;
+    }
+    const char* equals = strchr(word->text, '=');
+    ArithProgramPtr program = expansion->program;
+    if(expansion->offset != (uint32_t)(equals + 1 - word->text) ||
+       program->source + program->source_length + 2 != word->text + word->length) {
+        return SUCCESS;
+    }
+
+    int64_t value;
+    uint8_t textual;
+    StatusEnum st = arith_run(shell, program, &value, &textual);
+    if(st != SUCCESS || textual) {
+        return st;
+    }
+    char* name = arenaStrndup(&shell->command_arena, word->text, (size_t)(equals - word->text));
+    if(name == NULL) {
+        return ERROR_MALLOC_FAILURE;
+    }
+    st = shell_set_number(shell, name, value);
+    *done = (st == SUCCESS) ? 1U : 0U;
+    return st;
+} // arith_assign
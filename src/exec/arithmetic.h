@@ -0,0 +1,56 @@
+#ifndef ARITHMETIC_H
+#define ARITHMETIC_H
+
+#include <stdint.h>
+#include "exec.h"
+#include "../parser/parser.h"
+
+// deepest chain of variables whose values are expressions themselves
+#define ARITH_RECURSION_MAX 1024U
+
+/**
+ * @brief       Runs compiled arithmetic expression
+ *
+ *              Variables hold numbers or expressions which are evaluated in
+ *              turn, unset and empty ones are 0. Operations wrap around
+ *              in 64 bits, shift counts are taken modulo 64
+ *
+ * @param shell shell state
+ * @param program compiled expression
+ * @param result output value
+ * @param textual output 1 when a $name of the expression does not hold a plain
+ *              number, the text has to be expanded and compiled instead. Nothing
+ *              was evaluated then
+ * @return      SUCCESS, ERROR_FATAL_EXPANSION on division by zero and similar
+ *              errors (reported to stderr), ERROR_MALLOC_FAILURE
+ */
+StatusEnum arith_run(ShellStatePtr shell, ArithProgramPtr program, int64_t* result, uint8_t* textual);
+
+/**
+ * @brief       Compiles and runs expression whose expansions are already done
+ *
+ * @param shell shell state
+ * @param text  expression
+ * @param length length of text
+ * @param result output value
+ * @return      SUCCESS, ERROR_FATAL_EXPANSION on syntax and evaluation errors
+ *              (reported to stderr), ERROR_MALLOC_FAILURE
+ */
+StatusEnum arith_evaluate(ShellStatePtr shell, const char* text, size_t length, int64_t* result);
+
+/**
+ * @brief       Assigns NAME=$(( )) word made of one compiled expansion as a number
+ *
+ *              The result is kept as the number of the variable, so a counter
+ *              updated by i=$((i+1)) is never formatted or parsed in the loop
+ *
+ * @param shell shell state
+ * @param word  assignment word of the syntax tree
+ * @param done  output 1 when the variable was assigned, 0 when the word has to
+ *              be expanded as usual
+ * @return      SUCCESS, ERROR_FATAL_EXPANSION on evaluation errors (reported to
+ *              stderr), ERROR_MALLOC_FAILURE
+ */
+StatusEnum arith_assign(ShellStatePtr shell, WordPtr word, uint8_t* done);
+
+#endif
@@ -0,0 +1,557 @@
+/**
+ * Builtin commands executed inside the shell process
+ */
+
+#include "builtins.h"
+#include "variables.h"
+#include "utilities.h"
+#include "parallel.h"
+#include "vm.h"
+
+typedef struct {
+    const char* name;
+    BuiltinFunction function;
+} BuiltinEntry;
+
+static int32_t builtin_hash(ShellStatePtr shell, uint32_t argc, char** argv);
+static int32_t builtin_local(ShellStatePtr shell, uint32_t argc, char** argv);
+static int32_t builtin_unset(ShellStatePtr shell, uint32_t argc, char** argv);
+static int32_t builtin_export(ShellStatePtr shell, uint32_t argc, char** argv);
+static int32_t builtin_break(ShellStatePtr shell, uint32_t argc, char** argv);
+static int32_t builtin_return(ShellStatePtr shell, uint32_t argc, char** argv);
+static int32_t builtin_exit(ShellStatePtr shell, uint32_t argc, char** argv);
+static int32_t builtin_wait(ShellStatePtr shell, uint32_t argc, char** argv);
+static int32_t builtin_jobs(ShellStatePtr shell, uint32_t argc, char** argv);
+
+static const BuiltinEntry builtin_table[] = {
+    {"hash", builtin_hash},
+    {"local", builtin_local},
+    {"unset", builtin_unset},
+    {"export", builtin_export},
+    {"break", builtin_break},
+    {"continue", builtin_break},
+    {"return", builtin_return},
+    {"exit", builtin_exit},
+    {"wait", builtin_wait},
+    {"jobs", builtin_jobs},
+    {"true", builtin_true},
+    {":", builtin_true},
+    {"false", builtin_false},
+    {"echo", builtin_echo},
+    {"printf", builtin_printf},
+    {"test", builtin_test},
+    {"[", builtin_test},
+    {"basename", builtin_basename},
+    {"dirname", builtin_dirname},
+    {"read", builtin_read},
+    {"parallel", builtin_parallel},
+};
+
+
+/**
+ * @brief       Fills dispatch table of builtins
+ *
+ * @param table uninitialized table, name -> BuiltinFunction stored as bytes
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+StatusEnum builtins_register(HashTablePtr table) {
+    StatusEnum st = hashTableCtor(table);
+    ERR_CHECK(st);
+
+    uint32_t count = sizeof(builtin_table) / sizeof(builtin_table[0]);
+    for(uint32_t i = 0; i < count; i++) {
+        st = hashTableInsertBytes(table, builtin_table[i].name, &builtin_table[i].function, sizeof(BuiltinFunction));
+        if(st != SUCCESS) {
+            hashTableDtor(table);
+            return st;
+        }
+    }
+    return SUCCESS;
+} // builtins_register
+
+
+/**
+ * @brief       Finds builtin by command name
+ * @param shell shell state with the builtin table
+ * @param name  command name
+ * @return      builtin function, NULL if name is not a builtin
+ */
+BuiltinFunction find_builtin(ShellStatePtr shell, const char* name) {
+    char* value;
+    if(hashTableGetValue(&shell->builtins, name, &value) != SUCCESS) {
+        return NULL;
+    }
+    // values are not aligned
+    BuiltinFunction function;
+    memcpy(&function, value, sizeof(function));
+    return function;
+} // find_builtin
+
+
+/**
+ * @brief       hash [-r] [name...]
+ *
+ *              Without arguments prints remembered command locations, -r forgets
+ *              all of them, names are looked up in PATH and remembered
+ */
+static int32_t builtin_hash(ShellStatePtr shell, uint32_t argc, char** argv) {
+    uint32_t i = 1;
+    if(i < argc && streq(argv[i], "-r")) {
+        if(path_cache_clear(shell) != SUCCESS) {
+            return ERROR_DEFAULT;
+        }
+        i++;
+    }
+    else if(i < argc && argv[i][0] == '-' && argv[i][1] != '\0') {
+        print_error("hash: %s: invalid option", argv[i]);
+        output_string(STDERR_FILENO, "hash: usage: hash [-r] [name ...]\n");
+        return ERROR_SHELL_MISUSE;
+    }
+
+    // listing only when nothing else was asked for
+    if(argc == 1) {
+        uint32_t position = 0;
+        char* name;
+        char* location;
+        while(hashTableIterate(&shell->path_cache, &position, &name, &location)) {
+            output_printf(STDOUT_FILENO, "%s\n", location);
+        }
+        return SUCCESS;
+    }
+
+    int32_t status = SUCCESS;
+    char path[PATH_MAX];
+    for(; i < argc; i++) {
+        // names with slash are never looked up
+        if(strchr(argv[i], '/') != NULL) {
+            continue;
+        }
+        if(find_command(shell, argv[i], path) != SUCCESS) {
+            print_error("hash: %s: not found", argv[i]);
+            status = ERROR_DEFAULT;
+        }
+    }
+    return status;
+} // builtin_hash
+
+
+/**
+ * @brief       local name[=value]...
+ *
+ *              Creates variables in the scope of the running function, they
+ *              shadow outer ones until the function returns. Name without
+ *              value starts with the value it currently has (empty if unset).
+ *              Local of an exported name is exported as well
+ */
+static int32_t builtin_local(ShellStatePtr shell, uint32_t argc, char** argv) {
+    VariableScopePtr scope = shell->scope;
+    if(scope == NULL || !scope->function_scope) {
+        print_error("local: can only be used in a function");
+        return ERROR_DEFAULT;
+    }
+
+    int32_t status = SUCCESS;
+    for(uint32_t i = 1; i < argc; i++) {
+        StatusEnum st;
+        if(is_assignment(argv[i])) {
+            char* equals = strchr(argv[i], '=');
+            *equals = '\0';
+            uint8_t exported = shell_is_exported(shell, argv[i]);
+            st = scope_set_local(shell, argv[i], equals + 1);
+            if(st == SUCCESS && exported) {
+                st = shell_export_variable(shell, argv[i]);
+            }
+            *equals = '=';
+        }
+        else if(is_name(argv[i])) {
+            char* value = "";
+            uint8_t exported = shell_is_exported(shell, argv[i]);
+            shell_get_variable(shell, argv[i], &value);
+            st = scope_set_local(shell, argv[i], value);
+            if(st == SUCCESS && exported) {
+                st = shell_export_variable(shell, argv[i]);
+            }
+        }
+        else {
+            print_error("local: `%s': not a valid identifier", argv[i]);
+            status = ERROR_DEFAULT;
+            continue;
+        }
+
+        if(st != SUCCESS) {
+            print_error("local: cannot allocate memory");
+            return ERROR_DEFAULT;
+        }
+    }
+    return status;
+} // builtin_local
+
+
+/**
+ * @brief       unset [-f | -v] name...
+ *
+ *              Removes the nearest visible definition of every name, an unset
+ *              local keeps hiding the outer variable, -f removes functions
+ */
+static int32_t builtin_unset(ShellStatePtr shell, uint32_t argc, char** argv) {
+    uint32_t i = 1;
+    uint8_t functions = 0U;
+    if(i < argc && (streq(argv[i], "-v") || streq(argv[i], "-f"))) {
+        functions = (argv[i][1] == 'f') ? 1U : 0U;
+        i++;
+    }
+    else if(i < argc && argv[i][0] == '-' && argv[i][1] != '\0') {
+        print_error("unset: %s: invalid option", argv[i]);
+        output_string(STDERR_FILENO, "unset: usage: unset [-f | -v] name ...\n");
+        return ERROR_SHELL_MISUSE;
+    }
+
+    if(functions) {
+        for(; i < argc; i++) {
+            function_undefine(shell, argv[i]);
+        }
+        return SUCCESS;
+    }
+
+    int32_t status = SUCCESS;
+    for(; i < argc; i++) {
+        if(!is_name(argv[i])) {
+            print_error("unset: `%s': not a valid identifier", argv[i]);
+            status = ERROR_DEFAULT;
+            continue;
+        }
+        StatusEnum st = shell_unset_variable(shell, argv[i]);
+        if(st != SUCCESS && st != ERROR_DEFAULT) {
+            print_error("unset: cannot allocate memory");
+            return ERROR_DEFAULT;
+        }
+    }
+    return status;
+} // builtin_unset
+
+
+/**
+ * @brief       export [-p] [name[=value]...]
+ *
+ *              Gives variables the export attribute so commands started by the
+ *              shell get them in their environment, name=value assigns the
+ *              variable first. Local names are exported only while their scope
+ *              lives. Without names lists exported global variables
+ */
+static int32_t builtin_export(ShellStatePtr shell, uint32_t argc, char** argv) {
+    uint32_t i = 1;
+    if(i < argc && streq(argv[i], "-p")) {
+        i++;
+    }
+    else if(i < argc && argv[i][0] == '-' && argv[i][1] != '\0') {
+        print_error("export: %s: invalid option", argv[i]);
+        output_string(STDERR_FILENO, "export: usage: export [-p] [name[=value] ...]\n");
+        return ERROR_SHELL_MISUSE;
+    }
+
+    if(i == argc) {
+        uint32_t position = 0;
+        char* name;
+        char* value;
+        while(hashTableIterate(&shell->env_table, &position, &name, &value)) {
+            if(!envIsExported(&shell->env_table, name)) {
+                continue;
+            }
+            // value in single quotes, a quote in it becomes '\''
+            output_printf(STDOUT_FILENO, "export %s='", name);
+            for(char* quote = strchr(value, '\''); quote != NULL; quote = strchr(value, '\'')) {
+                output_write(STDOUT_FILENO, value, (size_t)(quote - value));
+                output_string(STDOUT_FILENO, "'\\''");
+                value = quote + 1;
+            }
+            output_printf(STDOUT_FILENO, "%s'\n", value);
+        }
+        return SUCCESS;
+    }
+
+    int32_t status = SUCCESS;
+    for(; i < argc; i++) {
+        StatusEnum st = SUCCESS;
+        char* equals = strchr(argv[i], '=');
+        if(is_assignment(argv[i])) {
+            *equals = '\0';
+            st = shell_set_variable(shell, argv[i], equals + 1);
+        }
+        else if(!is_name(argv[i])) {
+            print_error("export: `%s': not a valid identifier", argv[i]);
+            status = ERROR_DEFAULT;
+            continue;
+        }
+
+        if(st == SUCCESS) {
+            st = shell_export_variable(shell, argv[i]);
+        }
+        if(equals != NULL) {
+            *equals = '=';
+        }
+        if(st != SUCCESS) {
+            print_error("export: cannot allocate memory");
+            return ERROR_DEFAULT;
+        }
+    }
+    return status;
+} // builtin_export
+
+
+/**
+ * @brief       Parses optional numeric argument of break, continue, return and exit
+ *
+ * @param minimum smallest allowed value
+ * @param value output number, unchanged when argument is missing
+ * @return      1 on success, 0 when argument is not a number (reported)
+ */
+static uint8_t numeric_argument(uint32_t argc, char** argv, long minimum, long* value) {
+    if(argc < 2) {
+        return 1U;
+    }
+    char* end = NULL;
+    errno = 0;
+    long number = strtol(argv[1], &end, 10);
+    if(*argv[1] == '\0' || *end != '\0' || errno == ERANGE || number < minimum) {
+        print_error("%s: %s: numeric argument required", argv[0], argv[1]);
+        return 0U;
+    }
+    *value = number;
+    return 1U;
+} // numeric_argument
+
+
+/**
+ * @brief       break [n], continue [n]
+ *
+ *              Leaves n enclosing loops, continue starts next iteration of
+ *              the n-th one instead of leaving it
+ */
+static int32_t builtin_break(ShellStatePtr shell, uint32_t argc, char** argv) {
+    long levels = 1;
+    if(!numeric_argument(argc, argv, 1, &levels)) {
+        return ERROR_DEFAULT;
+    }
+    if(shell->loop_depth == 0) {
+        print_error("%s: only meaningful in a loop", argv[0]);
+        return SUCCESS;
+    }
+
+    shell->break_levels = (levels > (long)shell->loop_depth) ? shell->loop_depth : (uint32_t)levels;
+    shell->continue_loop = (argv[0][0] == 'c') ? 1U : 0U;
+    return SUCCESS;
+} // builtin_break
+
+
+/**
+ * @brief       return [n]
+ *
+ *              Ends running function with status n (last status by default)
+ */
+static int32_t builtin_return(ShellStatePtr shell, uint32_t argc, char** argv) {
+    long status = shell->last_status;
+    if(!numeric_argument(argc, argv, LONG_MIN, &status)) {
+        return ERROR_SHELL_MISUSE;
+    }
+    if(shell->function_depth == 0) {
+        print_error("return: can only `return' from a function");
+        return ERROR_DEFAULT;
+    }
+    shell->returning = 1U;
+    return (int32_t)(status & 0xFF);
+} // builtin_return
+
+
+/**
+ * @brief       exit [n]
+ *
+ *              Ends the shell (or subshell) with status n, last status by default
+ */
+static int32_t builtin_exit(ShellStatePtr shell, uint32_t argc, char** argv) {
+    long status = shell->last_status;
+    if(!numeric_argument(argc, argv, LONG_MIN, &status)) {
+        status = ERROR_SHELL_MISUSE;
+    }
+    shell->exiting = 1U;
+    return (int32_t)(status & 0xFF);
+} // builtin_exit
+
+
+/**
+ * @brief       Waits for the first of the jobs to finish (wait -n)
+ *
+ *              A job which finished before is taken right away. Without
+ *              operands the completion queue gives the job, operands are
+ *              looked up once and only they are checked after every wakeup
+ *
+ * @param specs jobs to wait for, all jobs when count is 0
+ * @return      exit status of the job, 127 when there is nothing to wait for
+ */
+static int32_t wait_next(JobTablePtr table, char** specs, uint32_t count) {
+    JobPtr jobs[count > 0 ? count : 1];
+    for(uint32_t i = 0; i < count; i++) {
+        jobs[i] = jobs_find(table, specs[i]);
+    }
+
+    while(1) {
+        JobPtr found = NULL;
+        uint8_t running = 0U;
+        if(count == 0) {
+            found = jobs_first_finished(table);
+            running = (table->running > 0) ? 1U : 0U;
+        }
+        for(uint32_t i = 0; i < count && found == NULL; i++) {
+            JobPtr job = jobs[i];
+            if(job != NULL && job->done) {
+                found = job;
+            }
+            running = (job != NULL && !job->done && !job->inherited) ? 1U : running;
+        }
+
+        if(found != NULL) {
+            int32_t status = job_exit_status(found);
+            jobs_remove(table, found);
+            return status;
+        }
+        if(!running) {
+            return ERROR_COMMAND_NOT_FOUND;
+        }
+        jobs_reap(table, 1U);
+    }
+} // wait_next
+
+
+/**
+ * @brief       wait [-n] [pid | %job ...]
+ *
+ *              Without operands waits for all jobs and returns 0, otherwise
+ *              returns status of the last operand (127 for unknown ones).
+ *              -n returns status of the first of the jobs which finishes
+ */
+static int32_t builtin_wait(ShellStatePtr shell, uint32_t argc, char** argv) {
+    JobTablePtr table = &shell->jobs;
+    uint32_t i = 1;
+    uint8_t next = 0U;
+    if(i < argc && streq(argv[i], "-n")) {
+        next = 1U;
+        i++;
+    }
+    else if(i < argc && argv[i][0] == '-' && argv[i][1] != '\0') {
+        print_error("wait: %s: invalid option", argv[i]);
+        output_string(STDERR_FILENO, "wait: usage: wait [-n] [id ...]\n");
+        return ERROR_SHELL_MISUSE;
+    }
+    // anything printed so far shows up while waiting
+    output_flush();
+
+    if(next) {
+        return wait_next(table, argv + i, argc - i);
+    }
+    if(i == argc) {
+        while(table->running > 0) {
+            jobs_reap(table, 1U);
+        }
+        while(table->first != NULL) {
+            jobs_remove(table, table->first);
+        }
+        return SUCCESS;
+    }
+
+    int32_t status = SUCCESS;
+    for(; i < argc; i++) {
+        JobPtr job = jobs_find(table, argv[i]);
+        if(job != NULL && job->inherited) {
+            print_error("wait: pid %d is not a child of this shell", (int)job->pid);
+            status = ERROR_COMMAND_NOT_FOUND;
+            continue;
+        }
+        if(job == NULL) {
+            if(argv[i][0] == '%') {
+                print_error("wait: %s: no such job", argv[i]);
+                status = ERROR_COMMAND_NOT_FOUND;
+            }
+            else if(strspn(argv[i], "0123456789") == strlen(argv[i])) {
+                print_error("wait: pid %s is not a child of this shell", argv[i]);
+                status = ERROR_COMMAND_NOT_FOUND;
+            }
+            else {
+                print_error("wait: `%s': not a pid or valid job spec", argv[i]);
+                status = ERROR_SHELL_MISUSE;
+            }
+            continue;
+        }
+        while(!job->done) {
+            jobs_reap(table, 1U);
+        }
+        status = job_exit_status(job);
+        jobs_remove(table, job);
+    }
+    return status;
+} // builtin_wait
+
+
+/**
+ * @brief       Prints job for jobs, finished job is forgotten once it's listed
+ */
+static void list_job(JobTablePtr table, JobPtr job, uint8_t with_pid, uint8_t pids_only) {
+    if(pids_only) {
+        output_printf(STDOUT_FILENO, "%d\n", (int)job->pid);
+    }
+    else {
+        job_print(table, job, with_pid);
+    }
+    if(job->done) {
+        jobs_remove(table, job);
+    }
+} // list_job
+
+
+/**
+ * @brief       jobs [-l | -p] [%job ...]
+ *
+ *              Lists jobs with their state, finished jobs are forgotten once
+ *              they are listed. -p prints only process ids, -l adds them
+ */
+static int32_t builtin_jobs(ShellStatePtr shell, uint32_t argc, char** argv) {
+    JobTablePtr table = &shell->jobs;
+    uint32_t i = 1;
+    uint8_t with_pid = 0U;
+    uint8_t pids_only = 0U;
+    for(; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; i++) {
+        if(streq(argv[i], "-l")) {
+            with_pid = 1U;
+        }
+        else if(streq(argv[i], "-p")) {
+            pids_only = 1U;
+        }
+        else {
+            print_error("jobs: %s: invalid option", argv[i]);
+            output_string(STDERR_FILENO, "jobs: usage: jobs [-l | -p] [job ...]\n");
+            return ERROR_SHELL_MISUSE;
+        }
+    }
+    if(table->running > 0) {
+        jobs_reap(table, 0U);
+    }
+
+    if(i == argc) {
+        JobPtr next;
+        for(JobPtr job = table->first; job != NULL; job = next) {
+            next = job->next;
+            list_job(table, job, with_pid, pids_only);
+        }
+        return SUCCESS;
+    }
+
+    int32_t status = SUCCESS;
+    for(; i < argc; i++) {
+        JobPtr job = jobs_find(table, argv[i]);
+        if(job == NULL) {
+            print_error("jobs: %s: no such job", argv[i]);
+            status = ERROR_DEFAULT;
+            continue;
+        }
+        list_job(table, job, with_pid, pids_only);
+    }
+    return status;
+} // builtin_jobs
@@ -0,0 +1,27 @@
+#ifndef BUILTINS_H
+#define BUILTINS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "exec.h"
+
+// builtin entry point, returns exit status of the builtin
+typedef int32_t (*BuiltinFunction)(ShellStatePtr shell, uint32_t argc, char** argv);
+
+/**
+ * @brief       Fills dispatch table of builtins
+ *
+ * @param table uninitialized table, name -> BuiltinFunction stored as bytes
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+StatusEnum builtins_register(HashTablePtr table);
+
+/**
+ * @brief       Finds builtin by command name
+ * @param shell shell state with the builtin table
+ * @param name  command name
+ * @return      builtin function, NULL if name is not a builtin
+ */
+BuiltinFunction find_builtin(ShellStatePtr shell, const char* name);
+
+#endif
@@ -0,0 +1,456 @@
+/**
+ * Compiler from syntax tree to flat bytecode
+ */
+
+#include <string.h>
+#include "compile.h"
+
+// first capacity of instruction vectors
+#define COMPILE_MIN_CAPACITY 16U
+
+//
+typedef struct compiler {
+    ArenaPtr arena;
+    InstructionPtr code;
+    uint32_t length;
+    uint32_t capacity;
+    uint32_t depth;             // frames open at current instruction
+    uint32_t max_depth;
+} Compiler, *CompilerPtr;
+
+static const char* const opcode_names[OP_COUNT] = {
+    "HALT", "SIMPLE", "PIPELINE", "SUBSHELL", "BACKGROUND", "NOT", "SET_STATUS",
+    "JUMP", "JUMP_IF_TRUE", "JUMP_IF_FALSE", "REDIRECT", "REDIRECT_END",
+    "LOOP_ENTER", "LOOP_SAVE", "LOOP_EXIT", "FOR_INIT", "FOR_NEXT",
+    "CASE_BEGIN", "CASE_MATCH", "CASE_END", "DEFINE_FUNCTION"
+};
+
+static StatusEnum compile_node(CompilerPtr c, NodePtr node);
+
+
+/**
+ * @brief       Appends instruction to the code
+ *
+ * @param index output index of the new instruction, may be NULL
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+static StatusEnum emit(CompilerPtr c, OpcodeEnum op, uint32_t arg, void* data, uint32_t* index) {
+    if(c->length >= c->capacity) {
+        uint32_t capacity = (c->capacity == 0) ? COMPILE_MIN_CAPACITY : c->capacity * 2;
+        InstructionPtr code = (InstructionPtr) arenaAlloc(c->arena, sizeof(Instruction) * capacity);
+        if(code == NULL) {
+            return ERROR_MALLOC_FAILURE;
+        }
+        if(c->length > 0) {
+            memcpy(code, c->code, sizeof(Instruction) * c->length);
+        }
+        c->code = code;
+        c->capacity = capacity;
+    }
+
+    InstructionPtr instruction = &c->code[c->length];
+    instruction->op = op;
+    instruction->arg = arg;
+    instruction->arg2 = 0;
+    instruction->data = data;
+    if(index != NULL) {
+        *index = c->length;
+    }
+    c->length++;
+    return SUCCESS;
+} // emit
+
+
+/**
+ * @brief       Opens frame (loop, case, redirection) for the frame count of the program
+ */
+static inline void frame_open(CompilerPtr c) {
+    c->depth++;
+    if(c->depth > c->max_depth) {
+        c->max_depth = c->depth;
+    }
+} // frame_open
+
+
+/**
+ * @brief       Compiles tree into a nested program of its own
+ */
+static StatusEnum compile_nested(CompilerPtr c, NodePtr node, ProgramPtr* program) {
+    return compile_program(node, c->arena, program);
+} // compile_nested
+
+
+/**
+ * @brief       while/until: condition, conditional exit, body, jump back
+ */
+static StatusEnum compile_while(CompilerPtr c, NodePtr node) {
+    uint32_t enter;
+    StatusEnum st = emit(c, OP_LOOP_ENTER, 0, NULL, &enter);
+    ERR_CHECK(st);
+    frame_open(c);
+
+    uint32_t condition = c->length;
+    c->code[enter].arg2 = condition;
+    st = compile_node(c, node->loop.condition);
+    ERR_CHECK(st);
+
+    uint32_t exit_jump;
+    st = emit(c, (node->type == NODE_WHILE) ? OP_JUMP_IF_FALSE : OP_JUMP_IF_TRUE, 0, NULL, &exit_jump);
+    ERR_CHECK(st);
+    st = compile_node(c, node->loop.body);
+    ERR_CHECK(st);
+    st = emit(c, OP_LOOP_SAVE, 0, NULL, NULL);
+    ERR_CHECK(st);
+    st = emit(c, OP_JUMP, condition, NULL, NULL);
+    ERR_CHECK(st);
+
+    c->code[exit_jump].arg = c->length;
+    c->code[enter].arg = c->length;
+    c->depth--;
+    return emit(c, OP_LOOP_EXIT, 0, NULL, NULL);
+} // compile_while
+
+
+/**
+ * @brief       for: word list expanded once, FOR_NEXT assigns values until they run out
+ */
+static StatusEnum compile_for(CompilerPtr c, NodePtr node) {
+    uint32_t enter;
+    StatusEnum st = emit(c, OP_LOOP_ENTER, 0, NULL, &enter);
+    ERR_CHECK(st);
+    frame_open(c);
+
+    uint32_t init;
+    st = emit(c, OP_FOR_INIT, 0, node, &init);
+    ERR_CHECK(st);
+
+    uint32_t next;
+    st = emit(c, OP_FOR_NEXT, 0, node, &next);
+    ERR_CHECK(st);
+    c->code[enter].arg2 = next;
+
+    st = compile_node(c, node->for_loop.body);
+    ERR_CHECK(st);
+    st = emit(c, OP_LOOP_SAVE, 0, NULL, NULL);
+    ERR_CHECK(st);
+    st = emit(c, OP_JUMP, next, NULL, NULL);
+    ERR_CHECK(st);
+
+    c->code[enter].arg = c->length;
+    c->code[init].arg = c->length;
+    c->code[next].arg = c->length;
+    c->depth--;
+    return emit(c, OP_LOOP_EXIT, 0, NULL, NULL);
+} // compile_for
+
+
+/**
+ * @brief       case: all patterns are tried in order, matches jump to item bodies
+ */
+static StatusEnum compile_case(CompilerPtr c, NodePtr node) {
+    uint32_t begin;
+    StatusEnum st = emit(c, OP_CASE_BEGIN, 0, node, &begin);
+    ERR_CHECK(st);
+    frame_open(c);
+
+    uint32_t item_count = 0;
+    for(CaseItemPtr item = node->case_command.items; item != NULL; item = item->next) {
+        for(uint32_t i = 0; i < item->pattern_count; i++) {
+            st = emit(c, OP_CASE_MATCH, item_count, &item->patterns[i], NULL);
+            ERR_CHECK(st);
+        }
+        item_count++;
+    }
+
+    // no match, jumps to ends of bodies are patched below
+    uint32_t jumps[item_count + 1];
+    st = emit(c, OP_SET_STATUS, 0, NULL, NULL);
+    ERR_CHECK(st);
+    st = emit(c, OP_JUMP, 0, NULL, &jumps[item_count]);
+    ERR_CHECK(st);
+
+    // bodies, CASE_MATCH targets hold item numbers until now
+    uint32_t bodies[item_count > 0 ? item_count : 1];
+    uint32_t index = 0;
+    for(CaseItemPtr item = node->case_command.items; item != NULL; item = item->next, index++) {
+        bodies[index] = c->length;
+        if(item->body != NULL) {
+            st = compile_node(c, item->body);
+        }
+        else {
+            st = emit(c, OP_SET_STATUS, 0, NULL, NULL);
+        }
+        ERR_CHECK(st);
+        st = emit(c, OP_JUMP, 0, NULL, &jumps[index]);
+        ERR_CHECK(st);
+    }
+
+    for(uint32_t i = begin + 1; c->code[i].op == OP_CASE_MATCH; i++) {
+        c->code[i].arg = bodies[c->code[i].arg];
+    }
+    for(uint32_t i = 0; i <= item_count; i++) {
+        c->code[jumps[i]].arg = c->length;
+    }
+    c->depth--;
+    st = emit(c, OP_CASE_END, 0, NULL, NULL);
+    ERR_CHECK(st);
+    c->code[begin].arg = c->length;
+    return SUCCESS;
+} // compile_case
+
+
+/**
+ * @brief       Compiles node without its redirections
+ */
+static StatusEnum compile_command(CompilerPtr c, NodePtr node) {
+    StatusEnum st;
+    uint32_t jump;
+
+    switch(node->type) {
+        case NODE_SIMPLE:
+            return emit(c, OP_SIMPLE, 0, node, NULL);
+
+        case NODE_PIPELINE: {
+            ProgramPtr* stages = (ProgramPtr*) arenaAlloc(c->arena, sizeof(ProgramPtr) * node->list.count);
+            if(stages == NULL) {
+                return ERROR_MALLOC_FAILURE;
+            }
+            for(uint32_t i = 0; i < node->list.count; i++) {
+                st = compile_nested(c, node->list.items[i], &stages[i]);
+                ERR_CHECK(st);
+            }
+            return emit(c, OP_PIPELINE, node->list.count, stages, NULL);
+        }
+
+        case NODE_SUBSHELL: {
+            ProgramPtr body;
+            st = compile_nested(c, node->unary.body, &body);
+            ERR_CHECK(st);
+            return emit(c, OP_SUBSHELL, 0, body, NULL);
+        }
+
+        case NODE_BACKGROUND: {
+            BackgroundPtr background = (BackgroundPtr) arenaAlloc(c->arena, sizeof(Background));
+            if(background == NULL) {
+                return ERROR_MALLOC_FAILURE;
+            }
+            background->text = node->unary.text;
+            st = compile_nested(c, node->unary.body, &background->body);
+            ERR_CHECK(st);
+            return emit(c, OP_BACKGROUND, 0, background, NULL);
+        }
+
+        case NODE_NOT:
+            st = compile_node(c, node->unary.body);
+            ERR_CHECK(st);
+            return emit(c, OP_NOT, 0, NULL, NULL);
+
+        case NODE_AND:
+        case NODE_OR:
+            st = compile_node(c, node->binary.left);
+            ERR_CHECK(st);
+            st = emit(c, (node->type == NODE_AND) ? OP_JUMP_IF_FALSE : OP_JUMP_IF_TRUE, 0, NULL, &jump);
+            ERR_CHECK(st);
+            st = compile_node(c, node->binary.right);
+            ERR_CHECK(st);
+            c->code[jump].arg = c->length;
+            return SUCCESS;
+
+        case NODE_SEQUENCE:
+            for(uint32_t i = 0; i < node->list.count; i++) {
+                st = compile_node(c, node->list.items[i]);
+                ERR_CHECK(st);
+            }
+            return SUCCESS;
+
+        case NODE_GROUP:
+            return compile_node(c, node->unary.body);
+
+        case NODE_IF: {
+            st = compile_node(c, node->conditional.condition);
+            ERR_CHECK(st);
+            uint32_t else_jump;
+            st = emit(c, OP_JUMP_IF_FALSE, 0, NULL, &else_jump);
+            ERR_CHECK(st);
+            st = compile_node(c, node->conditional.then_body);
+            ERR_CHECK(st);
+            st = emit(c, OP_JUMP, 0, NULL, &jump);
+            ERR_CHECK(st);
+
+            c->code[else_jump].arg = c->length;
+            if(node->conditional.else_body != NULL) {
+                st = compile_node(c, node->conditional.else_body);
+            }
+            else {
+                st = emit(c, OP_SET_STATUS, 0, NULL, NULL);
+            }
+            ERR_CHECK(st);
+            c->code[jump].arg = c->length;
+            return SUCCESS;
+        }
+
+        case NODE_WHILE:
+        case NODE_UNTIL:
+            return compile_while(c, node);
+
+        case NODE_FOR:
+            return compile_for(c, node);
+
+        case NODE_CASE:
+            return compile_case(c, node);
+
+        case NODE_FUNCTION:
+            return emit(c, OP_DEFINE_FUNCTION, 0, node, NULL);
+    }
+    return SUCCESS;
+} // compile_command
+
+
+/**
+ * @brief       Compiles node, redirections of compound commands wrap its code
+ */
+static StatusEnum compile_node(CompilerPtr c, NodePtr node) {
+    if(node == NULL) {
+        return emit(c, OP_SET_STATUS, 0, NULL, NULL);
+    }
+    // simple commands apply their redirections themselves
+    if(node->redirections == NULL || node->type == NODE_SIMPLE) {
+        return compile_command(c, node);
+    }
+
+    uint32_t redirect;
+    StatusEnum st = emit(c, OP_REDIRECT, 0, node->redirections, &redirect);
+    ERR_CHECK(st);
+    frame_open(c);
+    st = compile_command(c, node);
+    ERR_CHECK(st);
+    c->depth--;
+    st = emit(c, OP_REDIRECT_END, 0, NULL, NULL);
+    ERR_CHECK(st);
+    c->code[redirect].arg = c->length;
+    return SUCCESS;
+} // compile_node
+
+
+/**
+ * @brief       Compiles syntax tree into a program
+ *
+ *              Control flow (if, loops, && ||, case) becomes jumps, words and
+ *              redirections stay in the tree and are referenced by instructions,
+ *              so the tree must live as long as the program
+ *
+ * @param node  tree to compile, NULL gives an empty program
+ * @param arena arena for the code
+ * @param program output program
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+StatusEnum compile_program(NodePtr node, ArenaPtr arena, ProgramPtr* program) {
+    Compiler c;
+    memset(&c, 0, sizeof(c));
+    c.arena = arena;
+
+    StatusEnum st = (node != NULL) ? compile_node(&c, node) : SUCCESS;
+    ERR_CHECK(st);
+    st = emit(&c, OP_HALT, 0, NULL, NULL);
+    ERR_CHECK(st);
+
+    *program = (ProgramPtr) arenaAlloc(arena, sizeof(Program));
+    if(*program == NULL) {
+        return ERROR_MALLOC_FAILURE;
+    }
+    (*program)->code = c.code;
+    (*program)->length = c.length;
+    (*program)->frame_count = c.max_depth;
+    return SUCCESS;
+} // compile_program
+
+
+/**
+ * @brief       Prints program with given indentation
+ */
+static void dump_indented(ProgramPtr program, ArenaPtr arena, FILE* output, uint32_t indent) {
+    for(uint32_t pc = 0; pc < program->length; pc++) {
+        InstructionPtr instruction = &program->code[pc];
+        fprintf(output, "%*s%04u  %-16s", (int)indent, "", pc, opcode_names[instruction->op]);
+
+        switch(instruction->op) {
+            case OP_SIMPLE: {
+                NodePtr node = (NodePtr) instruction->data;
+                for(uint32_t i = 0; i < node->simple.assignment_count; i++) {
+                    fprintf(output, " %s", node->simple.assignments[i].text);
+                }
+                for(uint32_t i = 0; i < node->simple.word_count; i++) {
+                    fprintf(output, " %s", node->simple.words[i].text);
+                }
+                if(node->redirections != NULL) {
+                    fprintf(output, " (redirected)");
+                }
+                break;
+            }
+            case OP_SET_STATUS:
+            case OP_JUMP:
+            case OP_JUMP_IF_TRUE:
+            case OP_JUMP_IF_FALSE:
+            case OP_REDIRECT:
+            case OP_FOR_INIT:
+            case OP_CASE_BEGIN:
+                fprintf(output, " %u", instruction->arg);
+                break;
+            case OP_LOOP_ENTER:
+                fprintf(output, " break %u continue %u", instruction->arg, instruction->arg2);
+                break;
+            case OP_FOR_NEXT:
+                fprintf(output, " %s %u", ((NodePtr) instruction->data)->for_loop.name, instruction->arg);
+                break;
+            case OP_CASE_MATCH:
+                fprintf(output, " %s %u", ((WordPtr) instruction->data)->text, instruction->arg);
+                break;
+            case OP_PIPELINE:
+                fprintf(output, " %u stages", instruction->arg);
+                break;
+            case OP_BACKGROUND:
+                fprintf(output, " %s", ((BackgroundPtr) instruction->data)->text);
+                break;
+            case OP_DEFINE_FUNCTION:
+                fprintf(output, " %s", ((NodePtr) instruction->data)->function.name);
+                break;
+            default:
+                break;
+        }
+        fputc('\n', output);
+
+        // nested programs
+        if(instruction->op == OP_PIPELINE) {
+            ProgramPtr* stages = (ProgramPtr*) instruction->data;
+            for(uint32_t i = 0; i < instruction->arg; i++) {
+                fprintf(output, "%*sstage %u:\n", (int)indent + 6, "", i);
+                dump_indented(stages[i], arena, output, indent + 6);
+            }
+        }
+        else if(instruction->op == OP_SUBSHELL) {
+            dump_indented((ProgramPtr) instruction->data, arena, output, indent + 6);
+        }
+        else if(instruction->op == OP_BACKGROUND) {
+            dump_indented(((BackgroundPtr) instruction->data)->body, arena, output, indent + 6);
+        }
+        else if(instruction->op == OP_DEFINE_FUNCTION) {
+            ProgramPtr body;
+            if(compile_program(((NodePtr) instruction->data)->function.body, arena, &body) == SUCCESS) {
+                dump_indented(body, arena, output, indent + 6);
+            }
+        }
+    }
+} // dump_indented
+
+
+/**
+ * @brief       Prints human readable listing of program and its nested programs
+ *
+ * @param program program to print
+ * @param arena arena for compiling function bodies shown in the listing
+ * @param output stream
+ */
+void program_dump(ProgramPtr program, ArenaPtr arena, FILE* output) {
+    dump_indented(program, arena, output, 0);
+    fflush(output);
+} // program_dump
@@ -0,0 +1,85 @@
+#ifndef COMPILE_H
+#define COMPILE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "../utils/error.h"
+#include "../data_structures/arena.h"
+#include "../parser/parser.h"
+
+// instructions of the shell virtual machine
+typedef enum {
+    OP_HALT,            // end of program
+    OP_SIMPLE,          // data: NODE_SIMPLE, expand and execute
+    OP_PIPELINE,        // data: ProgramPtr array, arg: number of stages
+    OP_SUBSHELL,        // data: ProgramPtr run in a forked child
+    OP_BACKGROUND,      // data: BackgroundPtr, body runs in a child which becomes a job
+    OP_NOT,             // negate last status
+    OP_SET_STATUS,      // arg: new last status
+    OP_JUMP,            // arg: target
+    OP_JUMP_IF_TRUE,    // arg: target, taken when last status is 0
+    OP_JUMP_IF_FALSE,   // arg: target, taken when last status is not 0
+    OP_REDIRECT,        // data: RedirectionNodePtr, arg: target after OP_REDIRECT_END on failure
+    OP_REDIRECT_END,    // undo the innermost OP_REDIRECT
+    OP_LOOP_ENTER,      // arg: OP_LOOP_EXIT (break target), arg2: continue target
+    OP_LOOP_SAVE,       // remember last status as status of the loop
+    OP_LOOP_EXIT,       // leave the innermost loop, its status becomes last status
+    OP_FOR_INIT,        // data: NODE_FOR, expands word list, arg: OP_LOOP_EXIT on failure
+    OP_FOR_NEXT,        // data: NODE_FOR, assigns next value or jumps to arg
+    OP_CASE_BEGIN,      // data: NODE_CASE, expands subject, arg: target after OP_CASE_END on failure
+    OP_CASE_MATCH,      // data: WordPtr pattern, arg: target when it matches
+    OP_CASE_END,        // forget subject of the innermost case
+    OP_DEFINE_FUNCTION, // data: NODE_FUNCTION
+    OP_COUNT
+} OpcodeEnum;
+
+
+//
+typedef struct instruction {
+    uint32_t op;                // OpcodeEnum
+    uint32_t arg;               // jump target, status or count
+    uint32_t arg2;              // second target of OP_LOOP_ENTER
+    void* data;                 // node, word or nested programs
+} Instruction, *InstructionPtr;
+
+
+/*  Flat code compiled from one syntax tree, nested programs are used for
+    parts which run in children (pipeline stages, subshells) */
+typedef struct program {
+    InstructionPtr code;
+    uint32_t length;
+    uint32_t frame_count;       // deepest nesting of loops, cases and redirections
+} Program, *ProgramPtr;
+
+
+// operand of OP_BACKGROUND
+typedef struct background {
+    ProgramPtr body;
+    const char* text;           // source of the command, listed by jobs
+} Background, *BackgroundPtr;
+
+
+/**
+ * @brief       Compiles syntax tree into a program
+ *
+ *              Control flow (if, loops, && ||, case) becomes jumps, words and
+ *              redirections stay in the tree and are referenced by instructions,
+ *              so the tree must live as long as the program
+ *
+ * @param node  tree to compile, NULL gives an empty program
+ * @param arena arena for the code
+ * @param program output program
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+StatusEnum compile_program(NodePtr node, ArenaPtr arena, ProgramPtr* program);
+
+/**
+ * @brief       Prints human readable listing of program and its nested programs
+ *
+ * @param program program to print
+ * @param arena arena for compiling function bodies shown in the listing
+ * @param output stream
+ */
+void program_dump(ProgramPtr program, ArenaPtr arena, FILE* output);
+
+#endif
@@ -0,0 +1,973 @@
+/**
+ * Simple command executor
+ *
+ * External programs are launched with posix_spawn (clone + vfork semantics in
+ * glibc) so the cost of starting a child does not depend on the size of the
+ * shell, redirection files are opened by the shell and handed to the child
+ * as spawn file actions
+ */
+
+#include "exec.h"
+#include "builtins.h"
+#include "heredoc.h"
+#include "variables.h"
+#include "vm.h"
+#include "../shell.h"
+
+// signals which are reset to default in every child
+static const int32_t child_default_signals[] = {
+    SIGINT, SIGQUIT, SIGTSTP, SIGTTIN, SIGTTOU
+};
+
+
+/**
+ * @brief       Initializes shell state from process environment
+ *
+ * @param shell state passed by address
+ * @param environ environment of the shell process
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+StatusEnum shell_state_init(ShellStatePtr shell, char** environ) {
+    if(shell == NULL || environ == NULL) {
+        return ERROR_DEFAULT;
+    }
+
+    memset(shell, 0, sizeof(*shell));
+    StatusEnum st = populateEnvTable(&shell->env_table, environ);
+    ERR_CHECK(st);
+
+    st = envExportCtor(&shell->env_export, &shell->env_table);
+    if(st != SUCCESS) {
+        hashTableDtor(&shell->env_table);
+        return st;
+    }
+
+    st = arenaCtor(&shell->command_arena);
+    if(st != SUCCESS) {
+        envExportDtor(&shell->env_export);
+        hashTableDtor(&shell->env_table);
+        return st;
+    }
+
+    st = hashTableCtor(&shell->path_cache);
+    if(st != SUCCESS) {
+        arenaDtor(&shell->command_arena);
+        envExportDtor(&shell->env_export);
+        hashTableDtor(&shell->env_table);
+        return st;
+    }
+
+    st = hashTableCtor(&shell->functions);
+    if(st == SUCCESS) {
+        st = builtins_register(&shell->builtins);
+        if(st != SUCCESS) {
+            hashTableDtor(&shell->functions);
+        }
+    }
+    if(st != SUCCESS) {
+        hashTableDtor(&shell->path_cache);
+        arenaDtor(&shell->command_arena);
+        envExportDtor(&shell->env_export);
+        hashTableDtor(&shell->env_table);
+        return st;
+    }
+
+    jobs_init(&shell->jobs);
+    shell->script_name = SHELL_NAME;
+    shell->shell_pid = getpid();
+    shell->last_status = 0;
+    return SUCCESS;
+} // shell_state_init
+
+
+/**
+ * @brief       Frees everything owned by shell state
+ */
+void shell_state_dispose(ShellStatePtr shell) {
+    if(shell == NULL) {
+        return;
+    }
+    scope_dispose(shell);
+    jobs_clear(&shell->jobs);
+    hashTableDtor(&shell->builtins);
+    functions_clear(shell);
+    hashTableDtor(&shell->functions);
+    hashTableDtor(&shell->path_cache);
+    arenaDtor(&shell->command_arena);
+    envExportDtor(&shell->env_export);
+    hashTableDtor(&shell->env_table);
+} // shell_state_dispose
+
+
+/**
+ * @brief       Forgets all remembered command locations (hash -r)
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+StatusEnum path_cache_clear(ShellStatePtr shell) {
+    if(shell->path_cache.currentSize == 0) {
+        return SUCCESS;
+    }
+    hashTableDtor(&shell->path_cache);
+    return hashTableCtor(&shell->path_cache);
+} // path_cache_clear
+
+
+/**
+ * @brief       Searches directories of PATH value for executable
+ *
+ * @param path_variable colon separated directories, empty entry is current directory
+ * @param name  command name without /
+ * @param path  output buffer of PATH_MAX bytes
+ * @return      SUCCESS, ERROR_COMMAND_NOT_FOUND or ERROR_COMM_CANNOT_EXEC
+ */
+static StatusEnum search_path(const char* path_variable, const char* name, size_t name_length, char* path) {
+    StatusEnum result = ERROR_COMMAND_NOT_FOUND;
+    const char* directory = path_variable;
+    while(1) {
+        const char* colon = strchr(directory, ':');
+        size_t directory_length = (colon != NULL) ? (size_t)(colon - directory) : strlen(directory);
+
+        if(directory_length + name_length + 2 <= PATH_MAX) {
+            // empty entry means current directory
+            size_t offset = 0;
+            if(directory_length != 0) {
+                memcpy(path, directory, directory_length);
+                path[directory_length] = '/';
+                offset = directory_length + 1;
+            }
+            memcpy(path + offset, name, name_length + 1);
+
+            struct stat info;
+            if(stat(path, &info) == 0 && S_ISREG(info.st_mode)) {
+                if(access(path, X_OK) == 0) {
+                    return SUCCESS;
+                }
+                result = ERROR_COMM_CANNOT_EXEC;
+            }
+        }
+
+        if(colon == NULL) {
+            break;
+        }
+        directory = colon + 1;
+    }
+    return result;
+} // search_path
+
+
+/**
+ * @brief       Finds executable for command name using PATH from env table
+ *
+ *              Found locations are remembered in the path cache so PATH is
+ *              searched once per command name until PATH changes or hash -r
+ *
+ * @param shell shell state with env table
+ * @param name  command name, names containing / are used as they are
+ * @param path  output buffer of PATH_MAX bytes
+ * @return      SUCCESS, ERROR_COMMAND_NOT_FOUND or ERROR_COMM_CANNOT_EXEC
+ */
+StatusEnum find_command(ShellStatePtr shell, const char* name, char* path) {
+    size_t name_length = strlen(name);
+    if(name_length == 0 || name_length >= PATH_MAX) {
+        return ERROR_COMMAND_NOT_FOUND;
+    }
+
+    // paths are not searched, spawn reports problems with them
+    if(strchr(name, '/') != NULL) {
+        memcpy(path, name, name_length + 1);
+        return SUCCESS;
+    }
+
+    char* cached = NULL;
+    if(hashTableGetValue(&shell->path_cache, name, &cached) == SUCCESS) {
+        memcpy(path, cached, strlen(cached) + 1);
+        return SUCCESS;
+    }
+
+    char* path_variable = NULL;
+    if(shell_get_variable(shell, "PATH", &path_variable) != SUCCESS) {
+        path_variable = DEFAULT_PATH;
+    }
+
+    StatusEnum st = search_path(path_variable, name, name_length, path);
+    if(st == SUCCESS) {
+        // failing to remember only costs another search next time
+        hashTableInsert(&shell->path_cache, name, path);
+    }
+    return st;
+} // find_command
+
+
+/**
+ * @brief       Finds executable for command with PATH= among its assignments
+ *
+ *              PATH given only for one command is searched without the path
+ *              cache, the cache belongs to PATH of the shell
+ *
+ * @param path_variable value of the last PATH= assignment of the command
+ * @return      SUCCESS, ERROR_COMMAND_NOT_FOUND or ERROR_COMM_CANNOT_EXEC
+ */
+static StatusEnum find_command_in(const char* path_variable, const char* name, char* path) {
+    size_t name_length = strlen(name);
+    if(name_length == 0 || name_length >= PATH_MAX) {
+        return ERROR_COMMAND_NOT_FOUND;
+    }
+    if(strchr(name, '/') != NULL) {
+        memcpy(path, name, name_length + 1);
+        return SUCCESS;
+    }
+    return search_path(path_variable, name, name_length, path);
+} // find_command_in
+
+
+/**
+ * @brief       Returns descriptor a redirector uses when no IO_NUMBER is given
+ */
+static int32_t redirection_default_fd(TokenTypeEnum type) {
+    switch(type) {
+        case TOKEN_LESS:
+        case TOKEN_LESSAND:
+        case TOKEN_LESSGREAT:
+        case TOKEN_DLESS:
+        case TOKEN_DLESSDASH:
+        case TOKEN_TLESS:
+            return 0;
+        default:
+            return 1;
+    }
+} // redirection_default_fd
+
+
+/**
+ * @brief       Opens file for redirection above SHELL_FD_BASE with close on exec
+ * @return      descriptor, -1 on failure with errno set
+ */
+static int32_t redirection_open(const char* target, int32_t flags) {
+    // keep low descriptors free so a later redirection can't land on them
+    return move_fd_above(open(target, flags | O_CLOEXEC, 0666), SHELL_FD_BASE);
+} // redirection_open
+
+
+/**
+ * @brief       Closes descriptors opened for redirections
+ */
+static void close_fd_actions(FdActionPtr actions, uint32_t count) {
+    for(uint32_t i = 0; i < count; i++) {
+        if(actions[i].owned) {
+            close(actions[i].source);
+        }
+    }
+} // close_fd_actions
+
+
+/**
+ * @brief       Opens redirection files and turns redirections into descriptor actions
+ *
+ * @param shell shell state, actions are allocated from command arena
+ * @param redirections list of redirections
+ * @param actions output array of actions
+ * @param count output number of actions
+ * @return      SUCCESS, ERROR_DEFAULT when redirection fails (reported to stderr)
+ */
+static StatusEnum prepare_fd_actions(ShellStatePtr shell, RedirectionPtr redirections,
+                                     FdActionPtr* actions, uint32_t* count) {
+    uint32_t redirection_count = 0;
+    for(RedirectionPtr r = redirections; r != NULL; r = r->next) {
+        redirection_count++;
+    }
+
+    *count = 0;
+    *actions = NULL;
+    if(redirection_count == 0) {
+        return SUCCESS;
+    }
+
+    *actions = (FdActionPtr) arenaAlloc(&shell->command_arena, sizeof(FdAction) * redirection_count);
+    if(*actions == NULL) {
+        return ERROR_MALLOC_FAILURE;
+    }
+
+    for(RedirectionPtr r = redirections; r != NULL; r = r->next) {
+        FdActionPtr action = &(*actions)[*count];
+        action->fd = (r->io_number >= 0) ? r->io_number : redirection_default_fd(r->type);
+        action->source = -1;
+        action->owned = 0U;
+
+        int32_t flags = -1;
+        switch(r->type) {
+            case TOKEN_LESS:
+                flags = O_RDONLY;
+                break;
+            case TOKEN_GREAT:
+            case TOKEN_CLOBBER:
+                flags = O_WRONLY | O_CREAT | O_TRUNC;
+                break;
+            case TOKEN_DGREAT:
+                flags = O_WRONLY | O_CREAT | O_APPEND;
+                break;
+            case TOKEN_LESSGREAT:
+                flags = O_RDWR | O_CREAT;
+                break;
+            case TOKEN_LESSAND:
+            case TOKEN_GREATAND: {
+                // n>&- closes, n>&m duplicates
+                if(strcmp(r->target, "-") == 0) {
+                    break;
+                }
+                char* end = NULL;
+                long source = strtol(r->target, &end, 10);
+                if(*r->target == '\0' || *end != '\0' || source < 0 || source > INT32_MAX ||
+                   fcntl((int32_t)source, F_GETFD) == -1) {
+                    print_error("%s: bad file descriptor", r->target);
+                    close_fd_actions(*actions, *count);
+                    return ERROR_DEFAULT;
+                }
+                action->source = (int32_t)source;
+                break;
+            }
+            case TOKEN_DLESS:
+            case TOKEN_DLESSDASH:
+            case TOKEN_TLESS: {
+                int32_t source = -1;
+                StatusEnum st = heredoc_open(shell, r, &source);
+                if(st == SUCCESS) {
+                    source = move_fd_above(source, SHELL_FD_BASE);
+                    st = (source != -1) ? SUCCESS : ERROR_DEFAULT;
+                    if(st != SUCCESS) {
+                        print_errno(SHELL_NAME);
+                    }
+                }
+                if(st != SUCCESS) {
+                    close_fd_actions(*actions, *count);
+                    return (st == ERROR_MALLOC_FAILURE) ? st : ERROR_DEFAULT;
+                }
+                action->source = source;
+                action->owned = 1U;
+                break;
+            }
+            default:
+                print_error("unsupported redirection");
+                close_fd_actions(*actions, *count);
+                return ERROR_DEFAULT;
+        }
+
+        if(flags != -1) {
+            action->source = redirection_open(r->target, flags);
+            if(action->source == -1) {
+                print_errno(r->target);
+                close_fd_actions(*actions, *count);
+                return ERROR_DEFAULT;
+            }
+            action->owned = 1U;
+        }
+        (*count)++;
+    }
+    return SUCCESS;
+} // prepare_fd_actions
+
+
+/**
+ * @brief       Starts external program with posix_spawn
+ *
+ *              Output buffered by builtins is written first so it comes
+ *              before the output of the program
+ *
+ * @return      0 or errno value of the failed spawn
+ */
+static int32_t spawn_program(const char* path, char** argv, char** envp,
+                             FdActionPtr actions, uint32_t count, pid_t* pid) {
+    posix_spawn_file_actions_t file_actions;
+    posix_spawnattr_t attributes;
+
+    output_flush();
+
+    int32_t rc = posix_spawn_file_actions_init(&file_actions);
+    if(rc != 0) {
+        return rc;
+    }
+    rc = posix_spawnattr_init(&attributes);
+    if(rc != 0) {
+        posix_spawn_file_actions_destroy(&file_actions);
+        return rc;
+    }
+
+    for(uint32_t i = 0; i < count && rc == 0; i++) {
+        if(actions[i].source == -1) {
+            rc = posix_spawn_file_actions_addclose(&file_actions, actions[i].fd);
+        }
+        else {
+            rc = posix_spawn_file_actions_adddup2(&file_actions, actions[i].source, actions[i].fd);
+        }
+    }
+
+    // child starts with empty signal mask and default job control signals
+    sigset_t mask;
+    sigset_t defaults;
+    sigemptyset(&mask);
+    sigemptyset(&defaults);
+    for(uint32_t i = 0; i < sizeof(child_default_signals) / sizeof(child_default_signals[0]); i++) {
+        sigaddset(&defaults, child_default_signals[i]);
+    }
+    if(rc == 0) {
+        posix_spawnattr_setsigmask(&attributes, &mask);
+        posix_spawnattr_setsigdefault(&attributes, &defaults);
+        rc = posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+    }
+
+    if(rc == 0) {
+        rc = posix_spawn(pid, path, &file_actions, &attributes, argv, envp);
+    }
+
+    posix_spawnattr_destroy(&attributes);
+    posix_spawn_file_actions_destroy(&file_actions);
+    return rc;
+} // spawn_program
+
+
+/**
+ * @brief       Applies descriptor actions in a forked child
+ */
+static void apply_fd_actions(FdActionPtr actions, uint32_t count) {
+    for(uint32_t i = 0; i < count; i++) {
+        if(actions[i].source == -1) {
+            close(actions[i].fd);
+        }
+        else if(dup2(actions[i].source, actions[i].fd) == -1) {
+            print_errno(SHELL_NAME);
+            _exit(ERROR_DEFAULT);
+        }
+    }
+} // apply_fd_actions
+
+
+/**
+ * @brief       Runs file without #! line as a shell script in a forked child
+ *
+ *              This is the only launch path that needs fork, the child has
+ *              to run shell code instead of just exec'ing. Its variables are
+ *              made from envp the command would have been started with
+ *
+ * @return      SUCCESS, ERROR_DEFAULT when fork fails
+ */
+static StatusEnum fork_script(ShellStatePtr shell, const char* path, SimpleCommandPtr command, char** envp,
+                              FdActionPtr actions, uint32_t count, pid_t* pid) {
+    *pid = fork();
+    if(*pid == -1) {
+        print_errno(SHELL_NAME);
+        return ERROR_DEFAULT;
+    }
+    if(*pid != 0) {
+        return SUCCESS;
+    }
+
+    // child, the script starts like a new shell with the environment only
+    apply_fd_actions(actions, count);
+    HashTable env_table;
+    if(populateEnvTable(&env_table, envp) != SUCCESS) {
+        _exit(ERROR_DEFAULT);
+    }
+    scope_dispose(shell);
+    envExportDtor(&shell->env_export);
+    hashTableDtor(&shell->env_table);
+    shell->env_table = env_table;
+    if(envExportCtor(&shell->env_export, &shell->env_table) != SUCCESS) {
+        _exit(ERROR_DEFAULT);
+    }
+    path_cache_clear(shell);
+    jobs_clear(&shell->jobs);
+    functions_clear(shell);
+    shell->script_name = command->argv[0];
+    shell->positional = command->argv + 1;
+    shell->positional_count = command->argc - 1;
+    shell->loop_depth = 0;
+    shell->function_depth = 0;
+
+    int32_t file_descriptor;
+    if(open_file(path, O_RDONLY, &file_descriptor) != SUCCESS) {
+        _exit(ERROR_COMM_CANNOT_EXEC);
+    }
+    run_shell(file_descriptor, shell);
+    exit_child(shell);
+} // fork_script
+
+
+/**
+ * @brief       Waits for child and converts its wait status to shell exit status
+ */
+int32_t wait_child(pid_t pid) {
+    int32_t status = 0;
+    while(waitpid(pid, &status, 0) == -1) {
+        if(errno != EINTR) {
+            return ERROR_DEFAULT;
+        }
+    }
+    if(WIFSIGNALED(status)) {
+        return 128 + WTERMSIG(status);
+    }
+    return WEXITSTATUS(status);
+} // wait_child
+
+
+/**
+ * @brief       Ends forked child of the shell with last status, buffered output is flushed first
+ */
+void exit_child(ShellStatePtr shell) {
+    output_flush();
+    _exit(shell->last_status);
+} // exit_child
+
+
+/**
+ * @brief       Applies actions to the shell process, replaced descriptors are saved
+ *
+ * @param saved output array of count descriptors, -1 when fd was not open
+ */
+static void fd_actions_push(FdActionPtr actions, uint32_t count, int32_t* saved) {
+    for(uint32_t i = 0; i < count; i++) {
+        // buffered output belongs to the descriptor before the change
+        if(actions[i].fd == STDOUT_FILENO || actions[i].fd == STDERR_FILENO) {
+            output_flush();
+        }
+        saved[i] = fcntl(actions[i].fd, F_DUPFD_CLOEXEC, SHELL_FD_BASE);
+        if(actions[i].source == -1) {
+            close(actions[i].fd);
+        }
+        else {
+            dup2(actions[i].source, actions[i].fd);
+        }
+    }
+} // fd_actions_push
+
+
+/**
+ * @brief       Tells whether actions replace descriptor 1 or 2
+ */
+static uint8_t fd_actions_output(FdActionPtr actions, uint32_t count) {
+    for(uint32_t i = 0; i < count; i++) {
+        if(actions[i].fd == STDOUT_FILENO || actions[i].fd == STDERR_FILENO) {
+            return 1U;
+        }
+    }
+    return 0U;
+} // fd_actions_output
+
+
+/**
+ * @brief       Puts back descriptors saved by fd_actions_push() in reverse order
+ */
+static void fd_actions_pop(FdActionPtr actions, uint32_t count, int32_t* saved) {
+    for(uint32_t i = count; i-- > 0;) {
+        if(actions[i].fd == STDOUT_FILENO || actions[i].fd == STDERR_FILENO) {
+            output_flush();
+        }
+        if(saved[i] == -1) {
+            close(actions[i].fd);
+        }
+        else {
+            dup2(saved[i], actions[i].fd);
+            close(saved[i]);
+        }
+    }
+} // fd_actions_pop
+
+
+/**
+ * @brief       Applies redirections to the shell process
+ *
+ *              Used for builtins, functions and compound commands, replaced
+ *              descriptors are saved above SHELL_FD_BASE
+ *
+ * @param shell shell state, bookkeeping is allocated from command arena
+ * @param redirections list of redirections, may be NULL
+ * @param saved output state for redirect_pop()
+ * @return      SUCCESS, ERROR_DEFAULT when redirection fails (reported to stderr),
+ *              ERROR_MALLOC_FAILURE
+ */
+StatusEnum redirect_push(ShellStatePtr shell, RedirectionPtr redirections, SavedFdsPtr saved) {
+    saved->actions = NULL;
+    saved->saved = NULL;
+    saved->count = 0;
+
+    StatusEnum st = prepare_fd_actions(shell, redirections, &saved->actions, &saved->count);
+    ERR_CHECK(st);
+    if(saved->count == 0) {
+        return SUCCESS;
+    }
+
+    saved->saved = (int32_t*) arenaAlloc(&shell->command_arena, sizeof(int32_t) * saved->count);
+    if(saved->saved == NULL) {
+        close_fd_actions(saved->actions, saved->count);
+        saved->count = 0;
+        return ERROR_MALLOC_FAILURE;
+    }
+    fd_actions_push(saved->actions, saved->count, saved->saved);
+    return SUCCESS;
+} // redirect_push
+
+
+/**
+ * @brief       Puts back descriptors replaced by redirect_push()
+ */
+void redirect_pop(SavedFdsPtr saved) {
+    if(saved->count == 0) {
+        return;
+    }
+    fd_actions_pop(saved->actions, saved->count, saved->saved);
+    close_fd_actions(saved->actions, saved->count);
+    saved->count = 0;
+} // redirect_pop
+
+
+/**
+ * @brief       Pushes temporary scope with NAME=value prefixes of command
+ *
+ *              Builtin or function sees the values while the global table stays
+ *              untouched, scope_pop() drops them again. Prefixes are exported
+ *              so commands started by a function get them too
+ *
+ * @param function_scope 1 when the scope belongs to a function call
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+static StatusEnum push_command_scope(ShellStatePtr shell, SimpleCommandPtr command, uint8_t function_scope) {
+    StatusEnum st = scope_push(shell, function_scope);
+    ERR_CHECK(st);
+
+    for(uint32_t i = 0; i < command->assignment_count; i++) {
+        char* assignment = command->assignments[i];
+        char* equals = strchr(assignment, '=');
+
+        *equals = '\0';
+        st = scope_set_local(shell, assignment, equals + 1);
+        if(st == SUCCESS) {
+            st = shell_export_variable(shell, assignment);
+        }
+        *equals = '=';
+        if(st != SUCCESS) {
+            scope_pop(shell);
+            return st;
+        }
+    }
+    return SUCCESS;
+} // push_command_scope
+
+
+/**
+ * @brief       Runs builtin in the shell process with redirections applied
+ *
+ *              Redirected descriptors are saved above SHELL_FD_BASE and put
+ *              back after the builtin returns, assignments before the builtin
+ *              name only live in a temporary scope
+ *
+ * @return      exit status of the builtin
+ */
+static int32_t run_builtin(ShellStatePtr shell, BuiltinFunction builtin, SimpleCommandPtr command,
+                           FdActionPtr actions, uint32_t count) {
+    int32_t saved[count > 0 ? count : 1];
+
+    if(command->assignment_count > 0 && push_command_scope(shell, command, 0U) != SUCCESS) {
+        print_error("cannot allocate memory");
+        return ERROR_DEFAULT;
+    }
+
+    fd_actions_push(actions, count, saved);
+    int32_t status = builtin(shell, command->argc, command->argv);
+    // output going to a redirected descriptor is written here, so its errors belong to the builtin
+    if(fd_actions_output(actions, count) && output_flush() != SUCCESS) {
+        print_error("%s: write error: %s", command->argv[0], strerror(errno));
+        status = ERROR_DEFAULT;
+    }
+    fd_actions_pop(actions, count, saved);
+
+    if(command->assignment_count > 0) {
+        scope_pop(shell);
+    }
+    return status;
+} // run_builtin
+
+
+/**
+ * @brief       Calls shell function in its own scope
+ *
+ *              Arguments become positional parameters, NAME=value prefixes and
+ *              `local` variables live in the scope of the call, loops of the
+ *              caller can't be left by break inside the function. The call
+ *              holds a reference so the body survives its own redefinition
+ *
+ * @return      SUCCESS or fatal error of the body
+ */
+static StatusEnum call_function(ShellStatePtr shell, ShellFunctionPtr function, SimpleCommandPtr command,
+                                FdActionPtr actions, uint32_t count) {
+    int32_t saved[count > 0 ? count : 1];
+
+    if(push_command_scope(shell, command, 1U) != SUCCESS) {
+        print_error("cannot allocate memory");
+        shell->last_status = ERROR_DEFAULT;
+        return SUCCESS;
+    }
+
+    char** positional = shell->positional;
+    uint32_t positional_count = shell->positional_count;
+    uint32_t loop_depth = shell->loop_depth;
+    shell->positional = command->argv + 1;
+    shell->positional_count = command->argc - 1;
+    shell->loop_depth = 0;
+    shell->function_depth++;
+
+    function->references++;
+    fd_actions_push(actions, count, saved);
+    StatusEnum st = vm_run(shell, function->program);
+    fd_actions_pop(actions, count, saved);
+    function_release(function);
+
+    shell->function_depth--;
+    shell->loop_depth = loop_depth;
+    shell->positional = positional;
+    shell->positional_count = positional_count;
+    shell->returning = 0U;
+    scope_pop(shell);
+    return st;
+} // call_function
+
+
+/**
+ * @brief       Sets shell variables from assignments of command without name
+ */
+static StatusEnum assign_variables(ShellStatePtr shell, SimpleCommandPtr command) {
+    for(uint32_t i = 0; i < command->assignment_count; i++) {
+        char* assignment = command->assignments[i];
+        char* equals = strchr(assignment, '=');
+
+        *equals = '\0';
+        StatusEnum st = shell_set_variable(shell, assignment, equals + 1);
+        *equals = '=';
+        ERR_CHECK(st);
+    }
+    return SUCCESS;
+} // assign_variables
+
+
+/**
+ * @brief       Returns value of the last PATH= prefix assignment of command
+ * @return      value, NULL when the command does not assign PATH
+ */
+static const char* command_path(SimpleCommandPtr command) {
+    const char* value = NULL;
+    for(uint32_t i = 0; i < command->assignment_count; i++) {
+        if(strncmp(command->assignments[i], "PATH=", 5) == 0) {
+            value = command->assignments[i] + 5;
+        }
+    }
+    return value;
+} // command_path
+
+
+/**
+ * @brief       Reports command which could not be started through its redirections
+ *
+ *              The message goes where stderr of the command would go, so
+ *              `nosuch 2>/dev/null` stays quiet as in other shells
+ *
+ * @param st    ERROR_COMMAND_NOT_FOUND or ERROR_COMM_CANNOT_EXEC of the PATH search
+ * @param error errno value of the failed spawn, 0 when PATH search failed
+ */
+static void report_spawn_error(FdActionPtr actions, uint32_t count, const char* name, StatusEnum st,
+                               int32_t error) {
+    int32_t saved[count > 0 ? count : 1];
+    fd_actions_push(actions, count, saved);
+    if(error != 0) {
+        errno = error;
+        print_errno(name);
+    }
+    else if(st == ERROR_COMMAND_NOT_FOUND) {
+        print_error("%s: command not found", name);
+    }
+    else {
+        print_error("%s: permission denied", name);
+    }
+    fd_actions_pop(actions, count, saved);
+} // report_spawn_error
+
+
+/**
+ * @brief       Starts external program of command with descriptor actions
+ *
+ * @param pid   output child, 0 when the program could not be started
+ *              (reported to stderr, shell->last_status is set)
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+static StatusEnum spawn_command(ShellStatePtr shell, SimpleCommandPtr command,
+                                FdActionPtr actions, uint32_t action_count, pid_t* pid) {
+    *pid = 0;
+    char path[PATH_MAX];
+    const char* path_variable = command_path(command);
+    StatusEnum st = (path_variable != NULL) ? find_command_in(path_variable, command->argv[0], path)
+                                            : find_command(shell, command->argv[0], path);
+    if(st != SUCCESS) {
+        report_spawn_error(actions, action_count, command->argv[0], st, 0);
+        shell->last_status = st;
+        return SUCCESS;
+    }
+
+    char** envp = NULL;
+    st = shell_build_envp(shell, command->assignments, command->assignment_count, &envp);
+    ERR_CHECK(st);
+
+    int32_t rc = spawn_program(path, command->argv, envp, actions, action_count, pid);
+    // remembered location is gone, search PATH once more
+    if(rc == ENOENT && path_variable == NULL && strchr(command->argv[0], '/') == NULL) {
+        hashTableRemove(&shell->path_cache, command->argv[0]);
+        if(find_command(shell, command->argv[0], path) == SUCCESS) {
+            rc = spawn_program(path, command->argv, envp, actions, action_count, pid);
+        }
+    }
+    if(rc == ENOEXEC) {
+        st = fork_script(shell, path, command, envp, actions, action_count, pid);
+        rc = (st == SUCCESS) ? 0 : -1;
+    }
+
+    if(rc != 0) {
+        if(rc > 0) {
+            report_spawn_error(actions, action_count, command->argv[0], ERROR_COMM_CANNOT_EXEC, rc);
+        }
+        shell->last_status = (rc == ENOENT) ? ERROR_COMMAND_NOT_FOUND : ERROR_COMM_CANNOT_EXEC;
+        *pid = 0;
+    }
+    return SUCCESS;
+} // spawn_command
+
+
+/**
+ * @brief       Executes simple command and waits for it
+ *
+ *              Assignments without command name set shell variables, external
+ *              programs are started with posix_spawn and redirections are passed
+ *              as spawn file actions, fork is only used when the child has to run
+ *              shell code (script without #! line)
+ *
+ * @param shell shell state
+ * @param command command to execute
+ * @return      SUCCESS or error status, exit status is stored in shell->last_status
+ */
+StatusEnum exec_simple_command(ShellStatePtr shell, SimpleCommandPtr command) {
+    if(shell == NULL || command == NULL) {
+        return ERROR_DEFAULT;
+    }
+
+    FdActionPtr actions = NULL;
+    uint32_t action_count = 0;
+    StatusEnum st = prepare_fd_actions(shell, command->redirections, &actions, &action_count);
+    if(st == ERROR_MALLOC_FAILURE) {
+        return st;
+    }
+    if(st != SUCCESS) {
+        shell->last_status = st;
+        return SUCCESS;
+    }
+
+    // only assignments and/or redirections
+    if(command->argc == 0) {
+        close_fd_actions(actions, action_count);
+        st = assign_variables(shell, command);
+        shell->last_status = (st == SUCCESS) ? 0 : st;
+        return (st == ERROR_MALLOC_FAILURE) ? st : SUCCESS;
+    }
+
+    ShellFunctionPtr function = function_find(shell, command->argv[0]);
+    if(function != NULL) {
+        st = call_function(shell, function, command, actions, action_count);
+        close_fd_actions(actions, action_count);
+        return st;
+    }
+
+    BuiltinFunction builtin = find_builtin(shell, command->argv[0]);
+    if(builtin != NULL) {
+        shell->last_status = run_builtin(shell, builtin, command, actions, action_count);
+        close_fd_actions(actions, action_count);
+        return SUCCESS;
+    }
+
+    pid_t pid;
+    st = spawn_command(shell, command, actions, action_count, &pid);
+    close_fd_actions(actions, action_count);
+    ERR_CHECK(st);
+
+    if(pid != 0) {
+        shell->last_status = wait_child(pid);
+    }
+    return SUCCESS;
+} // exec_simple_command
+
+
+/**
+ * @brief       Starts simple command without waiting for it
+ *
+ *              External programs are spawned like exec_simple_command() does,
+ *              functions, builtins and commands without a name run in a forked child
+ *
+ * @param shell shell state
+ * @param command command to execute
+ * @param setup actions applied before the redirections of the command (pipe ends),
+ *              their sources stay open in the shell, may be NULL
+ * @param setup_count number of setup actions
+ * @param pid   output child, 0 when the command could not be started
+ *              (reported to stderr, shell->last_status is set)
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+StatusEnum exec_start_command(ShellStatePtr shell, SimpleCommandPtr command, FdActionPtr setup,
+                              uint32_t setup_count, pid_t* pid) {
+    *pid = 0;
+    FdActionPtr redirections = NULL;
+    uint32_t redirection_count = 0;
+    StatusEnum st = prepare_fd_actions(shell, command->redirections, &redirections, &redirection_count);
+    if(st != SUCCESS) {
+        shell->last_status = st;
+        return (st == ERROR_MALLOC_FAILURE) ? st : SUCCESS;
+    }
+
+    FdActionPtr actions = redirections;
+    uint32_t action_count = redirection_count;
+    if(setup_count > 0) {
+        action_count += setup_count;
+        actions = (FdActionPtr) arenaAlloc(&shell->command_arena, sizeof(FdAction) * action_count);
+        if(actions == NULL) {
+            close_fd_actions(redirections, redirection_count);
+            return ERROR_MALLOC_FAILURE;
+        }
+        memcpy(actions, setup, sizeof(FdAction) * setup_count);
+        if(redirection_count > 0) {
+            memcpy(actions + setup_count, redirections, sizeof(FdAction) * redirection_count);
+        }
+    }
+
+    if(command->argc > 0 && function_find(shell, command->argv[0]) == NULL &&
+       find_builtin(shell, command->argv[0]) == NULL) {
+        st = spawn_command(shell, command, actions, action_count, pid);
+        close_fd_actions(redirections, redirection_count);
+        return st;
+    }
+
+    output_flush();
+    *pid = fork();
+    if(*pid == -1) {
+        print_errno(SHELL_NAME);
+        close_fd_actions(redirections, redirection_count);
+        shell->last_status = ERROR_DEFAULT;
+        *pid = 0;
+        return SUCCESS;
+    }
+    if(*pid != 0) {
+        close_fd_actions(redirections, redirection_count);
+        return SUCCESS;
+    }
+
+    // child, redirections are already in place
+    apply_fd_actions(actions, action_count);
+    jobs_inherit(&shell->jobs);
+    shell->loop_depth = 0;
+    shell->function_depth = 0;
+    command->redirections = NULL;
+    if(exec_simple_command(shell, command) != SUCCESS) {
+        shell->last_status = ERROR_DEFAULT;
+    }
+    exit_child(shell);
+} // exec_start_command
@@ -0,0 +1,185 @@
+#ifndef EXEC_H
+#define EXEC_H
+
+#include <stdint.h>
+#include <spawn.h>
+#include <signal.h>
+#include <limits.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include "../utils/error.h"
+#include "../utils/env.h"
+#include "../utils/file.h"
+#include "../utils/output.h"
+#include "../data_structures/htab.h"
+#include "../data_structures/arena.h"
+#include "../lexer/lexer.h"
+#include "jobs.h"
+
+// capacity asked for pipes of pipelines and command substitutions
+#define SHELL_PIPE_SIZE (1024 * 1024)
+// used when PATH is not set
+#define DEFAULT_PATH "/usr/local/bin:/usr/bin:/bin"
+
+
+struct variable_scope;
+
+// state shared by everything that runs commands
+typedef struct shell_state {
+    HashTable env_table;        // global variables, exported ones carry ENV_EXPORTED
+    EnvExport env_export;       // envp derived from env_table
+    Arena command_arena;        // per command line allocations
+    HashTable path_cache;       // command name -> full path (hash builtin)
+    struct variable_scope* scope;       // innermost local scope, NULL at top level
+    struct variable_scope* free_scopes; // popped scopes kept for reuse
+    HashTable functions;        // function name -> ShellFunctionPtr stored as bytes
+    HashTable builtins;         // command name -> BuiltinFunction stored as bytes
+    JobTable jobs;              // background commands
+    char* script_name;          // $0
+    char** positional;          // $1 ... not owned
+    uint32_t positional_count;  // $#
+    pid_t shell_pid;            // $$, subshells keep the value of the parent
+    pid_t last_background;      // $!, 0 before first background command
+    uint32_t loop_depth;        // loops running in the current function
+    uint32_t function_depth;    // functions being executed
+    uint32_t break_levels;      // loops left to leave after break or continue
+    uint8_t continue_loop;      // the last loop left by break_levels continues
+    uint8_t returning;          // return is unwinding current function
+    uint8_t exiting;            // exit is unwinding everything
+    uint8_t dump_bytecode;      // --dump-bytecode, compiled programs are listed on stderr
+    int32_t last_status;        // $?
+} ShellState, *ShellStatePtr;
+
+
+//
+typedef struct redirection {
+    struct redirection* next;
+    TokenTypeEnum type;         // redirector token TOKEN_LESS ... TOKEN_TLESS
+    int32_t io_number;          // redirected descriptor, -1 for the redirector default
+    char* target;               // file name, descriptor number for <& >&, word of <<<, body of << <<-
+    uint32_t body_length;       // length of here-document body
+    uint8_t expand_body;        // here-document body is expanded while it is written
+} Redirection, *RedirectionPtr;
+
+
+// one step of descriptor setup for a command, applied in order
+typedef struct fd_action {
+    int32_t fd;         // descriptor of the command
+    int32_t source;     // descriptor duplicated onto fd, -1 closes fd
+    uint8_t owned;      // source was opened by the shell, closed after use
+} FdAction, *FdActionPtr;
+
+
+// redirections applied in the shell process, undone by redirect_pop()
+typedef struct saved_fds {
+    FdActionPtr actions;
+    int32_t* saved;             // copies of replaced descriptors, -1 when fd was closed
+    uint32_t count;
+} SavedFds, *SavedFdsPtr;
+
+
+//
+typedef struct simple_command {
+    char** argv;                // NULL terminated, argv[0] is command name
+    uint32_t argc;
+    char** assignments;         // NAME=value words preceding the command name
+    uint32_t assignment_count;
+    RedirectionPtr redirections;    // in source order
+} SimpleCommand, *SimpleCommandPtr;
+
+
+/**
+ * @brief       Initializes shell state from process environment
+ *
+ * @param shell state passed by address
+ * @param environ environment of the shell process
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+StatusEnum shell_state_init(ShellStatePtr shell, char** environ);
+
+/**
+ * @brief       Frees everything owned by shell state
+ */
+void shell_state_dispose(ShellStatePtr shell);
+
+/**
+ * @brief       Applies redirections to the shell process
+ *
+ *              Used for builtins, functions and compound commands, replaced
+ *              descriptors are saved above SHELL_FD_BASE
+ *
+ * @param shell shell state, bookkeeping is allocated from command arena
+ * @param redirections list of redirections, may be NULL
+ * @param saved output state for redirect_pop()
+ * @return      SUCCESS, ERROR_DEFAULT when redirection fails (reported to stderr),
+ *              ERROR_MALLOC_FAILURE
+ */
+StatusEnum redirect_push(ShellStatePtr shell, RedirectionPtr redirections, SavedFdsPtr saved);
+
+/**
+ * @brief       Puts back descriptors replaced by redirect_push()
+ */
+void redirect_pop(SavedFdsPtr saved);
+
+/**
+ * @brief       Waits for child and converts its wait status to shell exit status
+ */
+int32_t wait_child(pid_t pid);
+
+/**
+ * @brief       Ends forked child of the shell with last status, buffered output is flushed first
+ */
+void exit_child(ShellStatePtr shell) __attribute__((noreturn));
+
+/**
+ * @brief       Forgets all remembered command locations (hash -r)
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+StatusEnum path_cache_clear(ShellStatePtr shell);
+
+/**
+ * @brief       Finds executable for command name using PATH from env table
+ *
+ *              Found locations are remembered in the path cache so PATH is
+ *              searched once per command name until PATH changes or hash -r
+ *
+ * @param shell shell state with env table
+ * @param name  command name, names containing / are used as they are
+ * @param path  output buffer of PATH_MAX bytes
+ * @return      SUCCESS, ERROR_COMMAND_NOT_FOUND or ERROR_COMM_CANNOT_EXEC
+ */
+StatusEnum find_command(ShellStatePtr shell, const char* name, char* path);
+
+/**
+ * @brief       Executes simple command and waits for it
+ *
+ *              Assignments without command name set shell variables, external
+ *              programs are started with posix_spawn and redirections are passed
+ *              as spawn file actions, fork is only used when the child has to run
+ *              shell code (script without #! line)
+ *
+ * @param shell shell state
+ * @param command command to execute
+ * @return      SUCCESS or error status, exit status is stored in shell->last_status
+ */
+StatusEnum exec_simple_command(ShellStatePtr shell, SimpleCommandPtr command);
+
+/**
+ * @brief       Starts simple command without waiting for it
+ *
+ *              External programs are spawned like exec_simple_command() does,
+ *              functions, builtins and commands without a name run in a forked child
+ *
+ * @param shell shell state
+ * @param command command to execute
+ * @param setup actions applied before the redirections of the command (pipe ends),
+ *              their sources stay open in the shell, may be NULL
+ * @param setup_count number of setup actions
+ * @param pid   output child, 0 when the command could not be started
+ *              (reported to stderr, shell->last_status is set)
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+StatusEnum exec_start_command(ShellStatePtr shell, SimpleCommandPtr command, FdActionPtr setup,
+                              uint32_t setup_count, pid_t* pid);
+
+#endif
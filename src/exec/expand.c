@@ -0,0 +1,887 @@
+/**
+ * Word expansion
+ *
+ * Words are kept raw in the syntax tree and expanded every time the command
+ * runs, words without $ ` or quotes skip all of this and are used as they are
+ */
+
+#include "expand.h"
+#include "variables.h"
+#include "arithmetic.h"
+#include "glob.h"
+#include "../shell.h"
+
+// first capacity of field buffers and field vectors
+#define EXPAND_MIN_CAPACITY 64U
+// bytes read from command substitution at once
+#define SUBSTITUTION_READ_SIZE 4096U
+
+// characters with special meaning in patterns, escaped when quoted,
+// ! and ^ only negate right after [ but escaping them elsewhere is harmless
+#define PATTERN_SPECIAL "*?[]!^\\"
+// classes of glob_chars, what a byte means in a field of pathname expansion
+#define GLOB_CHAR_QUOTED    0x01U   // escaped when quoted
+#define GLOB_CHAR_UNQUOTED  0x02U   // escaped when unquoted
+#define GLOB_CHAR_MAGIC     0x04U   // makes the field a pattern when unquoted
+
+
+//
+typedef struct expander {
+    ShellStatePtr shell;
+    uint32_t mode;              // EXPAND_SPLIT / EXPAND_PATTERN / EXPAND_HEREDOC / EXPAND_GLOB
+    char* buffer;               // current field, allocated from command arena
+    size_t length;
+    size_t capacity;
+    uint8_t field_started;      // quotes make a field even when it stays empty
+    uint8_t suppress_quotes;    // "$@" without parameters produces no field
+    char** fields;              // NULL terminated, unused without EXPAND_SPLIT
+    uint32_t field_count;
+    uint32_t field_capacity;
+    const char* ifs;            // field separators
+    const char* word_text;      // raw text of the expanded word, NULL for here-documents
+    ArithExpansionPtr arithmetic;   // its compiled $(( )), found by offset in word_text
+    GlobCachePtr glob;          // directory listings of the command, EXPAND_GLOB only
+    uint8_t glob_magic;         // current field has unquoted * ? or [
+    uint8_t glob_escaped;       // current field has escapes to remove when it is not expanded
+} Expander, *ExpanderPtr;
+
+static StatusEnum expand_text(ExpanderPtr e, const char* p, const char* end, uint8_t quoted);
+
+static const uint8_t glob_chars[256] = {
+    ['*'] = GLOB_CHAR_QUOTED | GLOB_CHAR_MAGIC,
+    ['?'] = GLOB_CHAR_QUOTED | GLOB_CHAR_MAGIC,
+    ['['] = GLOB_CHAR_QUOTED | GLOB_CHAR_MAGIC,
+    [']'] = GLOB_CHAR_QUOTED,
+    ['!'] = GLOB_CHAR_QUOTED,
+    ['^'] = GLOB_CHAR_QUOTED,
+    ['\\'] = GLOB_CHAR_QUOTED | GLOB_CHAR_UNQUOTED
+};
+
+
+/**
+ * @brief       Makes room for extra bytes and terminating NUL in the field buffer
+ */
+static StatusEnum buffer_reserve(ExpanderPtr e, size_t extra) {
+    if(e->length + extra + 1 <= e->capacity) {
+        return SUCCESS;
+    }
+
+    size_t capacity = (e->capacity == 0) ? EXPAND_MIN_CAPACITY : e->capacity * 2;
+    if(capacity < e->length + extra + 1) {
+        capacity = e->length + extra + 1;
+    }
+    char* buffer = (char*) arenaAlloc(&e->shell->command_arena, capacity);
+    if(buffer == NULL) {
+        return ERROR_MALLOC_FAILURE;
+    }
+    if(e->length > 0) {
+        memcpy(buffer, e->buffer, e->length);
+    }
+    e->buffer = buffer;
+    e->capacity = capacity;
+    return SUCCESS;
+} // buffer_reserve
+
+
+/**
+ * @brief       Appends text to the current field
+ *
+ *              Quoted text gets pattern characters escaped in EXPAND_PATTERN and
+ *              EXPAND_GLOB modes, unquoted backslashes are escaped in EXPAND_GLOB
+ *              mode where fields keep their escapes until field_end()
+ */
+static StatusEnum append_literal(ExpanderPtr e, const char* text, size_t length, uint8_t quoted) {
+    // most text has no pattern characters and is copied as it is
+    size_t plain = length;
+    if(e->mode & EXPAND_GLOB) {
+        uint8_t mask = quoted ? GLOB_CHAR_QUOTED : (GLOB_CHAR_UNQUOTED | GLOB_CHAR_MAGIC);
+        plain = 0;
+        while(plain < length && !(glob_chars[(uint8_t)text[plain]] & mask)) {
+            plain++;
+        }
+    }
+    if(plain < length) {
+        StatusEnum st = buffer_reserve(e, length * 2);
+        ERR_CHECK(st);
+        memcpy(e->buffer + e->length, text, plain);
+        e->length += plain;
+        for(size_t i = plain; i < length; i++) {
+            uint8_t class = glob_chars[(uint8_t)text[i]];
+            if(class & (quoted ? GLOB_CHAR_QUOTED : GLOB_CHAR_UNQUOTED)) {
+                e->buffer[e->length++] = '\\';
+                e->glob_escaped = 1U;
+            }
+            else if(!quoted && (class & GLOB_CHAR_MAGIC)) {
+                e->glob_magic = 1U;
+            }
+            e->buffer[e->length++] = text[i];
+        }
+        return SUCCESS;
+    }
+    if(!(quoted && (e->mode & EXPAND_PATTERN))) {
+        StatusEnum st = buffer_reserve(e, length);
+        ERR_CHECK(st);
+        memcpy(e->buffer + e->length, text, length);
+        e->length += length;
+        return SUCCESS;
+    }
+
+    StatusEnum st = buffer_reserve(e, length * 2);
+    ERR_CHECK(st);
+    for(size_t i = 0; i < length; i++) {
+        if(strchr(PATTERN_SPECIAL, text[i]) != NULL) {
+            e->buffer[e->length++] = '\\';
+        }
+        e->buffer[e->length++] = text[i];
+    }
+    return SUCCESS;
+} // append_literal
+
+
+/**
+ * @brief       Returns NUL terminated current field
+ */
+static char* field_text(ExpanderPtr e) {
+    if(e->buffer == NULL) {
+        return "";
+    }
+    e->buffer[e->length] = '\0';
+    return e->buffer;
+} // field_text
+
+
+/**
+ * @brief       Appends finished string to the field vector
+ */
+static StatusEnum field_push(ExpanderPtr e, char* field) {
+    if(e->field_count + 1 >= e->field_capacity) {
+        uint32_t capacity = (e->field_capacity == 0) ? EXPAND_MIN_CAPACITY / 8 : e->field_capacity * 2;
+        char** fields = (char**) arenaAlloc(&e->shell->command_arena, sizeof(char*) * capacity);
+        if(fields == NULL) {
+            return ERROR_MALLOC_FAILURE;
+        }
+        if(e->field_count > 0) {
+            memcpy(fields, e->fields, sizeof(char*) * e->field_count);
+        }
+        e->fields = fields;
+        e->field_capacity = capacity;
+    }
+    e->fields[e->field_count++] = field;
+    e->fields[e->field_count] = NULL;
+    return SUCCESS;
+} // field_push
+
+
+/**
+ * @brief       Ends current field, empty unquoted fields are dropped
+ *
+ *              In EXPAND_GLOB mode a field with unquoted * ? or [ is replaced
+ *              by the sorted paths it matches, or stays as it is without escapes
+ *              when nothing matches
+ */
+static StatusEnum field_end(ExpanderPtr e) {
+    if(e->length == 0 && !e->field_started) {
+        return SUCCESS;
+    }
+    char* field = field_text(e);
+    StatusEnum st = SUCCESS;
+    if(e->glob_magic && e->glob != NULL && glob_is_pattern(field)) {
+        char** matches;
+        uint32_t count;
+        st = glob_expand(e->glob, &e->shell->command_arena, field, &matches, &count);
+        for(uint32_t i = 0; i < count && st == SUCCESS; i++) {
+            st = field_push(e, matches[i]);
+        }
+        if(st == SUCCESS && count > 0) {
+            field = NULL;
+        }
+    }
+    if(st == SUCCESS && field != NULL) {
+        if(e->glob_magic || e->glob_escaped) {
+            glob_unescape(field);
+        }
+        st = field_push(e, field);
+    }
+    ERR_CHECK(st);
+
+    // next field gets a buffer of its own
+    e->buffer = NULL;
+    e->length = 0;
+    e->capacity = 0;
+    e->field_started = 0U;
+    e->glob_magic = 0U;
+    e->glob_escaped = 0U;
+    return SUCCESS;
+} // field_end
+
+
+/**
+ * @brief       Appends result of an expansion, unquoted results are split on IFS
+ */
+static StatusEnum append_expansion(ExpanderPtr e, const char* value, size_t length, uint8_t quoted) {
+    if(quoted || !(e->mode & EXPAND_SPLIT)) {
+        return append_literal(e, value, length, quoted);
+    }
+
+    const char* end = value + length;
+    while(value < end) {
+        const char* start = value;
+        while(value < end && strchr(e->ifs, *value) == NULL) {
+            value++;
+        }
+        StatusEnum st = append_literal(e, start, (size_t)(value - start), 0U);
+        ERR_CHECK(st);
+        if(value < end) {
+            st = field_end(e);
+            ERR_CHECK(st);
+            value++;
+        }
+    }
+    return SUCCESS;
+} // append_expansion
+
+
+/**
+ * @brief       Formats number into the command arena
+ */
+static char* number_text(ShellStatePtr shell, int64_t number) {
+    char text[24];
+    int length = snprintf(text, sizeof(text), "%lld", (long long)number);
+    return arenaStrndup(&shell->command_arena, text, (size_t)length);
+} // number_text
+
+
+/**
+ * @brief       Looks up named, positional or special parameter
+ *
+ * @param name  parameter name (not NUL terminated)
+ * @param length length of name
+ * @param value output value
+ * @return      SUCCESS, ERROR_DEFAULT when parameter is unset, ERROR_MALLOC_FAILURE
+ */
+static StatusEnum parameter_value(ShellStatePtr shell, const char* name, size_t length, char** value) {
+    char first = name[0];
+    if(first >= '0' && first <= '9') {
+        uint64_t index = 0;
+        for(size_t i = 0; i < length && index <= UINT32_MAX; i++) {
+            index = index * 10 + (uint64_t)(name[i] - '0');
+        }
+        if(index == 0) {
+            *value = shell->script_name;
+            return SUCCESS;
+        }
+        if(index > shell->positional_count) {
+            return ERROR_DEFAULT;
+        }
+        *value = shell->positional[index - 1];
+        return SUCCESS;
+    }
+
+    if(length == 1) {
+        switch(first) {
+            case '?':
+                *value = number_text(shell, shell->last_status);
+                return (*value != NULL) ? SUCCESS : ERROR_MALLOC_FAILURE;
+            case '$':
+                *value = number_text(shell, shell->shell_pid);
+                return (*value != NULL) ? SUCCESS : ERROR_MALLOC_FAILURE;
+            case '#':
+                *value = number_text(shell, shell->positional_count);
+                return (*value != NULL) ? SUCCESS : ERROR_MALLOC_FAILURE;
+            case '!':
+                if(shell->last_background == 0) {
+                    return ERROR_DEFAULT;
+                }
+                *value = number_text(shell, shell->last_background);
+                return (*value != NULL) ? SUCCESS : ERROR_MALLOC_FAILURE;
+            case '-':
+                *value = "";
+                return SUCCESS;
+            default:
+                break;
+        }
+    }
+
+    char* key = arenaStrndup(&shell->command_arena, name, length);
+    if(key == NULL) {
+        return ERROR_MALLOC_FAILURE;
+    }
+    return shell_get_variable(shell, key, value);
+} // parameter_value
+
+
+/**
+ * @brief       Expands $@ and $*
+ *
+ *              "$@" gives one field per parameter, "$*" joins them with the
+ *              first character of IFS, unquoted forms are split as usual
+ */
+static StatusEnum expand_positional(ExpanderPtr e, uint8_t star, uint8_t quoted) {
+    ShellStatePtr shell = e->shell;
+    if(shell->positional_count == 0) {
+        e->suppress_quotes = (quoted && !star) ? 1U : e->suppress_quotes;
+        return SUCCESS;
+    }
+
+    for(uint32_t i = 0; i < shell->positional_count; i++) {
+        if(i > 0) {
+            StatusEnum st;
+            if(quoted && !star && (e->mode & EXPAND_SPLIT)) {
+                e->field_started = 1U;
+                st = field_end(e);
+            }
+            else if(quoted || !(e->mode & EXPAND_SPLIT)) {
+                char separator = (e->ifs != NULL && *e->ifs != '\0') ? *e->ifs : ' ';
+                st = (e->ifs != NULL && *e->ifs == '\0') ? SUCCESS : append_literal(e, &separator, 1, quoted);
+            }
+            else {
+                st = field_end(e);
+            }
+            ERR_CHECK(st);
+        }
+        StatusEnum st = append_expansion(e, shell->positional[i], strlen(shell->positional[i]), quoted);
+        ERR_CHECK(st);
+    }
+    return SUCCESS;
+} // expand_positional
+
+
+/**
+ * @brief       Runs command in a child and appends its output without trailing newlines
+ */
+static StatusEnum command_substitution(ExpanderPtr e, const char* text, size_t length, uint8_t quoted) {
+    ShellStatePtr shell = e->shell;
+    int32_t fds[2];
+    StatusEnum st = open_pipe(fds);
+    ERR_CHECK(st);
+    pipe_grow(fds[1], SHELL_PIPE_SIZE);
+
+    output_flush();
+    pid_t pid = fork();
+    if(pid == -1) {
+        print_errno(SHELL_NAME);
+        close(fds[0]);
+        close(fds[1]);
+        return ERROR_DEFAULT;
+    }
+    if(pid == 0) {
+        close(fds[0]);
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[1]);
+        jobs_inherit(&shell->jobs);
+        run_string(shell, text, length);
+        exit_child(shell);
+    }
+    close(fds[1]);
+
+    char* output = NULL;
+    size_t output_length = 0;
+    size_t output_capacity = 0;
+    while(1) {
+        if(output_capacity - output_length < SUBSTITUTION_READ_SIZE) {
+            output_capacity = (output_capacity == 0) ? SUBSTITUTION_READ_SIZE : output_capacity * 2;
+            char* grown = (char*) realloc(output, output_capacity);
+            if(grown == NULL) {
+                st = ERROR_MALLOC_FAILURE;
+                break;
+            }
+            output = grown;
+        }
+        ssize_t count = read(fds[0], output + output_length, output_capacity - output_length);
+        if(count == -1 && errno == EINTR) {
+            continue;
+        }
+        if(count <= 0) {
+            break;
+        }
+        output_length += (size_t)count;
+    }
+    close(fds[0]);
+    shell->last_status = wait_child(pid);
+
+    while(output_length > 0 && output[output_length - 1] == '\n') {
+        output_length--;
+    }
+    if(st == SUCCESS && output_length > 0) {
+        st = append_expansion(e, output, output_length, quoted);
+    }
+    free(output);
+    return st;
+} // command_substitution
+
+
+/**
+ * @brief       Expands ${...}, p and end delimit text between the braces
+ */
+static StatusEnum expand_braced(ExpanderPtr e, const char* p, const char* end, uint8_t quoted) {
+    ShellStatePtr shell = e->shell;
+
+    // ${#name} length of value
+    uint8_t length_of = (end - p > 1 && *p == '#') ? 1U : 0U;
+    if(length_of) {
+        p++;
+    }
+
+    const char* name = p;
+    if(p < end && (*p == '_' || (*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z'))) {
+        while(p < end && (*p == '_' || (*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') ||
+                          (*p >= '0' && *p <= '9'))) {
+            p++;
+        }
+    }
+    else if(p < end && *p >= '0' && *p <= '9') {
+        while(p < end && *p >= '0' && *p <= '9') {
+            p++;
+        }
+    }
+    else if(p < end && strchr("?$#!-@*", *p) != NULL) {
+        p++;
+    }
+    size_t name_length = (size_t)(p - name);
+
+    if(name_length == 0 || (length_of && p != end)) {
+        print_error("${%.*s}: bad substitution", (int)(end - name + length_of), name - length_of);
+        return ERROR_DEFAULT;
+    }
+
+    if(*name == '@' || *name == '*') {
+        if(p != end) {
+            print_error("${%.*s}: bad substitution", (int)(end - name), name);
+            return ERROR_DEFAULT;
+        }
+        if(length_of) {
+            char* count = number_text(shell, shell->positional_count);
+            return (count != NULL) ? append_literal(e, count, strlen(count), quoted) : ERROR_MALLOC_FAILURE;
+        }
+        return expand_positional(e, (*name == '*') ? 1U : 0U, quoted);
+    }
+
+    char* value = NULL;
+    StatusEnum st = parameter_value(shell, name, name_length, &value);
+    if(st == ERROR_MALLOC_FAILURE) {
+        return st;
+    }
+    uint8_t set = (st == SUCCESS) ? 1U : 0U;
+
+    if(length_of) {
+        char* length = number_text(shell, set ? (int64_t)strlen(value) : 0);
+        return (length != NULL) ? append_literal(e, length, strlen(length), quoted) : ERROR_MALLOC_FAILURE;
+    }
+    if(p == end) {
+        return set ? append_expansion(e, value, strlen(value), quoted) : SUCCESS;
+    }
+
+    // ${name[:]op word}
+    uint8_t colon = (*p == ':') ? 1U : 0U;
+    p += colon;
+    char op = (p < end) ? *p : '\0';
+    if(op != '-' && op != '=' && op != '+' && op != '?') {
+        print_error("${%.*s}: bad substitution", (int)(end - name), name);
+        return ERROR_DEFAULT;
+    }
+    p++;
+
+    uint8_t usable = (set && !(colon && *value == '\0')) ? 1U : 0U;
+    switch(op) {
+        case '-':
+            return usable ? append_expansion(e, value, strlen(value), quoted) : expand_text(e, p, end, quoted);
+        case '+':
+            return usable ? expand_text(e, p, end, quoted) : SUCCESS;
+        default:
+            break;
+    }
+    if(usable) {
+        return append_expansion(e, value, strlen(value), quoted);
+    }
+
+    // = and ? need the word as a string
+    Expander word = {shell, 0U, NULL, 0, 0, 0U, 0U, NULL, 0, 0, e->ifs, e->word_text, e->arithmetic,
+                     NULL, 0U, 0U};
+    st = expand_text(&word, p, end, quoted);
+    ERR_CHECK(st);
+    char* text = field_text(&word);
+
+    if(op == '?') {
+        print_error("%.*s: %s", (int)name_length, name, (*text != '\0') ? text : "parameter null or not set");
+        shell->last_status = ERROR_DEFAULT;
+        return ERROR_FATAL_EXPANSION;
+    }
+
+    char* key = arenaStrndup(&shell->command_arena, name, name_length);
+    if(key == NULL) {
+        return ERROR_MALLOC_FAILURE;
+    }
+    if(!is_name(key)) {
+        print_error("%s: cannot assign in this way", key);
+        return ERROR_DEFAULT;
+    }
+    st = shell_set_variable(shell, key, text);
+    ERR_CHECK(st);
+    return append_expansion(e, text, strlen(text), quoted);
+} // expand_braced
+
+
+/**
+ * @brief       Expands $(( )), body and length delimit the expression
+ *
+ *              The program compiled with the word is run when there is one,
+ *              otherwise the expression is expanded and compiled every time
+ */
+static StatusEnum expand_arithmetic(ExpanderPtr e, const char* dollar, const char* body, size_t length,
+                                    uint8_t quoted) {
+    ShellStatePtr shell = e->shell;
+    int64_t value = 0;
+    uint8_t textual = 1U;
+    StatusEnum st;
+    if(e->word_text != NULL) {
+        uint32_t offset = (uint32_t)(dollar - e->word_text);
+        for(ArithExpansionPtr expansion = e->arithmetic; expansion != NULL; expansion = expansion->next) {
+            if(expansion->offset == offset) {
+                st = arith_run(shell, expansion->program, &value, &textual);
+                ERR_CHECK(st);
+                break;
+            }
+        }
+    }
+
+    if(textual) {
+        Expander text = {shell, 0U, NULL, 0, 0, 0U, 0U, NULL, 0, 0, e->ifs, e->word_text, e->arithmetic,
+                     NULL, 0U, 0U};
+        st = expand_text(&text, body, body + length, 0U);
+        ERR_CHECK(st);
+        st = arith_evaluate(shell, field_text(&text), text.length, &value);
+        ERR_CHECK(st);
+    }
+
+    char* number = number_text(shell, value);
+    if(number == NULL) {
+        return ERROR_MALLOC_FAILURE;
+    }
+    return append_expansion(e, number, strlen(number), quoted);
+} // expand_arithmetic
+
+
+/**
+ * @brief       Expands $ construct at *cursor and moves cursor past it
+ */
+static StatusEnum expand_dollar(ExpanderPtr e, const char** cursor, const char* end, uint8_t quoted) {
+    const char* p = *cursor + 1;
+    if(p >= end) {
+        *cursor = p;
+        return append_literal(e, "$", 1, quoted);
+    }
+
+    if(*p == '{' || *p == '(') {
+        const char* dollar = *cursor;
+        const char* close = lexer_skip_quoted(*cursor, end);
+        if(close == NULL) {
+            close = end;
+        }
+        *cursor = close;
+
+        if(*p == '{') {
+            return expand_braced(e, p + 1, close - 1, quoted);
+        }
+        const char* body;
+        size_t length;
+        if(arith_expansion_body(dollar, close, &body, &length)) {
+            return expand_arithmetic(e, dollar, body, length, quoted);
+        }
+        return command_substitution(e, p + 1, (size_t)(close - 1 - (p + 1)), quoted);
+    }
+
+    const char* name = p;
+    if(*p == '_' || (*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z')) {
+        while(p < end && (*p == '_' || (*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') ||
+                          (*p >= '0' && *p <= '9'))) {
+            p++;
+        }
+    }
+    else if(*p == '@' || *p == '*') {
+        *cursor = p + 1;
+        return expand_positional(e, (*p == '*') ? 1U : 0U, quoted);
+    }
+    else if((*p >= '0' && *p <= '9') || strchr("?$#!-", *p) != NULL) {
+        p++;
+    }
+    else {
+        // not a parameter, $ stays
+        *cursor = p;
+        return append_literal(e, "$", 1, quoted);
+    }
+    *cursor = p;
+
+    char* value;
+    StatusEnum st = parameter_value(e->shell, name, (size_t)(p - name), &value);
+    if(st == ERROR_DEFAULT) {
+        return SUCCESS;
+    }
+    ERR_CHECK(st);
+    return append_expansion(e, value, strlen(value), quoted);
+} // expand_dollar
+
+
+/**
+ * @brief       Expands `command`, backslash escapes of $ ` and \ are removed first
+ */
+static StatusEnum expand_backquote(ExpanderPtr e, const char** cursor, const char* end, uint8_t quoted) {
+    const char* start = *cursor + 1;
+    const char* close = lexer_skip_quoted(*cursor, end);
+    if(close == NULL) {
+        close = end + 1;
+    }
+    *cursor = (close > end) ? end : close;
+
+    size_t length = (size_t)(close - 1 - start);
+    char* command = (char*) arenaAlloc(&e->shell->command_arena, length + 1);
+    if(command == NULL) {
+        return ERROR_MALLOC_FAILURE;
+    }
+    size_t command_length = 0;
+    for(size_t i = 0; i < length; i++) {
+        if(start[i] == '\\' && i + 1 < length && strchr("$`\\", start[i + 1]) != NULL) {
+            i++;
+        }
+        command[command_length++] = start[i];
+    }
+    return command_substitution(e, command, command_length, quoted);
+} // expand_backquote
+
+
+/**
+ * @brief       Expands raw text between p and end
+ *
+ * @param quoted 1 inside double quotes
+ */
+static StatusEnum expand_text(ExpanderPtr e, const char* p, const char* end, uint8_t quoted) {
+    StatusEnum st = SUCCESS;
+    while(p < end && st == SUCCESS) {
+        char c = *p;
+        if(c == '\'' && !quoted) {
+            const char* close = lexer_skip_quoted(p, end);
+            close = (close == NULL) ? end + 1 : close;
+            st = append_literal(e, p + 1, (size_t)(close - 1 - (p + 1)), 1U);
+            e->field_started = 1U;
+            p = (close > end) ? end : close;
+        }
+        else if(c == '"' && !quoted) {
+            const char* close = lexer_skip_quoted(p, end);
+            close = (close == NULL) ? end + 1 : close;
+            e->suppress_quotes = 0U;
+            st = expand_text(e, p + 1, close - 1, 1U);
+            if(!e->suppress_quotes) {
+                e->field_started = 1U;
+            }
+            e->suppress_quotes = 0U;
+            p = (close > end) ? end : close;
+        }
+        else if(c == '\\') {
+            if(p + 1 >= end) {
+                st = append_literal(e, p, 1, quoted);
+                p++;
+            }
+            else if(p[1] == '\n') {
+                p += 2;
+            }
+            else if(!quoted || strchr((e->mode & EXPAND_HEREDOC) ? "$`\\" : "$`\"\\", p[1]) != NULL) {
+                st = append_literal(e, p + 1, 1, 1U);
+                p += 2;
+            }
+            else {
+                st = append_literal(e, p, 1, 1U);
+                p++;
+            }
+        }
+        else if(c == '$') {
+            st = expand_dollar(e, &p, end, quoted);
+        }
+        else if(c == '`') {
+            st = expand_backquote(e, &p, end, quoted);
+        }
+        else {
+            const char* start = p;
+            while(p < end && *p != '\\' && *p != '$' && *p != '`' && (quoted || *p != '\'') &&
+                  (*p != '"' || (e->mode & EXPAND_HEREDOC))) {
+                p++;
+            }
+            st = append_literal(e, start, (size_t)(p - start), quoted);
+        }
+    }
+    return st;
+} // expand_text
+
+
+/**
+ * @brief       Expands one word into the expander, leading ~ is replaced by home directory
+ */
+static StatusEnum expand_word(ExpanderPtr e, WordPtr word) {
+    const char* p = word->text;
+    const char* end = word->text + word->length;
+    e->word_text = word->text;
+    e->arithmetic = word->arithmetic;
+
+    if(*p == '~') {
+        const char* slash = memchr(p, '/', word->length);
+        const char* prefix_end = (slash != NULL) ? slash : end;
+        const char* user = p + 1;
+        size_t user_length = (size_t)(prefix_end - user);
+
+        // quoted or expanded login names are left alone
+        uint8_t plain = 1U;
+        for(const char* q = user; q < prefix_end; q++) {
+            plain = (strchr("'\"\\$`", *q) == NULL) ? plain : 0U;
+        }
+
+        char* home = NULL;
+        if(plain && user_length == 0) {
+            shell_get_variable(e->shell, "HOME", &home);
+        }
+        else if(plain) {
+            char* login = arenaStrndup(&e->shell->command_arena, user, user_length);
+            if(login == NULL) {
+                return ERROR_MALLOC_FAILURE;
+            }
+            struct passwd* entry = getpwnam(login);
+            home = (entry != NULL) ? entry->pw_dir : NULL;
+        }
+        if(home != NULL) {
+            StatusEnum st = append_literal(e, home, strlen(home), 1U);
+            ERR_CHECK(st);
+            p = prefix_end;
+        }
+    }
+    return expand_text(e, p, end, 0U);
+} // expand_word
+
+
+/**
+ * @brief       Initializes expander
+ */
+static void expander_init(ExpanderPtr e, ShellStatePtr shell, uint32_t mode) {
+    memset(e, 0, sizeof(*e));
+    e->shell = shell;
+    e->mode = mode;
+    if(shell_get_variable(shell, "IFS", (char**) &e->ifs) != SUCCESS) {
+        e->ifs = DEFAULT_IFS;
+    }
+} // expander_init
+
+
+/**
+ * @brief       Tells whether word needs no expansion at all, pattern characters
+ *              count only for pathname expansion
+ */
+static inline uint8_t word_is_literal(WordPtr word, uint32_t mode) {
+    uint32_t flags = (mode & EXPAND_GLOB) ? word->flags : (word->flags & ~WORD_FLAG_GLOB);
+    return (flags == 0 && word->text[0] != '~') ? 1U : 0U;
+} // word_is_literal
+
+
+/**
+ * @brief       Expands words into NULL terminated vector of fields
+ *
+ *              Words without flags are used as they are, others go through
+ *              tilde, parameter and command substitution, field splitting,
+ *              pathname expansion (EXPAND_GLOB) and quote removal. Everything
+ *              is allocated from the command arena
+ *
+ * @param shell shell state
+ * @param words words of the syntax tree
+ * @param count number of words
+ * @param mode  EXPAND_SPLIT / EXPAND_PATTERN / EXPAND_GLOB
+ * @param fields output vector
+ * @param field_count output number of fields
+ * @return      SUCCESS, ERROR_DEFAULT on bad substitution (reported to stderr),
+ *              ERROR_MALLOC_FAILURE
+ */
+StatusEnum expand_words(ShellStatePtr shell, WordPtr words, uint32_t count, uint32_t mode,
+                        char*** fields, uint32_t* field_count) {
+    Expander e;
+    expander_init(&e, shell, mode | EXPAND_SPLIT);
+
+    // listings are shared by all words, dir/*.log dir/*.gz reads dir once
+    GlobCache glob;
+    if(mode & EXPAND_GLOB) {
+        glob_cache_init(&glob);
+        e.glob = &glob;
+    }
+
+    StatusEnum st = SUCCESS;
+    for(uint32_t i = 0; i < count && st == SUCCESS; i++) {
+        if(word_is_literal(&words[i], mode)) {
+            st = field_push(&e, words[i].text);
+            continue;
+        }
+        st = expand_word(&e, &words[i]);
+        if(st == SUCCESS) {
+            st = field_end(&e);
+        }
+    }
+    if(mode & EXPAND_GLOB) {
+        glob_cache_dispose(&glob);
+    }
+    ERR_CHECK(st);
+
+    // vector always exists so callers can rely on argv[argc] == NULL
+    if(e.fields == NULL) {
+        e.fields = (char**) arenaAlloc(&shell->command_arena, sizeof(char*));
+        if(e.fields == NULL) {
+            return ERROR_MALLOC_FAILURE;
+        }
+        e.fields[0] = NULL;
+    }
+    *fields = e.fields;
+    *field_count = e.field_count;
+    return SUCCESS;
+} // expand_words
+
+
+/**
+ * @brief       Expands word into a single string without field splitting
+ *
+ *              Used for assignments, redirection targets and case words
+ *
+ * @param shell shell state
+ * @param word  word of the syntax tree
+ * @param mode  0 or EXPAND_PATTERN
+ * @param result output string allocated from the command arena
+ * @return      SUCCESS, ERROR_DEFAULT on bad substitution, ERROR_MALLOC_FAILURE
+ */
+StatusEnum expand_string(ShellStatePtr shell, WordPtr word, uint32_t mode, char** result) {
+    if(word_is_literal(word, mode)) {
+        *result = word->text;
+        return SUCCESS;
+    }
+
+    Expander e;
+    expander_init(&e, shell, mode & ~EXPAND_SPLIT);
+    StatusEnum st = expand_word(&e, word);
+    ERR_CHECK(st);
+    *result = field_text(&e);
+    return SUCCESS;
+} // expand_string
+
+
+/**
+ * @brief       Expands part of a here-document body
+ *
+ *              Text is expanded like inside double quotes except that double
+ *              quotes are ordinary characters and \" is kept as it is
+ *
+ * @param shell shell state
+ * @param text  raw body text, callers pass it in pieces ending at newlines
+ * @param length length of text
+ * @param result output text allocated from the command arena
+ * @param result_length output length of result
+ * @return      SUCCESS, ERROR_DEFAULT on bad substitution, ERROR_MALLOC_FAILURE
+ */
+StatusEnum expand_here_document(ShellStatePtr shell, const char* text, size_t length,
+                                char** result, size_t* result_length) {
+    Expander e;
+    expander_init(&e, shell, EXPAND_HEREDOC);
+    StatusEnum st = expand_text(&e, text, text + length, 1U);
+    ERR_CHECK(st);
+    *result = field_text(&e);
+    *result_length = e.length;
+    return SUCCESS;
+} // expand_here_document
@@ -0,0 +1,68 @@
+#ifndef EXPAND_H
+#define EXPAND_H
+
+#include <stdint.h>
+#include <pwd.h>
+#include "exec.h"
+#include "../parser/parser.h"
+
+// expansion modes
+#define EXPAND_SPLIT    0x01U   // unquoted results of expansions are split into fields on IFS
+#define EXPAND_PATTERN  0x02U   // quoted characters are escaped so fnmatch() takes them literally
+#define EXPAND_HEREDOC  0x04U   // double quotes are ordinary characters, as in here-document bodies
+#define EXPAND_GLOB     0x08U   // fields with unquoted * ? or [ are replaced by matching paths
+
+// IFS used when the variable is not set
+#define DEFAULT_IFS " \t\n"
+
+
+/**
+ * @brief       Expands words into NULL terminated vector of fields
+ *
+ *              Words without flags are used as they are, others go through
+ *              tilde, parameter and command substitution, field splitting,
+ *              pathname expansion (EXPAND_GLOB) and quote removal. Everything
+ *              is allocated from the command arena
+ *
+ * @param shell shell state
+ * @param words words of the syntax tree
+ * @param count number of words
+ * @param mode  EXPAND_SPLIT / EXPAND_PATTERN / EXPAND_GLOB
+ * @param fields output vector
+ * @param field_count output number of fields
+ * @return      SUCCESS, ERROR_DEFAULT on bad substitution (reported to stderr),
+ *              ERROR_MALLOC_FAILURE
+ */
+StatusEnum expand_words(ShellStatePtr shell, WordPtr words, uint32_t count, uint32_t mode,
+                        char*** fields, uint32_t* field_count);
+
+/**
+ * @brief       Expands word into a single string without field splitting
+ *
+ *              Used for assignments, redirection targets and case words
+ *
+ * @param shell shell state
+ * @param word  word of the syntax tree
+ * @param mode  0 or EXPAND_PATTERN
+ * @param result output string allocated from the command arena
+ * @return      SUCCESS, ERROR_DEFAULT on bad substitution, ERROR_MALLOC_FAILURE
+ */
+StatusEnum expand_string(ShellStatePtr shell, WordPtr word, uint32_t mode, char** result);
+
+/**
+ * @brief       Expands part of a here-document body
+ *
+ *              Text is expanded like inside double quotes except that double
+ *              quotes are ordinary characters and \" is kept as it is
+ *
+ * @param shell shell state
+ * @param text  raw body text, callers pass it in pieces ending at newlines
+ * @param length length of text
+ * @param result output text allocated from the command arena
+ * @param result_length output length of result
+ * @return      SUCCESS, ERROR_DEFAULT on bad substitution, ERROR_MALLOC_FAILURE
+ */
+StatusEnum expand_here_document(ShellStatePtr shell, const char* text, size_t length,
+                                char** result, size_t* result_length);
+
+#endif
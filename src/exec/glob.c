@@ -0,0 +1,770 @@
+/**
+ * Pathname expansion
+ *
+ * Every component of a pattern is compiled once into a matcher: a literal
+ * prefix and suffix reject most names with one memcmp() before the token
+ * walk runs. Components without pattern characters are never listed, they
+ * are only appended to the path. Directories are read with getdents64()
+ * into one buffer per directory, a listing is kept for all words of the
+ * command so two patterns in one directory read it once
+ */
+
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include "glob.h"
+
+// first capacity of the match vector and the path buffer
+#define GLOB_MIN_MATCHES 16U
+#define GLOB_MIN_PATH 256U
+
+
+// tokens of compiled pattern components
+typedef enum {
+    GLOB_TOKEN_LITERAL,     // text of length bytes
+    GLOB_TOKEN_ANY,         // ?
+    GLOB_TOKEN_CLASS,       // [...], set holds the accepted bytes
+    GLOB_TOKEN_STAR         // *, runs of stars are merged
+} GlobTokenEnum;
+
+
+//
+typedef struct glob_token {
+    uint32_t type;          // GlobTokenEnum
+    uint32_t length;        // bytes of literal text
+    const char* text;       // literal text without escapes
+    uint8_t set[32];        // bitmap of class bytes
+} GlobToken, *GlobTokenPtr;
+
+
+/*  One component of the pattern between slashes. Components without pattern
+    characters keep only their unescaped text in literal */
+typedef struct glob_component {
+    char* literal;              // NULL for components which have to be matched
+    GlobTokenPtr tokens;
+    uint32_t token_count;
+    uint32_t min_length;        // shortest name the tokens can match
+    uint32_t suffix;            // index of literal token after the last star, token_count if none
+    uint8_t dot;                // starts with a literal ., hidden names may match
+} GlobComponent, *GlobComponentPtr;
+
+
+//
+typedef struct glob_walk {
+    GlobCachePtr cache;
+    ArenaPtr arena;
+    GlobComponentPtr components;
+    uint32_t component_count;
+    uint8_t directory_only;     // pattern ends with /
+    char* path;                 // path of the directory being matched, malloc'd
+    size_t path_length;
+    size_t path_capacity;
+    char** matches;             // malloc'd vector of strings in arena
+    uint32_t match_count;
+    uint32_t match_capacity;
+} GlobWalk, *GlobWalkPtr;
+
+
+// record of getdents64(), glibc does not always declare it
+typedef struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+} LinuxDirent64;
+
+
+//
+typedef struct glob_class_name {
+    const char* name;
+    int (*test)(int);
+} GlobClassName;
+
+static const GlobClassName class_names[] = {
+    {"alnum", isalnum}, {"alpha", isalpha}, {"blank", isblank}, {"cntrl", iscntrl},
+    {"digit", isdigit}, {"graph", isgraph}, {"lower", islower}, {"print", isprint},
+    {"punct", ispunct}, {"space", isspace}, {"upper", isupper}, {"xdigit", isxdigit}
+};
+
+
+/**
+ * @brief       Reads directory entries, glibc may not have a wrapper for it
+ * @return      bytes read, 0 at the end, -1 with errno set
+ */
+static ssize_t read_entries(int fd, char* buffer, size_t size) {
+#ifdef SYS_getdents64
+    return (ssize_t) syscall(SYS_getdents64, fd, buffer, size);
+#else
+    (void) fd;
+    (void) buffer;
+    (void) size;
+    errno = ENOSYS;
+    return -1;
+#endif
+} // read_entries
+
+
+/**
+ * @brief       Initializes empty directory cache
+ */
+void glob_cache_init(GlobCachePtr cache) {
+    cache->listings = NULL;
+    cache->buffer = NULL;
+} // glob_cache_init
+
+
+/**
+ * @brief       Frees all cached listings
+ */
+void glob_cache_dispose(GlobCachePtr cache) {
+    DirListingPtr listing = cache->listings;
+    while(listing != NULL) {
+        DirListingPtr next = listing->next;
+        free(listing->path);
+        free(listing->names);
+        free(listing->offsets);
+        free(listing->types);
+        free(listing);
+        listing = next;
+    }
+    free(cache->buffer);
+    glob_cache_init(cache);
+} // glob_cache_dispose
+
+
+/**
+ * @brief       Appends entry to listing
+ */
+static StatusEnum listing_add(DirListingPtr listing, const char* name, size_t length, uint8_t type) {
+    if(listing->count == listing->capacity) {
+        uint32_t capacity = (listing->capacity == 0) ? GLOB_MIN_CAPACITY : listing->capacity * 2;
+        uint32_t* offsets = (uint32_t*) realloc(listing->offsets, sizeof(uint32_t) * capacity);
+        if(offsets == NULL) {
+            return ERROR_MALLOC_FAILURE;
+        }
+        listing->offsets = offsets;
+        uint8_t* types = (uint8_t*) realloc(listing->types, capacity);
+        if(types == NULL) {
+            return ERROR_MALLOC_FAILURE;
+        }
+        listing->types = types;
+        listing->capacity = capacity;
+    }
+    if(listing->names_length + length + 1 > listing->names_capacity) {
+        size_t capacity = (listing->names_capacity == 0) ? GLOB_MIN_CAPACITY * 16 : listing->names_capacity * 2;
+        while(capacity < listing->names_length + length + 1) {
+            capacity *= 2;
+        }
+        if(capacity > UINT32_MAX) {
+            return ERROR_MALLOC_FAILURE;
+        }
+        char* names = (char*) realloc(listing->names, capacity);
+        if(names == NULL) {
+            return ERROR_MALLOC_FAILURE;
+        }
+        listing->names = names;
+        listing->names_capacity = capacity;
+    }
+
+    listing->offsets[listing->count] = (uint32_t) listing->names_length;
+    listing->types[listing->count] = type;
+    listing->count++;
+    memcpy(listing->names + listing->names_length, name, length + 1);
+    listing->names_length += length + 1;
+    return SUCCESS;
+} // listing_add
+
+
+/**
+ * @brief       Tells whether name is . or ..
+ */
+static inline uint8_t is_dot_entry(const char* name) {
+    return (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) ? 1U : 0U;
+} // is_dot_entry
+
+
+/**
+ * @brief       Reads entries with readdir() where getdents64() is not available
+ */
+static StatusEnum listing_read_dir(DirListingPtr listing, int fd) {
+    DIR* dir = fdopendir(fd);
+    if(dir == NULL) {
+        close(fd);
+        return SUCCESS;
+    }
+    StatusEnum st = SUCCESS;
+    struct dirent* entry;
+    while(st == SUCCESS && (entry = readdir(dir)) != NULL) {
+        if(!is_dot_entry(entry->d_name)) {
+            st = listing_add(listing, entry->d_name, strlen(entry->d_name), entry->d_type);
+        }
+    }
+    closedir(dir);
+    return st;
+} // listing_read_dir
+
+
+/**
+ * @brief       Reads all entries of the directory of listing
+ *
+ *              Directories which cannot be read have no entries, as if
+ *              nothing matched in them
+ */
+static StatusEnum listing_read(GlobCachePtr cache, DirListingPtr listing) {
+    int fd = open(listing->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(fd == -1) {
+        return SUCCESS;
+    }
+    if(cache->buffer == NULL) {
+        cache->buffer = (char*) malloc(GLOB_READ_SIZE);
+        if(cache->buffer == NULL) {
+            close(fd);
+            return ERROR_MALLOC_FAILURE;
+        }
+    }
+
+    StatusEnum st = SUCCESS;
+    while(st == SUCCESS) {
+        ssize_t length = read_entries(fd, cache->buffer, GLOB_READ_SIZE);
+        if(length == -1 && errno == EINTR) {
+            continue;
+        }
+        if(length == -1 && errno == ENOSYS && listing->count == 0) {
+            return listing_read_dir(listing, fd);
+        }
+        if(length <= 0) {
+            break;
+        }
+        for(ssize_t offset = 0; offset < length && st == SUCCESS;) {
+            LinuxDirent64* entry = (LinuxDirent64*)(cache->buffer + offset);
+            offset += entry->d_reclen;
+            if(!is_dot_entry(entry->d_name)) {
+                st = listing_add(listing, entry->d_name, strlen(entry->d_name), entry->d_type);
+            }
+        }
+    }
+    close(fd);
+    return st;
+} // listing_read
+
+
+/**
+ * @brief       Finds listing of directory in the cache, reads it on first use
+ *
+ * @param cache directory cache
+ * @param path  directory, "" for the current one
+ * @param listing output listing
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+static StatusEnum cache_listing(GlobCachePtr cache, const char* path, DirListingPtr* listing) {
+    if(*path == '\0') {
+        path = ".";
+    }
+    for(DirListingPtr l = cache->listings; l != NULL; l = l->next) {
+        if(strcmp(l->path, path) == 0) {
+            *listing = l;
+            return SUCCESS;
+        }
+    }
+
+    DirListingPtr l = (DirListingPtr) calloc(1, sizeof(DirListing));
+    if(l == NULL) {
+        return ERROR_MALLOC_FAILURE;
+    }
+    l->path = strdup(path);
+    if(l->path == NULL) {
+        free(l);
+        return ERROR_MALLOC_FAILURE;
+    }
+    l->next = cache->listings;
+    cache->listings = l;
+    *listing = l;
+    return listing_read(cache, l);
+} // cache_listing
+
+
+/**
+ * @brief       Adds class [:name:] to set
+ * @return      0 for unknown class name
+ */
+static uint8_t class_add_named(uint8_t* set, const char* name, size_t length) {
+    for(size_t i = 0; i < sizeof(class_names) / sizeof(class_names[0]); i++) {
+        if(strlen(class_names[i].name) != length || memcmp(class_names[i].name, name, length) != 0) {
+            continue;
+        }
+        for(uint32_t c = 1; c < 256; c++) {
+            if(class_names[i].test((int) c)) {
+                set[c >> 3] |= (uint8_t)(1U << (c & 7));
+            }
+        }
+        return 1U;
+    }
+    return 0U;
+} // class_add_named
+
+
+/**
+ * @brief       Compiles bracket expression into byte set
+ *
+ * @param p     first character after [
+ * @param end   end of component
+ * @param set   output bitmap
+ * @return      pointer after the closing ], NULL if the bracket is not closed
+ *              and [ stands for itself
+ */
+static const char* compile_class(const char* p, const char* end, uint8_t* set) {
+    memset(set, 0, 32);
+    uint8_t negate = (p < end && (*p == '!' || *p == '^')) ? 1U : 0U;
+    p += negate;
+
+    const char* first = p;
+    while(p < end) {
+        if(*p == ']' && p > first) {
+            for(uint32_t i = 0; negate && i < 32; i++) {
+                set[i] = (uint8_t) ~set[i];
+            }
+            set[0] &= (uint8_t) ~1U;
+            return p + 1;
+        }
+        if(*p == '[' && p + 1 < end && p[1] == ':') {
+            const char* close = p + 2;
+            while(close + 1 < end && !(close[0] == ':' && close[1] == ']')) {
+                close++;
+            }
+            // unknown names match nothing
+            if(close + 1 < end) {
+                class_add_named(set, p + 2, (size_t)(close - (p + 2)));
+                p = close + 2;
+                continue;
+            }
+        }
+
+        if(*p == '\\' && p + 1 < end) {
+            p++;
+        }
+        uint32_t low = (uint8_t) *p++;
+        uint32_t high = low;
+        if(p + 1 < end && *p == '-' && p[1] != ']') {
+            p++;
+            if(*p == '\\' && p + 1 < end) {
+                p++;
+            }
+            high = (uint8_t) *p++;
+        }
+        for(uint32_t c = low; c <= high; c++) {
+            set[c >> 3] |= (uint8_t)(1U << (c & 7));
+        }
+    }
+    return NULL;
+} // compile_class
+
+
+/**
+ * @brief       Compiles one component of the pattern
+ *
+ * @param arena arena for tokens and texts
+ * @param text  component with escapes
+ * @param length length of text
+ * @param component output component
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+static StatusEnum compile_component(ArenaPtr arena, const char* text, size_t length, GlobComponentPtr component) {
+    memset(component, 0, sizeof(*component));
+    char* literal = (char*) arenaAlloc(arena, length + 1);
+    component->tokens = (GlobTokenPtr) arenaAlloc(arena, sizeof(GlobToken) * (length + 1));
+    if(literal == NULL || component->tokens == NULL) {
+        return ERROR_MALLOC_FAILURE;
+    }
+
+    // literal characters are unescaped into one buffer, consecutive ones make one token
+    size_t literal_length = 0;
+    GlobTokenPtr last = NULL;
+    const char* p = text;
+    const char* end = text + length;
+    while(p < end) {
+        GlobToken token;
+        token.type = GLOB_TOKEN_LITERAL;
+        if(*p == '*') {
+            token.type = GLOB_TOKEN_STAR;
+            while(p < end && *p == '*') {
+                p++;
+            }
+        }
+        else if(*p == '?') {
+            token.type = GLOB_TOKEN_ANY;
+            p++;
+        }
+        else if(*p == '[') {
+            const char* close = compile_class(p + 1, end, token.set);
+            if(close != NULL) {
+                token.type = GLOB_TOKEN_CLASS;
+                p = close;
+            }
+        }
+
+        if(token.type != GLOB_TOKEN_LITERAL) {
+            if(token.type == GLOB_TOKEN_STAR && last != NULL && last->type == GLOB_TOKEN_STAR) {
+                continue;
+            }
+            component->min_length += (token.type == GLOB_TOKEN_STAR) ? 0U : 1U;
+            last = &component->tokens[component->token_count++];
+            *last = token;
+            continue;
+        }
+
+        if(*p == '\\' && p + 1 < end) {
+            p++;
+        }
+        if(last == NULL || last->type != GLOB_TOKEN_LITERAL) {
+            last = &component->tokens[component->token_count++];
+            last->type = GLOB_TOKEN_LITERAL;
+            last->length = 0;
+            last->text = literal + literal_length;
+        }
+        literal[literal_length++] = *p++;
+        last->length++;
+        component->min_length++;
+    }
+    literal[literal_length] = '\0';
+
+    if(component->token_count == 0 ||
+       (component->token_count == 1 && component->tokens[0].type == GLOB_TOKEN_LITERAL)) {
+        component->literal = literal;
+        return SUCCESS;
+    }
+    component->dot = (component->tokens[0].type == GLOB_TOKEN_LITERAL && literal[0] == '.') ? 1U : 0U;
+    component->suffix = component->token_count;
+    if(last->type == GLOB_TOKEN_LITERAL && component->token_count > 1 &&
+       component->tokens[component->token_count - 2].type == GLOB_TOKEN_STAR) {
+        component->suffix = component->token_count - 1;
+    }
+    return SUCCESS;
+} // compile_component
+
+
+/**
+ * @brief       Matches name against compiled component
+ *
+ *              A star takes one more byte each time the tokens after it fail,
+ *              only the last star is retried since all other tokens have fixed length
+ *
+ * @return      1 on match, 0 otherwise
+ */
+static uint8_t component_matches(GlobComponentPtr component, const char* name, size_t length) {
+    if(length < component->min_length || (name[0] == '.' && !component->dot)) {
+        return 0U;
+    }
+    GlobTokenPtr tokens = component->tokens;
+    uint32_t count = component->token_count;
+    if(component->suffix < count) {
+        GlobTokenPtr suffix = &tokens[component->suffix];
+        if(memcmp(name + length - suffix->length, suffix->text, suffix->length) != 0) {
+            return 0U;
+        }
+    }
+
+    uint32_t t = 0;
+    size_t n = 0;
+    if(tokens[0].type == GLOB_TOKEN_LITERAL) {
+        if(memcmp(name, tokens[0].text, tokens[0].length) != 0) {
+            return 0U;
+        }
+        t = 1;
+        n = tokens[0].length;
+    }
+
+    uint32_t star = UINT32_MAX;
+    size_t star_n = 0;
+    while(t < count || n < length) {
+        if(t < count) {
+            GlobTokenPtr token = &tokens[t];
+            uint8_t c = (n < length) ? (uint8_t) name[n] : 0U;
+            switch(token->type) {
+                case GLOB_TOKEN_STAR:
+                    star = t++;
+                    star_n = n;
+                    continue;
+                case GLOB_TOKEN_LITERAL:
+                    if(length - n >= token->length && memcmp(name + n, token->text, token->length) == 0) {
+                        n += token->length;
+                        t++;
+                        continue;
+                    }
+                    break;
+                case GLOB_TOKEN_ANY:
+                    if(n < length) {
+                        n++;
+                        t++;
+                        continue;
+                    }
+                    break;
+                default:
+                    if(n < length && (token->set[c >> 3] & (1U << (c & 7)))) {
+                        n++;
+                        t++;
+                        continue;
+                    }
+                    break;
+            }
+        }
+        if(star == UINT32_MAX || star_n >= length) {
+            return 0U;
+        }
+        t = star + 1;
+        n = ++star_n;
+    }
+    return 1U;
+} // component_matches
+
+
+/**
+ * @brief       Appends /name to the walk path
+ * @return      previous length of the path to restore it
+ */
+static StatusEnum path_push(GlobWalkPtr w, const char* name, size_t length, size_t* saved) {
+    *saved = w->path_length;
+    if(w->path_length + length + 2 > w->path_capacity) {
+        size_t capacity = (w->path_capacity == 0) ? GLOB_MIN_PATH : w->path_capacity * 2;
+        while(capacity < w->path_length + length + 2) {
+            capacity *= 2;
+        }
+        char* path = (char*) realloc(w->path, capacity);
+        if(path == NULL) {
+            return ERROR_MALLOC_FAILURE;
+        }
+        w->path = path;
+        w->path_capacity = capacity;
+    }
+    if(w->path_length > 0 && w->path[w->path_length - 1] != '/') {
+        w->path[w->path_length++] = '/';
+    }
+    memcpy(w->path + w->path_length, name, length);
+    w->path_length += length;
+    w->path[w->path_length] = '\0';
+    return SUCCESS;
+} // path_push
+
+
+/**
+ * @brief       Restores path to length returned by path_push()
+ */
+static inline void path_pop(GlobWalkPtr w, size_t saved) {
+    w->path_length = saved;
+    w->path[saved] = '\0';
+} // path_pop
+
+
+/**
+ * @brief       Tells whether entry of given d_type is a directory, links are followed
+ */
+static uint8_t is_directory(const char* path, uint8_t type) {
+    if(type == DT_DIR) {
+        return 1U;
+    }
+    if(type != DT_LNK && type != DT_UNKNOWN) {
+        return 0U;
+    }
+    struct stat info;
+    return (stat(path, &info) == 0 && S_ISDIR(info.st_mode)) ? 1U : 0U;
+} // is_directory
+
+
+/**
+ * @brief       Copies current path into the match vector
+ */
+static StatusEnum add_match(GlobWalkPtr w) {
+    if(w->match_count == w->match_capacity) {
+        uint32_t capacity = (w->match_capacity == 0) ? GLOB_MIN_MATCHES : w->match_capacity * 2;
+        char** matches = (char**) realloc(w->matches, sizeof(char*) * capacity);
+        if(matches == NULL) {
+            return ERROR_MALLOC_FAILURE;
+        }
+        w->matches = matches;
+        w->match_capacity = capacity;
+    }
+    char* match = (char*) arenaAlloc(w->arena, w->path_length + 2);
+    if(match == NULL) {
+        return ERROR_MALLOC_FAILURE;
+    }
+    memcpy(match, w->path, w->path_length);
+    size_t length = w->path_length;
+    if(w->directory_only) {
+        match[length++] = '/';
+    }
+    match[length] = '\0';
+    w->matches[w->match_count++] = match;
+    return SUCCESS;
+} // add_match
+
+
+/**
+ * @brief       Matches components from index on below the current path
+ */
+static StatusEnum walk_component(GlobWalkPtr w, uint32_t index) {
+    GlobComponentPtr component = &w->components[index];
+    uint8_t last = (index + 1 == w->component_count) ? 1U : 0U;
+    size_t saved;
+    StatusEnum st;
+
+    // literal components are not listed, the path only has to exist
+    if(component->literal != NULL) {
+        st = path_push(w, component->literal, strlen(component->literal), &saved);
+        ERR_CHECK(st);
+        if(!last) {
+            st = walk_component(w, index + 1);
+        }
+        else {
+            struct stat info;
+            uint8_t exists = w->directory_only ? (stat(w->path, &info) == 0 && S_ISDIR(info.st_mode)) :
+                                                 (lstat(w->path, &info) == 0);
+            st = exists ? add_match(w) : SUCCESS;
+        }
+        path_pop(w, saved);
+        return st;
+    }
+
+    DirListingPtr listing;
+    st = cache_listing(w->cache, (w->path != NULL) ? w->path : "", &listing);
+    ERR_CHECK(st);
+    for(uint32_t i = 0; i < listing->count && st == SUCCESS; i++) {
+        const char* name = listing->names + listing->offsets[i];
+        size_t length = strlen(name);
+        if(!component_matches(component, name, length)) {
+            continue;
+        }
+        st = path_push(w, name, length, &saved);
+        ERR_CHECK(st);
+        if(last) {
+            st = (!w->directory_only || is_directory(w->path, listing->types[i])) ? add_match(w) : SUCCESS;
+        }
+        else if(is_directory(w->path, listing->types[i])) {
+            st = walk_component(w, index + 1);
+        }
+        path_pop(w, saved);
+    }
+    return st;
+} // walk_component
+
+
+/**
+ * @brief       Compares strings for qsort()
+ */
+static int compare_matches(const void* a, const void* b) {
+    return strcmp(*(char* const*) a, *(char* const*) b);
+} // compare_matches
+
+
+/**
+ * @brief       Expands pathname pattern into sorted list of matching paths
+ *
+ *              Pattern characters are * ? and [...], a backslash makes the next
+ *              character literal. Components without pattern characters are not
+ *              listed, they are only descended into (or checked when they are
+ *              the last one). Names starting with . match only an explicit .
+ *
+ * @param cache directory cache of the command
+ * @param arena arena for the compiled pattern and the matches
+ * @param pattern pattern with backslash escapes
+ * @param matches output vector of matches allocated from arena
+ * @param count output number of matches, 0 when nothing matched
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+StatusEnum glob_expand(GlobCachePtr cache, ArenaPtr arena, const char* pattern, char*** matches, uint32_t* count) {
+    GlobWalk w;
+    memset(&w, 0, sizeof(w));
+    w.cache = cache;
+    w.arena = arena;
+    *matches = NULL;
+    *count = 0;
+
+    // every component is at least one character and a slash
+    size_t length = strlen(pattern);
+    w.components = (GlobComponentPtr) arenaAlloc(arena, sizeof(GlobComponent) * (length / 2 + 1));
+    if(w.components == NULL) {
+        return ERROR_MALLOC_FAILURE;
+    }
+    StatusEnum st = SUCCESS;
+    const char* p = pattern;
+    while(*p != '\0' && st == SUCCESS) {
+        const char* start = p;
+        while(*p != '\0' && *p != '/') {
+            p += (*p == '\\' && p[1] != '\0') ? 2 : 1;
+        }
+        if(p > start) {
+            st = compile_component(arena, start, (size_t)(p - start), &w.components[w.component_count++]);
+        }
+        w.directory_only = (*p == '/') ? 1U : 0U;
+        p += (*p == '/') ? 1 : 0;
+    }
+    ERR_CHECK(st);
+
+    size_t saved;
+    if(*pattern == '/') {
+        st = path_push(&w, "/", 1, &saved);
+    }
+    if(st == SUCCESS && w.component_count > 0) {
+        st = walk_component(&w, 0);
+    }
+    free(w.path);
+
+    if(st == SUCCESS && w.match_count > 0) {
+        qsort(w.matches, w.match_count, sizeof(char*), compare_matches);
+        *matches = (char**) arenaAlloc(arena, sizeof(char*) * w.match_count);
+        if(*matches != NULL) {
+            memcpy(*matches, w.matches, sizeof(char*) * w.match_count);
+            *count = w.match_count;
+        }
+        st = (*matches != NULL) ? SUCCESS : ERROR_MALLOC_FAILURE;
+    }
+    free(w.matches);
+    return st;
+} // glob_expand
+
+
+/**
+ * @brief       Tells whether text has unescaped * ? or bracket expression
+ *
+ *              Lone [ and ] as in test commands are ordinary characters, such
+ *              fields skip the directory walk
+ */
+uint8_t glob_is_pattern(const char* text) {
+    for(const char* p = text; *p != '\0'; p++) {
+        if(*p == '\\' && p[1] != '\0') {
+            p++;
+        }
+        else if(*p == '*' || *p == '?') {
+            return 1U;
+        }
+        else if(*p == '[') {
+            uint8_t set[32];
+            const char* end = p + strcspn(p, "/");
+            if(compile_class(p + 1, end, set) != NULL) {
+                return 1U;
+            }
+        }
+    }
+    return 0U;
+} // glob_is_pattern
+
+
+/**
+ * @brief       Removes backslash escapes of pattern in place
+ */
+void glob_unescape(char* text) {
+    char* out = text;
+    for(const char* p = text; *p != '\0'; p++) {
+        if(*p == '\\' && p[1] != '\0') {
+            p++;
+        }
+        *out++ = *p;
+    }
+    *out = '\0';
+} // glob_unescape
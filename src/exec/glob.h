@@ -0,0 +1,76 @@
+#ifndef GLOB_H
+#define GLOB_H
+
+#include <stdint.h>
+#include "../utils/error.h"
+#include "../data_structures/arena.h"
+
+// bytes of directory entries read by one getdents64() call
+#define GLOB_READ_SIZE (256U * 1024U)
+// first capacity of entry vectors of a listing
+#define GLOB_MIN_CAPACITY 64U
+
+/*  Entries of one directory as read by getdents64(), names are stored one
+    after another in a single buffer. Listings are cached for the words of
+    one command, so two patterns in one directory read it only once */
+typedef struct dir_listing {
+    struct dir_listing* next;
+    char* path;                 // directory as it was opened
+    char* names;                // NUL terminated names, . and .. are left out
+    size_t names_length;
+    size_t names_capacity;
+    uint32_t* offsets;          // start of every name in names
+    uint8_t* types;             // d_type of every name, DT_UNKNOWN when not known
+    uint32_t count;
+    uint32_t capacity;
+} DirListing, *DirListingPtr;
+
+
+//
+typedef struct glob_cache {
+    DirListingPtr listings;
+    char* buffer;               // getdents64() buffer shared by all listings
+} GlobCache, *GlobCachePtr;
+
+
+/**
+ * @brief       Initializes empty directory cache
+ */
+void glob_cache_init(GlobCachePtr cache);
+
+/**
+ * @brief       Frees all cached listings
+ */
+void glob_cache_dispose(GlobCachePtr cache);
+
+/**
+ * @brief       Expands pathname pattern into sorted list of matching paths
+ *
+ *              Pattern characters are * ? and [...], a backslash makes the next
+ *              character literal. Components without pattern characters are not
+ *              listed, they are only descended into (or checked when they are
+ *              the last one). Names starting with . match only an explicit .
+ *
+ * @param cache directory cache of the command
+ * @param arena arena for the compiled pattern and the matches
+ * @param pattern pattern with backslash escapes
+ * @param matches output vector of matches allocated from arena
+ * @param count output number of matches, 0 when nothing matched
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+StatusEnum glob_expand(GlobCachePtr cache, ArenaPtr arena, const char* pattern, char*** matches, uint32_t* count);
+
+/**
+ * @brief       Tells whether text has unescaped * ? or bracket expression
+ *
+ *              Lone [ and ] as in test commands are ordinary characters, such
+ *              fields skip the directory walk
+ */
+uint8_t glob_is_pattern(const char* text);
+
+/**
+ * @brief       Removes backslash escapes of pattern in place
+ */
+void glob_unescape(char* text);
+
+#endif
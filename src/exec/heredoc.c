@@ -0,0 +1,262 @@
+/**
+ * Here-documents and here-strings without temporary files
+ *
+ * The text is written into a pipe before the command starts and the command
+ * reads the other end. Nobody reads the pipe while it is filled, so writes
+ * don't block: when the buffer is full it is enlarged once and after that
+ * the text already in the pipe is spliced into a memfd which takes the rest
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include "heredoc.h"
+#include "expand.h"
+
+// bytes copied at once when splice() is not available
+#define HEREDOC_COPY_SIZE 4096U
+
+
+//
+typedef struct here_sink {
+    int32_t fd;             // write end of the pipe, the memfd after spilling
+    int32_t read_fd;        // read end of the pipe, -1 after spilling
+    size_t pending;         // bytes in the pipe
+    uint8_t grown;          // pipe buffer was already enlarged
+} HereSink, *HereSinkPtr;
+
+
+/**
+ * @brief       Writes whole buffer to blocking descriptor, interrupts are retried
+ * @return      SUCCESS, ERROR_DEFAULT with errno set
+ */
+static StatusEnum write_all(int32_t fd, const char* data, size_t length) {
+    while(length > 0) {
+        ssize_t written = write(fd, data, length);
+        if(written < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            return ERROR_DEFAULT;
+        }
+        data += written;
+        length -= (size_t)written;
+    }
+    return SUCCESS;
+} // write_all
+
+
+/**
+ * @brief       Creates pipe with non blocking write end
+ */
+static StatusEnum sink_open(HereSinkPtr sink) {
+    int32_t fds[2];
+    StatusEnum st = open_pipe(fds);
+    ERR_CHECK(st);
+    fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    sink->fd = fds[1];
+    sink->read_fd = fds[0];
+    sink->pending = 0;
+    sink->grown = 0U;
+    return SUCCESS;
+} // sink_open
+
+
+/**
+ * @brief       Closes descriptors of unfinished sink
+ */
+static void sink_close(HereSinkPtr sink) {
+    close(sink->fd);
+    if(sink->read_fd != -1) {
+        close(sink->read_fd);
+    }
+} // sink_close
+
+
+/**
+ * @brief       Moves text from the pipe into a memfd which takes over writing
+ *
+ *              splice() moves pipe pages into the file without copying them
+ *              through the shell, read() and write() are used where it fails
+ *
+ * @return      SUCCESS, ERROR_DEFAULT with errno set
+ */
+static StatusEnum sink_spill(HereSinkPtr sink) {
+    int32_t memfd = memfd_create(HEREDOC_MEMFD_NAME, MFD_CLOEXEC);
+    if(memfd == -1) {
+        return ERROR_DEFAULT;
+    }
+
+    while(sink->pending > 0) {
+        ssize_t moved = splice(sink->read_fd, NULL, memfd, NULL, sink->pending, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if(moved < 0 && errno == EINTR) {
+            continue;
+        }
+        if(moved <= 0) {
+            char buffer[HEREDOC_COPY_SIZE];
+            moved = read(sink->read_fd, buffer, (sink->pending < sizeof(buffer)) ? sink->pending : sizeof(buffer));
+            if(moved <= 0 || write_all(memfd, buffer, (size_t)moved) != SUCCESS) {
+                int32_t saved_errno = errno;
+                close(memfd);
+                errno = saved_errno;
+                return ERROR_DEFAULT;
+            }
+        }
+        sink->pending -= (size_t)moved;
+    }
+
+    close(sink->fd);
+    close(sink->read_fd);
+    sink->fd = memfd;
+    sink->read_fd = -1;
+    return SUCCESS;
+} // sink_spill
+
+
+/**
+ * @brief       Appends text to the sink
+ * @return      SUCCESS, ERROR_DEFAULT with errno set
+ */
+static StatusEnum sink_write(HereSinkPtr sink, const char* data, size_t length) {
+    while(sink->read_fd != -1 && length > 0) {
+        ssize_t written = write(sink->fd, data, length);
+        if(written >= 0) {
+            data += written;
+            length -= (size_t)written;
+            sink->pending += (size_t)written;
+        }
+        else if(errno == EAGAIN && !sink->grown) {
+            // most bodies fit into the default buffer, only larger ones pay for a larger one
+            pipe_grow(sink->fd, SHELL_PIPE_SIZE);
+            sink->grown = 1U;
+        }
+        else if(errno == EAGAIN) {
+            StatusEnum st = sink_spill(sink);
+            ERR_CHECK(st);
+        }
+        else if(errno != EINTR) {
+            return ERROR_DEFAULT;
+        }
+    }
+    return write_all(sink->fd, data, length);
+} // sink_write
+
+
+/**
+ * @brief       Ends writing, returns descriptor the command reads from
+ * @return      SUCCESS, ERROR_DEFAULT with errno set
+ */
+static StatusEnum sink_finish(HereSinkPtr sink, int32_t* fd) {
+    if(sink->read_fd != -1) {
+        close(sink->fd);
+        *fd = sink->read_fd;
+        return SUCCESS;
+    }
+    if(lseek(sink->fd, 0, SEEK_SET) == -1) {
+        return ERROR_DEFAULT;
+    }
+    *fd = sink->fd;
+    return SUCCESS;
+} // sink_finish
+
+
+/**
+ * @brief       Finds end of the next piece of body to expand
+ *
+ *              Piece ends with a newline after at least HEREDOC_PIECE_SIZE bytes,
+ *              substitutions and escaped characters are never split
+ */
+static const char* piece_end(const char* p, const char* end) {
+    const char* start = p;
+    while(p < end) {
+        if(*p == '\n' && (size_t)(p - start) >= HEREDOC_PIECE_SIZE) {
+            return p + 1;
+        }
+        if(*p == '\\') {
+            p += 2;
+        }
+        else if(*p == '`' || (*p == '$' && p + 1 < end && (p[1] == '(' || p[1] == '{'))) {
+            p = lexer_skip_quoted(p, end);
+            p = (p == NULL) ? end : p;
+        }
+        else {
+            p++;
+        }
+    }
+    return end;
+} // piece_end
+
+
+/**
+ * @brief       Expands body piece by piece and writes the results
+ *
+ *              Each piece is released from the command arena once it's written
+ */
+static StatusEnum write_expanded_body(ShellStatePtr shell, HereSinkPtr sink, const char* p, const char* end) {
+    while(p < end) {
+        const char* next = piece_end(p, end);
+        next = (next > end) ? end : next;
+
+        ArenaMark mark = arenaMark(&shell->command_arena);
+        char* text;
+        size_t length;
+        StatusEnum st = expand_here_document(shell, p, (size_t)(next - p), &text, &length);
+        if(st == SUCCESS && sink_write(sink, text, length) != SUCCESS) {
+            print_errno(SHELL_NAME);
+            st = ERROR_DEFAULT;
+        }
+        arenaRelease(&shell->command_arena, mark);
+        ERR_CHECK(st);
+        p = next;
+    }
+    return SUCCESS;
+} // write_expanded_body
+
+
+/**
+ * @brief       Writes here-document or here-string into a new descriptor
+ *
+ *              Bodies which need expansion are expanded and written piece
+ *              by piece, the expanded body is never held in memory at once
+ *
+ * @param shell shell state
+ * @param redirection << <<- (body in target) or <<< (expanded word in target)
+ * @param fd    output descriptor to read the text from, closed on exec
+ * @return      SUCCESS, ERROR_DEFAULT when expansion or writing fails
+ *              (reported to stderr), ERROR_MALLOC_FAILURE
+ */
+StatusEnum heredoc_open(ShellStatePtr shell, RedirectionPtr redirection, int32_t* fd) {
+    HereSink sink;
+    StatusEnum st = sink_open(&sink);
+    ERR_CHECK(st);
+
+    const char* text = redirection->target;
+    if(redirection->type == TOKEN_TLESS) {
+        st = sink_write(&sink, text, strlen(text));
+        if(st == SUCCESS) {
+            st = sink_write(&sink, "\n", 1);
+        }
+    }
+    else if(!redirection->expand_body) {
+        st = sink_write(&sink, text, redirection->body_length);
+    }
+    else {
+        // reports its own errors
+        st = write_expanded_body(shell, &sink, text, text + redirection->body_length);
+        if(st != SUCCESS) {
+            sink_close(&sink);
+            return st;
+        }
+    }
+
+    if(st == SUCCESS) {
+        st = sink_finish(&sink, fd);
+        if(st == SUCCESS) {
+            return SUCCESS;
+        }
+    }
+    print_errno(SHELL_NAME);
+    sink_close(&sink);
+    return st;
+} // heredoc_open
@@ -0,0 +1,30 @@
+#ifndef HEREDOC_H
+#define HEREDOC_H
+
+#include <stdint.h>
+#include "exec.h"
+
+// name of memory files holding bodies larger than the pipe, seen in /proc/<pid>/fd
+#define HEREDOC_MEMFD_NAME SHELL_NAME "-heredoc"
+// expanded bodies are written in pieces of at least this size, split at newlines
+#define HEREDOC_PIECE_SIZE (16U * 1024U)
+
+/*  Here-documents and here-strings reach the command through a pipe which
+    the shell fills before the command starts, text that does not fit into
+    the pipe buffer continues in a memfd. No temporary files are created */
+
+/**
+ * @brief       Writes here-document or here-string into a new descriptor
+ *
+ *              Bodies which need expansion are expanded and written piece
+ *              by piece, the expanded body is never held in memory at once
+ *
+ * @param shell shell state
+ * @param redirection << <<- (body in target) or <<< (expanded word in target)
+ * @param fd    output descriptor to read the text from, closed on exec
+ * @return      SUCCESS, ERROR_DEFAULT when expansion or writing fails
+ *              (reported to stderr), ERROR_MALLOC_FAILURE
+ */
+StatusEnum heredoc_open(ShellStatePtr shell, RedirectionPtr redirection, int32_t* fd);
+
+#endif
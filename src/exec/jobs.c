@@ -0,0 +1,402 @@
+/**
+ * Job table of background commands
+ *
+ * A script starting hundreds of workers must not pay for all of them on
+ * every exit: each job's pidfd sits in one epoll set and its event points
+ * at the job, so an exit costs one epoll event and one waitpid() of that
+ * child. Nothing scans the table except listing it
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include "jobs.h"
+#include "exec.h"
+#include "../utils/file.h"
+#include "../utils/output.h"
+#include "../utils/strings.h"
+
+
+/**
+ * @brief       Opens pidfd of child, glibc may not have a wrapper for it
+ * @return      descriptor, -1 with errno set
+ */
+static int32_t pidfd_open_child(pid_t pid) {
+#ifdef SYS_pidfd_open
+    return (int32_t) syscall(SYS_pidfd_open, pid, 0);
+#else
+    (void) pid;
+    errno = ENOSYS;
+    return -1;
+#endif
+} // pidfd_open_child
+
+
+/**
+ * @brief       Initializes empty job table
+ */
+void jobs_init(JobTablePtr table) {
+    memset(table, 0, sizeof(*table));
+    table->epoll = -1;
+} // jobs_init
+
+
+/**
+ * @brief       Removes all jobs without waiting for them, used by disposal
+ *              and by forked children which have no jobs of their own
+ */
+void jobs_clear(JobTablePtr table) {
+    while(table->first != NULL) {
+        jobs_remove(table, table->first);
+    }
+    if(table->epoll != -1) {
+        close(table->epoll);
+    }
+    jobs_init(table);
+} // jobs_clear
+
+
+/**
+ * @brief       Turns jobs into jobs of the parent in a forked subshell
+ *
+ *              They are still listed by jobs but they are not children of
+ *              the subshell, so nothing waits for them
+ */
+void jobs_inherit(JobTablePtr table) {
+    for(JobPtr job = table->first; job != NULL; job = job->next) {
+        if(job->pidfd != -1) {
+            close(job->pidfd);
+            job->pidfd = -1;
+        }
+        job->inherited = (job->done) ? 0U : 1U;
+    }
+    if(table->epoll != -1) {
+        close(table->epoll);
+        table->epoll = -1;
+    }
+    table->running = 0;
+    table->unwatched = 0;
+} // jobs_inherit
+
+
+/**
+ * @brief       Takes pidfd of job out of the epoll set and closes it
+ *
+ *              Closing alone is not enough, a forked child may still hold a
+ *              copy of the descriptor and keep it registered
+ */
+static void job_unwatch(JobTablePtr table, JobPtr job) {
+    epoll_ctl(table->epoll, EPOLL_CTL_DEL, job->pidfd, NULL);
+    close(job->pidfd);
+    job->pidfd = -1;
+} // job_unwatch
+
+
+/**
+ * @brief       Stores status of reaped job
+ */
+static void job_finish(JobTablePtr table, JobPtr job, int32_t wait_status) {
+    job->done = 1U;
+    job->wait_status = wait_status;
+    job->completed_next = NULL;
+    job->completed_prev = table->completed_last;
+    if(table->completed_last != NULL) {
+        table->completed_last->completed_next = job;
+    }
+    else {
+        table->completed_first = job;
+    }
+    table->completed_last = job;
+    if(job->pidfd != -1) {
+        job_unwatch(table, job);
+    }
+    else {
+        table->unwatched--;
+    }
+    table->running--;
+    table->finished++;
+} // job_finish
+
+
+/**
+ * @brief       Reaps job if it has ended
+ * @return      1 when the job is done now, 0 if it still runs
+ */
+static uint8_t job_try_reap(JobTablePtr table, JobPtr job) {
+    int status = 0;
+    pid_t pid;
+    while((pid = waitpid(job->pid, &status, WNOHANG)) == -1 && errno == EINTR) {
+    }
+    if(pid == 0) {
+        return 0U;
+    }
+    // ECHILD, somebody else reaped it
+    job_finish(table, job, (pid == -1) ? 0 : status);
+    return 1U;
+} // job_try_reap
+
+
+/**
+ * @brief       Adds started background child as the current job
+ *
+ *              Jobs which ended in the meantime are reaped first so finished
+ *              children don't stay zombies while a script keeps starting more
+ *
+ * @param table job table
+ * @param pid   child process
+ * @param text  command as written, copied
+ * @param added output new job, may be NULL
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE (child is left running)
+ */
+StatusEnum jobs_add(JobTablePtr table, pid_t pid, const char* text, JobPtr* added) {
+    if(table->running > 0) {
+        jobs_reap(table, 0U);
+    }
+
+    JobPtr job = (JobPtr) malloc(sizeof(Job));
+    if(job == NULL) {
+        return ERROR_MALLOC_FAILURE;
+    }
+    job->text = strdup(text);
+    if(job->text == NULL) {
+        free(job);
+        return ERROR_MALLOC_FAILURE;
+    }
+    job->pid = pid;
+    job->id = (table->last != NULL) ? table->last->id + 1 : 1;
+    job->wait_status = 0;
+    job->done = 0U;
+    job->inherited = 0U;
+
+    if(table->epoll == -1) {
+        table->epoll = move_fd_above(epoll_create1(EPOLL_CLOEXEC), SHELL_FD_BASE);
+    }
+    job->pidfd = -1;
+    if(table->epoll != -1) {
+        job->pidfd = move_fd_above(pidfd_open_child(pid), SHELL_FD_BASE);
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.ptr = job;
+        if(job->pidfd != -1 && epoll_ctl(table->epoll, EPOLL_CTL_ADD, job->pidfd, &event) == -1) {
+            close(job->pidfd);
+            job->pidfd = -1;
+        }
+    }
+    if(job->pidfd == -1) {
+        table->unwatched++;
+    }
+    table->running++;
+
+    job->next = NULL;
+    job->prev = table->last;
+    if(table->last != NULL) {
+        table->last->next = job;
+    }
+    else {
+        table->first = job;
+    }
+    table->last = job;
+    if(added != NULL) {
+        *added = job;
+    }
+    return SUCCESS;
+} // jobs_add
+
+
+/**
+ * @brief       Reaps jobs which ended
+ *
+ * @param table job table
+ * @param block 1 waits until at least one job ends (there must be a running one)
+ * @return      number of reaped jobs
+ */
+uint32_t jobs_reap(JobTablePtr table, uint8_t block) {
+    uint32_t reaped = 0;
+
+    // without pidfds there is nothing to sleep on, such jobs are polled
+    if(table->unwatched > 0) {
+        for(JobPtr job = table->first; job != NULL; job = job->next) {
+            if(!job->done && !job->inherited && job->pidfd == -1) {
+                reaped += job_try_reap(table, job);
+            }
+        }
+    }
+
+    if(table->running > table->unwatched) {
+        struct epoll_event events[JOBS_EVENT_BATCH];
+        int timeout = (block && reaped == 0 && table->unwatched == 0) ? -1 : 0;
+        int count;
+        while((count = epoll_wait(table->epoll, events, JOBS_EVENT_BATCH, timeout)) == -1 && errno == EINTR) {
+        }
+        for(int i = 0; i < count; i++) {
+            reaped += job_try_reap(table, (JobPtr) events[i].data.ptr);
+        }
+    }
+
+    if(block && reaped == 0 && table->unwatched > 0) {
+        // all children of the shell not waited for are jobs
+        int status = 0;
+        pid_t pid;
+        while((pid = waitpid(-1, &status, 0)) == -1 && errno == EINTR) {
+        }
+        for(JobPtr job = table->first; job != NULL && pid > 0; job = job->next) {
+            if(job->pid == pid && !job->done && !job->inherited) {
+                job_finish(table, job, status);
+                reaped++;
+                break;
+            }
+        }
+    }
+    return reaped;
+} // jobs_reap
+
+
+/**
+ * @brief       Finds job by %id, %+, %%, %- or process id
+ * @return      job, NULL if there is no such job
+ */
+JobPtr jobs_find(JobTablePtr table, const char* spec) {
+    if(spec[0] == '%') {
+        if(spec[1] == '\0' || streq(spec + 1, "%") || streq(spec + 1, "+")) {
+            return table->last;
+        }
+        if(streq(spec + 1, "-")) {
+            return (table->last != NULL) ? table->last->prev : NULL;
+        }
+    }
+
+    const char* digits = (spec[0] == '%') ? spec + 1 : spec;
+    char* end = NULL;
+    long number = strtol(digits, &end, 10);
+    if(*digits == '\0' || *end != '\0' || number <= 0) {
+        return NULL;
+    }
+    for(JobPtr job = table->first; job != NULL; job = job->next) {
+        if((spec[0] == '%') ? (job->id == (uint32_t)number) : (job->pid == (pid_t)number)) {
+            return job;
+        }
+    }
+    return NULL;
+} // jobs_find
+
+
+/**
+ * @brief       Returns job which finished first of those not reported yet
+ * @return      job, NULL when no job has finished
+ */
+JobPtr jobs_first_finished(JobTablePtr table) {
+    return table->completed_first;
+} // jobs_first_finished
+
+
+/**
+ * @brief       Unlinks and frees job, a running job is left running
+ */
+void jobs_remove(JobTablePtr table, JobPtr job) {
+    if(job->prev != NULL) {
+        job->prev->next = job->next;
+    }
+    else {
+        table->first = job->next;
+    }
+    if(job->next != NULL) {
+        job->next->prev = job->prev;
+    }
+    else {
+        table->last = job->prev;
+    }
+
+    if(job->done) {
+        if(job->completed_prev != NULL) {
+            job->completed_prev->completed_next = job->completed_next;
+        }
+        else {
+            table->completed_first = job->completed_next;
+        }
+        if(job->completed_next != NULL) {
+            job->completed_next->completed_prev = job->completed_prev;
+        }
+        else {
+            table->completed_last = job->completed_prev;
+        }
+        table->finished--;
+    }
+    else if(!job->inherited) {
+        if(job->pidfd != -1) {
+            job_unwatch(table, job);
+        }
+        else {
+            table->unwatched--;
+        }
+        table->running--;
+    }
+    free(job->text);
+    free(job);
+} // jobs_remove
+
+
+/**
+ * @brief       Converts wait status of finished job to shell exit status
+ */
+int32_t job_exit_status(JobPtr job) {
+    if(WIFSIGNALED(job->wait_status)) {
+        return 128 + WTERMSIG(job->wait_status);
+    }
+    return WEXITSTATUS(job->wait_status);
+} // job_exit_status
+
+
+/**
+ * @brief       Prints job line as jobs does, "[id]+  Running  text &"
+ *
+ * @param table job table, tells which job is current and previous
+ * @param job   job to print
+ * @param with_pid 1 adds process id (jobs -l)
+ */
+void job_print(JobTablePtr table, JobPtr job, uint8_t with_pid) {
+    char state[32];
+    if(!job->done) {
+        strcpy(state, "Running");
+    }
+    else if(WIFSIGNALED(job->wait_status)) {
+        snprintf(state, sizeof(state), "%s", strsignal(WTERMSIG(job->wait_status)));
+    }
+    else if(WEXITSTATUS(job->wait_status) != 0) {
+        snprintf(state, sizeof(state), "Exit %d", WEXITSTATUS(job->wait_status));
+    }
+    else {
+        strcpy(state, "Done");
+    }
+
+    char mark = (job == table->last) ? '+' : (table->last != NULL && job == table->last->prev) ? '-' : ' ';
+    output_printf(STDOUT_FILENO, "[%u]%c ", job->id, mark);
+    if(with_pid) {
+        output_printf(STDOUT_FILENO, "%d ", (int)job->pid);
+    }
+    else {
+        output_char(STDOUT_FILENO, ' ');
+    }
+    output_printf(STDOUT_FILENO, "%-24s%s%s\n", state, job->text, job->done ? "" : " &");
+} // job_print
+
+
+/**
+ * @brief       Prints and forgets jobs which finished since the last report,
+ *              the interactive shell calls it before the prompt
+ */
+void jobs_notify(JobTablePtr table) {
+    if(table->running > 0) {
+        jobs_reap(table, 0U);
+    }
+    JobPtr job;
+    while((job = table->completed_first) != NULL) {
+        job_print(table, job, 0U);
+        jobs_remove(table, job);
+    }
+} // jobs_notify
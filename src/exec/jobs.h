@@ -0,0 +1,126 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include "../utils/error.h"
+
+// events taken from epoll at once while reaping
+#define JOBS_EVENT_BATCH 64
+
+/*  Background jobs of the shell. Every job has a pidfd registered in one
+    epoll instance, an exit wakes exactly the job that ended and only that
+    child is reaped. Finished jobs keep their status until wait or jobs
+    reports it, they are queued in order of completion so wait -n takes
+    the next one without looking at the others. Kernels without
+    pidfd_open() fall back to waitpid() */
+
+//
+typedef struct job {
+    struct job* next;
+    struct job* prev;
+    struct job* completed_next; // completion queue, valid once done
+    struct job* completed_prev;
+    pid_t pid;
+    int32_t pidfd;          // -1 after reaping or without pidfd support
+    uint32_t id;            // number used by %id
+    int32_t wait_status;    // status from waitpid() once done
+    uint8_t done;
+    uint8_t inherited;      // job of the parent shell, listed but not waited for
+    char* text;             // command as written, owned
+} Job, *JobPtr;
+
+
+// jobs in order of start, ids grow along the list
+typedef struct job_table {
+    JobPtr first;
+    JobPtr last;            // current job (%+), its predecessor is %-
+    uint32_t running;       // own jobs not reaped yet
+    uint32_t unwatched;     // running jobs without pidfd
+    uint32_t finished;      // reaped jobs not reported yet
+    JobPtr completed_first; // reaped jobs not reported yet, in order of completion
+    JobPtr completed_last;
+    int32_t epoll;          // -1 until the first job starts
+} JobTable, *JobTablePtr;
+
+
+/**
+ * @brief       Initializes empty job table
+ */
+void jobs_init(JobTablePtr table);
+
+/**
+ * @brief       Removes all jobs without waiting for them, used by disposal
+ *              and by forked children which have no jobs of their own
+ */
+void jobs_clear(JobTablePtr table);
+
+/**
+ * @brief       Turns jobs into jobs of the parent in a forked subshell
+ *
+ *              They are still listed by jobs but they are not children of
+ *              the subshell, so nothing waits for them
+ */
+void jobs_inherit(JobTablePtr table);
+
+/**
+ * @brief       Adds started background child as the current job
+ *
+ *              Jobs which ended in the meantime are reaped first so finished
+ *              children don't stay zombies while a script keeps starting more
+ *
+ * @param table job table
+ * @param pid   child process
+ * @param text  command as written, copied
+ * @param added output new job, may be NULL
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE (child is left running)
+ */
+StatusEnum jobs_add(JobTablePtr table, pid_t pid, const char* text, JobPtr* added);
+
+/**
+ * @brief       Reaps jobs which ended
+ *
+ * @param table job table
+ * @param block 1 waits until at least one job ends (there must be a running one)
+ * @return      number of reaped jobs
+ */
+uint32_t jobs_reap(JobTablePtr table, uint8_t block);
+
+/**
+ * @brief       Finds job by %id, %+, %%, %- or process id
+ * @return      job, NULL if there is no such job
+ */
+JobPtr jobs_find(JobTablePtr table, const char* spec);
+
+/**
+ * @brief       Returns job which finished first of those not reported yet
+ * @return      job, NULL when no job has finished
+ */
+JobPtr jobs_first_finished(JobTablePtr table);
+
+/**
+ * @brief       Unlinks and frees job, a running job is left running
+ */
+void jobs_remove(JobTablePtr table, JobPtr job);
+
+/**
+ * @brief       Converts wait status of finished job to shell exit status
+ */
+int32_t job_exit_status(JobPtr job);
+
+/**
+ * @brief       Prints job line as jobs does, "[id]+  Running  text &"
+ *
+ * @param table job table, tells which job is current and previous
+ * @param job   job to print
+ * @param with_pid 1 adds process id (jobs -l)
+ */
+void job_print(JobTablePtr table, JobPtr job, uint8_t with_pid);
+
+/**
+ * @brief       Prints and forgets jobs which finished since the last report,
+ *              the interactive shell calls it before the prompt
+ */
+void jobs_notify(JobTablePtr table);
+
+#endif
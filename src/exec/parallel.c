@@ -0,0 +1,372 @@
+/**
+ * Worker pool builtin
+ *
+ * Replaces `for f in ...; do cmd "$f" & done; wait` with a bounded number
+ * of children. Tasks are started by exec_start_command() and tracked in a
+ * job table of their own, so they are not listed by jobs and wait does not
+ * see them. A slot is refilled as soon as the reaper reports its exit
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include "parallel.h"
+#include "../utils/strings.h"
+
+// bytes copied at once when sendfile() can't write to standard output
+#define PARALLEL_COPY_SIZE 4096U
+// name of memory files collecting output of -k
+#define PARALLEL_MEMFD_NAME SHELL_NAME "-parallel"
+
+
+//
+typedef struct parallel_task {
+    int32_t output;         // memfd with standard output for -k, -1 otherwise
+    int32_t status;         // exit status once done
+    uint8_t done;
+} ParallelTask, *ParallelTaskPtr;
+
+
+// running task, job is NULL when the slot is free
+typedef struct parallel_slot {
+    JobPtr job;
+    uint32_t task;
+} ParallelSlot, *ParallelSlotPtr;
+
+
+//
+typedef struct parallel {
+    ShellStatePtr shell;
+    char** words;               // command and its arguments
+    uint32_t word_count;
+    uint8_t placeholder;        // some word contains {}
+    char** values;
+    uint32_t value_count;
+    ParallelTaskPtr tasks;
+    ParallelSlotPtr slots;
+    uint32_t slot_count;
+    uint32_t busy;              // slots holding a job, finished ones until they are collected
+    uint32_t finished;          // tasks which are done
+    uint32_t next_output;       // first task whose output was not printed yet
+    uint8_t keep_order;         // -k
+    JobTable pool;
+} Parallel, *ParallelPtr;
+
+
+/**
+ * @brief       Replaces every {} in word by value
+ * @return      new string from command arena, NULL on malloc failure
+ */
+static char* substitute(ArenaPtr arena, const char* word, const char* value) {
+    size_t value_length = strlen(value);
+    size_t length = 0;
+    for(const char* p = word; *p != '\0'; p++) {
+        length += (p[0] == '{' && p[1] == '}') ? value_length : 1;
+        p += (p[0] == '{' && p[1] == '}') ? 1 : 0;
+    }
+
+    char* result = (char*) arenaAlloc(arena, length + 1);
+    if(result == NULL) {
+        return NULL;
+    }
+    char* out = result;
+    for(const char* p = word; *p != '\0'; p++) {
+        if(p[0] == '{' && p[1] == '}') {
+            memcpy(out, value, value_length);
+            out += value_length;
+            p++;
+        }
+        else {
+            *out++ = *p;
+        }
+    }
+    *out = '\0';
+    return result;
+} // substitute
+
+
+/**
+ * @brief       Marks task as done
+ */
+static void task_finish(ParallelPtr p, uint32_t index, int32_t status) {
+    p->tasks[index].status = status;
+    p->tasks[index].done = 1U;
+    p->finished++;
+} // task_finish
+
+
+/**
+ * @brief       Starts task for value of index in a free slot
+ *
+ *              Task which can't be started is done at once with the status
+ *              set by exec_start_command()
+ *
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+static StatusEnum task_start(ParallelPtr p, uint32_t index) {
+    ShellStatePtr shell = p->shell;
+    ParallelTaskPtr task = &p->tasks[index];
+    const char* value = p->values[index];
+    task->output = -1;
+    task->done = 0U;
+
+    // argv and redirection are needed only until the child is started
+    ArenaMark mark = arenaMark(&shell->command_arena);
+    SimpleCommand command;
+    memset(&command, 0, sizeof(command));
+    command.argc = p->word_count + (p->placeholder ? 0U : 1U);
+    command.argv = (char**) arenaAlloc(&shell->command_arena, sizeof(char*) * (command.argc + 1));
+    if(command.argv == NULL) {
+        return ERROR_MALLOC_FAILURE;
+    }
+    for(uint32_t i = 0; i < p->word_count; i++) {
+        command.argv[i] = p->placeholder ? substitute(&shell->command_arena, p->words[i], value) : p->words[i];
+        if(command.argv[i] == NULL) {
+            arenaRelease(&shell->command_arena, mark);
+            return ERROR_MALLOC_FAILURE;
+        }
+    }
+    if(!p->placeholder) {
+        command.argv[p->word_count] = (char*) value;
+    }
+    command.argv[command.argc] = NULL;
+
+    // standard output goes to a memory file, >&fd of the usual redirection machinery
+    char target[16];
+    Redirection output;
+    if(p->keep_order) {
+        task->output = move_fd_above(memfd_create(PARALLEL_MEMFD_NAME, MFD_CLOEXEC), SHELL_FD_BASE);
+        if(task->output == -1) {
+            print_errno(SHELL_NAME);
+            arenaRelease(&shell->command_arena, mark);
+            task_finish(p, index, ERROR_DEFAULT);
+            return SUCCESS;
+        }
+        snprintf(target, sizeof(target), "%d", task->output);
+        memset(&output, 0, sizeof(output));
+        output.type = TOKEN_GREATAND;
+        output.io_number = STDOUT_FILENO;
+        output.target = target;
+        command.redirections = &output;
+    }
+
+    pid_t pid;
+    StatusEnum st = exec_start_command(shell, &command, NULL, 0, &pid);
+    arenaRelease(&shell->command_arena, mark);
+    ERR_CHECK(st);
+    if(pid == 0) {
+        task_finish(p, index, shell->last_status);
+        return SUCCESS;
+    }
+
+    ParallelSlotPtr slot = p->slots;
+    while(slot->job != NULL) {
+        slot++;
+    }
+    slot->task = index;
+    p->busy++;
+    return jobs_add(&p->pool, pid, value, &slot->job);
+} // task_start
+
+
+/**
+ * @brief       Takes exit statuses of reaped tasks and frees their slots
+ */
+static void collect_finished(ParallelPtr p) {
+    for(uint32_t i = 0; i < p->slot_count; i++) {
+        JobPtr job = p->slots[i].job;
+        if(job != NULL && job->done) {
+            task_finish(p, p->slots[i].task, job_exit_status(job));
+            jobs_remove(&p->pool, job);
+            p->slots[i].job = NULL;
+            p->busy--;
+        }
+    }
+} // collect_finished
+
+
+/**
+ * @brief       Copies collected output of task to standard output and closes it
+ */
+static void print_output(int32_t fd) {
+    output_flush();
+    struct stat info;
+    off_t offset = 0;
+    off_t size = (fstat(fd, &info) == 0) ? info.st_size : 0;
+    while(offset < size) {
+        ssize_t sent = sendfile(STDOUT_FILENO, fd, &offset, (size_t)(size - offset));
+        if(sent > 0) {
+            continue;
+        }
+        if(sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if(sent == 0) {
+            break;
+        }
+
+        // descriptor 1 which sendfile() can't write to
+        char buffer[PARALLEL_COPY_SIZE];
+        ssize_t length = pread(fd, buffer, sizeof(buffer), offset);
+        if(length <= 0) {
+            break;
+        }
+        output_write(STDOUT_FILENO, buffer, (size_t)length);
+        output_flush();
+        offset += length;
+    }
+    close(fd);
+} // print_output
+
+
+/**
+ * @brief       Prints outputs of finished tasks in the order of values
+ */
+static void print_outputs(ParallelPtr p) {
+    while(p->next_output < p->value_count && p->tasks[p->next_output].done) {
+        if(p->tasks[p->next_output].output != -1) {
+            print_output(p->tasks[p->next_output].output);
+        }
+        p->next_output++;
+    }
+} // print_outputs
+
+
+/**
+ * @brief       Tells whether another task may start
+ *
+ *              With -k the number of outputs kept for later is limited, a slow
+ *              task holds back new ones instead of filling the descriptor table
+ */
+static uint8_t can_start(ParallelPtr p, uint32_t started) {
+    if(started >= p->value_count || p->busy >= p->slot_count) {
+        return 0U;
+    }
+    return (!p->keep_order || started - p->next_output < PARALLEL_HELD_OUTPUTS + p->slot_count) ? 1U : 0U;
+} // can_start
+
+
+/**
+ * @brief       Reports wrong usage of parallel
+ * @return      2
+ */
+static int32_t parallel_usage(void) {
+    output_string(STDERR_FILENO, "parallel: usage: parallel [-j jobs] [-k] command [arg ...] ::: value ...\n");
+    return ERROR_SHELL_MISUSE;
+} // parallel_usage
+
+
+/**
+ * @brief       parallel [-j jobs] [-k] command [arg...] ::: value...
+ *
+ *              Runs command once for every value with at most jobs (number
+ *              of processors by default) of them at a time. {} in arguments
+ *              is replaced by the value, otherwise the value is appended.
+ *              -k collects standard output of each task and prints it whole
+ *              in the order of values
+ *
+ * @return      status of the first failed task in the order of values,
+ *              0 when all succeeded, 2 on usage error
+ */
+int32_t builtin_parallel(ShellStatePtr shell, uint32_t argc, char** argv) {
+    Parallel p;
+    memset(&p, 0, sizeof(p));
+    p.shell = shell;
+
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t i = 1;
+    for(; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; i++) {
+        if(streq(argv[i], "--")) {
+            i++;
+            break;
+        }
+        if(streq(argv[i], "-k")) {
+            p.keep_order = 1U;
+            continue;
+        }
+        if(argv[i][1] != 'j') {
+            print_error("parallel: %s: invalid option", argv[i]);
+            return parallel_usage();
+        }
+
+        // -j N or -jN
+        const char* number = (argv[i][2] != '\0') ? argv[i] + 2 : argv[++i];
+        if(number == NULL) {
+            return parallel_usage();
+        }
+        char* end = NULL;
+        jobs = strtol(number, &end, 10);
+        if(*number == '\0' || *end != '\0' || jobs <= 0 || jobs > INT32_MAX) {
+            print_error("parallel: %s: invalid number of jobs", number);
+            return ERROR_SHELL_MISUSE;
+        }
+    }
+
+    p.words = argv + i;
+    while(i < argc && !streq(argv[i], PARALLEL_SEPARATOR)) {
+        p.placeholder = (strstr(argv[i], "{}") != NULL) ? 1U : p.placeholder;
+        i++;
+    }
+    p.word_count = (uint32_t)(argv + i - p.words);
+    if(i == argc || p.word_count == 0) {
+        return parallel_usage();
+    }
+    p.values = argv + i + 1;
+    p.value_count = argc - i - 1;
+    if(p.value_count == 0) {
+        return SUCCESS;
+    }
+
+    p.slot_count = (jobs < 1) ? 1U : ((uint32_t)jobs < p.value_count) ? (uint32_t)jobs : p.value_count;
+    p.tasks = (ParallelTaskPtr) arenaAlloc(&shell->command_arena, sizeof(ParallelTask) * p.value_count);
+    p.slots = (ParallelSlotPtr) arenaAlloc(&shell->command_arena, sizeof(ParallelSlot) * p.slot_count);
+    if(p.tasks == NULL || p.slots == NULL) {
+        print_error("parallel: cannot allocate memory");
+        return ERROR_DEFAULT;
+    }
+    memset(p.tasks, 0, sizeof(ParallelTask) * p.value_count);
+    memset(p.slots, 0, sizeof(ParallelSlot) * p.slot_count);
+    jobs_init(&p.pool);
+
+    StatusEnum st = SUCCESS;
+    uint32_t started = 0;
+    while(1) {
+        while(st == SUCCESS && can_start(&p, started)) {
+            st = task_start(&p, started);
+            if(st != SUCCESS && !p.tasks[started].done) {
+                // nothing to wait for, the task counts as failed
+                task_finish(&p, started, ERROR_DEFAULT);
+            }
+            started++;
+        }
+        // starting a job reaps the ones which ended already
+        collect_finished(&p);
+        print_outputs(&p);
+        if(p.finished == started && (st != SUCCESS || started == p.value_count)) {
+            break;
+        }
+        if(p.pool.running > 0) {
+            jobs_reap(&p.pool, 1U);
+        }
+    }
+    jobs_clear(&p.pool);
+
+    int32_t status = SUCCESS;
+    for(uint32_t t = 0; t < started; t++) {
+        if(!p.tasks[t].done && p.tasks[t].output != -1) {
+            close(p.tasks[t].output);
+        }
+        if(status == SUCCESS && p.tasks[t].done) {
+            status = p.tasks[t].status;
+        }
+    }
+    if(st != SUCCESS) {
+        print_error("parallel: cannot allocate memory");
+        return ERROR_DEFAULT;
+    }
+    return status;
+} // builtin_parallel
@@ -0,0 +1,26 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stdint.h>
+#include "exec.h"
+
+// separator between the command and its argument values
+#define PARALLEL_SEPARATOR ":::"
+// with -k at most this many finished outputs wait for an earlier task
+#define PARALLEL_HELD_OUTPUTS 256U
+
+/**
+ * @brief       parallel [-j jobs] [-k] command [arg...] ::: value...
+ *
+ *              Runs command once for every value with at most jobs (number
+ *              of processors by default) of them at a time. {} in arguments
+ *              is replaced by the value, otherwise the value is appended.
+ *              -k collects output of each task and prints it whole in the
+ *              order of values
+ *
+ * @return      status of the first failed task in the order of values,
+ *              0 when all succeeded, 2 on usage error
+ */
+int32_t builtin_parallel(ShellStatePtr shell, uint32_t argc, char** argv);
+
+#endif
@@ -0,0 +1,977 @@
+/**
+ * Builtin versions of standard utilities
+ *
+ * basename, dirname, echo, printf, test and read are called from loops of
+ * most scripts, running them in the shell saves a fork and exec per call.
+ * Output goes to the output buffer of the shell which is flushed before
+ * anything else writes to descriptor 1 (redirection, spawn, fork)
+ */
+
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include "utilities.h"
+#include "variables.h"
+#include "expand.h"
+
+// longest conversion specification printf passes on to stdio
+#define PRINTF_SPEC_MAX 64U
+// first size of the line buffer of read
+#define READ_MIN_CAPACITY 128U
+
+
+/**
+ * @brief       true, :
+ * @return      0
+ */
+int32_t builtin_true(ShellStatePtr shell, uint32_t argc, char** argv) {
+    (void)shell;
+    (void)argc;
+    (void)argv;
+    return SUCCESS;
+} // builtin_true
+
+
+/**
+ * @brief       false
+ * @return      1
+ */
+int32_t builtin_false(ShellStatePtr shell, uint32_t argc, char** argv) {
+    (void)shell;
+    (void)argc;
+    (void)argv;
+    return ERROR_DEFAULT;
+} // builtin_false
+
+
+/**
+ * @brief       Decodes backslash escape
+ *
+ * @param p     text after the backslash
+ * @param octal_zero 1 when octal escapes start with 0 (\0nnn of echo and %b),
+ *              0 for \nnn of printf format
+ * @param out   receives one or two characters, unknown escapes keep the backslash
+ * @param produced output number of characters stored in out
+ * @param stop  set to 1 by \c, output has to end
+ * @return      number of characters used after the backslash
+ */
+static uint32_t decode_escape(const char* p, uint8_t octal_zero, char* out, uint32_t* produced, uint8_t* stop) {
+    *produced = 1;
+    switch(*p) {
+        case 'a':  *out = '\a'; return 1U;
+        case 'b':  *out = '\b'; return 1U;
+        case 'e':  *out = 0x1B; return 1U;
+        case 'f':  *out = '\f'; return 1U;
+        case 'n':  *out = '\n'; return 1U;
+        case 'r':  *out = '\r'; return 1U;
+        case 't':  *out = '\t'; return 1U;
+        case 'v':  *out = '\v'; return 1U;
+        case '\\': *out = '\\'; return 1U;
+        case 'c':
+            *produced = 0;
+            *stop = 1U;
+            return 1U;
+        default:
+            break;
+    }
+
+    if(*p == 'x' && isxdigit((unsigned char)p[1])) {
+        uint32_t used = 1;
+        int32_t c = 0;
+        while(used < 3 && isxdigit((unsigned char)p[used])) {
+            c = c * 16 + (isdigit((unsigned char)p[used]) ? p[used] - '0' : (tolower((unsigned char)p[used]) - 'a' + 10));
+            used++;
+        }
+        *out = (char)c;
+        return used;
+    }
+    if(*p >= '0' && *p <= '7' && (!octal_zero || *p == '0')) {
+        uint32_t used = (octal_zero) ? 1U : 0U;
+        uint32_t digits = 0;
+        int32_t c = 0;
+        while(digits < 3 && p[used] >= '0' && p[used] <= '7') {
+            c = c * 8 + (p[used] - '0');
+            used++;
+            digits++;
+        }
+        *out = (char)(c & 0xFF);
+        return used;
+    }
+
+    // unknown escape stays as it is
+    out[0] = '\\';
+    if(*p == '\0') {
+        return 0U;
+    }
+    out[1] = *p;
+    *produced = 2;
+    return 1U;
+} // decode_escape
+
+
+/**
+ * @brief       Decodes string with backslash escapes of echo -e and %b
+ *
+ * @param out   buffer of strlen(s) + 1 bytes, decoded text is never longer
+ * @param stop  set to 1 when \c ended the text
+ * @return      length of decoded text
+ */
+static size_t decode_escaped_string(const char* s, char* out, uint8_t* stop) {
+    size_t length = 0;
+    while(*s != '\0' && !*stop) {
+        if(*s == '\\') {
+            uint32_t produced;
+            s++;
+            s += decode_escape(s, 1U, out + length, &produced, stop);
+            length += produced;
+        }
+        else {
+            out[length++] = *s++;
+        }
+    }
+    out[length] = '\0';
+    return length;
+} // decode_escaped_string
+
+
+/**
+ * @brief       Prints string with backslash escapes of echo -e and %b
+ *
+ * @param arena scratch space for the decoded text
+ * @param spec  printf conversion for the text, NULL prints it as it is
+ * @return      1 when \c ended the output, 0 otherwise
+ */
+static uint8_t put_escaped_string(ArenaPtr arena, const char* s, const char* spec) {
+    ArenaMark mark = arenaMark(arena);
+    char* decoded = (char*) arenaAlloc(arena, strlen(s) + 1);
+    if(decoded == NULL) {
+        return 1U;
+    }
+
+    uint8_t stop = 0U;
+    size_t length = decode_escaped_string(s, decoded, &stop);
+    if(spec == NULL) {
+        output_write(STDOUT_FILENO, decoded, length);
+    }
+    else {
+        output_printf(STDOUT_FILENO, spec, decoded);
+    }
+    arenaRelease(arena, mark);
+    return stop;
+} // put_escaped_string
+
+
+/**
+ * @brief       echo [-neE] [arg...]
+ *
+ *              Prints arguments separated by spaces, -n omits the newline,
+ *              -e interprets backslash escapes, -E (default) does not
+ *
+ * @return      0
+ */
+int32_t builtin_echo(ShellStatePtr shell, uint32_t argc, char** argv) {
+    uint8_t newline = 1U;
+    uint8_t escapes = 0U;
+
+    // only words made of option letters are options
+    uint32_t i = 1;
+    for(; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; i++) {
+        if(strspn(argv[i] + 1, "neE") != strlen(argv[i] + 1)) {
+            break;
+        }
+        for(const char* option = argv[i] + 1; *option != '\0'; option++) {
+            if(*option == 'n') {
+                newline = 0U;
+            }
+            else {
+                escapes = (*option == 'e') ? 1U : 0U;
+            }
+        }
+    }
+
+    for(uint32_t first = i; i < argc; i++) {
+        if(i > first) {
+            output_char(STDOUT_FILENO, ' ');
+        }
+        if(!escapes) {
+            output_string(STDOUT_FILENO, argv[i]);
+        }
+        else if(put_escaped_string(&shell->command_arena, argv[i], NULL)) {
+            return SUCCESS;
+        }
+    }
+    if(newline) {
+        output_char(STDOUT_FILENO, '\n');
+    }
+    return SUCCESS;
+} // builtin_echo
+
+
+/**
+ * @brief       Converts printf argument to number, 'c or "c gives code of c
+ *
+ * @param status set to 1 when argument is not a valid number (reported)
+ * @return      value of the argument, 0 when missing
+ */
+static intmax_t printf_integer(const char* arg, int32_t* status) {
+    if(arg == NULL || *arg == '\0') {
+        return 0;
+    }
+    if(*arg == '\'' || *arg == '"') {
+        return (unsigned char)arg[1];
+    }
+
+    char* end;
+    errno = 0;
+    intmax_t value;
+    if(*arg == '-') {
+        value = strtoimax(arg, &end, 0);
+    }
+    else {
+        value = (intmax_t)strtoumax(arg, &end, 0);
+    }
+    if(end == arg || *end != '\0' || errno == ERANGE) {
+        print_error("printf: %s: %s", arg, (errno == ERANGE) ? "Result too large" : "invalid number");
+        *status = ERROR_DEFAULT;
+    }
+    return value;
+} // printf_integer
+
+
+/**
+ * @brief       Converts printf argument to floating point number
+ *
+ * @param status set to 1 when argument is not a valid number (reported)
+ */
+static double printf_double(const char* arg, int32_t* status) {
+    if(arg == NULL || *arg == '\0') {
+        return 0.0;
+    }
+    if(*arg == '\'' || *arg == '"') {
+        return (unsigned char)arg[1];
+    }
+
+    char* end;
+    double value = strtod(arg, &end);
+    if(end == arg || *end != '\0') {
+        print_error("printf: %s: invalid number", arg);
+        *status = ERROR_DEFAULT;
+    }
+    return value;
+} // printf_double
+
+
+/**
+ * @brief       Prints one conversion of printf format
+ *
+ * @param arena scratch space for %b
+ * @param format text after %, advanced past the conversion
+ * @param args  arguments, NULL when they ran out
+ * @param index next argument, advanced by the arguments used
+ * @param count number of arguments
+ * @param status set to 1 on invalid number or format
+ * @return      1 when \c of %b ended the output, 0 otherwise
+ */
+static uint8_t printf_conversion(ArenaPtr arena, const char** format, char** args, uint32_t* index,
+                                 uint32_t count, int32_t* status) {
+    char spec[PRINTF_SPEC_MAX];
+    size_t length = 0;
+    const char* p = *format;
+    spec[length++] = '%';
+
+    // flags, width and precision are copied, * takes a number argument
+    while(*p != '\0' && strchr("-+ #0123456789.*", *p) != NULL && length < PRINTF_SPEC_MAX - 16) {
+        if(*p == '*') {
+            char* arg = (*index < count) ? args[(*index)++] : NULL;
+            int written = snprintf(spec + length, PRINTF_SPEC_MAX - 16 - length, "%d",
+                                   (int)printf_integer(arg, status));
+            length += (written > 0) ? (size_t)written : 0;
+        }
+        else {
+            spec[length++] = *p;
+        }
+        p++;
+    }
+
+    char conversion = *p;
+    if(conversion == '\0' || strchr("diouxXeEfFgGaAcsb", conversion) == NULL) {
+        if(conversion == '\0') {
+            print_error("printf: %%%.*s: missing format character", (int)(p - *format), *format);
+        }
+        else {
+            print_error("printf: `%c': invalid format character", conversion);
+        }
+        *status = ERROR_DEFAULT;
+        *format = p;
+        return 1U;
+    }
+    p++;
+    *format = p;
+
+    char* arg = (*index < count) ? args[(*index)++] : NULL;
+    switch(conversion) {
+        case 'd':
+        case 'i':
+            memcpy(spec + length, "jd", 3);
+            output_printf(STDOUT_FILENO, spec, printf_integer(arg, status));
+            return 0U;
+
+        case 'o':
+        case 'u':
+        case 'x':
+        case 'X':
+            spec[length++] = 'j';
+            spec[length++] = conversion;
+            spec[length] = '\0';
+            output_printf(STDOUT_FILENO, spec, (uintmax_t)printf_integer(arg, status));
+            return 0U;
+
+        case 'c':
+            // empty argument prints nothing, not NUL
+            if(arg == NULL || *arg == '\0') {
+                return 0U;
+            }
+            memcpy(spec + length, "c", 2);
+            output_printf(STDOUT_FILENO, spec, arg[0]);
+            return 0U;
+
+        case 's':
+            // plain %s is not formatted, large values are written straight from the argument
+            if(length == 1) {
+                output_string(STDOUT_FILENO, (arg != NULL) ? arg : "");
+                return 0U;
+            }
+            memcpy(spec + length, "s", 2);
+            output_printf(STDOUT_FILENO, spec, (arg != NULL) ? arg : "");
+            return 0U;
+
+        case 'b':
+            // escapes first, then width and precision apply to the result
+            if(arg == NULL) {
+                return 0U;
+            }
+            memcpy(spec + length, "s", 2);
+            return put_escaped_string(arena, arg, (length == 1) ? NULL : spec);
+
+        default:
+            spec[length++] = conversion;
+            spec[length] = '\0';
+            output_printf(STDOUT_FILENO, spec, printf_double(arg, status));
+            return 0U;
+    }
+} // printf_conversion
+
+
+/**
+ * @brief       printf format [arg...]
+ *
+ *              Format is reused while arguments are left, conversions
+ *              %s %b %c %d %i %o %u %x %X %e %E %f %F %g %G %a %A with flags,
+ *              width and precision (* takes them from arguments)
+ *
+ * @return      0, 1 on invalid number or format, 2 on usage error
+ */
+int32_t builtin_printf(ShellStatePtr shell, uint32_t argc, char** argv) {
+    uint32_t first = 1;
+    if(first < argc && streq(argv[first], "--")) {
+        first++;
+    }
+    if(first >= argc) {
+        output_string(STDERR_FILENO, "printf: usage: printf format [arguments]\n");
+        return ERROR_SHELL_MISUSE;
+    }
+
+    const char* format = argv[first];
+    char** args = argv + first + 1;
+    uint32_t count = argc - first - 1;
+    uint32_t index = 0;
+    int32_t status = SUCCESS;
+
+    uint32_t used;
+    do {
+        used = index;
+        uint8_t stop = 0U;
+        for(const char* p = format; *p != '\0' && !stop;) {
+            if(*p == '\\') {
+                p++;
+                // quotes may be escaped in the format
+                if(*p == '"' || *p == '\'') {
+                    output_char(STDOUT_FILENO, *p++);
+                }
+                else {
+                    char decoded[2];
+                    uint32_t produced;
+                    p += decode_escape(p, 0U, decoded, &produced, &stop);
+                    output_write(STDOUT_FILENO, decoded, produced);
+                }
+            }
+            else if(*p == '%' && p[1] == '%') {
+                output_char(STDOUT_FILENO, '%');
+                p += 2;
+            }
+            else if(*p == '%') {
+                p++;
+                stop = printf_conversion(&shell->command_arena, &p, args, &index, count, &status);
+            }
+            else {
+                output_char(STDOUT_FILENO, *p++);
+            }
+        }
+        if(stop) {
+            break;
+        }
+    } while(index < count && index > used);
+
+    return status;
+} // builtin_printf
+
+
+// state of test expression evaluation
+typedef struct test_parser {
+    char** argv;
+    uint32_t position;
+    uint32_t end;
+    uint8_t error;
+} TestParser, *TestParserPtr;
+
+static uint8_t test_or(TestParserPtr t);
+
+
+/**
+ * @brief       Reports test error once, the result of the expression is 2
+ * @return      0 so callers can return it as false
+ */
+static uint8_t test_error(TestParserPtr t, const char* format, const char* arg) {
+    if(!t->error) {
+        char message[256];
+        snprintf(message, sizeof(message), format, arg);
+        print_error("%s: %s", t->argv[0], message);
+    }
+    t->error = 1U;
+    return 0U;
+} // test_error
+
+
+/**
+ * @brief       Tells whether word is binary comparison operator of test
+ */
+static uint8_t test_is_binary(const char* op) {
+    static const char* const operators[] = {
+        "=", "==", "!=", "<", ">", "-eq", "-ne", "-lt", "-le", "-gt", "-ge", "-nt", "-ot", "-ef"
+    };
+    for(uint32_t i = 0; i < sizeof(operators) / sizeof(operators[0]); i++) {
+        if(streq(op, operators[i])) {
+            return 1U;
+        }
+    }
+    return 0U;
+} // test_is_binary
+
+
+/**
+ * @brief       Tells whether word is unary primary of test (-f, -z, ...)
+ */
+static uint8_t test_is_unary(const char* op) {
+    return (op[0] == '-' && op[1] != '\0' && op[2] == '\0' && strchr("bcdefghLnprsStuwxzGO", op[1]) != NULL)
+           ? 1U : 0U;
+} // test_is_unary
+
+
+/**
+ * @brief       Parses integer operand of test, surrounding blanks are allowed
+ */
+static long long test_integer(TestParserPtr t, const char* arg) {
+    char* end;
+    errno = 0;
+    long long value = strtoll(arg, &end, 10);
+    while(*end == ' ' || *end == '\t') {
+        end++;
+    }
+    if(end == arg || *end != '\0' || errno == ERANGE) {
+        test_error(t, "%s: integer expression expected", arg);
+        return 0;
+    }
+    return value;
+} // test_integer
+
+
+/**
+ * @brief       Evaluates unary primary
+ */
+static uint8_t test_unary(TestParserPtr t, char op, const char* arg) {
+    struct stat info;
+    switch(op) {
+        case 'n':
+            return (*arg != '\0') ? 1U : 0U;
+        case 'z':
+            return (*arg == '\0') ? 1U : 0U;
+        case 't':
+            return isatty((int)test_integer(t, arg)) ? 1U : 0U;
+        case 'r':
+            return (access(arg, R_OK) == 0) ? 1U : 0U;
+        case 'w':
+            return (access(arg, W_OK) == 0) ? 1U : 0U;
+        case 'x':
+            return (access(arg, X_OK) == 0) ? 1U : 0U;
+        case 'h':
+        case 'L':
+            return (lstat(arg, &info) == 0 && S_ISLNK(info.st_mode)) ? 1U : 0U;
+        default:
+            break;
+    }
+
+    if(stat(arg, &info) != 0) {
+        return 0U;
+    }
+    switch(op) {
+        case 'b': return S_ISBLK(info.st_mode) ? 1U : 0U;
+        case 'c': return S_ISCHR(info.st_mode) ? 1U : 0U;
+        case 'd': return S_ISDIR(info.st_mode) ? 1U : 0U;
+        case 'f': return S_ISREG(info.st_mode) ? 1U : 0U;
+        case 'p': return S_ISFIFO(info.st_mode) ? 1U : 0U;
+        case 'S': return S_ISSOCK(info.st_mode) ? 1U : 0U;
+        case 'g': return (info.st_mode & S_ISGID) ? 1U : 0U;
+        case 'u': return (info.st_mode & S_ISUID) ? 1U : 0U;
+        case 's': return (info.st_size > 0) ? 1U : 0U;
+        case 'G': return (info.st_gid == getegid()) ? 1U : 0U;
+        case 'O': return (info.st_uid == geteuid()) ? 1U : 0U;
+        default:  return 1U; // -e
+    }
+} // test_unary
+
+
+/**
+ * @brief       Evaluates binary comparison
+ */
+static uint8_t test_binary(TestParserPtr t, const char* left, const char* op, const char* right) {
+    if(op[0] != '-') {
+        int compared = strcmp(left, right);
+        switch(op[0]) {
+            case '=': return (compared == 0) ? 1U : 0U;
+            case '!': return (compared != 0) ? 1U : 0U;
+            case '<': return (compared < 0) ? 1U : 0U;
+            default:  return (compared > 0) ? 1U : 0U;
+        }
+    }
+
+    // files
+    if(op[1] == 'n' && op[2] == 't') {
+        struct stat a, b;
+        if(stat(left, &a) != 0) {
+            return 0U;
+        }
+        if(stat(right, &b) != 0) {
+            return 1U;
+        }
+        return (a.st_mtim.tv_sec > b.st_mtim.tv_sec ||
+                (a.st_mtim.tv_sec == b.st_mtim.tv_sec && a.st_mtim.tv_nsec > b.st_mtim.tv_nsec)) ? 1U : 0U;
+    }
+    if(op[1] == 'o' && op[2] == 't') {
+        return test_binary(t, right, "-nt", left);
+    }
+    if(op[1] == 'e' && op[2] == 'f') {
+        struct stat a, b;
+        return (stat(left, &a) == 0 && stat(right, &b) == 0 && a.st_dev == b.st_dev && a.st_ino == b.st_ino)
+               ? 1U : 0U;
+    }
+
+    // integers
+    long long a = test_integer(t, left);
+    long long b = test_integer(t, right);
+    switch(op[1]) {
+        case 'e': return (a == b) ? 1U : 0U;
+        case 'n': return (a != b) ? 1U : 0U;
+        case 'l': return ((op[2] == 't') ? a < b : a <= b) ? 1U : 0U;
+        default:  return ((op[2] == 't') ? a > b : a >= b) ? 1U : 0U;
+    }
+} // test_binary
+
+
+/**
+ * @brief       primary: ( expression ) | unary-op word | word binary-op word | word
+ */
+static uint8_t test_primary(TestParserPtr t) {
+    if(t->position >= t->end) {
+        return test_error(t, "%sargument expected", "");
+    }
+    char** argv = t->argv;
+    uint32_t p = t->position;
+
+    // comparison wins, `[ -n = -n ]` compares two strings
+    if(p + 2 < t->end && test_is_binary(argv[p + 1])) {
+        t->position += 3;
+        return test_binary(t, argv[p], argv[p + 1], argv[p + 2]);
+    }
+    if(streq(argv[p], "(") && p + 1 < t->end) {
+        t->position++;
+        uint8_t result = test_or(t);
+        if(t->position >= t->end || !streq(argv[t->position], ")")) {
+            return test_error(t, "%s`)' expected", "");
+        }
+        t->position++;
+        return result;
+    }
+    if(test_is_unary(argv[p]) && p + 1 < t->end) {
+        t->position += 2;
+        return test_unary(t, argv[p][1], argv[p + 1]);
+    }
+    t->position++;
+    return (argv[p][0] != '\0') ? 1U : 0U;
+} // test_primary
+
+
+/**
+ * @brief       not: ! not | primary
+ */
+static uint8_t test_not(TestParserPtr t) {
+    if(t->position + 1 < t->end && streq(t->argv[t->position], "!")) {
+        t->position++;
+        return !test_not(t);
+    }
+    return test_primary(t);
+} // test_not
+
+
+/**
+ * @brief       and: not [-a not]...
+ */
+static uint8_t test_and(TestParserPtr t) {
+    uint8_t result = test_not(t);
+    while(t->position < t->end && streq(t->argv[t->position], "-a")) {
+        t->position++;
+        uint8_t right = test_not(t);
+        result = result && right;
+    }
+    return result;
+} // test_and
+
+
+/**
+ * @brief       or: and [-o and]...
+ */
+static uint8_t test_or(TestParserPtr t) {
+    uint8_t result = test_and(t);
+    while(t->position < t->end && streq(t->argv[t->position], "-o")) {
+        t->position++;
+        uint8_t right = test_and(t);
+        result = result || right;
+    }
+    return result;
+} // test_or
+
+
+/**
+ * @brief       test expression, [ expression ]
+ *
+ *              POSIX file, string and integer primaries combined with ! -a -o
+ *              and parentheses
+ *
+ * @return      0 true, 1 false, 2 on error
+ */
+int32_t builtin_test(ShellStatePtr shell, uint32_t argc, char** argv) {
+    (void)shell;
+    if(streq(argv[0], "[")) {
+        if(!streq(argv[argc - 1], "]")) {
+            print_error("[: missing `]'");
+            return ERROR_SHELL_MISUSE;
+        }
+        argc--;
+    }
+
+    TestParser t = {argv, 1, argc, 0U};
+    if(argc <= 1) {
+        return ERROR_DEFAULT;
+    }
+    uint8_t result = test_or(&t);
+    if(!t.error && t.position < t.end) {
+        test_error(&t, "%s: unexpected argument", argv[t.position]);
+    }
+    if(t.error) {
+        return ERROR_SHELL_MISUSE;
+    }
+    return result ? SUCCESS : ERROR_DEFAULT;
+} // builtin_test
+
+
+/**
+ * @brief       Length of path without trailing slashes, a lone slash is kept
+ */
+static size_t strip_slashes(const char* path, size_t length) {
+    while(length > 1 && path[length - 1] == '/') {
+        length--;
+    }
+    return length;
+} // strip_slashes
+
+
+/**
+ * @brief       basename string [suffix]
+ * @return      0, 1 on missing or extra operand
+ */
+int32_t builtin_basename(ShellStatePtr shell, uint32_t argc, char** argv) {
+    (void)shell;
+    uint32_t i = (argc > 1 && streq(argv[1], "--")) ? 2 : 1;
+    if(i >= argc) {
+        print_error("basename: missing operand");
+        return ERROR_DEFAULT;
+    }
+    if(argc > i + 2) {
+        print_error("basename: extra operand '%s'", argv[i + 2]);
+        return ERROR_DEFAULT;
+    }
+
+    const char* path = argv[i];
+    size_t end = strip_slashes(path, strlen(path));
+    size_t start = end;
+    while(start > 0 && path[start - 1] != '/') {
+        start--;
+    }
+    // "/" stays, "//" gives "/"
+    if(end - start == 0 && end > 0) {
+        start = end - 1;
+    }
+
+    size_t length = end - start;
+    if(i + 1 < argc && !(length == 1 && path[start] == '/')) {
+        size_t suffix = strlen(argv[i + 1]);
+        if(suffix < length && memcmp(path + end - suffix, argv[i + 1], suffix) == 0) {
+            length -= suffix;
+        }
+    }
+    output_write(STDOUT_FILENO, path + start, length);
+    output_char(STDOUT_FILENO, '\n');
+    return SUCCESS;
+} // builtin_basename
+
+
+/**
+ * @brief       dirname string
+ * @return      0, 1 on missing operand
+ */
+int32_t builtin_dirname(ShellStatePtr shell, uint32_t argc, char** argv) {
+    (void)shell;
+    uint32_t i = (argc > 1 && streq(argv[1], "--")) ? 2 : 1;
+    if(i >= argc) {
+        print_error("dirname: missing operand");
+        return ERROR_DEFAULT;
+    }
+
+    const char* path = argv[i];
+    size_t length = strip_slashes(path, strlen(path));
+    while(length > 0 && path[length - 1] != '/') {
+        length--;
+    }
+    if(length == 0) {
+        output_string(STDOUT_FILENO, ".\n");
+        return SUCCESS;
+    }
+    length = strip_slashes(path, length);
+    output_write(STDOUT_FILENO, path, length);
+    output_char(STDOUT_FILENO, '\n');
+    return SUCCESS;
+} // builtin_dirname
+
+
+/**
+ * @brief       Reads one line of stdin, nothing after the newline is taken
+ *              from a shared descriptor
+ *
+ *              Backslashes are removed in place as each physical line comes
+ *              in, an escaped newline makes the next one part of the line.
+ *              NUL bytes can't be stored in a variable and are dropped
+ *
+ * @param raw   1 keeps backslashes as they are
+ * @param line  output malloc'd line without the newline
+ * @param escaped output malloc'd flags, 1 for characters escaped by backslash
+ * @param length output length of the line
+ * @return      SUCCESS, ERROR_DEFAULT on end of file, ERROR_MALLOC_FAILURE
+ */
+static StatusEnum read_input_line(uint8_t raw, char** line, uint8_t** escaped, size_t* length) {
+    size_t capacity = READ_MIN_CAPACITY;
+    *line = (char*) malloc(capacity);
+    *escaped = NULL;
+    *length = 0;
+    if(*line == NULL) {
+        return ERROR_MALLOC_FAILURE;
+    }
+
+    size_t escaped_capacity = 0;
+    for(;;) {
+        size_t start = *length;
+        StatusEnum st = file_read_line(STDIN_FILENO, line, length, &capacity);
+        if(st == ERROR_MALLOC_FAILURE) {
+            return st;
+        }
+        if(escaped_capacity < capacity) {
+            uint8_t* grown = (uint8_t*) realloc(*escaped, capacity);
+            if(grown == NULL) {
+                return ERROR_MALLOC_FAILURE;
+            }
+            *escaped = grown;
+            escaped_capacity = capacity;
+        }
+
+        char* text = *line;
+        size_t end = *length;
+        uint8_t joined = 0U;
+        if(raw) {
+            size_t out = start;
+            for(size_t in = start; in < *length && text[in] != '\n'; in++) {
+                if(text[in] != '\0') {
+                    (*escaped)[out] = 0U;
+                    text[out++] = text[in];
+                }
+            }
+            end = out;
+        }
+        else {
+            // unescaping only shrinks, the line is rewritten in place
+            size_t out = start;
+            for(size_t in = start; in < *length; in++) {
+                char c = text[in];
+                uint8_t was_escaped = 0U;
+                if(c == '\\') {
+                    // a backslash cut by end of file is dropped
+                    if(++in == *length) {
+                        break;
+                    }
+                    c = text[in];
+                    if(c == '\n') {
+                        joined = 1U;
+                        break;
+                    }
+                    was_escaped = 1U;
+                }
+                else if(c == '\n') {
+                    break;
+                }
+                if(c == '\0') {
+                    continue;
+                }
+                (*escaped)[out] = was_escaped;
+                text[out++] = c;
+            }
+            end = out;
+        }
+        *length = end;
+        text[end] = '\0';
+
+        if(st != SUCCESS) {
+            return ERROR_DEFAULT;
+        }
+        if(!joined) {
+            return SUCCESS;
+        }
+    }
+} // read_input_line
+
+
+/**
+ * @brief       read [-r] [name...]
+ *
+ *              Reads one line from stdin and splits it on IFS into the
+ *              variables, the last one gets the rest of the line. Without
+ *              names the whole line goes to REPLY. Backslash escapes the
+ *              next character and joins lines unless -r is given
+ *
+ * @return      0, 1 on end of file, 2 on usage error
+ */
+int32_t builtin_read(ShellStatePtr shell, uint32_t argc, char** argv) {
+    uint8_t raw = 0U;
+    uint32_t i = 1;
+    for(; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; i++) {
+        if(streq(argv[i], "--")) {
+            i++;
+            break;
+        }
+        if(!streq(argv[i], "-r")) {
+            print_error("read: %s: invalid option", argv[i]);
+            output_string(STDERR_FILENO, "read: usage: read [-r] [name ...]\n");
+            return ERROR_SHELL_MISUSE;
+        }
+        raw = 1U;
+    }
+    for(uint32_t j = i; j < argc; j++) {
+        if(!is_name(argv[j])) {
+            print_error("read: `%s': not a valid identifier", argv[j]);
+            return ERROR_DEFAULT;
+        }
+    }
+
+    // anything printed so far appears before the shell waits for input
+    output_flush();
+
+    char* line;
+    uint8_t* escaped;
+    size_t length;
+    StatusEnum st = read_input_line(raw, &line, &escaped, &length);
+    int32_t status = (st == SUCCESS) ? SUCCESS : ERROR_DEFAULT;
+    if(st == ERROR_MALLOC_FAILURE) {
+        print_error("read: cannot allocate memory");
+        free(line);
+        free(escaped);
+        return ERROR_DEFAULT;
+    }
+
+    // a line cut by end of file is still assigned
+    st = SUCCESS;
+    if(i >= argc) {
+        st = shell_set_variable(shell, "REPLY", line);
+    }
+    else {
+        char* ifs;
+        if(shell_get_variable(shell, "IFS", &ifs) != SUCCESS) {
+            ifs = DEFAULT_IFS;
+        }
+
+        size_t p = 0;
+        while(p < length && !escaped[p] && strchr(" \t\n", line[p]) != NULL && strchr(ifs, line[p]) != NULL) {
+            p++;
+        }
+        for(; i < argc && st == SUCCESS; i++) {
+            size_t start = p;
+            size_t end;
+            if(i + 1 == argc) {
+                // the last variable takes the rest without trailing IFS white space
+                end = length;
+                while(end > start && !escaped[end - 1] && strchr(" \t\n", line[end - 1]) != NULL &&
+                      strchr(ifs, line[end - 1]) != NULL) {
+                    end--;
+                }
+                p = length;
+            }
+            else {
+                while(p < length && (escaped[p] || strchr(ifs, line[p]) == NULL)) {
+                    p++;
+                }
+                end = p;
+                // white space around one delimiter belongs to it
+                uint8_t delimiter = 0U;
+                while(p < length && !escaped[p] && strchr(ifs, line[p]) != NULL) {
+                    uint8_t white = (strchr(" \t\n", line[p]) != NULL) ? 1U : 0U;
+                    if(!white) {
+                        if(delimiter) {
+                            break;
+                        }
+                        delimiter = 1U;
+                    }
+                    p++;
+                }
+            }
+
+            char saved = line[end];
+            line[end] = '\0';
+            st = shell_set_variable(shell, argv[i], line + start);
+            line[end] = saved;
+        }
+    }
+
+    free(line);
+    free(escaped);
+    if(st != SUCCESS) {
+        print_error("read: cannot allocate memory");
+        return ERROR_DEFAULT;
+    }
+    return status;
+} // builtin_read
@@ -0,0 +1,78 @@
+#ifndef UTILITIES_H
+#define UTILITIES_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "exec.h"
+
+/*  Builtin versions of standard utilities which scripts call in loops,
+    they run in the shell process and write to the shared output buffer */
+
+/**
+ * @brief       true, :
+ * @return      0
+ */
+int32_t builtin_true(ShellStatePtr shell, uint32_t argc, char** argv);
+
+/**
+ * @brief       false
+ * @return      1
+ */
+int32_t builtin_false(ShellStatePtr shell, uint32_t argc, char** argv);
+
+/**
+ * @brief       echo [-neE] [arg...]
+ *
+ *              Prints arguments separated by spaces, -n omits the newline,
+ *              -e interprets backslash escapes, -E (default) does not
+ *
+ * @return      0
+ */
+int32_t builtin_echo(ShellStatePtr shell, uint32_t argc, char** argv);
+
+/**
+ * @brief       printf format [arg...]
+ *
+ *              Format is reused while arguments are left, conversions
+ *              %s %b %c %d %i %o %u %x %X %e %E %f %F %g %G %a %A with flags,
+ *              width and precision (* takes them from arguments)
+ *
+ * @return      0, 1 on invalid number or format, 2 on usage error
+ */
+int32_t builtin_printf(ShellStatePtr shell, uint32_t argc, char** argv);
+
+/**
+ * @brief       test expression, [ expression ]
+ *
+ *              POSIX file, string and integer primaries combined with ! -a -o
+ *              and parentheses
+ *
+ * @return      0 true, 1 false, 2 on error
+ */
+int32_t builtin_test(ShellStatePtr shell, uint32_t argc, char** argv);
+
+/**
+ * @brief       basename string [suffix]
+ * @return      0, 1 on missing operand
+ */
+int32_t builtin_basename(ShellStatePtr shell, uint32_t argc, char** argv);
+
+/**
+ * @brief       dirname string
+ * @return      0, 1 on missing operand
+ */
+int32_t builtin_dirname(ShellStatePtr shell, uint32_t argc, char** argv);
+
+/**
+ * @brief       read [-r] [name...]
+ *
+ *              Reads one line from stdin and splits it on IFS into the
+ *              variables, the last one gets the rest of the line. Without
+ *              names the whole line goes to REPLY. Backslash escapes the
+ *              next character and joins lines unless -r is given
+ *
+ * @return      0, 1 on end of file, 2 on usage error
+ */
+int32_t builtin_read(ShellStatePtr shell, uint32_t argc, char** argv);
+
+#endif
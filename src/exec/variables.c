@@ -0,0 +1,442 @@
+/**
+ * Scope chain of shell variables
+ *
+ * Global variables live in the env table, every function call gets an
+ * overlay table for its `local` variables which is dropped on return,
+ * nothing is ever copied from the parent
+ */
+
+#include "variables.h"
+
+
+/**
+ * @brief       Returns nearest scope which has its own table
+ */
+static inline VariableScopePtr scope_first_with_locals(VariableScopePtr scope) {
+    if(scope != NULL && !scope->has_locals) {
+        return scope->parent_with_locals;
+    }
+    return scope;
+} // scope_first_with_locals
+
+
+/**
+ * @brief       Finds nearest scope table which defines key
+ * @return      scope, NULL when key is not local anywhere
+ */
+static VariableScopePtr scope_find(ShellStatePtr shell, const char* key) {
+    for(VariableScopePtr scope = scope_first_with_locals(shell->scope); scope != NULL;
+        scope = scope->parent_with_locals) {
+        if(hashTableFindItem(&scope->variables, key) != NULL) {
+            return scope;
+        }
+    }
+    return NULL;
+} // scope_find
+
+
+/**
+ * @brief       Pushes new empty scope on top of the chain
+ *
+ * @param shell shell state
+ * @param function_scope 1 for function calls, 0 for temporary NAME=value scopes
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+StatusEnum scope_push(ShellStatePtr shell, uint8_t function_scope) {
+    VariableScopePtr scope = shell->free_scopes;
+    if(scope != NULL) {
+        shell->free_scopes = scope->parent;
+    }
+    else {
+        scope = (VariableScopePtr) malloc(sizeof(VariableScope));
+        if(scope == NULL) {
+            return ERROR_MALLOC_FAILURE;
+        }
+    }
+
+    VariableScopePtr parent = shell->scope;
+    scope->parent = parent;
+    scope->parent_with_locals = scope_first_with_locals(parent);
+    scope->has_locals = 0U;
+    scope->function_scope = function_scope;
+    shell->scope = scope;
+    return SUCCESS;
+} // scope_push
+
+
+/**
+ * @brief       Drops top scope with all its variables in O(number of locals)
+ */
+void scope_pop(ShellStatePtr shell) {
+    VariableScopePtr scope = shell->scope;
+    if(scope == NULL) {
+        return;
+    }
+
+    if(scope->has_locals) {
+        // outer PATH becomes visible again
+        if(hashTableFindItem(&scope->variables, "PATH") != NULL) {
+            path_cache_clear(shell);
+        }
+        hashTableDtor(&scope->variables);
+    }
+
+    // frame is kept for the next call
+    shell->scope = scope->parent;
+    scope->parent = shell->free_scopes;
+    shell->free_scopes = scope;
+} // scope_pop
+
+
+/**
+ * @brief       Frees all scopes including the pool of reusable ones
+ */
+void scope_dispose(ShellStatePtr shell) {
+    while(shell->scope != NULL) {
+        scope_pop(shell);
+    }
+    while(shell->free_scopes != NULL) {
+        VariableScopePtr next = shell->free_scopes->parent;
+        free(shell->free_scopes);
+        shell->free_scopes = next;
+    }
+} // scope_dispose
+
+
+/**
+ * @brief       Creates or sets variable in the top scope (local)
+ *
+ * @param shell shell state, a scope must be pushed
+ * @param key   variable name
+ * @param value value of variable
+ * @return      SUCCESS, ERROR_DEFAULT without scope, ERROR_MALLOC_FAILURE
+ */
+StatusEnum scope_set_local(ShellStatePtr shell, const char* key, const char* value) {
+    VariableScopePtr scope = shell->scope;
+    if(scope == NULL) {
+        return ERROR_DEFAULT;
+    }
+
+    if(!scope->has_locals) {
+        StatusEnum st = hashTableCtor(&scope->variables);
+        ERR_CHECK(st);
+        scope->has_locals = 1U;
+    }
+
+    StatusEnum st = hashTableInsert(&scope->variables, key, value);
+    ERR_CHECK(st);
+    hashTableFindItem(&scope->variables, key)->flags &= ~SCOPE_ITEM_UNSET;
+    if(streq(key, "PATH")) {
+        return path_cache_clear(shell);
+    }
+    return SUCCESS;
+} // scope_set_local
+
+
+/**
+ * @brief       Looks variable up through the scope chain and then env table
+ *
+ * @param shell shell state
+ * @param key   variable name
+ * @param value output pointer to stored value (not a copy)
+ * @return      SUCCESS, ERROR_DEFAULT when variable is not set
+ */
+StatusEnum shell_get_variable(ShellStatePtr shell, const char* key, char** value) {
+    for(VariableScopePtr scope = scope_first_with_locals(shell->scope); scope != NULL;
+        scope = scope->parent_with_locals) {
+        HashTableItemPtr item = hashTableFindItem(&scope->variables, key);
+        if(item != NULL) {
+            if(item->flags & SCOPE_ITEM_UNSET) {
+                return ERROR_DEFAULT;
+            }
+            return (hashTableItemValue(item, value) == SUCCESS) ? SUCCESS : ERROR_DEFAULT;
+        }
+    }
+    return (hashTableGetValue(&shell->env_table, key, value) == SUCCESS) ? SUCCESS : ERROR_DEFAULT;
+} // shell_get_variable
+
+
+/**
+ * @brief       Sets variable where it is visible from, nearest local or global
+ *
+ *              Assigning PATH forgets remembered command locations
+ *
+ * @param shell shell state
+ * @param key   variable name
+ * @param value new value
+ * @return      SUCCESS or status of the underlying table
+ */
+StatusEnum shell_set_variable(ShellStatePtr shell, const char* key, const char* value) {
+    StatusEnum st;
+    VariableScopePtr scope = scope_find(shell, key);
+    if(scope != NULL) {
+        st = hashTableInsert(&scope->variables, key, value);
+        if(st == SUCCESS) {
+            hashTableFindItem(&scope->variables, key)->flags &= ~SCOPE_ITEM_UNSET;
+        }
+    }
+    else {
+        st = envSet(&shell->env_table, &shell->env_export, key, value);
+    }
+    ERR_CHECK(st);
+
+    if(streq(key, "PATH")) {
+        return path_cache_clear(shell);
+    }
+    return SUCCESS;
+} // shell_set_variable
+
+
+/**
+ * @brief       Exports nearest visible definition of variable to commands started by the shell
+ *
+ *              A local keeps the attribute until its scope is popped and the
+ *              global of the same name is left alone, global name which is not
+ *              set yet is exported once it is assigned
+ *
+ * @param shell shell state
+ * @param key   variable name
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+StatusEnum shell_export_variable(ShellStatePtr shell, const char* key) {
+    VariableScopePtr scope = scope_find(shell, key);
+    if(scope != NULL) {
+        hashTableFindItem(&scope->variables, key)->flags |= ENV_EXPORTED;
+        return SUCCESS;
+    }
+    return envExport(&shell->env_table, &shell->env_export, key);
+} // shell_export_variable
+
+
+/**
+ * @brief       Tells whether nearest visible definition of variable is exported
+ *
+ * @param shell shell state
+ * @param key   variable name
+ * @return      1 when it is set and exported, 0 otherwise
+ */
+uint8_t shell_is_exported(ShellStatePtr shell, const char* key) {
+    VariableScopePtr scope = scope_find(shell, key);
+    if(scope != NULL) {
+        uint32_t flags = hashTableFindItem(&scope->variables, key)->flags;
+        return ((flags & ENV_EXPORTED) && !(flags & SCOPE_ITEM_UNSET)) ? 1U : 0U;
+    }
+    return envIsExported(&shell->env_table, key);
+} // shell_is_exported
+
+
+/**
+ * @brief       Finds item of variable for arithmetic, which reads and sets its number
+ *
+ * @param shell shell state
+ * @param key   variable name
+ * @return      item valid until the next assignment, NULL when variable is not set
+ */
+HashTableItemPtr shell_find_variable(ShellStatePtr shell, const char* key) {
+    for(VariableScopePtr scope = scope_first_with_locals(shell->scope); scope != NULL;
+        scope = scope->parent_with_locals) {
+        HashTableItemPtr item = hashTableFindItem(&scope->variables, key);
+        if(item != NULL) {
+            return (item->flags & SCOPE_ITEM_UNSET) ? NULL : item;
+        }
+    }
+    return hashTableFindItem(&shell->env_table, key);
+} // shell_find_variable
+
+
+/**
+ * @brief       Sets variable to number, text of the value is written when it is read
+ *
+ *              Loop counters updated by arithmetic are neither formatted nor
+ *              reallocated on every assignment, only exported ones are marked
+ *              changed for the export vector, new variables and PATH go
+ *              through shell_set_variable()
+ *
+ * @param shell shell state
+ * @param key   variable name
+ * @param number new value
+ * @return      SUCCESS or status of the underlying table
+ */
+StatusEnum shell_set_number(ShellStatePtr shell, const char* key, int64_t number) {
+    HashTableItemPtr item = NULL;
+    uint8_t local = 0U;
+    for(VariableScopePtr scope = scope_first_with_locals(shell->scope); scope != NULL && item == NULL;
+        scope = scope->parent_with_locals) {
+        item = hashTableFindItem(&scope->variables, key);
+        local = (item != NULL) ? 1U : 0U;
+    }
+    if(item == NULL) {
+        item = hashTableFindItem(&shell->env_table, key);
+    }
+    if(item == NULL || streq(key, "PATH")) {
+        char text[24];
+        snprintf(text, sizeof(text), "%lld", (long long)number);
+        return shell_set_variable(shell, key, text);
+    }
+
+    hashTableSetNumber(item, number);
+    item->flags &= ~SCOPE_ITEM_UNSET;
+    // counters which are not exported never touch the export vector
+    if(!local && (item->flags & ENV_EXPORTED)) {
+        envMarkChanged(&shell->env_export, key);
+    }
+    return SUCCESS;
+} // shell_set_number
+
+
+/**
+ * @brief       Unsets nearest visible definition of variable
+ *
+ *              A local stays in its scope marked unset, so the outer variable
+ *              remains hidden until the scope is popped. Unsetting PATH
+ *              forgets remembered command locations
+ *
+ * @param shell shell state
+ * @param key   variable name
+ * @return      SUCCESS or status of the underlying table
+ */
+StatusEnum shell_unset_variable(ShellStatePtr shell, const char* key) {
+    StatusEnum st;
+    VariableScopePtr scope = scope_find(shell, key);
+    if(scope != NULL) {
+        st = hashTableInsert(&scope->variables, key, "");
+        if(st == SUCCESS) {
+            HashTableItemPtr item = hashTableFindItem(&scope->variables, key);
+            item->flags = (item->flags & ~ENV_EXPORTED) | SCOPE_ITEM_UNSET;
+        }
+    }
+    else {
+        st = envUnset(&shell->env_table, &shell->env_export, key);
+    }
+    ERR_CHECK(st);
+
+    if(streq(key, "PATH")) {
+        return path_cache_clear(shell);
+    }
+    return SUCCESS;
+} // shell_unset_variable
+
+
+/**
+ * @brief       Tells whether one of the prefixes assigns key
+ */
+static uint8_t prefix_assigns(char** assignments, uint32_t count, const char* key) {
+    size_t length = strlen(key);
+    for(uint32_t i = 0; i < count; i++) {
+        if(strncmp(assignments[i], key, length) == 0 && assignments[i][length] == '=') {
+            return 1U;
+        }
+    }
+    return 0U;
+} // prefix_assigns
+
+
+/**
+ * @brief       Tells whether a scope between top and scope (exclusive) defines key
+ */
+static uint8_t scope_shadowed(VariableScopePtr top, VariableScopePtr scope, const char* key) {
+    for(; top != scope; top = top->parent_with_locals) {
+        if(hashTableFindItem(&top->variables, key) != NULL) {
+            return 1U;
+        }
+    }
+    return 0U;
+} // scope_shadowed
+
+
+/**
+ * @brief       Replaces entry of key in envp copy, appends it or leaves a hole when entry is NULL
+ */
+static void envp_put(ShellStatePtr shell, char** envp, uint32_t* count, const char* key, char* entry) {
+    int64_t index = envEntryIndex(&shell->env_export, key);
+    if(index != -1) {
+        envp[index] = entry;
+    }
+    else if(entry != NULL) {
+        envp[(*count)++] = entry;
+    }
+} // envp_put
+
+
+/**
+ * @brief       Builds envp of a command from exported globals and the visible scope chain
+ *
+ *              Without locals and prefixes the cached export vector is returned
+ *              as is, otherwise its pointers are copied into the command arena
+ *              and every visible local replaces, adds or hides its name
+ *
+ * @param shell shell state
+ * @param assignments NAME=value prefixes of the command, they shadow everything
+ * @param assignment_count number of prefixes
+ * @param envp  output NULL terminated vector, valid until the next change or arena reset
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+StatusEnum shell_build_envp(ShellStatePtr shell, char** assignments, uint32_t assignment_count, char*** envp) {
+    char** exported = NULL;
+    StatusEnum st = envGetEnvp(&shell->env_export, &shell->env_table, &exported);
+    ERR_CHECK(st);
+
+    VariableScopePtr top = scope_first_with_locals(shell->scope);
+    if(top == NULL && assignment_count == 0) {
+        *envp = exported;
+        return SUCCESS;
+    }
+
+    uint32_t count = shell->env_export.count;
+    size_t room = count + assignment_count + 1;
+    for(VariableScopePtr scope = top; scope != NULL; scope = scope->parent_with_locals) {
+        room += scope->variables.currentSize;
+    }
+    char** result = (char**) arenaAlloc(&shell->command_arena, sizeof(char*) * room);
+    if(result == NULL) {
+        return ERROR_MALLOC_FAILURE;
+    }
+    memcpy(result, exported, sizeof(char*) * count);
+
+    // the last prefix of a name wins
+    for(uint32_t i = assignment_count; i-- > 0;) {
+        char* equals = strchr(assignments[i], '=');
+        *equals = '\0';
+        if(!prefix_assigns(assignments + i + 1, assignment_count - i - 1, assignments[i])) {
+            envp_put(shell, result, &count, assignments[i], assignments[i]);
+        }
+        *equals = '=';
+    }
+
+    // nearest definition of a name decides, locals which are unset or not exported hide the global
+    for(VariableScopePtr scope = top; scope != NULL; scope = scope->parent_with_locals) {
+        uint32_t position = 0;
+        char* key;
+        char* value;
+        while(hashTableIterate(&scope->variables, &position, &key, &value)) {
+            if(prefix_assigns(assignments, assignment_count, key) || scope_shadowed(top, scope, key)) {
+                continue;
+            }
+            char* entry = NULL;
+            uint32_t flags = hashTableFindItem(&scope->variables, key)->flags;
+            if((flags & ENV_EXPORTED) && !(flags & SCOPE_ITEM_UNSET)) {
+                size_t key_length = strlen(key);
+                size_t value_length = strlen(value);
+                entry = (char*) arenaAlloc(&shell->command_arena, key_length + value_length + 2);
+                if(entry == NULL) {
+                    return ERROR_MALLOC_FAILURE;
+                }
+                memcpy(entry, key, key_length);
+                entry[key_length] = '=';
+                memcpy(entry + key_length + 1, value, value_length + 1);
+            }
+            envp_put(shell, result, &count, key, entry);
+        }
+    }
+
+    // close holes of hidden names
+    uint32_t kept = 0;
+    for(uint32_t i = 0; i < count; i++) {
+        if(result[i] != NULL) {
+            result[kept++] = result[i];
+        }
+    }
+    result[kept] = NULL;
+    *envp = result;
+    return SUCCESS;
+} // shell_build_envp
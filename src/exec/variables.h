@@ -0,0 +1,148 @@
+#ifndef VARIABLES_H
+#define VARIABLES_H
+
+#include <stdint.h>
+#include "exec.h"
+
+// flag of scope item which stands for a variable unset in that scope
+#define SCOPE_ITEM_UNSET 0x0400U
+
+/*  One layer of the variable scope chain, function calls and commands with
+    NAME=value prefixes push a layer whose table shadows everything below it.
+    The table is created on first local variable so frames without locals
+    cost no allocation, and lookups skip them */
+typedef struct variable_scope {
+    struct variable_scope* parent;
+    struct variable_scope* parent_with_locals;  // nearest ancestor which has locals
+    HashTable variables;        // valid only when has_locals is set
+    uint8_t has_locals;
+    uint8_t function_scope;     // pushed by function call, `local` is allowed
+} VariableScope, *VariableScopePtr;
+
+
+/**
+ * @brief       Pushes new empty scope on top of the chain
+ *
+ * @param shell shell state
+ * @param function_scope 1 for function calls, 0 for temporary NAME=value scopes
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+StatusEnum scope_push(ShellStatePtr shell, uint8_t function_scope);
+
+/**
+ * @brief       Drops top scope with all its variables in O(number of locals)
+ */
+void scope_pop(ShellStatePtr shell);
+
+/**
+ * @brief       Frees all scopes including the pool of reusable ones
+ */
+void scope_dispose(ShellStatePtr shell);
+
+/**
+ * @brief       Creates or sets variable in the top scope (local)
+ *
+ * @param shell shell state, a scope must be pushed
+ * @param key   variable name
+ * @param value value of variable
+ * @return      SUCCESS, ERROR_DEFAULT without scope, ERROR_MALLOC_FAILURE
+ */
+StatusEnum scope_set_local(ShellStatePtr shell, const char* key, const char* value);
+
+/**
+ * @brief       Looks variable up through the scope chain and then env table
+ *
+ * @param shell shell state
+ * @param key   variable name
+ * @param value output pointer to stored value (not a copy)
+ * @return      SUCCESS, ERROR_DEFAULT when variable is not set
+ */
+StatusEnum shell_get_variable(ShellStatePtr shell, const char* key, char** value);
+
+/**
+ * @brief       Sets variable where it is visible from, nearest local or global
+ *
+ *              Assigning PATH forgets remembered command locations
+ *
+ * @param shell shell state
+ * @param key   variable name
+ * @param value new value
+ * @return      SUCCESS or status of the underlying table
+ */
+StatusEnum shell_set_variable(ShellStatePtr shell, const char* key, const char* value);
+
+/**
+ * @brief       Exports nearest visible definition of variable to commands started by the shell
+ *
+ *              A local keeps the attribute until its scope is popped and the
+ *              global of the same name is left alone, global name which is not
+ *              set yet is exported once it is assigned
+ *
+ * @param shell shell state
+ * @param key   variable name
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+StatusEnum shell_export_variable(ShellStatePtr shell, const char* key);
+
+/**
+ * @brief       Tells whether nearest visible definition of variable is exported
+ *
+ * @param shell shell state
+ * @param key   variable name
+ * @return      1 when it is set and exported, 0 otherwise
+ */
+uint8_t shell_is_exported(ShellStatePtr shell, const char* key);
+
+/**
+ * @brief       Finds item of variable for arithmetic, which reads and sets its number
+ *
+ * @param shell shell state
+ * @param key   variable name
+ * @return      item valid until the next assignment, NULL when variable is not set
+ */
+HashTableItemPtr shell_find_variable(ShellStatePtr shell, const char* key);
+
+/**
+ * @brief       Sets variable to number, text of the value is written when it is read
+ *
+ *              Loop counters updated by arithmetic are neither formatted nor
+ *              reallocated on every assignment, only exported ones are marked
+ *              changed for the export vector, new variables and PATH go
+ *              through shell_set_variable()
+ *
+ * @param shell shell state
+ * @param key   variable name
+ * @param number new value
+ * @return      SUCCESS or status of the underlying table
+ */
+StatusEnum shell_set_number(ShellStatePtr shell, const char* key, int64_t number);
+
+/**
+ * @brief       Unsets nearest visible definition of variable
+ *
+ *              A local stays in its scope marked unset, so the outer variable
+ *              remains hidden until the scope is popped. Unsetting PATH
+ *              forgets remembered command locations
+ *
+ * @param shell shell state
+ * @param key   variable name
+ * @return      SUCCESS or status of the underlying table
+ */
+StatusEnum shell_unset_variable(ShellStatePtr shell, const char* key);
+
+/**
+ * @brief       Builds envp of a command from exported globals and the visible scope chain
+ *
+ *              Without locals and prefixes the cached export vector is returned
+ *              as is, otherwise its pointers are copied into the command arena
+ *              and every visible local replaces, adds or hides its name
+ *
+ * @param shell shell state
+ * @param assignments NAME=value prefixes of the command, they shadow everything
+ * @param assignment_count number of prefixes
+ * @param envp  output NULL terminated vector, valid until the next change or arena reset
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+StatusEnum shell_build_envp(ShellStatePtr shell, char** assignments, uint32_t assignment_count, char*** envp);
+
+#endif
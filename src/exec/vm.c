@@ -0,0 +1,805 @@
+/**
+ * Bytecode virtual machine
+ *
+ * A command line is parsed and compiled once, loop bodies and function
+ * bodies then run as flat instruction arrays, control flow is a jump and
+ * the next handler is reached through a computed goto instead of walking
+ * the tree and dispatching on node types
+ */
+
+#include "vm.h"
+#include "expand.h"
+#include "variables.h"
+#include "arithmetic.h"
+
+// labels as values are a GNU extension, other compilers use a switch
+#if defined(__GNUC__) && !defined(VM_NO_COMPUTED_GOTO)
+#define VM_COMPUTED_GOTO
+#endif
+
+#ifdef VM_COMPUTED_GOTO
+#define TARGET(op)  target_##op
+#define DISPATCH()  goto *dispatch_table[code[pc].op]
+#else
+#define TARGET(op)  case op
+#define DISPATCH()  goto dispatch
+#endif
+
+//
+typedef enum {
+    FRAME_LOOP,
+    FRAME_REDIRECT,
+    FRAME_CASE
+} FrameTypeEnum;
+
+
+// state of a loop, case or redirection open in the running program
+typedef struct vm_frame {
+    FrameTypeEnum type;
+    ArenaMark mark;             // command arena before the frame, released when it closes
+    uint32_t break_target;      // OP_LOOP_EXIT of loop, OP_CASE_END of case
+    uint32_t continue_target;
+    int32_t status;             // status of the loop
+    char** values;              // values of for loop
+    uint32_t value_count;
+    uint32_t value_index;
+    char* subject;              // expanded word of case
+    SavedFds saved;             // descriptors replaced by redirection
+} VmFrame, *VmFramePtr;
+
+
+/**
+ * @brief       Turns redirections of the tree into expanded redirections
+ *
+ * @param redirections output list allocated from the command arena
+ * @return      SUCCESS, ERROR_DEFAULT on bad substitution, ERROR_MALLOC_FAILURE
+ */
+static StatusEnum expand_redirections(ShellStatePtr shell, RedirectionNodePtr nodes, RedirectionPtr* redirections) {
+    RedirectionPtr* tail = redirections;
+    for(RedirectionNodePtr r = nodes; r != NULL; r = r->next) {
+        RedirectionPtr redirection = (RedirectionPtr) arenaAlloc(&shell->command_arena, sizeof(Redirection));
+        if(redirection == NULL) {
+            return ERROR_MALLOC_FAILURE;
+        }
+        redirection->next = NULL;
+        redirection->type = r->type;
+        redirection->io_number = r->io_number;
+        redirection->body_length = 0;
+        redirection->expand_body = 0U;
+        if(r->type == TOKEN_DLESS || r->type == TOKEN_DLESSDASH) {
+            // body is expanded piece by piece when it's written to the descriptor
+            redirection->target = (r->body.text != NULL) ? r->body.text : "";
+            redirection->body_length = r->body.length;
+            redirection->expand_body = (r->body.flags != 0) ? 1U : 0U;
+        }
+        else {
+            StatusEnum st = expand_string(shell, &r->target, 0U, &redirection->target);
+            ERR_CHECK(st);
+        }
+
+        *tail = redirection;
+        tail = &redirection->next;
+    }
+    *tail = NULL;
+    return SUCCESS;
+} // expand_redirections
+
+
+/**
+ * @brief       Stores status of failed expansion
+ *
+ *              Only malloc failure, ${name?word} and $(( )) errors stop the
+ *              program, the latter two are passed up to end a non-interactive shell
+ */
+static StatusEnum expansion_failed(ShellStatePtr shell, StatusEnum st) {
+    shell->last_status = ERROR_DEFAULT;
+    if(st == ERROR_MALLOC_FAILURE || st == ERROR_FATAL_EXPANSION) {
+        return st;
+    }
+    return SUCCESS;
+} // expansion_failed
+
+
+/**
+ * @brief       Expands words, assignments and redirections of simple command
+ *
+ * @param command output command allocated from the command arena
+ * @return      SUCCESS, ERROR_DEFAULT on bad substitution, ERROR_MALLOC_FAILURE
+ */
+static StatusEnum expand_command(ShellStatePtr shell, NodePtr node, SimpleCommandPtr command) {
+    memset(command, 0, sizeof(*command));
+    StatusEnum st = expand_words(shell, node->simple.words, node->simple.word_count, EXPAND_SPLIT | EXPAND_GLOB,
+                                 &command->argv, &command->argc);
+
+    if(st == SUCCESS && node->simple.assignment_count > 0) {
+        command->assignments = (char**) arenaAlloc(&shell->command_arena,
+                                                   sizeof(char*) * (node->simple.assignment_count + 1));
+        st = (command->assignments != NULL) ? SUCCESS : ERROR_MALLOC_FAILURE;
+        for(uint32_t i = 0; i < node->simple.assignment_count && st == SUCCESS; i++) {
+            st = expand_string(shell, &node->simple.assignments[i], 0U, &command->assignments[i]);
+        }
+        if(st == SUCCESS) {
+            command->assignments[node->simple.assignment_count] = NULL;
+            command->assignment_count = node->simple.assignment_count;
+        }
+    }
+
+    if(st == SUCCESS) {
+        st = expand_redirections(shell, node->redirections, &command->redirections);
+    }
+    return st;
+} // expand_command
+
+
+/**
+ * @brief       Expands and executes simple command
+ *
+ *              Everything allocated for the command is released when it
+ *              finishes so loops do not grow the command arena
+ */
+static StatusEnum run_simple(ShellStatePtr shell, NodePtr node) {
+    ArenaMark mark = arenaMark(&shell->command_arena);
+
+    // i=$((i+1)) stores the number without expanding the word
+    if(node->simple.word_count == 0 && node->simple.assignment_count == 1 && node->redirections == NULL &&
+       node->simple.assignments[0].arithmetic != NULL) {
+        uint8_t done = 0U;
+        StatusEnum st = arith_assign(shell, &node->simple.assignments[0], &done);
+        if(st == SUCCESS && done) {
+            shell->last_status = 0;
+        }
+        if(st != SUCCESS || done) {
+            arenaRelease(&shell->command_arena, mark);
+            return (st == SUCCESS) ? SUCCESS : expansion_failed(shell, st);
+        }
+    }
+
+    SimpleCommand command;
+    StatusEnum st = expand_command(shell, node, &command);
+    if(st == SUCCESS) {
+        st = exec_simple_command(shell, &command);
+    }
+    else {
+        st = expansion_failed(shell, st);
+    }
+
+    arenaRelease(&shell->command_arena, mark);
+    return st;
+} // run_simple
+
+
+/**
+ * @brief       Runs program in a forked child, parent gets the pid
+ *
+ * @param input descriptor for stdin of the child, -1 keeps stdin
+ * @param output descriptor for stdout of the child, -1 keeps stdout
+ * @param pending read end of the pipe of output which the child must not keep, -1 if none
+ * @return      SUCCESS, ERROR_DEFAULT when fork fails (reported)
+ */
+static StatusEnum fork_program(ShellStatePtr shell, ProgramPtr program, int32_t input, int32_t output,
+                               int32_t pending, pid_t* pid) {
+    output_flush();
+
+    *pid = fork();
+    if(*pid == -1) {
+        print_errno(SHELL_NAME);
+        return ERROR_DEFAULT;
+    }
+    if(*pid != 0) {
+        return SUCCESS;
+    }
+
+    // child, builtins and loops of the stage must not hold pipe ends open or
+    // the writer never gets EPIPE and the reader never sees end of file
+    if(input != -1) {
+        dup2(input, STDIN_FILENO);
+        if(input != STDIN_FILENO) {
+            close(input);
+        }
+    }
+    if(output != -1) {
+        dup2(output, STDOUT_FILENO);
+        if(output != STDOUT_FILENO) {
+            close(output);
+        }
+    }
+    if(pending != -1) {
+        close(pending);
+    }
+    // loops and functions of the parent can't be left from a subshell
+    shell->loop_depth = 0;
+    shell->function_depth = 0;
+    jobs_inherit(&shell->jobs);
+    if(vm_run(shell, program) != SUCCESS) {
+        shell->last_status = ERROR_DEFAULT;
+    }
+    exit_child(shell);
+} // fork_program
+
+
+/**
+ * @brief       Fills descriptor actions connecting pipeline stage to its pipes
+ *
+ *              Mirrors what fork_program() does in the child, the pipe ends
+ *              are moved to 0 and 1 and every other end is closed
+ *
+ * @param actions output array of at least 5 actions
+ * @return      number of actions
+ */
+static uint32_t pipe_actions(int32_t input, int32_t output, int32_t pending, FdActionPtr actions) {
+    uint32_t count = 0;
+    if(input != -1) {
+        actions[count++] = (FdAction) {STDIN_FILENO, input, 0U};
+    }
+    if(output != -1) {
+        actions[count++] = (FdAction) {STDOUT_FILENO, output, 0U};
+    }
+    if(input != -1 && input != STDIN_FILENO) {
+        actions[count++] = (FdAction) {input, -1, 0U};
+    }
+    if(output != -1 && output != STDOUT_FILENO) {
+        actions[count++] = (FdAction) {output, -1, 0U};
+    }
+    if(pending != -1) {
+        actions[count++] = (FdAction) {pending, -1, 0U};
+    }
+    return count;
+} // pipe_actions
+
+
+/**
+ * @brief       Starts one stage of pipeline
+ *
+ *              A simple command is expanded in the shell and started with
+ *              exec_start_command(), so an external program is spawned straight
+ *              into the pipeline, only builtins, functions and compound stages
+ *              are forked
+ *
+ * @param pid   output child, 0 when the stage could not be started and its
+ *              status is in shell->last_status
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+static StatusEnum start_stage(ShellStatePtr shell, ProgramPtr stage, int32_t input, int32_t output,
+                              int32_t pending, pid_t* pid) {
+    *pid = 0;
+    NodePtr node = (NodePtr) stage->code[0].data;
+    if(stage->length != 2 || stage->code[0].op != OP_SIMPLE || node->simple.word_count == 0) {
+        if(fork_program(shell, stage, input, output, pending, pid) != SUCCESS) {
+            *pid = 0;
+            shell->last_status = ERROR_DEFAULT;
+        }
+        return SUCCESS;
+    }
+
+    ArenaMark mark = arenaMark(&shell->command_arena);
+    SimpleCommand command;
+    StatusEnum st = expand_command(shell, node, &command);
+    if(st == SUCCESS) {
+        FdAction actions[5];
+        uint32_t count = pipe_actions(input, output, pending, actions);
+        st = exec_start_command(shell, &command, actions, count, pid);
+    }
+    else {
+        // the stage stands for a subshell, only that one would exit
+        st = expansion_failed(shell, st);
+        st = (st == ERROR_FATAL_EXPANSION) ? SUCCESS : st;
+    }
+    arenaRelease(&shell->command_arena, mark);
+    return st;
+} // start_stage
+
+
+/**
+ * @brief       Runs stages of pipeline in children connected by pipes
+ *
+ *              Exit status is the status of the last stage
+ *
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+static StatusEnum run_pipeline(ShellStatePtr shell, ProgramPtr* stages, uint32_t count) {
+    pid_t pids[count];
+    int32_t statuses[count];
+    uint32_t started = 0;
+    int32_t input = -1;
+    StatusEnum st = SUCCESS;
+
+    for(uint32_t i = 0; i < count; i++) {
+        int32_t fds[2] = {-1, -1};
+        if(i + 1 < count) {
+            st = open_pipe(fds);
+            if(st != SUCCESS) {
+                break;
+            }
+            // a builtin producer writes its output in large blocks
+            pipe_grow(fds[1], SHELL_PIPE_SIZE);
+        }
+
+        st = start_stage(shell, stages[i], input, fds[1], fds[0], &pids[i]);
+        statuses[i] = shell->last_status;
+        if(input != -1) {
+            close(input);
+        }
+        if(fds[1] != -1) {
+            close(fds[1]);
+        }
+        input = fds[0];
+        if(st != SUCCESS) {
+            break;
+        }
+        started++;
+    }
+    if(input != -1) {
+        close(input);
+    }
+
+    int32_t status = ERROR_DEFAULT;
+    for(uint32_t i = 0; i < started; i++) {
+        status = (pids[i] != 0) ? wait_child(pids[i]) : statuses[i];
+    }
+    shell->last_status = (st == SUCCESS && started == count) ? status : ERROR_DEFAULT;
+    return (st == ERROR_MALLOC_FAILURE) ? st : SUCCESS;
+} // run_pipeline
+
+
+/**
+ * @brief       Closes frame, undoes its redirection and drops its allocations
+ */
+static void frame_close(ShellStatePtr shell, VmFramePtr frame) {
+    if(frame->type == FRAME_LOOP) {
+        shell->loop_depth--;
+    }
+    else if(frame->type == FRAME_REDIRECT) {
+        redirect_pop(&frame->saved);
+    }
+    arenaRelease(&shell->command_arena, frame->mark);
+} // frame_close
+
+
+/**
+ * @brief       Closes frames left by break, continue, return or exit
+ *
+ * @param depth number of open frames, updated
+ * @return      index of the next instruction, OP_HALT when the program is left
+ */
+static uint32_t unwind(ShellStatePtr shell, ProgramPtr program, VmFramePtr frames, uint32_t* depth) {
+    while(*depth > 0) {
+        VmFramePtr frame = &frames[*depth - 1];
+        if(frame->type == FRAME_LOOP && shell->break_levels > 0 && !shell->returning && !shell->exiting) {
+            shell->break_levels--;
+            if(shell->break_levels == 0) {
+                if(shell->continue_loop) {
+                    shell->continue_loop = 0U;
+                    return frame->continue_target;
+                }
+                // OP_LOOP_EXIT closes the frame
+                frame->status = shell->last_status;
+                return frame->break_target;
+            }
+        }
+        frame_close(shell, frame);
+        (*depth)--;
+    }
+    return program->length - 1;
+} // unwind
+
+
+/**
+ * @brief       Executes compiled program
+ *
+ *              Instructions are dispatched by computed goto where the compiler
+ *              supports it, loops jump back in the flat code, only words are
+ *              expanded again on every pass
+ *
+ * @param shell shell state
+ * @param program program to execute
+ * @return      SUCCESS or fatal error (ERROR_MALLOC_FAILURE), exit status
+ *              of the program is stored in shell->last_status
+ */
+StatusEnum vm_run(ShellStatePtr shell, ProgramPtr program) {
+#ifdef VM_COMPUTED_GOTO
+    static const void* const dispatch_table[OP_COUNT] = {
+        [OP_HALT] = &&target_OP_HALT,
+        [OP_SIMPLE] = &&target_OP_SIMPLE,
+        [OP_PIPELINE] = &&target_OP_PIPELINE,
+        [OP_SUBSHELL] = &&target_OP_SUBSHELL,
+        [OP_BACKGROUND] = &&target_OP_BACKGROUND,
+        [OP_NOT] = &&target_OP_NOT,
+        [OP_SET_STATUS] = &&target_OP_SET_STATUS,
+        [OP_JUMP] = &&target_OP_JUMP,
+        [OP_JUMP_IF_TRUE] = &&target_OP_JUMP_IF_TRUE,
+        [OP_JUMP_IF_FALSE] = &&target_OP_JUMP_IF_FALSE,
+        [OP_REDIRECT] = &&target_OP_REDIRECT,
+        [OP_REDIRECT_END] = &&target_OP_REDIRECT_END,
+        [OP_LOOP_ENTER] = &&target_OP_LOOP_ENTER,
+        [OP_LOOP_SAVE] = &&target_OP_LOOP_SAVE,
+        [OP_LOOP_EXIT] = &&target_OP_LOOP_EXIT,
+        [OP_FOR_INIT] = &&target_OP_FOR_INIT,
+        [OP_FOR_NEXT] = &&target_OP_FOR_NEXT,
+        [OP_CASE_BEGIN] = &&target_OP_CASE_BEGIN,
+        [OP_CASE_MATCH] = &&target_OP_CASE_MATCH,
+        [OP_CASE_END] = &&target_OP_CASE_END,
+        [OP_DEFINE_FUNCTION] = &&target_OP_DEFINE_FUNCTION
+    };
+#endif
+
+    ArenaMark mark = arenaMark(&shell->command_arena);
+    VmFramePtr frames = NULL;
+    if(program->frame_count > 0) {
+        frames = (VmFramePtr) arenaAlloc(&shell->command_arena, sizeof(VmFrame) * program->frame_count);
+        if(frames == NULL) {
+            return ERROR_MALLOC_FAILURE;
+        }
+    }
+
+    InstructionPtr code = program->code;
+    uint32_t depth = 0;
+    uint32_t pc = 0;
+    StatusEnum st = SUCCESS;
+
+#ifdef VM_COMPUTED_GOTO
+    DISPATCH();
+#else
+dispatch:
+    switch(code[pc].op) {
+#endif
+
+    TARGET(OP_HALT): {
+        goto halt;
+    }
+
+    TARGET(OP_SIMPLE): {
+        st = run_simple(shell, (NodePtr) code[pc].data);
+        if(st != SUCCESS) {
+            goto halt;
+        }
+        pc++;
+        // only builtins and functions run here can start unwinding
+        if(control_pending(shell)) {
+            pc = unwind(shell, program, frames, &depth);
+        }
+        DISPATCH();
+    }
+
+    TARGET(OP_PIPELINE): {
+        st = run_pipeline(shell, (ProgramPtr*) code[pc].data, code[pc].arg);
+        if(st != SUCCESS) {
+            goto halt;
+        }
+        pc++;
+        DISPATCH();
+    }
+
+    TARGET(OP_SUBSHELL): {
+        pid_t pid;
+        if(fork_program(shell, (ProgramPtr) code[pc].data, -1, -1, -1, &pid) != SUCCESS) {
+            shell->last_status = ERROR_DEFAULT;
+        }
+        else {
+            shell->last_status = wait_child(pid);
+        }
+        pc++;
+        DISPATCH();
+    }
+
+    TARGET(OP_BACKGROUND): {
+        BackgroundPtr background = (BackgroundPtr) code[pc].data;
+        pid_t pid;
+        if(fork_program(shell, background->body, -1, -1, -1, &pid) != SUCCESS) {
+            shell->last_status = ERROR_DEFAULT;
+        }
+        else {
+            shell->last_background = pid;
+            shell->last_status = 0;
+            st = jobs_add(&shell->jobs, pid, background->text, NULL);
+            if(st != SUCCESS) {
+                goto halt;
+            }
+        }
+        pc++;
+        DISPATCH();
+    }
+
+    TARGET(OP_NOT): {
+        shell->last_status = (shell->last_status == 0) ? 1 : 0;
+        pc++;
+        DISPATCH();
+    }
+
+    TARGET(OP_SET_STATUS): {
+        shell->last_status = (int32_t) code[pc].arg;
+        pc++;
+        DISPATCH();
+    }
+
+    TARGET(OP_JUMP): {
+        pc = code[pc].arg;
+        DISPATCH();
+    }
+
+    TARGET(OP_JUMP_IF_TRUE): {
+        pc = (shell->last_status == 0) ? code[pc].arg : pc + 1;
+        DISPATCH();
+    }
+
+    TARGET(OP_JUMP_IF_FALSE): {
+        pc = (shell->last_status != 0) ? code[pc].arg : pc + 1;
+        DISPATCH();
+    }
+
+    TARGET(OP_REDIRECT): {
+        VmFramePtr frame = &frames[depth];
+        frame->type = FRAME_REDIRECT;
+        frame->mark = arenaMark(&shell->command_arena);
+
+        RedirectionPtr redirections;
+        st = expand_redirections(shell, (RedirectionNodePtr) code[pc].data, &redirections);
+        if(st == SUCCESS) {
+            st = redirect_push(shell, redirections, &frame->saved);
+        }
+        if(st != SUCCESS) {
+            arenaRelease(&shell->command_arena, frame->mark);
+            st = expansion_failed(shell, st);
+            if(st != SUCCESS) {
+                goto halt;
+            }
+            pc = code[pc].arg;
+            DISPATCH();
+        }
+        depth++;
+        pc++;
+        DISPATCH();
+    }
+
+    TARGET(OP_REDIRECT_END): {
+        frame_close(shell, &frames[--depth]);
+        pc++;
+        DISPATCH();
+    }
+
+    TARGET(OP_LOOP_ENTER): {
+        VmFramePtr frame = &frames[depth++];
+        frame->type = FRAME_LOOP;
+        frame->mark = arenaMark(&shell->command_arena);
+        frame->break_target = code[pc].arg;
+        frame->continue_target = code[pc].arg2;
+        frame->status = 0;
+        shell->loop_depth++;
+        pc++;
+        DISPATCH();
+    }
+
+    TARGET(OP_LOOP_SAVE): {
+        frames[depth - 1].status = shell->last_status;
+        pc++;
+        DISPATCH();
+    }
+
+    TARGET(OP_LOOP_EXIT): {
+        int32_t status = frames[depth - 1].status;
+        frame_close(shell, &frames[--depth]);
+        shell->last_status = status;
+        pc++;
+        DISPATCH();
+    }
+
+    TARGET(OP_FOR_INIT): {
+        VmFramePtr frame = &frames[depth - 1];
+        NodePtr node = (NodePtr) code[pc].data;
+        frame->value_index = 0;
+        if(node->for_loop.has_in) {
+            // values stay allocated until OP_LOOP_EXIT releases the frame
+            st = expand_words(shell, node->for_loop.words, node->for_loop.word_count, EXPAND_SPLIT | EXPAND_GLOB,
+                              &frame->values, &frame->value_count);
+            if(st != SUCCESS) {
+                st = expansion_failed(shell, st);
+                if(st != SUCCESS) {
+                    goto halt;
+                }
+                frame->status = ERROR_DEFAULT;
+                pc = code[pc].arg;
+                DISPATCH();
+            }
+        }
+        else {
+            frame->values = shell->positional;
+            frame->value_count = shell->positional_count;
+        }
+        pc++;
+        DISPATCH();
+    }
+
+    TARGET(OP_FOR_NEXT): {
+        VmFramePtr frame = &frames[depth - 1];
+        if(frame->value_index >= frame->value_count) {
+            pc = code[pc].arg;
+            DISPATCH();
+        }
+        st = shell_set_variable(shell, ((NodePtr) code[pc].data)->for_loop.name,
+                                frame->values[frame->value_index++]);
+        if(st != SUCCESS) {
+            goto halt;
+        }
+        pc++;
+        DISPATCH();
+    }
+
+    TARGET(OP_CASE_BEGIN): {
+        VmFramePtr frame = &frames[depth];
+        frame->type = FRAME_CASE;
+        frame->mark = arenaMark(&shell->command_arena);
+        frame->break_target = code[pc].arg - 1;
+
+        st = expand_string(shell, &((NodePtr) code[pc].data)->case_command.subject, 0U, &frame->subject);
+        if(st != SUCCESS) {
+            arenaRelease(&shell->command_arena, frame->mark);
+            st = expansion_failed(shell, st);
+            if(st != SUCCESS) {
+                goto halt;
+            }
+            pc = code[pc].arg;
+            DISPATCH();
+        }
+        depth++;
+        pc++;
+        DISPATCH();
+    }
+
+    TARGET(OP_CASE_MATCH): {
+        VmFramePtr frame = &frames[depth - 1];
+        ArenaMark pattern_mark = arenaMark(&shell->command_arena);
+        char* pattern;
+        st = expand_string(shell, (WordPtr) code[pc].data, EXPAND_PATTERN, &pattern);
+        if(st != SUCCESS) {
+            arenaRelease(&shell->command_arena, pattern_mark);
+            st = expansion_failed(shell, st);
+            if(st != SUCCESS) {
+                goto halt;
+            }
+            pc = frame->break_target;
+            DISPATCH();
+        }
+        int matches = fnmatch(pattern, frame->subject, 0);
+        arenaRelease(&shell->command_arena, pattern_mark);
+        pc = (matches == 0) ? code[pc].arg : pc + 1;
+        DISPATCH();
+    }
+
+    TARGET(OP_CASE_END): {
+        frame_close(shell, &frames[--depth]);
+        pc++;
+        DISPATCH();
+    }
+
+    TARGET(OP_DEFINE_FUNCTION): {
+        st = function_define(shell, (NodePtr) code[pc].data);
+        if(st != SUCCESS) {
+            shell->last_status = ERROR_DEFAULT;
+            goto halt;
+        }
+        shell->last_status = 0;
+        pc++;
+        DISPATCH();
+    }
+
+#ifndef VM_COMPUTED_GOTO
+    default:
+        goto halt;
+    }
+#endif
+
+halt:
+    while(depth > 0) {
+        frame_close(shell, &frames[--depth]);
+    }
+    arenaRelease(&shell->command_arena, mark);
+    return st;
+} // vm_run
+
+
+/**
+ * @brief       Defines function, the body is copied out of the command arena
+ *              and compiled once
+ *
+ *              A previous definition is released, its body is freed unless
+ *              it is running
+ *
+ * @param shell shell state
+ * @param node  NODE_FUNCTION node
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+StatusEnum function_define(ShellStatePtr shell, NodePtr node) {
+    ShellFunctionPtr function = (ShellFunctionPtr) malloc(sizeof(ShellFunction));
+    if(function == NULL) {
+        return ERROR_MALLOC_FAILURE;
+    }
+    StatusEnum st = arenaCtorSize(&function->arena, FUNCTION_ARENA_BLOCK_SIZE);
+    if(st != SUCCESS) {
+        free(function);
+        return st;
+    }
+    function->references = 1;
+
+    NodePtr body;
+    st = ast_copy(node->function.body, &function->arena, &body);
+    if(st == SUCCESS) {
+        st = compile_program(body, &function->arena, &function->program);
+    }
+    if(st != SUCCESS) {
+        function_release(function);
+        return st;
+    }
+
+    ShellFunctionPtr previous = function_find(shell, node->function.name);
+    st = hashTableInsertBytes(&shell->functions, node->function.name, &function, sizeof(function));
+    if(st != SUCCESS) {
+        function_release(function);
+        return st;
+    }
+    if(previous != NULL) {
+        function_release(previous);
+    }
+    return SUCCESS;
+} // function_define
+
+
+/**
+ * @brief       Finds defined function
+ * @return      function, NULL when no such function is defined
+ */
+ShellFunctionPtr function_find(ShellStatePtr shell, const char* name) {
+    if(shell->functions.currentSize == 0) {
+        return NULL;
+    }
+
+    char* value;
+    if(hashTableGetValue(&shell->functions, name, &value) != SUCCESS) {
+        return NULL;
+    }
+    ShellFunctionPtr function;
+    memcpy(&function, value, sizeof(function));
+    return function;
+} // function_find
+
+
+/**
+ * @brief       Drops one reference of function, the last one frees its body
+ */
+void function_release(ShellFunctionPtr function) {
+    if(--function->references > 0) {
+        return;
+    }
+    arenaDtor(&function->arena);
+    free(function);
+} // function_release
+
+
+/**
+ * @brief       Removes function definition (unset -f)
+ * @return      SUCCESS, ERROR_DEFAULT when no such function is defined
+ */
+StatusEnum function_undefine(ShellStatePtr shell, const char* name) {
+    ShellFunctionPtr function = function_find(shell, name);
+    if(function == NULL) {
+        return ERROR_DEFAULT;
+    }
+    hashTableRemove(&shell->functions, name);
+    function_release(function);
+    return SUCCESS;
+} // function_undefine
+
+
+/**
+ * @brief       Removes all function definitions, running bodies stay until they return
+ */
+void functions_clear(ShellStatePtr shell) {
+    uint32_t position = 0;
+    char* key;
+    char* value;
+    while(hashTableIterate(&shell->functions, &position, &key, &value)) {
+        ShellFunctionPtr function;
+        memcpy(&function, value, sizeof(function));
+        function_release(function);
+    }
+    hashTableDtor(&shell->functions);
+    hashTableCtor(&shell->functions);
+} // functions_clear
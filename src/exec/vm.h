@@ -0,0 +1,83 @@
+#ifndef VM_H
+#define VM_H
+
+#include <stdint.h>
+#include <fnmatch.h>
+#include "exec.h"
+#include "compile.h"
+#include "../parser/parser.h"
+
+// block size of the arena of one function body
+#define FUNCTION_ARENA_BLOCK_SIZE 4096U
+
+
+/*  Defined function, the body is copied out of the command line into an
+    arena of its own. The functions table holds one reference and every
+    running call another, so redefinition or unset -f while the function
+    runs frees the old body only after the last call returns */
+typedef struct shell_function {
+    Arena arena;                // copied body and its program
+    ProgramPtr program;
+    uint32_t references;
+} ShellFunction, *ShellFunctionPtr;
+
+
+/**
+ * @brief       Tells whether break, continue, return or exit is unwinding
+ *
+ *              Lists stop running further commands while this is set
+ */
+static inline uint8_t control_pending(ShellStatePtr shell) {
+    return (shell->break_levels > 0 || shell->returning || shell->exiting) ? 1U : 0U;
+}
+
+/**
+ * @brief       Executes compiled program
+ *
+ *              Instructions are dispatched by computed goto where the compiler
+ *              supports it, loops jump back in the flat code, only words are
+ *              expanded again on every pass
+ *
+ * @param shell shell state
+ * @param program program to execute
+ * @return      SUCCESS or fatal error (ERROR_MALLOC_FAILURE), exit status
+ *              of the program is stored in shell->last_status
+ */
+StatusEnum vm_run(ShellStatePtr shell, ProgramPtr program);
+
+/**
+ * @brief       Defines function, the body is copied out of the command arena
+ *              and compiled once
+ *
+ *              A previous definition is released, its body is freed unless
+ *              it is running
+ *
+ * @param shell shell state
+ * @param node  NODE_FUNCTION node
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+StatusEnum function_define(ShellStatePtr shell, NodePtr node);
+
+/**
+ * @brief       Finds defined function
+ * @return      function, NULL when no such function is defined
+ */
+ShellFunctionPtr function_find(ShellStatePtr shell, const char* name);
+
+/**
+ * @brief       Drops one reference of function, the last one frees its body
+ */
+void function_release(ShellFunctionPtr function);
+
+/**
+ * @brief       Removes function definition (unset -f)
+ * @return      SUCCESS, ERROR_DEFAULT when no such function is defined
+ */
+StatusEnum function_undefine(ShellStatePtr shell, const char* name);
+
+/**
+ * @brief       Removes all function definitions, running bodies stay until they return
+ */
+void functions_clear(ShellStatePtr shell);
+
+#endif
@@ -1,11 +1,637 @@
+/**
+ * Table driven POSIX tokenizer
+ *
+ * Every input byte is classified with one lookup into char_class, the
+ * tokens are (offset, length) slices of the input buffer so lexing itself
+ * never allocates. Quote removal is done on demand by token_unquote()
+ */
 
+#define _GNU_SOURCE
+#include <string.h>
+#include "lexer.h"
 
+// character classes, one lookup per input byte
+#define CC_BLANK    0x01U   // space, tab
+#define CC_NEWLINE  0x02U   // \n
+#define CC_OPERATOR 0x04U   // first character of operator | & ; < > ( )
+#define CC_QUOTE    0x08U   // ' " `
+#define CC_ESCAPE   0x10U   // backslash
+#define CC_DOLLAR   0x20U   // $
+#define CC_DIGIT    0x40U   // 0-9
+#define CC_COMMENT  0x80U   // # (only special at the start of token)
 
-void get_token() {
+// any of these ends the fast unquoted word scan
+#define CC_WORD_BREAK (CC_BLANK | CC_NEWLINE | CC_OPERATOR | CC_QUOTE | CC_ESCAPE | CC_DOLLAR)
+// any of these ends the word itself
+#define CC_DELIMITER (CC_BLANK | CC_NEWLINE | CC_OPERATOR)
+
+static const uint8_t char_class[256] = {
+    [' '] = CC_BLANK, ['\t'] = CC_BLANK,
+    ['\n'] = CC_NEWLINE,
+    ['|'] = CC_OPERATOR, ['&'] = CC_OPERATOR, [';'] = CC_OPERATOR,
+    ['<'] = CC_OPERATOR, ['>'] = CC_OPERATOR,
+    ['('] = CC_OPERATOR, [')'] = CC_OPERATOR,
+    ['\''] = CC_QUOTE, ['"'] = CC_QUOTE, ['`'] = CC_QUOTE,
+    ['\\'] = CC_ESCAPE,
+    ['$'] = CC_DOLLAR,
+    ['0'] = CC_DIGIT, ['1'] = CC_DIGIT, ['2'] = CC_DIGIT, ['3'] = CC_DIGIT, ['4'] = CC_DIGIT,
+    ['5'] = CC_DIGIT, ['6'] = CC_DIGIT, ['7'] = CC_DIGIT, ['8'] = CC_DIGIT, ['9'] = CC_DIGIT,
+    ['#'] = CC_COMMENT,
+};
+
+/*  Operators ordered so that the longest match for each
+    first character comes first (<<< before << before <) */
+typedef struct {
+    const char* text;
+    uint32_t length;
+    TokenTypeEnum type;
+} OperatorEntry;
+
+static const OperatorEntry operator_table[] = {
+    {"<<<", 3, TOKEN_TLESS},
+    {"<<-", 3, TOKEN_DLESSDASH},
+    {"<<",  2, TOKEN_DLESS},
+    {"<&",  2, TOKEN_LESSAND},
+    {"<>",  2, TOKEN_LESSGREAT},
+    {">>",  2, TOKEN_DGREAT},
+    {">&",  2, TOKEN_GREATAND},
+    {">|",  2, TOKEN_CLOBBER},
+    {"&&",  2, TOKEN_AND_IF},
+    {"||",  2, TOKEN_OR_IF},
+    {";;",  2, TOKEN_DOUBLE_SEMI},
+    {"<",   1, TOKEN_LESS},
+    {">",   1, TOKEN_GREAT},
+    {"&",   1, TOKEN_BG},
+    {"|",   1, TOKEN_PIPE},
+    {";",   1, TOKEN_SEMI},
+    {"(",   1, TOKEN_LPAREN},
+    {")",   1, TOKEN_RPAREN},
+};
+
+static const char* skip_dollar(const char* p, const char* end);
+static const char* skip_double_quote(const char* p, const char* end);
+
+
+/**
+ * @brief       Skips single quoted text
+ * @param p     first character after opening quote
+ * @return      pointer after closing quote, NULL if quote is not terminated
+ */
+static const char* skip_single_quote(const char* p, const char* end) {
+    const char* quote = memchr(p, '\'', end - p);
+    return (quote != NULL) ? quote + 1 : NULL;
+} // skip_single_quote
+
+
+/**
+ * @brief       Skips `command substitution`
+ * @param p     first character after opening backquote
+ * @return      pointer after closing backquote, NULL if not terminated
+ */
+static const char* skip_backquote(const char* p, const char* end) {
+    while(p < end) {
+        if(*p == '\\') {
+            p += 2;
+        }
+        else if(*p == '`') {
+            return p + 1;
+        }
+        else {
+            p++;
+        }
+    }
+    return NULL;
+} // skip_backquote
+
+
+/**
+ * @brief       Skips nested text up to matching close character
+ *
+ *              Used for $( ), $(( )) and ${ }, quotes and nested substitutions
+ *              inside are skipped as a whole so their contents can't close the group
+ *
+ * @param p     first character after the opening character
+ * @param open  opening character, increases depth
+ * @param close closing character
+ * @return      pointer after the matching close character, NULL if not terminated
+ */
+static const char* skip_group(const char* p, const char* end, char open, char close) {
+    uint32_t depth = 1;
+    while(p != NULL && p < end) {
+        char c = *p;
+        if(c == close) {
+            if(--depth == 0) {
+                return p + 1;
+            }
+            p++;
+        }
+        else if(c == open) {
+            depth++;
+            p++;
+        }
+        else if(c == '\'') {
+            p = skip_single_quote(p + 1, end);
+        }
+        else if(c == '"') {
+            p = skip_double_quote(p + 1, end);
+        }
+        else if(c == '`') {
+            p = skip_backquote(p + 1, end);
+        }
+        else if(c == '$') {
+            p = skip_dollar(p, end);
+        }
+        else if(c == '\\') {
+            p += 2;
+        }
+        else {
+            p++;
+        }
+    }
+    return NULL;
+} // skip_group
+
+
+/**
+ * @brief       Skips $ and the substitution it starts (if any)
+ * @param p     pointer to the $ character
+ * @return      pointer after the substitution, NULL if it's not terminated
+ */
+static const char* skip_dollar(const char* p, const char* end) {
+    p++;
+    if(p >= end) {
+        return p;
+    }
+    if(*p == '(') {
+        return skip_group(p + 1, end, '(', ')');
+    }
+    if(*p == '{') {
+        return skip_group(p + 1, end, '{', '}');
+    }
+    // plain $name, the name is scanned as ordinary word characters
+    return p;
+} // skip_dollar
+
+
+/**
+ * @brief       Skips double quoted text including nested substitutions
+ * @param p     first character after opening quote
+ * @return      pointer after closing quote, NULL if quote is not terminated
+ */
+static const char* skip_double_quote(const char* p, const char* end) {
+    while(p != NULL && p < end) {
+        switch(*p) {
+            case '"':
+                return p + 1;
+            case '\\':
+                p += 2;
+                break;
+            case '$':
+                p = skip_dollar(p, end);
+                break;
+            case '`':
+                p = skip_backquote(p + 1, end);
+                break;
+            default:
+                p++;
+                break;
+        }
+    }
+    return NULL;
+} // skip_double_quote
+
+
+/**
+ * @brief       Skips quoted text or substitution starting at p
+ *
+ *              Shares the lexer rules so expansion finds the same ends of
+ *              quotes, $( ), ${ } and backquotes as get_token() did
+ *
+ * @param p     pointer to ' " ` or $
+ * @param end   end of text
+ * @return      pointer after the quoted part, NULL if it's not terminated
+ */
+const char* lexer_skip_quoted(const char* p, const char* end) {
+    switch(*p) {
+        case '\'':
+            return skip_single_quote(p + 1, end);
+        case '"':
+            return skip_double_quote(p + 1, end);
+        case '`':
+            return skip_backquote(p + 1, end);
+        case '$':
+            return skip_dollar(p, end);
+        default:
+            return p + 1;
+    }
+} // lexer_skip_quoted
+
+
+/**
+ * @brief       Initializes lexer over a buffer
+ *
+ * @param lexer lexer which will be initialized
+ * @param input buffer with script text, it must outlive all returned tokens
+ * @param length length of input in bytes
+ * @return      SUCCESS, ERROR_DEFAULT on NULL, ERROR_INT_OVERFLOW if input
+ *              cannot be addressed by 32bit token offsets
+ */
+StatusEnum lexer_init(LexerPtr lexer, const char* input, size_t length) {
+    if(lexer == NULL || (input == NULL && length != 0)) {
+        return ERROR_DEFAULT;
+    }
+    // token offsets are 32bit
+    if(length > UINT32_MAX) {
+        return ERROR_INT_OVERFLOW;
+    }
+
+    lexer->input = input;
+    lexer->length = length;
+    lexer->position = 0;
+    lexer->refill = NULL;
+    lexer->refill_context = NULL;
+    return SUCCESS;
+} // lexer_init
+
+
+/**
+ * @brief       Lets lexer pull more input when it reaches end of buffer
+ *
+ * @param lexer lexer initialized by lexer_init()
+ * @param refill callback appending more data to the buffer
+ * @param context passed to refill
+ */
+void lexer_set_refill(LexerPtr lexer, LexerRefill refill, void* context) {
+    lexer->refill = refill;
+    lexer->refill_context = context;
+} // lexer_set_refill
+
+
+/**
+ * @brief       Scans one token from what is currently in the buffer
+ *
+ * @param lexer lexer from which token is read
+ * @param token output token
+ * @return      SUCCESS or ERROR_SHELL_MISUSE on unterminated quote
+ */
+static StatusEnum lexer_scan(LexerPtr lexer, TokenPtr token) {
+    const char* start = lexer->input + lexer->position;
+    const char* end = lexer->input + lexer->length;
+    const char* p = start;
+    FSMStates state = LEX_STATE_START;
+
+    token->type = TOKEN_WORD;
+    token->flags = 0;
+
+    while(state != LEX_STATE_DONE) {
+        switch(state) {
+            case LEX_STATE_START: {
+                // skip blanks and line continuations
+                while(p < end) {
+                    if(char_class[(uint8_t)*p] & CC_BLANK) {
+                        p++;
+                    }
+                    else if(*p == '\\' && p + 1 < end && p[1] == '\n') {
+                        p += 2;
+                    }
+                    else {
+                        break;
+                    }
+                }
+                start = p;
+
+                if(p >= end) {
+                    token->type = TOKEN_EOF;
+                    state = LEX_STATE_DONE;
+                    break;
+                }
+
+                uint8_t class = char_class[(uint8_t)*p];
+                if(class & CC_NEWLINE) {
+                    token->type = TOKEN_NEWLINE;
+                    p++;
+                    state = LEX_STATE_DONE;
+                }
+                else if(class & CC_COMMENT) {
+                    state = LEX_STATE_COMMENT;
+                }
+                else if(class & CC_OPERATOR) {
+                    state = LEX_STATE_OPERATOR;
+                }
+                else if(class & CC_DIGIT) {
+                    state = LEX_STATE_IO_NUM;
+                }
+                else {
+                    state = LEX_STATE_WORD;
+                }
+                break;
+            }
+
+            case LEX_STATE_COMMENT: {
+                // newline itself is not part of comment
+                const char* newline = memchr(p, '\n', end - p);
+                p = (newline != NULL) ? newline : end;
+                state = LEX_STATE_START;
+                break;
+            }
+
+            case LEX_STATE_OPERATOR: {
+                uint32_t count = sizeof(operator_table) / sizeof(operator_table[0]);
+                for(uint32_t i = 0; i < count; i++) {
+                    const OperatorEntry* op = &operator_table[i];
+                    if((size_t)(end - p) >= op->length && memcmp(p, op->text, op->length) == 0) {
+                        token->type = op->type;
+                        p += op->length;
+                        break;
+                    }
+                }
+                state = LEX_STATE_DONE;
+                break;
+            }
+
+            case LEX_STATE_IO_NUM: {
+                while(p < end && (char_class[(uint8_t)*p] & CC_DIGIT)) {
+                    p++;
+                }
+                // digits directly followed by redirector are IO_NUMBER (2>file)
+                if(p < end && (*p == '<' || *p == '>')) {
+                    token->type = TOKEN_IO_NUM;
+                    state = LEX_STATE_DONE;
+                }
+                else {
+                    state = LEX_STATE_WORD;
+                }
+                break;
+            }
+
+            case LEX_STATE_WORD: {
+                // fast path, run of characters with no special meaning
+                while(p < end && !(char_class[(uint8_t)*p] & CC_WORD_BREAK)) {
+                    p++;
+                }
+                if(p >= end) {
+                    state = LEX_STATE_DONE;
+                    break;
+                }
+
+                uint8_t class = char_class[(uint8_t)*p];
+                if(class & CC_DELIMITER) {
+                    state = LEX_STATE_DONE;
+                }
+                else if(class & CC_ESCAPE) {
+                    token->flags |= TOKEN_FLAG_QUOTED;
+                    p++;
+                    state = LEX_STATE_ESCAPE;
+                }
+                else if(*p == '\'') {
+                    token->flags |= TOKEN_FLAG_QUOTED;
+                    p++;
+                    state = LEX_STATE_SINGLE_QUOTE;
+                }
+                else if(*p == '"') {
+                    token->flags |= TOKEN_FLAG_QUOTED;
+                    p++;
+                    state = LEX_STATE_DOUBLE_QUOTE;
+                }
+                else if(*p == '`') {
+                    token->flags |= TOKEN_FLAG_EXPAND;
+                    p = skip_backquote(p + 1, end);
+                }
+                else { // $
+                    const char* dollar = p;
+                    token->flags |= TOKEN_FLAG_EXPAND;
+                    p = skip_dollar(p, end);
+                    if(p != NULL && p - dollar > 2 && memmem(dollar, p - dollar, "$((", 3) != NULL) {
+                        token->flags |= TOKEN_FLAG_ARITH;
+                    }
+                }
+
+                if(p == NULL) {
+                    p = end;
+                    token->type = TOKEN_ERROR;
+                    state = LEX_STATE_DONE;
+                }
+                break;
+            }
+
+            case LEX_STATE_ESCAPE:
+                // backslash at the very end of input is kept literally
+                if(p < end) {
+                    p++;
+                }
+                state = LEX_STATE_WORD;
+                break;
+
+            case LEX_STATE_SINGLE_QUOTE:
+                p = skip_single_quote(p, end);
+                state = LEX_STATE_WORD;
+                if(p == NULL) {
+                    p = end;
+                    token->type = TOKEN_ERROR;
+                    state = LEX_STATE_DONE;
+                }
+                break;
+
+            case LEX_STATE_DOUBLE_QUOTE: {
+                const char* quote_start = p;
+                p = skip_double_quote(p, end);
+                state = LEX_STATE_WORD;
+                if(p == NULL) {
+                    p = end;
+                    token->type = TOKEN_ERROR;
+                    state = LEX_STATE_DONE;
+                }
+                else if(memchr(quote_start, '$', p - quote_start) != NULL ||
+                        memchr(quote_start, '`', p - quote_start) != NULL) {
+                    token->flags |= TOKEN_FLAG_EXPAND;
+                    if(memmem(quote_start, p - quote_start, "$((", 3) != NULL) {
+                        token->flags |= TOKEN_FLAG_ARITH;
+                    }
+                }
+                break;
+            }
+
+            case LEX_STATE_DONE:
+                break;
+        } // switch
+    } // while
+
+    // skip_* helpers may step over the end on a trailing backslash
+    if(p > end) {
+        p = end;
+    }
+
+    token->offset = (uint32_t)(start - lexer->input);
+    token->length = (uint32_t)(p - start);
+    lexer->position = (size_t)(p - lexer->input);
+
+    return (token->type == TOKEN_ERROR) ? ERROR_SHELL_MISUSE : SUCCESS;
+} // lexer_scan
+
+
+/**
+ * @brief       Reads next token from input
+ *
+ *              Table driven state machine, the token is returned as offset and length
+ *              into lexer->input. Words keep their quotes, TOKEN_FLAG_QUOTED tells
+ *              that token_unquote() is needed to get the literal value. Token which
+ *              touches the end of buffer is rescanned after refill as it may continue
+ *
+ * @param lexer lexer from which token is read
+ * @param token output token
+ * @return      SUCCESS or ERROR_SHELL_MISUSE on unterminated quote (token type TOKEN_ERROR)
+ */
+StatusEnum get_token(LexerPtr lexer, TokenPtr token) {
+    if(lexer == NULL || token == NULL) {
+        return ERROR_DEFAULT;
+    }
+
+    size_t token_start = lexer->position;
+    while(1) {
+        StatusEnum scan_status = lexer_scan(lexer, token);
+
+        if(lexer->refill == NULL || lexer->position < lexer->length || token->type == TOKEN_NEWLINE) {
+            return scan_status;
+        }
+
+        size_t old_length = lexer->length;
+        StatusEnum st = lexer->refill(lexer->refill_context, &lexer->input, &lexer->length);
+        ERR_CHECK(st);
+
+        // end of input, token is final
+        if(lexer->length == old_length) {
+            lexer->refill = NULL;
+            return scan_status;
+        }
+        lexer->position = token_start;
+    }
+} // get_token
+
+
+/**
+ * @brief       Reads one raw line of input, used for here-document bodies
+ *
+ *              The line is not tokenized, it is returned as a TOKEN_WORD slice
+ *              without the newline and the lexer continues after it. Input is
+ *              refilled until the line is complete or input ends
+ *
+ * @param lexer lexer positioned at the start of a line
+ * @param line  output slice, TOKEN_EOF when no input is left
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE from refill
+ */
+StatusEnum lexer_read_line(LexerPtr lexer, TokenPtr line) {
+    size_t start = lexer->position;
+    size_t scanned = start;
     while(1) {
-        switch(STATE) {
+        const char* newline = memchr(lexer->input + scanned, '\n', lexer->length - scanned);
+        if(newline != NULL) {
+            line->length = (uint32_t)(newline - (lexer->input + start));
+            lexer->position = start + line->length + 1;
+            break;
+        }
+        scanned = lexer->length;
 
+        size_t old_length = lexer->length;
+        if(lexer->refill != NULL) {
+            StatusEnum st = lexer->refill(lexer->refill_context, &lexer->input, &lexer->length);
+            ERR_CHECK(st);
+        }
+        if(lexer->length == old_length) {
+            // last line without newline
+            lexer->refill = NULL;
+            line->length = (uint32_t)(lexer->length - start);
+            lexer->position = lexer->length;
+            break;
         }
     }
-    return token;
-}
\ No newline at end of file
+
+    line->type = (lexer->position == start) ? TOKEN_EOF : TOKEN_WORD;
+    line->offset = (uint32_t)start;
+    line->flags = 0;
+    return SUCCESS;
+} // lexer_read_line
+
+
+/**
+ * @brief       Removes quotes and escapes from a word
+ *
+ *              Copies word into dest while dropping quote characters and escaping
+ *              backslashes, no expansion is performed. Only words flagged with
+ *              TOKEN_FLAG_QUOTED need this, others can be used directly as a slice
+ *
+ * @param src   start of the raw word
+ * @param length length of raw word
+ * @param dest  buffer with space for at least length + 1 bytes, result is NUL terminated
+ * @return      length of unquoted word
+ */
+uint32_t token_unquote(const char* src, uint32_t length, char* dest) {
+    const char* end = src + length;
+    char* out = dest;
+
+    while(src < end) {
+        char c = *src++;
+        if(c == '\\') {
+            if(src >= end) {
+                *out++ = c;
+            }
+            else if(*src == '\n') { // line continuation
+                src++;
+            }
+            else {
+                *out++ = *src++;
+            }
+        }
+        else if(c == '\'') {
+            while(src < end && *src != '\'') {
+                *out++ = *src++;
+            }
+            src++;
+        }
+        else if(c == '"') {
+            while(src < end && *src != '"') {
+                // inside double quotes backslash only escapes $ ` " \ and newline
+                if(*src == '\\' && src + 1 < end && memchr("$`\"\\\n", src[1], 5) != NULL) {
+                    src++;
+                    if(*src == '\n') {
+                        src++;
+                        continue;
+                    }
+                }
+                *out++ = *src++;
+            }
+            src++;
+        }
+        else {
+            *out++ = c;
+        }
+    }
+
+    *out = '\0';
+    return (uint32_t)(out - dest);
+} // token_unquote
+
+
+/**
+ * @brief       Returns NUL terminated literal value of token allocated from arena
+ *
+ *              Plain words are copied as they are, quoted words go through
+ *              token_unquote(), the value lives until the arena is reset
+ *
+ * @param lexer lexer which produced the token
+ * @param token token whose value is wanted
+ * @param arena per command arena
+ * @return      value of token, NULL on malloc failure
+ */
+char* token_value(const LexerPtr lexer, const TokenPtr token, ArenaPtr arena) {
+    const char* text = lexer->input + token->offset;
+    if(!(token->flags & TOKEN_FLAG_QUOTED)) {
+        return arenaStrndup(arena, text, token->length);
+    }
+
+    char* value = (char*) arenaAlloc(arena, (size_t)token->length + 1);
+    if(value == NULL) {
+        return NULL;
+    }
+    token_unquote(text, token->length, value);
+    return value;
+} // token_value
@@ -1,7 +1,23 @@
+#ifndef LEXER_H
+#define LEXER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
 #include "../utils/error.h"
+#include "../data_structures/arena.h"
 
+// states of the get_token() finite state machine
 typedef enum {
-
+    LEX_STATE_START,        // skipping blanks, deciding what the next token is
+    LEX_STATE_WORD,         // inside unquoted part of a word
+    LEX_STATE_IO_NUM,       // digits which may turn out to be an IO_NUMBER
+    LEX_STATE_SINGLE_QUOTE, // inside '...'
+    LEX_STATE_DOUBLE_QUOTE, // inside "..."
+    LEX_STATE_ESCAPE,       // character after an unquoted backslash
+    LEX_STATE_OPERATOR,     // control operator or redirector
+    LEX_STATE_COMMENT,      // from # to the end of line
+    LEX_STATE_DONE          // token is complete
 } FSMStates;
 
 
@@ -35,13 +51,141 @@ typedef enum {
     TOKEN_LESSGREAT,    // <>
     TOKEN_DLESSDASH,    // <<-
     TOKEN_TLESS,        // <<<
-    
+
     // special
     TOKEN_ERROR,
-}TokenTypeEnum; 
+}TokenTypeEnum;
 
+// token flags, tell later stages whether the raw slice can be used as is
+#define TOKEN_FLAG_QUOTED   0x01U   // word contains ' " or \ and needs quote removal
+#define TOKEN_FLAG_EXPAND   0x02U   // word contains $ or ` and needs expansion
+#define TOKEN_FLAG_ARITH    0x04U   // word may contain $(( )), its expressions are compiled
+
+/*  Token is a slice of the lexer input buffer, the text of the token
+    is input[offset .. offset + length), nothing is copied while lexing */
 typedef struct token {
     TokenTypeEnum type;
-    char* value;
+    uint32_t offset;
+    uint32_t length;
+    uint32_t flags;
+} Token, *TokenPtr;
+
+
+/*  Called when a token reaches the end of buffer and more input may follow,
+    it may move the buffer (tokens are offsets so they stay valid),
+    length is left unchanged when there is no more input */
+typedef StatusEnum (*LexerRefill)(void* context, const char** input, size_t* length);
+
+typedef struct lexer {
+    const char* input;      // buffer with the whole input (not owned)
+    size_t length;          // length of input
+    size_t position;        // offset of next unread character
+    LexerRefill refill;     // NULL when whole input is already in buffer
+    void* refill_context;
+} Lexer, *LexerPtr;
+
+
+/**
+ * @brief       Initializes lexer over a buffer
+ *
+ * @param lexer lexer which will be initialized
+ * @param input buffer with script text, it must outlive all returned tokens
+ * @param length length of input in bytes
+ * @return      SUCCESS, ERROR_DEFAULT on NULL, ERROR_INT_OVERFLOW if input
+ *              cannot be addressed by 32bit token offsets
+ */
+StatusEnum lexer_init(LexerPtr lexer, const char* input, size_t length);
+
+/**
+ * @brief       Lets lexer pull more input when it reaches end of buffer
+ *
+ * @param lexer lexer initialized by lexer_init()
+ * @param refill callback appending more data to the buffer
+ * @param context passed to refill
+ */
+void lexer_set_refill(LexerPtr lexer, LexerRefill refill, void* context);
+
+/**
+ * @brief       Reads next token from input
+ *
+ *              Table driven state machine, the token is returned as offset and length
+ *              into lexer->input. Words keep their quotes, TOKEN_FLAG_QUOTED tells
+ *              that token_unquote() is needed to get the literal value. Token which
+ *              touches the end of buffer is rescanned after refill as it may continue
+ *
+ * @param lexer lexer from which token is read
+ * @param token output token
+ * @return      SUCCESS or ERROR_SHELL_MISUSE on unterminated quote (token type TOKEN_ERROR)
+ */
+StatusEnum get_token(LexerPtr lexer, TokenPtr token);
+
+/**
+ * @brief       Reads one raw line of input, used for here-document bodies
+ *
+ *              The line is not tokenized, it is returned as a TOKEN_WORD slice
+ *              without the newline and the lexer continues after it. Input is
+ *              refilled until the line is complete or input ends
+ *
+ * @param lexer lexer positioned at the start of a line
+ * @param line  output slice, TOKEN_EOF when no input is left
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE from refill
+ */
+StatusEnum lexer_read_line(LexerPtr lexer, TokenPtr line);
+
+/**
+ * @brief       Skips quoted text or substitution starting at p
+ *
+ *              Shares the lexer rules so expansion finds the same ends of
+ *              quotes, $( ), ${ } and backquotes as get_token() did
+ *
+ * @param p     pointer to ' " ` or $
+ * @param end   end of text
+ * @return      pointer after the quoted part, NULL if it's not terminated
+ */
+const char* lexer_skip_quoted(const char* p, const char* end);
+
+/**
+ * @brief       Returns pointer to the first character of token inside the input buffer
+ */
+static inline const char* token_text(const LexerPtr lexer, const TokenPtr token) {
+    return lexer->input + token->offset;
+}
+
+/**
+ * @brief       Compares token text with NUL terminated string without copying
+ * @return      1 if equal, 0 otherwise
+ */
+static inline uint8_t token_equals(const LexerPtr lexer, const TokenPtr token, const char* str) {
+    size_t str_length = strlen(str);
+    return (str_length == token->length &&
+            memcmp(lexer->input + token->offset, str, str_length) == 0) ? 1U : 0U;
+}
+
+/**
+ * @brief       Removes quotes and escapes from a word
+ *
+ *              Copies word into dest while dropping quote characters and escaping
+ *              backslashes, no expansion is performed. Only words flagged with
+ *              TOKEN_FLAG_QUOTED need this, others can be used directly as a slice
+ *
+ * @param src   start of the raw word
+ * @param length length of raw word
+ * @param dest  buffer with space for at least length + 1 bytes, result is NUL terminated
+ * @return      length of unquoted word
+ */
+uint32_t token_unquote(const char* src, uint32_t length, char* dest);
+
+/**
+ * @brief       Returns NUL terminated literal value of token allocated from arena
+ *
+ *              Plain words are copied as they are, quoted words go through
+ *              token_unquote(), the value lives until the arena is reset
+ *
+ * @param lexer lexer which produced the token
+ * @param token token whose value is wanted
+ * @param arena per command arena
+ * @return      value of token, NULL on malloc failure
+ */
+char* token_value(const LexerPtr lexer, const TokenPtr token, ArenaPtr arena);
 
-} Token, TokenPtr;
\ No newline at end of file
+#endif
@@ -0,0 +1,857 @@
+/**
+ * Compiler of arithmetic expressions
+ *
+ * A Pratt parser turns the text of $(( )) into postfix code for a value
+ * stack. Words compile their expansions once when they are parsed, so a
+ * loop evaluating i=$((i+1)) never looks at the text again
+ */
+
+#define _GNU_SOURCE
+#include <string.h>
+#include <stdlib.h>
+#include "arith.h"
+#include "../lexer/lexer.h"
+
+// first capacity of the code buffer
+#define ARITH_MIN_CAPACITY 16U
+
+// binding powers, higher binds tighter
+#define BP_COMMA        1U
+#define BP_ASSIGN       2U
+#define BP_CONDITIONAL  3U
+#define BP_OR           4U
+#define BP_AND          5U
+#define BP_BITOR        6U
+#define BP_BITXOR       7U
+#define BP_BITAND       8U
+#define BP_EQUALITY     9U
+#define BP_RELATION     10U
+#define BP_SHIFT        11U
+#define BP_ADDITIVE     12U
+#define BP_MULTIPLY     13U
+#define BP_POWER        14U
+#define BP_UNARY        15U
+
+// tokens of expressions
+typedef enum {
+    TK_END,
+    TK_NUMBER,
+    TK_NAME,
+    TK_PARAM,           // $name ${name} $1
+    TK_LPAREN,
+    TK_RPAREN,
+    TK_QUESTION,
+    TK_COLON,
+    TK_COMMA,
+    TK_INC,
+    TK_DEC,
+    TK_BANG,
+    TK_TILDE,
+    TK_ASSIGN,          // = and op=, op holds the operator
+    TK_AND,
+    TK_OR,
+    TK_BINARY,          // op holds the operator, also + and - which may be unary
+} ArithTokenEnum;
+
+
+//
+typedef struct operator {
+    const char* text;
+    uint32_t token;
+    uint32_t op;
+} Operator;
+
+// longest operators first so << is not read as <
+static const Operator operators[] = {
+    {"<<=", TK_ASSIGN, ARITH_SHL}, {">>=", TK_ASSIGN, ARITH_SHR},
+    {"**", TK_BINARY, ARITH_POW}, {"<<", TK_BINARY, ARITH_SHL}, {">>", TK_BINARY, ARITH_SHR},
+    {"<=", TK_BINARY, ARITH_LE}, {">=", TK_BINARY, ARITH_GE}, {"==", TK_BINARY, ARITH_EQ},
+    {"!=", TK_BINARY, ARITH_NE}, {"&&", TK_AND, ARITH_AND}, {"||", TK_OR, ARITH_OR},
+    {"*=", TK_ASSIGN, ARITH_MUL}, {"/=", TK_ASSIGN, ARITH_DIV}, {"%=", TK_ASSIGN, ARITH_MOD},
+    {"+=", TK_ASSIGN, ARITH_ADD}, {"-=", TK_ASSIGN, ARITH_SUB}, {"&=", TK_ASSIGN, ARITH_BITAND},
+    {"^=", TK_ASSIGN, ARITH_BITXOR}, {"|=", TK_ASSIGN, ARITH_BITOR},
+    {"*", TK_BINARY, ARITH_MUL}, {"/", TK_BINARY, ARITH_DIV}, {"%", TK_BINARY, ARITH_MOD},
+    {"+", TK_BINARY, ARITH_ADD}, {"-", TK_BINARY, ARITH_SUB}, {"<", TK_BINARY, ARITH_LT},
+    {">", TK_BINARY, ARITH_GT}, {"&", TK_BINARY, ARITH_BITAND}, {"^", TK_BINARY, ARITH_BITXOR},
+    {"|", TK_BINARY, ARITH_BITOR}, {"=", TK_ASSIGN, ARITH_OP_COUNT}, {"!", TK_BANG, ARITH_NOT},
+    {"~", TK_TILDE, ARITH_BITNOT}, {"(", TK_LPAREN, 0}, {")", TK_RPAREN, 0},
+    {"?", TK_QUESTION, 0}, {":", TK_COLON, 0}, {",", TK_COMMA, 0},
+};
+
+
+// result of compiling a subexpression
+typedef struct operand {
+    uint32_t start;             // first instruction of its code
+    uint8_t constant;           // code is a single ARITH_PUSH
+    int64_t value;
+} Operand;
+
+
+//
+typedef struct arith_compiler {
+    const char* text;
+    const char* p;
+    const char* end;
+    ArenaPtr arena;
+    ArithInstructionPtr code;   // malloc'd while compiling
+    uint32_t length;
+    uint32_t capacity;
+    uint32_t depth;             // values on the stack after the code so far
+    uint32_t nesting;
+    uint32_t param_count;
+    StatusEnum status;          // first error
+    // current token
+    uint32_t token;
+    uint32_t op;
+    int64_t number;
+    const char* name;
+    size_t name_length;
+    uint8_t after_name;         // previous token was a name, ++ and -- are postfix
+} ArithCompiler, *ArithCompilerPtr;
+
+
+/**
+ * @brief       Character may continue a name
+ */
+static inline uint8_t is_name_char(char c) {
+    return (c == '_' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')) ? 1U : 0U;
+} // is_name_char
+
+
+/**
+ * @brief       Parses number constant the way the compiler does
+ *
+ * @param p     first character
+ * @param end   end of text
+ * @param value output value, wraps around on overflow
+ * @return      pointer after the number, NULL if p does not start a valid number
+ */
+const char* arith_parse_number(const char* p, const char* end, int64_t* value) {
+    if(p >= end || *p < '0' || *p > '9') {
+        return NULL;
+    }
+
+    uint64_t base = 10;
+    if(*p == '0' && p + 1 < end && (p[1] == 'x' || p[1] == 'X')) {
+        base = 16;
+        p += 2;
+    }
+    else if(*p == '0') {
+        base = 8;
+    }
+    else {
+        // base#digits
+        const char* q = p;
+        uint64_t prefix = 0;
+        while(q < end && *q >= '0' && *q <= '9' && prefix <= 64) {
+            prefix = prefix * 10 + (uint64_t)(*q - '0');
+            q++;
+        }
+        if(q < end && *q == '#') {
+            if(prefix < 2 || prefix > 36) {
+                return NULL;
+            }
+            base = prefix;
+            p = q + 1;
+        }
+    }
+
+    const char* start = p;
+    uint64_t result = 0;
+    while(p < end && is_name_char(*p)) {
+        uint64_t digit;
+        if(*p >= '0' && *p <= '9') {
+            digit = (uint64_t)(*p - '0');
+        }
+        else if(*p >= 'a' && *p <= 'z') {
+            digit = (uint64_t)(*p - 'a') + 10;
+        }
+        else if(*p >= 'A' && *p <= 'Z') {
+            digit = (uint64_t)(*p - 'A') + 10;
+        }
+        else {
+            return NULL;
+        }
+        if(digit >= base) {
+            return NULL;
+        }
+        result = result * base + digit;
+        p++;
+    }
+    if(p == start) {
+        return NULL;
+    }
+    *value = (int64_t)result;
+    return p;
+} // arith_parse_number
+
+
+/**
+ * @brief       Records first error, later ones are consequences of it
+ */
+static void compile_error(ArithCompilerPtr c, StatusEnum status) {
+    if(c->status == SUCCESS) {
+        c->status = status;
+    }
+    c->token = TK_END;
+} // compile_error
+
+
+/**
+ * @brief       Reads next token
+ */
+static void next_token(ArithCompilerPtr c) {
+    uint8_t after_name = (c->token == TK_NAME) ? 1U : 0U;
+    if(c->status != SUCCESS) {
+        c->token = TK_END;
+        return;
+    }
+    while(c->p < c->end && (*c->p == ' ' || *c->p == '\t' || *c->p == '\n')) {
+        c->p++;
+    }
+    c->after_name = after_name;
+    if(c->p >= c->end) {
+        c->token = TK_END;
+        return;
+    }
+
+    char first = *c->p;
+    if(first >= '0' && first <= '9') {
+        const char* stop = arith_parse_number(c->p, c->end, &c->number);
+        if(stop == NULL) {
+            compile_error(c, ERROR_SHELL_MISUSE);
+            return;
+        }
+        c->p = stop;
+        c->token = TK_NUMBER;
+        return;
+    }
+    if(is_name_char(first)) {
+        c->name = c->p;
+        while(c->p < c->end && is_name_char(*c->p)) {
+            c->p++;
+        }
+        c->name_length = (size_t)(c->p - c->name);
+        c->token = TK_NAME;
+        return;
+    }
+
+    if(first == '$') {
+        // $name, ${name} and $1 are looked up at run time, anything else needs expansion first
+        if(c->p > c->text && is_name_char(c->p[-1])) {
+            compile_error(c, ERROR_DEFAULT);
+            return;
+        }
+        const char* q = c->p + 1;
+        uint8_t braced = (q < c->end && *q == '{') ? 1U : 0U;
+        q += braced;
+        const char* name = q;
+        if(q < c->end && *q >= '0' && *q <= '9') {
+            q++;
+            while(braced && q < c->end && *q >= '0' && *q <= '9') {
+                q++;
+            }
+        }
+        else if(q < c->end && is_name_char(*q)) {
+            while(q < c->end && is_name_char(*q)) {
+                q++;
+            }
+        }
+        size_t length = (size_t)(q - name);
+        if(length == 0 || (braced && (q >= c->end || *q != '}'))) {
+            compile_error(c, ERROR_DEFAULT);
+            return;
+        }
+        q += braced;
+        // text pasted next to a name or number would become part of it
+        if(q < c->end && (is_name_char(*q) || *q == '$')) {
+            compile_error(c, ERROR_DEFAULT);
+            return;
+        }
+        c->name = name;
+        c->name_length = length;
+        c->p = q;
+        c->token = TK_PARAM;
+        return;
+    }
+    if(first == '\'' || first == '"' || first == '`' || first == '\\') {
+        compile_error(c, ERROR_DEFAULT);
+        return;
+    }
+
+    // ++ and -- only next to a name, 5--1 is 5 - -1
+    if((first == '+' || first == '-') && c->p + 1 < c->end && c->p[1] == first) {
+        const char* q = c->p + 2;
+        while(q < c->end && (*q == ' ' || *q == '\t' || *q == '\n')) {
+            q++;
+        }
+        if(after_name || (q < c->end && is_name_char(*q) && !(*q >= '0' && *q <= '9'))) {
+            c->p += 2;
+            c->token = (first == '+') ? TK_INC : TK_DEC;
+            return;
+        }
+    }
+
+    for(size_t i = 0; i < sizeof(operators) / sizeof(operators[0]); i++) {
+        size_t length = strlen(operators[i].text);
+        if((size_t)(c->end - c->p) >= length && memcmp(c->p, operators[i].text, length) == 0) {
+            c->p += length;
+            c->token = operators[i].token;
+            c->op = operators[i].op;
+            return;
+        }
+    }
+    compile_error(c, ERROR_SHELL_MISUSE);
+} // next_token
+
+
+/**
+ * @brief       Appends instruction and keeps track of the stack depth
+ *
+ * @param effect change of the number of values on the stack
+ * @return      index of the instruction
+ */
+static uint32_t emit(ArithCompilerPtr c, uint32_t op, int64_t value, char* name, int32_t effect) {
+    if(c->status != SUCCESS) {
+        return 0;
+    }
+    if(c->length == c->capacity) {
+        uint32_t capacity = (c->capacity == 0) ? ARITH_MIN_CAPACITY : c->capacity * 2;
+        ArithInstructionPtr code = (ArithInstructionPtr) realloc(c->code, sizeof(ArithInstruction) * capacity);
+        if(code == NULL) {
+            compile_error(c, ERROR_MALLOC_FAILURE);
+            return 0;
+        }
+        c->code = code;
+        c->capacity = capacity;
+    }
+    c->depth = (uint32_t)((int32_t)c->depth + effect);
+    if(c->depth > ARITH_STACK_SIZE) {
+        compile_error(c, ERROR_SHELL_MISUSE);
+        return 0;
+    }
+    ArithInstructionPtr instruction = &c->code[c->length];
+    instruction->op = op;
+    instruction->arg = 0;
+    instruction->value = value;
+    instruction->name = name;
+    return c->length++;
+} // emit
+
+
+/**
+ * @brief       Copies current name token into the arena
+ */
+static char* token_name(ArithCompilerPtr c) {
+    char* name = arenaStrndup(c->arena, c->name, c->name_length);
+    if(name == NULL) {
+        compile_error(c, ERROR_MALLOC_FAILURE);
+    }
+    return name;
+} // token_name
+
+
+/**
+ * @brief       Replaces code of an operand by a push of its folded value
+ */
+static Operand fold(ArithCompilerPtr c, uint32_t start, int64_t value) {
+    c->length = start;
+    emit(c, ARITH_PUSH, value, NULL, 0);
+    Operand result = {start, 1U, value};
+    return result;
+} // fold
+
+
+/**
+ * @brief       Applies binary operator, shared by folding and evaluation
+ *
+ * @param op    ARITH_POW ... ARITH_BITOR
+ * @param left  left operand
+ * @param right right operand
+ * @param result output value
+ * @return      1 on success, 0 on division by zero or negative exponent
+ */
+uint8_t arith_apply(uint32_t op, int64_t left, int64_t right, int64_t* result) {
+    uint64_t a = (uint64_t)left;
+    uint64_t b = (uint64_t)right;
+    switch(op) {
+        case ARITH_POW: {
+            if(right < 0) {
+                return 0U;
+            }
+            uint64_t power = 1;
+            while(b > 0) {
+                if(b & 1U) {
+                    power *= a;
+                }
+                a *= a;
+                b >>= 1;
+            }
+            *result = (int64_t)power;
+            return 1U;
+        }
+        case ARITH_MUL:     *result = (int64_t)(a * b); return 1U;
+        case ARITH_DIV:
+        case ARITH_MOD:
+            if(right == 0) {
+                return 0U;
+            }
+            // INT64_MIN / -1 does not fit, it wraps like the other operators
+            if(right == -1) {
+                *result = (op == ARITH_DIV) ? (int64_t)(0 - a) : 0;
+                return 1U;
+            }
+            *result = (op == ARITH_DIV) ? left / right : left % right;
+            return 1U;
+        case ARITH_ADD:     *result = (int64_t)(a + b); return 1U;
+        case ARITH_SUB:     *result = (int64_t)(a - b); return 1U;
+        case ARITH_SHL:     *result = (int64_t)(a << (b & 63U)); return 1U;
+        case ARITH_SHR:     *result = left >> (b & 63U); return 1U;
+        case ARITH_LT:      *result = left < right; return 1U;
+        case ARITH_LE:      *result = left <= right; return 1U;
+        case ARITH_GT:      *result = left > right; return 1U;
+        case ARITH_GE:      *result = left >= right; return 1U;
+        case ARITH_EQ:      *result = left == right; return 1U;
+        case ARITH_NE:      *result = left != right; return 1U;
+        case ARITH_BITAND:  *result = (int64_t)(a & b); return 1U;
+        case ARITH_BITXOR:  *result = (int64_t)(a ^ b); return 1U;
+        case ARITH_BITOR:   *result = (int64_t)(a | b); return 1U;
+        default:
+            return 0U;
+    }
+} // arith_apply
+
+
+/**
+ * @brief       Left binding power of current token, 0 ends the expression
+ */
+static uint32_t binding_power(ArithCompilerPtr c) {
+    switch(c->token) {
+        case TK_COMMA:      return BP_COMMA;
+        case TK_QUESTION:   return BP_CONDITIONAL;
+        case TK_OR:         return BP_OR;
+        case TK_AND:        return BP_AND;
+        case TK_BINARY:
+            switch(c->op) {
+                case ARITH_BITOR:   return BP_BITOR;
+                case ARITH_BITXOR:  return BP_BITXOR;
+                case ARITH_BITAND:  return BP_BITAND;
+                case ARITH_EQ:
+                case ARITH_NE:      return BP_EQUALITY;
+                case ARITH_LT:
+                case ARITH_LE:
+                case ARITH_GT:
+                case ARITH_GE:      return BP_RELATION;
+                case ARITH_SHL:
+                case ARITH_SHR:     return BP_SHIFT;
+                case ARITH_ADD:
+                case ARITH_SUB:     return BP_ADDITIVE;
+                case ARITH_POW:     return BP_POWER;
+                default:            return BP_MULTIPLY;
+            }
+        default:
+            return 0U;
+    }
+} // binding_power
+
+
+static Operand parse_expression(ArithCompilerPtr c, uint32_t min_bp);
+
+
+/**
+ * @brief       Compiles operand with its prefix operators
+ */
+static Operand parse_prefix(ArithCompilerPtr c) {
+    Operand result = {c->length, 0U, 0};
+    uint32_t token = c->token;
+    uint32_t op = c->op;
+
+    switch(token) {
+        case TK_NUMBER:
+            emit(c, ARITH_PUSH, c->number, NULL, 1);
+            result.constant = 1U;
+            result.value = c->number;
+            next_token(c);
+            return result;
+
+        case TK_PARAM: {
+            char* name = token_name(c);
+            uint32_t param = emit(c, ARITH_PARAM, 0, name, 1);
+            if(c->status == SUCCESS) {
+                c->code[param].arg = c->param_count++;
+            }
+            next_token(c);
+            return result;
+        }
+
+        case TK_NAME: {
+            char* name = token_name(c);
+            next_token(c);
+            if(c->token == TK_INC || c->token == TK_DEC) {
+                // old value stays below the stored one
+                uint32_t step = (c->token == TK_INC) ? ARITH_ADD : ARITH_SUB;
+                emit(c, ARITH_LOAD, 0, name, 1);
+                emit(c, ARITH_DUP, 0, NULL, 1);
+                emit(c, ARITH_PUSH, 1, NULL, 1);
+                emit(c, step, 0, NULL, -1);
+                emit(c, ARITH_STORE, 0, name, 0);
+                emit(c, ARITH_POP, 0, NULL, -1);
+                next_token(c);
+                return result;
+            }
+            if(c->token == TK_ASSIGN) {
+                uint32_t assign = c->op;
+                next_token(c);
+                if(assign != ARITH_OP_COUNT) {
+                    emit(c, ARITH_LOAD, 0, name, 1);
+                }
+                parse_expression(c, BP_ASSIGN - 1);
+                if(assign != ARITH_OP_COUNT) {
+                    emit(c, assign, 0, NULL, -1);
+                }
+                emit(c, ARITH_STORE, 0, name, 0);
+                return result;
+            }
+            emit(c, ARITH_LOAD, 0, name, 1);
+            return result;
+        }
+
+        case TK_INC:
+        case TK_DEC: {
+            next_token(c);
+            if(c->token != TK_NAME) {
+                compile_error(c, ERROR_SHELL_MISUSE);
+                return result;
+            }
+            char* name = token_name(c);
+            emit(c, ARITH_LOAD, 0, name, 1);
+            emit(c, ARITH_PUSH, 1, NULL, 1);
+            emit(c, (token == TK_INC) ? ARITH_ADD : ARITH_SUB, 0, NULL, -1);
+            emit(c, ARITH_STORE, 0, name, 0);
+            next_token(c);
+            return result;
+        }
+
+        case TK_LPAREN:
+            next_token(c);
+            result = parse_expression(c, 0);
+            if(c->token != TK_RPAREN) {
+                compile_error(c, ERROR_SHELL_MISUSE);
+                return result;
+            }
+            next_token(c);
+            return result;
+
+        case TK_BANG:
+        case TK_TILDE:
+        case TK_BINARY: {
+            if(token == TK_BINARY && op != ARITH_ADD && op != ARITH_SUB) {
+                break;
+            }
+            next_token(c);
+            Operand operand = parse_expression(c, BP_UNARY - 1);
+            if(token == TK_BINARY && op == ARITH_ADD) {
+                return operand;
+            }
+            uint32_t unary = (token == TK_BANG) ? ARITH_NOT : (token == TK_TILDE) ? ARITH_BITNOT : ARITH_NEG;
+            if(operand.constant) {
+                int64_t value = operand.value;
+                value = (unary == ARITH_NOT) ? !value : (unary == ARITH_BITNOT) ? ~value :
+                        (int64_t)(0 - (uint64_t)value);
+                return fold(c, result.start, value);
+            }
+            emit(c, unary, 0, NULL, 0);
+            return result;
+        }
+
+        default:
+            break;
+    }
+    compile_error(c, ERROR_SHELL_MISUSE);
+    return result;
+} // parse_prefix
+
+
+/**
+ * @brief       Compiles expression whose operators bind tighter than min_bp
+ */
+static Operand parse_expression(ArithCompilerPtr c, uint32_t min_bp) {
+    if(++c->nesting > ARITH_NESTING_MAX) {
+        compile_error(c, ERROR_SHELL_MISUSE);
+    }
+    Operand left = parse_prefix(c);
+
+    uint32_t bp;
+    while(c->status == SUCCESS && (bp = binding_power(c)) > min_bp) {
+        uint32_t token = c->token;
+        uint32_t op = c->op;
+        next_token(c);
+        uint32_t start = left.start;
+
+        if(token == TK_COMMA) {
+            if(left.constant) {
+                c->length = start;
+                c->depth--;
+            }
+            else {
+                emit(c, ARITH_POP, 0, NULL, -1);
+            }
+            Operand right = parse_expression(c, BP_COMMA);
+            left = right;
+            left.start = start;
+            continue;
+        }
+
+        if(token == TK_QUESTION) {
+            uint32_t jump_else = emit(c, ARITH_JUMP_IF_ZERO, 0, NULL, -1);
+            Operand taken = parse_expression(c, 0);
+            if(c->token != TK_COLON) {
+                compile_error(c, ERROR_SHELL_MISUSE);
+                break;
+            }
+            next_token(c);
+            uint32_t jump_end = emit(c, ARITH_JUMP, 0, NULL, -1);
+            c->code[jump_else].arg = c->length;
+            Operand other = parse_expression(c, BP_CONDITIONAL - 1);
+            c->code[jump_end].arg = c->length;
+            if(c->status == SUCCESS && left.constant && taken.constant && other.constant) {
+                left = fold(c, start, left.value ? taken.value : other.value);
+            }
+            else {
+                left.constant = 0U;
+            }
+            continue;
+        }
+
+        if(token == TK_AND || token == TK_OR) {
+            uint32_t jump = emit(c, op, 0, NULL, -1);
+            Operand right = parse_expression(c, bp);
+            emit(c, ARITH_BOOL, 0, NULL, 0);
+            c->code[jump].arg = c->length;
+            if(c->status == SUCCESS && left.constant && (right.constant || (token == TK_AND) == (left.value == 0))) {
+                // a constant deciding left side makes the right side dead code
+                int64_t value = (token == TK_AND) ? (left.value != 0 && right.value != 0) :
+                                                    (left.value != 0 || right.value != 0);
+                if(!right.constant) {
+                    value = (token == TK_AND) ? 0 : 1;
+                }
+                left = fold(c, start, value);
+            }
+            else {
+                left.constant = 0U;
+            }
+            continue;
+        }
+
+        // ** is right associative
+        Operand right = parse_expression(c, (op == ARITH_POW) ? bp - 1 : bp);
+        int64_t value;
+        if(c->status == SUCCESS && left.constant && right.constant &&
+           arith_apply(op, left.value, right.value, &value)) {
+            left = fold(c, start, value);
+            c->depth--;
+        }
+        else {
+            emit(c, op, 0, NULL, -1);
+            left.constant = 0U;
+        }
+    }
+    c->nesting--;
+    return left;
+} // parse_expression
+
+
+/**
+ * @brief       Compiles arithmetic expression
+ *
+ *              Operators and precedence of C for 64bit integers (with ** and
+ *              without casts), numbers are decimal, octal (0...), hexadecimal
+ *              (0x...) or base#digits. Plain $name, ${name} and $1 are kept for
+ *              run time, other expansions and quotes make the text dynamic
+ *
+ * @param text  expression
+ * @param length length of text
+ * @param arena arena for the program
+ * @param program output program
+ * @return      SUCCESS, ERROR_SHELL_MISUSE on syntax error, ERROR_DEFAULT when the
+ *              text has to be expanded first, ERROR_MALLOC_FAILURE
+ */
+StatusEnum arith_compile(const char* text, size_t length, ArenaPtr arena, ArithProgramPtr* program) {
+    ArithCompiler c;
+    memset(&c, 0, sizeof(c));
+    c.text = text;
+    c.p = text;
+    c.end = text + length;
+    c.arena = arena;
+    c.token = TK_END;
+    next_token(&c);
+
+    // empty expression is 0
+    if(c.token == TK_END && c.status == SUCCESS) {
+        emit(&c, ARITH_PUSH, 0, NULL, 1);
+    }
+    else {
+        parse_expression(&c, 0);
+        if(c.token != TK_END) {
+            compile_error(&c, ERROR_SHELL_MISUSE);
+        }
+    }
+
+    ArithProgramPtr result = NULL;
+    if(c.status == SUCCESS) {
+        result = (ArithProgramPtr) arenaAlloc(arena, sizeof(ArithProgram));
+        ArithInstructionPtr code = (ArithInstructionPtr) arenaAlloc(arena, sizeof(ArithInstruction) * c.length);
+        if(result == NULL || code == NULL) {
+            c.status = ERROR_MALLOC_FAILURE;
+        }
+        else {
+            memcpy(code, c.code, sizeof(ArithInstruction) * c.length);
+            result->code = code;
+            result->length = c.length;
+            result->param_count = c.param_count;
+            result->source = (char*) text;
+            result->source_length = (uint32_t)length;
+        }
+    }
+    free(c.code);
+    *program = (c.status == SUCCESS) ? result : NULL;
+    return c.status;
+} // arith_compile
+
+
+/**
+ * @brief       Tells whether $( at dollar is an arithmetic expansion $(( ))
+ *
+ *              $((cmd) (cmd)) is a command substitution of subshells
+ *
+ * @param dollar pointer to $
+ * @param close pointer after the closing parenthesis
+ * @param body  output start of the expression
+ * @param length output length of the expression
+ * @return      1 for arithmetic expansion, 0 otherwise
+ */
+uint8_t arith_expansion_body(const char* dollar, const char* close, const char** body, size_t* length) {
+    if(close - dollar < 6 || dollar[1] != '(' || dollar[2] != '(' || close[-1] != ')' || close[-2] != ')') {
+        return 0U;
+    }
+    // the inner ( must be closed by the ) before the last one
+    const char* p = dollar + 3;
+    const char* end = close - 2;
+    uint32_t depth = 0;
+    while(p < end) {
+        if(*p == '(') {
+            depth++;
+            p++;
+        }
+        else if(*p == ')') {
+            if(depth == 0) {
+                return 0U;
+            }
+            depth--;
+            p++;
+        }
+        else if(*p == '\'' || *p == '"' || *p == '`' || *p == '$') {
+            const char* skipped = lexer_skip_quoted(p, end);
+            p = (skipped != NULL && skipped > p) ? skipped : p + 1;
+        }
+        else {
+            p++;
+        }
+    }
+    if(depth != 0) {
+        return 0U;
+    }
+    *body = dollar + 3;
+    *length = (size_t)(end - *body);
+    return 1U;
+} // arith_expansion_body
+
+
+/**
+ * @brief       Compiles every $(( )) in word text which can be compiled ahead
+ *
+ * @param text  raw word text, programs keep pointers into it
+ * @param length length of text
+ * @param arena arena of the word
+ * @param list  output list of compiled expansions, NULL if there are none
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+StatusEnum arith_compile_word(char* text, uint32_t length, ArenaPtr arena, ArithExpansionPtr* list) {
+    *list = NULL;
+    ArithExpansionPtr* tail = list;
+    const char* end = text + length;
+    const char* p = text;
+    // every occurrence is compiled, ones inside quotes or $( ) are just never looked up
+    while((p = (const char*) memmem(p, (size_t)(end - p), "$((", 3)) != NULL) {
+        const char* close = lexer_skip_quoted(p, end);
+        const char* body;
+        size_t body_length;
+        if(close == NULL || !arith_expansion_body(p, close, &body, &body_length)) {
+            p++;
+            continue;
+        }
+
+        ArithProgramPtr program;
+        StatusEnum st = arith_compile(body, body_length, arena, &program);
+        if(st == ERROR_MALLOC_FAILURE) {
+            return st;
+        }
+        if(st == SUCCESS) {
+            ArithExpansionPtr expansion = (ArithExpansionPtr) arenaAlloc(arena, sizeof(ArithExpansion));
+            if(expansion == NULL) {
+                return ERROR_MALLOC_FAILURE;
+            }
+            expansion->next = NULL;
+            expansion->offset = (uint32_t)(p - text);
+            expansion->program = program;
+            *tail = expansion;
+            tail = &expansion->next;
+        }
+        // nested $(( )) get entries of their own
+        p += 3;
+    }
+    return SUCCESS;
+} // arith_compile_word
+
+
+/**
+ * @brief       Copies list of compiled expansions into another arena
+ *
+ * @param list  list to copy, may be NULL
+ * @param text  copy of the word text the programs will point into
+ * @param arena destination arena
+ * @param copy  output copy
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+StatusEnum arith_copy_word(ArithExpansionPtr list, char* text, ArenaPtr arena, ArithExpansionPtr* copy) {
+    *copy = NULL;
+    ArithExpansionPtr* tail = copy;
+    for(ArithExpansionPtr expansion = list; expansion != NULL; expansion = expansion->next) {
+        ArithExpansionPtr result = (ArithExpansionPtr) arenaAlloc(arena, sizeof(ArithExpansion));
+        ArithProgramPtr program = (ArithProgramPtr) arenaAlloc(arena, sizeof(ArithProgram));
+        ArithInstructionPtr code = (ArithInstructionPtr) arenaAlloc(arena,
+                                       sizeof(ArithInstruction) * expansion->program->length);
+        if(result == NULL || program == NULL || code == NULL) {
+            return ERROR_MALLOC_FAILURE;
+        }
+        *program = *expansion->program;
+        // the source is at the same place in the copied text, $(( is 3 characters
+        program->source = text + expansion->offset + 3;
+        program->code = code;
+        for(uint32_t i = 0; i < program->length; i++) {
+            code[i] = expansion->program->code[i];
+            if(code[i].name != NULL) {
+                code[i].name = arenaStrndup(arena, code[i].name, strlen(code[i].name));
+                if(code[i].name == NULL) {
+                    return ERROR_MALLOC_FAILURE;
+                }
+            }
+        }
+        result->next = NULL;
+        result->offset = expansion->offset;
+        result->program = program;
+        *tail = result;
+        tail = &result->next;
+    }
+    return SUCCESS;
+} // arith_copy_word
@@ -0,0 +1,154 @@
+#ifndef ARITH_H
+#define ARITH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../utils/error.h"
+#include "../data_structures/arena.h"
+
+// deepest value stack a compiled expression may need
+#define ARITH_STACK_SIZE 64U
+// deepest nesting of parentheses and operators the compiler follows
+#define ARITH_NESTING_MAX 128U
+
+// instructions of compiled arithmetic expressions, operands are on a value stack
+typedef enum {
+    ARITH_PUSH,         // value: constant
+    ARITH_LOAD,         // name: variable, its value is evaluated as an expression
+    ARITH_PARAM,        // name: $name in the text, must expand to a plain number, arg: its index
+    ARITH_STORE,        // name: assigns top of stack, which stays
+    ARITH_DUP,          // copies top of stack
+    ARITH_POP,          // drops top of stack
+    ARITH_NEG,          // unary -
+    ARITH_NOT,          // !
+    ARITH_BITNOT,       // ~
+    ARITH_BOOL,         // turns top of stack into 0 or 1
+    ARITH_POW,          // **
+    ARITH_MUL,
+    ARITH_DIV,
+    ARITH_MOD,
+    ARITH_ADD,
+    ARITH_SUB,
+    ARITH_SHL,
+    ARITH_SHR,
+    ARITH_LT,
+    ARITH_LE,
+    ARITH_GT,
+    ARITH_GE,
+    ARITH_EQ,
+    ARITH_NE,
+    ARITH_BITAND,
+    ARITH_BITXOR,
+    ARITH_BITOR,
+    ARITH_AND,          // arg: target, 0 on top stays and jumps, otherwise it is dropped
+    ARITH_OR,           // arg: target, non zero on top becomes 1 and jumps, otherwise it is dropped
+    ARITH_JUMP,         // arg: target
+    ARITH_JUMP_IF_ZERO, // arg: target, top of stack is dropped
+    ARITH_OP_COUNT
+} ArithOpcodeEnum;
+
+
+//
+typedef struct arith_instruction {
+    uint32_t op;                // ArithOpcodeEnum
+    uint32_t arg;               // jump target
+    int64_t value;              // constant of ARITH_PUSH
+    char* name;                 // variable of ARITH_LOAD, ARITH_PARAM and ARITH_STORE
+} ArithInstruction, *ArithInstructionPtr;
+
+
+/*  Expression of $(( )) compiled to postfix code, constant parts are
+    folded into single pushes while compiling */
+typedef struct arith_program {
+    ArithInstructionPtr code;
+    uint32_t length;
+    uint32_t param_count;       // ARITH_PARAM instructions, numbered by their arg
+    char* source;               // text between (( and )) for diagnostics
+    uint32_t source_length;
+} ArithProgram, *ArithProgramPtr;
+
+
+/*  Compiled $(( )) of a word, found by the offset of its $ in the word text.
+    Expansions which could not be compiled ahead (syntax errors, $( ) inside)
+    have no entry and are compiled every time they are expanded */
+typedef struct arith_expansion {
+    struct arith_expansion* next;
+    uint32_t offset;
+    ArithProgramPtr program;
+} ArithExpansion, *ArithExpansionPtr;
+
+
+/**
+ * @brief       Compiles arithmetic expression
+ *
+ *              Operators and precedence of C for 64bit integers (with ** and
+ *              without casts), numbers are decimal, octal (0...), hexadecimal
+ *              (0x...) or base#digits. Plain $name, ${name} and $1 are kept for
+ *              run time, other expansions and quotes make the text dynamic
+ *
+ * @param text  expression
+ * @param length length of text
+ * @param arena arena for the program
+ * @param program output program
+ * @return      SUCCESS, ERROR_SHELL_MISUSE on syntax error, ERROR_DEFAULT when the
+ *              text has to be expanded first, ERROR_MALLOC_FAILURE
+ */
+StatusEnum arith_compile(const char* text, size_t length, ArenaPtr arena, ArithProgramPtr* program);
+
+/**
+ * @brief       Applies binary operator, shared by folding and evaluation
+ *
+ * @param op    ARITH_POW ... ARITH_BITOR
+ * @param left  left operand
+ * @param right right operand
+ * @param result output value
+ * @return      1 on success, 0 on division by zero or negative exponent
+ */
+uint8_t arith_apply(uint32_t op, int64_t left, int64_t right, int64_t* result);
+
+/**
+ * @brief       Parses number constant the way the compiler does
+ *
+ * @param p     first character
+ * @param end   end of text
+ * @param value output value, wraps around on overflow
+ * @return      pointer after the number, NULL if p does not start a valid number
+ */
+const char* arith_parse_number(const char* p, const char* end, int64_t* value);
+
+/**
+ * @brief       Tells whether $( at dollar is an arithmetic expansion $(( ))
+ *
+ *              $((cmd) (cmd)) is a command substitution of subshells
+ *
+ * @param dollar pointer to $
+ * @param close pointer after the closing parenthesis
+ * @param body  output start of the expression
+ * @param length output length of the expression
+ * @return      1 for arithmetic expansion, 0 otherwise
+ */
+uint8_t arith_expansion_body(const char* dollar, const char* close, const char** body, size_t* length);
+
+/**
+ * @brief       Compiles every $(( )) in word text which can be compiled ahead
+ *
+ * @param text  raw word text, programs keep pointers into it
+ * @param length length of text
+ * @param arena arena of the word
+ * @param list  output list of compiled expansions, NULL if there are none
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+StatusEnum arith_compile_word(char* text, uint32_t length, ArenaPtr arena, ArithExpansionPtr* list);
+
+/**
+ * @brief       Copies list of compiled expansions into another arena
+ *
+ * @param list  list to copy, may be NULL
+ * @param text  copy of the word text the programs will point into
+ * @param arena destination arena
+ * @param copy  output copy
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+StatusEnum arith_copy_word(ArithExpansionPtr list, char* text, ArenaPtr arena, ArithExpansionPtr* copy);
+
+#endif
@@ -0,0 +1,1184 @@
+/**
+ * Recursive descent parser turning lexer tokens into a syntax tree
+ *
+ * The tree is built once per command line, loops and functions are executed
+ * from it without lexing or parsing their bodies again
+ */
+
+#include "parser.h"
+#include "../utils/strings.h"
+
+// first capacity of word, item and node vectors
+#define PARSER_VECTOR_MIN_CAPACITY 4U
+
+static StatusEnum parse_list(ParserPtr parser, uint8_t top_level, NodePtr* node);
+static StatusEnum parse_command(ParserPtr parser, NodePtr* node);
+
+
+/**
+ * @brief       Appends item to vector allocated from arena
+ *
+ *              Vector doubles its capacity by copying, the old copy stays
+ *              in the arena until it is reset
+ *
+ * @return      pointer to the new zeroed item, NULL on malloc failure
+ */
+static void* vector_push(ArenaPtr arena, void** items, uint32_t* count, uint32_t* capacity, size_t item_size) {
+    if(*count >= *capacity) {
+        uint32_t new_capacity = (*capacity == 0) ? PARSER_VECTOR_MIN_CAPACITY : *capacity * 2;
+        void* new_items = arenaAlloc(arena, item_size * new_capacity);
+        if(new_items == NULL) {
+            return NULL;
+        }
+        if(*items != NULL) {
+            memcpy(new_items, *items, item_size * (*count));
+        }
+        *items = new_items;
+        *capacity = new_capacity;
+    }
+    void* item = (char*) *items + item_size * (*count)++;
+    memset(item, 0, item_size);
+    return item;
+} // vector_push
+
+
+/**
+ * @brief       Allocates zeroed node of given type
+ * @return      node, NULL on malloc failure
+ */
+static NodePtr node_new(ArenaPtr arena, NodeTypeEnum type) {
+    NodePtr node = (NodePtr) arenaAlloc(arena, sizeof(Node));
+    if(node == NULL) {
+        return NULL;
+    }
+    memset(node, 0, sizeof(Node));
+    node->type = type;
+    return node;
+} // node_new
+
+
+/**
+ * @brief       Reports unexpected token, returns status of a syntax error
+ */
+static StatusEnum syntax_error(ParserPtr parser) {
+    LexerPtr lexer = parser->lexer;
+    TokenPtr token = &parser->token;
+
+    if(token->type == TOKEN_ERROR) {
+        print_error("syntax error: unterminated quoted string");
+    }
+    else if(token->type == TOKEN_EOF) {
+        print_error("syntax error: unexpected end of file");
+    }
+    else if(token->type == TOKEN_NEWLINE) {
+        print_error("syntax error near unexpected newline");
+    }
+    else {
+        print_error("syntax error near unexpected token `%.*s'", (int)token->length, token_text(lexer, token));
+    }
+    // rest of the line can't be trusted
+    parser->has_token = 0U;
+    return ERROR_SHELL_MISUSE;
+} // syntax_error
+
+
+/**
+ * @brief       Copies lines of here-document body into arena, <<- strips leading tabs
+ */
+static char* copy_heredoc_body(ArenaPtr arena, const char* p, const char* end, uint8_t strip_tabs) {
+    char* body = (char*) arenaAlloc(arena, (size_t)(end - p) + 1);
+    if(body == NULL) {
+        return NULL;
+    }
+    if(!strip_tabs) {
+        memcpy(body, p, (size_t)(end - p));
+        body[end - p] = '\0';
+        return body;
+    }
+
+    char* out = body;
+    while(p < end) {
+        while(p < end && *p == '\t') {
+            p++;
+        }
+        const char* newline = memchr(p, '\n', (size_t)(end - p));
+        const char* line_end = (newline != NULL) ? newline + 1 : end;
+        memcpy(out, p, (size_t)(line_end - p));
+        out += line_end - p;
+        p = line_end;
+    }
+    *out = '\0';
+    return body;
+} // copy_heredoc_body
+
+
+/**
+ * @brief       Reads bodies of here-documents of the line which just ended
+ *
+ *              Each body is made of the lines up to its delimiter line. A quoted
+ *              delimiter keeps the body literal, otherwise it is expanded at run
+ *              time when it contains $ ` or \
+ */
+static StatusEnum read_heredocs(ParserPtr parser) {
+    LexerPtr lexer = parser->lexer;
+    for(uint32_t i = 0; i < parser->heredoc_count; i++) {
+        RedirectionNodePtr redirection = parser->heredocs[i];
+        WordPtr target = &redirection->target;
+        uint8_t strip_tabs = (redirection->type == TOKEN_DLESSDASH) ? 1U : 0U;
+
+        char* delimiter = target->text;
+        uint32_t delimiter_length = target->length;
+        if(target->flags & TOKEN_FLAG_QUOTED) {
+            delimiter = (char*) arenaAlloc(parser->arena, target->length + 1);
+            if(delimiter == NULL) {
+                return ERROR_MALLOC_FAILURE;
+            }
+            delimiter_length = token_unquote(target->text, target->length, delimiter);
+        }
+
+        size_t body_start = lexer->position;
+        size_t body_end;
+        while(1) {
+            Token line;
+            StatusEnum st = lexer_read_line(lexer, &line);
+            ERR_CHECK(st);
+            if(line.type == TOKEN_EOF) {
+                print_error("warning: here-document delimited by end-of-file (wanted `%s')", delimiter);
+                body_end = lexer->position;
+                break;
+            }
+
+            const char* text = token_text(lexer, &line);
+            uint32_t length = line.length;
+            while(strip_tabs && length > 0 && *text == '\t') {
+                text++;
+                length--;
+            }
+            if(length == delimiter_length && memcmp(text, delimiter, length) == 0) {
+                body_end = line.offset;
+                break;
+            }
+        }
+
+        WordPtr body = &redirection->body;
+        body->text = copy_heredoc_body(parser->arena, lexer->input + body_start, lexer->input + body_end, strip_tabs);
+        if(body->text == NULL) {
+            return ERROR_MALLOC_FAILURE;
+        }
+        body->length = (uint32_t) strlen(body->text);
+        body->flags = (!(target->flags & TOKEN_FLAG_QUOTED) && strpbrk(body->text, "$`\\") != NULL) ?
+                      TOKEN_FLAG_EXPAND : 0U;
+    }
+    parser->heredoc_count = 0;
+    return SUCCESS;
+} // read_heredocs
+
+
+/**
+ * @brief       Makes sure parser->token holds the next unconsumed token
+ * @return      SUCCESS, ERROR_SHELL_MISUSE on unterminated quote
+ */
+static StatusEnum peek(ParserPtr parser) {
+    if(parser->has_token) {
+        return SUCCESS;
+    }
+    if(get_token(parser->lexer, &parser->token) != SUCCESS) {
+        return syntax_error(parser);
+    }
+    parser->has_token = 1U;
+    if(parser->heredoc_count > 0 &&
+       (parser->token.type == TOKEN_NEWLINE || parser->token.type == TOKEN_EOF)) {
+        return read_heredocs(parser);
+    }
+    return SUCCESS;
+} // peek
+
+
+/**
+ * @brief       Marks lookahead token as consumed
+ */
+static inline void consume(ParserPtr parser) {
+    parser->has_token = 0U;
+} // consume
+
+
+/**
+ * @brief       Checks whether peeked token is the given reserved word
+ *
+ *              Only unquoted words can be reserved, caller must be in command position
+ */
+static uint8_t is_reserved(ParserPtr parser, const char* word) {
+    return (parser->token.type == TOKEN_WORD && parser->token.flags == 0 &&
+            token_equals(parser->lexer, &parser->token, word)) ? 1U : 0U;
+} // is_reserved
+
+
+/**
+ * @brief       Consumes reserved word, anything else is a syntax error
+ */
+static StatusEnum expect_reserved(ParserPtr parser, const char* word) {
+    StatusEnum st = peek(parser);
+    ERR_CHECK(st);
+    if(!is_reserved(parser, word)) {
+        return syntax_error(parser);
+    }
+    consume(parser);
+    return SUCCESS;
+} // expect_reserved
+
+
+/**
+ * @brief       Consumes operator token of given type, anything else is a syntax error
+ */
+static StatusEnum expect_token(ParserPtr parser, TokenTypeEnum type) {
+    StatusEnum st = peek(parser);
+    ERR_CHECK(st);
+    if(parser->token.type != type) {
+        return syntax_error(parser);
+    }
+    consume(parser);
+    return SUCCESS;
+} // expect_token
+
+
+/**
+ * @brief       Consumes any number of newline tokens
+ */
+static StatusEnum skip_newlines(ParserPtr parser) {
+    StatusEnum st = peek(parser);
+    while(st == SUCCESS && parser->token.type == TOKEN_NEWLINE) {
+        consume(parser);
+        st = peek(parser);
+    }
+    return st;
+} // skip_newlines
+
+
+/**
+ * @brief       Checks whether peeked token ends a compound list
+ */
+static uint8_t is_list_end(ParserPtr parser) {
+    static const char* const closing_words[] = {
+        "then", "else", "elif", "fi", "do", "done", "esac", "}"
+    };
+
+    switch(parser->token.type) {
+        case TOKEN_EOF:
+        case TOKEN_RPAREN:
+        case TOKEN_DOUBLE_SEMI:
+            return 1U;
+        case TOKEN_WORD:
+            for(uint32_t i = 0; i < sizeof(closing_words) / sizeof(closing_words[0]); i++) {
+                if(is_reserved(parser, closing_words[i])) {
+                    return 1U;
+                }
+            }
+            return 0U;
+        default:
+            return 0U;
+    }
+} // is_list_end
+
+
+/**
+ * @brief       Copies peeked word token into arena and consumes it
+ */
+static StatusEnum take_word(ParserPtr parser, WordPtr word) {
+    TokenPtr token = &parser->token;
+    word->text = arenaStrndup(parser->arena, token_text(parser->lexer, token), token->length);
+    if(word->text == NULL) {
+        return ERROR_MALLOC_FAILURE;
+    }
+    word->length = token->length;
+    word->flags = token->flags;
+    const char* bracket = strchr(word->text, '[');
+    if(strpbrk(word->text, "*?") != NULL || (bracket != NULL && strchr(bracket + 1, ']') != NULL)) {
+        word->flags |= WORD_FLAG_GLOB;
+    }
+    word->arithmetic = NULL;
+    if(word->flags & TOKEN_FLAG_ARITH) {
+        StatusEnum st = arith_compile_word(word->text, word->length, parser->arena, &word->arithmetic);
+        ERR_CHECK(st);
+    }
+    consume(parser);
+    return SUCCESS;
+} // take_word
+
+
+/**
+ * @brief       Checks whether raw word starts with NAME= without copying it
+ */
+static uint8_t token_is_assignment(const char* text, uint32_t length) {
+    uint32_t i = 0;
+    while(i < length && (text[i] == '_' || (text[i] >= 'a' && text[i] <= 'z') || (text[i] >= 'A' && text[i] <= 'Z') ||
+                         (i > 0 && text[i] >= '0' && text[i] <= '9'))) {
+        i++;
+    }
+    return (i > 0 && i < length && text[i] == '=') ? 1U : 0U;
+} // token_is_assignment
+
+
+/**
+ * @brief       Checks whether token type is a redirector
+ */
+static uint8_t is_redirector(TokenTypeEnum type) {
+    switch(type) {
+        case TOKEN_LESS:
+        case TOKEN_GREAT:
+        case TOKEN_DLESS:
+        case TOKEN_DGREAT:
+        case TOKEN_LESSAND:
+        case TOKEN_GREATAND:
+        case TOKEN_LESSGREAT:
+        case TOKEN_DLESSDASH:
+        case TOKEN_TLESS:
+        case TOKEN_CLOBBER:
+            return 1U;
+        default:
+            return 0U;
+    }
+} // is_redirector
+
+
+/**
+ * @brief       Parses [IO_NUMBER] redirector word, peeked token is IO_NUM or redirector
+ *
+ * @param tail  pointer to next pointer of the last redirection, moved past the new one
+ */
+static StatusEnum parse_redirection(ParserPtr parser, RedirectionNodePtr** tail) {
+    int32_t io_number = -1;
+    if(parser->token.type == TOKEN_IO_NUM) {
+        long number = strtol(token_text(parser->lexer, &parser->token), NULL, 10);
+        io_number = (number > INT32_MAX) ? INT32_MAX : (int32_t)number;
+        consume(parser);
+
+        StatusEnum st = peek(parser);
+        ERR_CHECK(st);
+        if(!is_redirector(parser->token.type)) {
+            return syntax_error(parser);
+        }
+    }
+
+    RedirectionNodePtr redirection = (RedirectionNodePtr) arenaAlloc(parser->arena, sizeof(RedirectionNode));
+    if(redirection == NULL) {
+        return ERROR_MALLOC_FAILURE;
+    }
+    redirection->next = NULL;
+    redirection->type = parser->token.type;
+    redirection->io_number = io_number;
+    consume(parser);
+
+    StatusEnum st = peek(parser);
+    ERR_CHECK(st);
+    if(parser->token.type != TOKEN_WORD) {
+        return syntax_error(parser);
+    }
+    st = take_word(parser, &redirection->target);
+    ERR_CHECK(st);
+
+    memset(&redirection->body, 0, sizeof(redirection->body));
+    if(redirection->type == TOKEN_DLESS || redirection->type == TOKEN_DLESSDASH) {
+        // body is read when the line ends
+        RedirectionNodePtr* pending = (RedirectionNodePtr*) vector_push(parser->arena, (void**) &parser->heredocs,
+                                                                        &parser->heredoc_count,
+                                                                        &parser->heredoc_capacity,
+                                                                        sizeof(RedirectionNodePtr));
+        if(pending == NULL) {
+            return ERROR_MALLOC_FAILURE;
+        }
+        *pending = redirection;
+    }
+
+    **tail = redirection;
+    *tail = &redirection->next;
+    return SUCCESS;
+} // parse_redirection
+
+
+/**
+ * @brief       Parses redirections following a compound command
+ */
+static StatusEnum parse_trailing_redirections(ParserPtr parser, NodePtr node) {
+    RedirectionNodePtr* tail = &node->redirections;
+    while(1) {
+        StatusEnum st = peek(parser);
+        ERR_CHECK(st);
+        if(parser->token.type != TOKEN_IO_NUM && !is_redirector(parser->token.type)) {
+            return SUCCESS;
+        }
+        st = parse_redirection(parser, &tail);
+        ERR_CHECK(st);
+    }
+} // parse_trailing_redirections
+
+
+/**
+ * @brief       Parses list which must not be empty (bodies of compound commands)
+ */
+static StatusEnum parse_body(ParserPtr parser, NodePtr* node) {
+    StatusEnum st = parse_list(parser, 0U, node);
+    ERR_CHECK(st);
+    if(*node == NULL) {
+        return syntax_error(parser);
+    }
+    return SUCCESS;
+} // parse_body
+
+
+/**
+ * @brief       Parses function definition after name and `(` were seen
+ */
+static StatusEnum parse_function(ParserPtr parser, WordPtr name, NodePtr* node) {
+    if(name->flags != 0 || !is_name(name->text)) {
+        return syntax_error(parser);
+    }
+    consume(parser);    // (
+
+    StatusEnum st = expect_token(parser, TOKEN_RPAREN);
+    ERR_CHECK(st);
+    st = skip_newlines(parser);
+    ERR_CHECK(st);
+
+    // body must be a compound command
+    static const char* const compound_words[] = {"{", "if", "while", "until", "for", "case"};
+    uint8_t compound = (parser->token.type == TOKEN_LPAREN) ? 1U : 0U;
+    for(uint32_t i = 0; i < sizeof(compound_words) / sizeof(compound_words[0]) && !compound; i++) {
+        compound = is_reserved(parser, compound_words[i]);
+    }
+    if(!compound) {
+        return syntax_error(parser);
+    }
+
+    *node = node_new(parser->arena, NODE_FUNCTION);
+    if(*node == NULL) {
+        return ERROR_MALLOC_FAILURE;
+    }
+    (*node)->function.name = name->text;
+    return parse_command(parser, &(*node)->function.body);
+} // parse_function
+
+
+/**
+ * @brief       Parses simple command or function definition
+ */
+static StatusEnum parse_simple_command(ParserPtr parser, NodePtr* node) {
+    *node = node_new(parser->arena, NODE_SIMPLE);
+    if(*node == NULL) {
+        return ERROR_MALLOC_FAILURE;
+    }
+
+    NodePtr command = *node;
+    uint32_t word_capacity = 0;
+    uint32_t assignment_capacity = 0;
+    RedirectionNodePtr* tail = &command->redirections;
+
+    while(1) {
+        StatusEnum st = peek(parser);
+        ERR_CHECK(st);
+        TokenTypeEnum type = parser->token.type;
+
+        if(type == TOKEN_WORD) {
+            // assignments are only recognized before the command name
+            uint8_t assignment = (command->simple.word_count == 0) ?
+                token_is_assignment(token_text(parser->lexer, &parser->token), parser->token.length) : 0U;
+
+            WordPtr word = (assignment) ?
+                (WordPtr) vector_push(parser->arena, (void**) &command->simple.assignments,
+                                      &command->simple.assignment_count, &assignment_capacity, sizeof(Word)) :
+                (WordPtr) vector_push(parser->arena, (void**) &command->simple.words,
+                                      &command->simple.word_count, &word_capacity, sizeof(Word));
+            if(word == NULL) {
+                return ERROR_MALLOC_FAILURE;
+            }
+            st = take_word(parser, word);
+            ERR_CHECK(st);
+
+            // name ( ) starts a function definition
+            if(!assignment && command->simple.word_count == 1 && command->simple.assignment_count == 0 &&
+               command->redirections == NULL) {
+                st = peek(parser);
+                ERR_CHECK(st);
+                if(parser->token.type == TOKEN_LPAREN) {
+                    return parse_function(parser, word, node);
+                }
+            }
+        }
+        else if(type == TOKEN_IO_NUM || is_redirector(type)) {
+            st = parse_redirection(parser, &tail);
+            ERR_CHECK(st);
+        }
+        else {
+            break;
+        }
+    }
+
+    if(command->simple.word_count == 0 && command->simple.assignment_count == 0 &&
+       command->redirections == NULL) {
+        return syntax_error(parser);
+    }
+    return SUCCESS;
+} // parse_simple_command
+
+
+/**
+ * @brief       Parses rest of if or elif after the reserved word was consumed, up to fi
+ */
+static StatusEnum parse_if(ParserPtr parser, NodePtr* node) {
+    *node = node_new(parser->arena, NODE_IF);
+    if(*node == NULL) {
+        return ERROR_MALLOC_FAILURE;
+    }
+
+    StatusEnum st = parse_body(parser, &(*node)->conditional.condition);
+    ERR_CHECK(st);
+    st = expect_reserved(parser, "then");
+    ERR_CHECK(st);
+    st = parse_body(parser, &(*node)->conditional.then_body);
+    ERR_CHECK(st);
+
+    st = peek(parser);
+    ERR_CHECK(st);
+    if(is_reserved(parser, "elif")) {
+        consume(parser);
+        return parse_if(parser, &(*node)->conditional.else_body);
+    }
+    if(is_reserved(parser, "else")) {
+        consume(parser);
+        st = parse_body(parser, &(*node)->conditional.else_body);
+        ERR_CHECK(st);
+    }
+    return expect_reserved(parser, "fi");
+} // parse_if
+
+
+/**
+ * @brief       Parses do list done
+ */
+static StatusEnum parse_do_group(ParserPtr parser, NodePtr* body) {
+    StatusEnum st = expect_reserved(parser, "do");
+    ERR_CHECK(st);
+    st = parse_body(parser, body);
+    ERR_CHECK(st);
+    return expect_reserved(parser, "done");
+} // parse_do_group
+
+
+/**
+ * @brief       Parses for name [in word...]; do list done after `for` was consumed
+ */
+static StatusEnum parse_for(ParserPtr parser, NodePtr* node) {
+    *node = node_new(parser->arena, NODE_FOR);
+    if(*node == NULL) {
+        return ERROR_MALLOC_FAILURE;
+    }
+    NodePtr loop = *node;
+
+    StatusEnum st = peek(parser);
+    ERR_CHECK(st);
+    if(parser->token.type != TOKEN_WORD) {
+        return syntax_error(parser);
+    }
+    Word name;
+    st = take_word(parser, &name);
+    ERR_CHECK(st);
+    if(name.flags != 0 || !is_name(name.text)) {
+        print_error("for: `%s': not a valid identifier", name.text);
+        return ERROR_SHELL_MISUSE;
+    }
+    loop->for_loop.name = name.text;
+
+    st = peek(parser);
+    ERR_CHECK(st);
+    if(parser->token.type == TOKEN_SEMI) {
+        consume(parser);
+    }
+    else {
+        st = skip_newlines(parser);
+        ERR_CHECK(st);
+        if(is_reserved(parser, "in")) {
+            consume(parser);
+            loop->for_loop.has_in = 1U;
+
+            uint32_t capacity = 0;
+            while(1) {
+                st = peek(parser);
+                ERR_CHECK(st);
+                if(parser->token.type != TOKEN_WORD) {
+                    break;
+                }
+                WordPtr word = (WordPtr) vector_push(parser->arena, (void**) &loop->for_loop.words,
+                                                     &loop->for_loop.word_count, &capacity, sizeof(Word));
+                if(word == NULL) {
+                    return ERROR_MALLOC_FAILURE;
+                }
+                st = take_word(parser, word);
+                ERR_CHECK(st);
+            }
+            if(parser->token.type != TOKEN_SEMI && parser->token.type != TOKEN_NEWLINE) {
+                return syntax_error(parser);
+            }
+            consume(parser);
+        }
+    }
+
+    st = skip_newlines(parser);
+    ERR_CHECK(st);
+    return parse_do_group(parser, &loop->for_loop.body);
+} // parse_for
+
+
+/**
+ * @brief       Parses case word in [(]pattern[|pattern]) list;; ... esac after `case` was consumed
+ */
+static StatusEnum parse_case(ParserPtr parser, NodePtr* node) {
+    *node = node_new(parser->arena, NODE_CASE);
+    if(*node == NULL) {
+        return ERROR_MALLOC_FAILURE;
+    }
+    NodePtr command = *node;
+
+    StatusEnum st = peek(parser);
+    ERR_CHECK(st);
+    if(parser->token.type != TOKEN_WORD) {
+        return syntax_error(parser);
+    }
+    st = take_word(parser, &command->case_command.subject);
+    ERR_CHECK(st);
+
+    st = skip_newlines(parser);
+    ERR_CHECK(st);
+    st = expect_reserved(parser, "in");
+    ERR_CHECK(st);
+
+    CaseItemPtr* tail = &command->case_command.items;
+    while(1) {
+        st = skip_newlines(parser);
+        ERR_CHECK(st);
+        if(is_reserved(parser, "esac")) {
+            consume(parser);
+            return SUCCESS;
+        }
+
+        CaseItemPtr item = (CaseItemPtr) arenaAlloc(parser->arena, sizeof(CaseItem));
+        if(item == NULL) {
+            return ERROR_MALLOC_FAILURE;
+        }
+        memset(item, 0, sizeof(CaseItem));
+
+        if(parser->token.type == TOKEN_LPAREN) {
+            consume(parser);
+            st = peek(parser);
+            ERR_CHECK(st);
+        }
+
+        uint32_t capacity = 0;
+        while(1) {
+            if(parser->token.type != TOKEN_WORD) {
+                return syntax_error(parser);
+            }
+            WordPtr pattern = (WordPtr) vector_push(parser->arena, (void**) &item->patterns,
+                                                    &item->pattern_count, &capacity, sizeof(Word));
+            if(pattern == NULL) {
+                return ERROR_MALLOC_FAILURE;
+            }
+            st = take_word(parser, pattern);
+            ERR_CHECK(st);
+
+            st = peek(parser);
+            ERR_CHECK(st);
+            if(parser->token.type != TOKEN_PIPE) {
+                break;
+            }
+            consume(parser);
+            st = peek(parser);
+            ERR_CHECK(st);
+        }
+        st = expect_token(parser, TOKEN_RPAREN);
+        ERR_CHECK(st);
+
+        st = parse_list(parser, 0U, &item->body);
+        ERR_CHECK(st);
+        *tail = item;
+        tail = &item->next;
+
+        st = peek(parser);
+        ERR_CHECK(st);
+        if(parser->token.type == TOKEN_DOUBLE_SEMI) {
+            consume(parser);
+        }
+        else if(!is_reserved(parser, "esac")) {
+            return syntax_error(parser);
+        }
+    }
+} // parse_case
+
+
+/**
+ * @brief       Parses compound or simple command with its redirections
+ */
+static StatusEnum parse_command(ParserPtr parser, NodePtr* node) {
+    StatusEnum st = peek(parser);
+    ERR_CHECK(st);
+
+    NodeTypeEnum type;
+    if(parser->token.type == TOKEN_LPAREN) {
+        consume(parser);
+        *node = node_new(parser->arena, NODE_SUBSHELL);
+        if(*node == NULL) {
+            return ERROR_MALLOC_FAILURE;
+        }
+        st = parse_body(parser, &(*node)->unary.body);
+        ERR_CHECK(st);
+        st = expect_token(parser, TOKEN_RPAREN);
+    }
+    else if(is_reserved(parser, "{")) {
+        consume(parser);
+        *node = node_new(parser->arena, NODE_GROUP);
+        if(*node == NULL) {
+            return ERROR_MALLOC_FAILURE;
+        }
+        st = parse_body(parser, &(*node)->unary.body);
+        ERR_CHECK(st);
+        st = expect_reserved(parser, "}");
+    }
+    else if(is_reserved(parser, "if")) {
+        consume(parser);
+        st = parse_if(parser, node);
+    }
+    else if((type = NODE_WHILE, is_reserved(parser, "while")) || (type = NODE_UNTIL, is_reserved(parser, "until"))) {
+        consume(parser);
+        *node = node_new(parser->arena, type);
+        if(*node == NULL) {
+            return ERROR_MALLOC_FAILURE;
+        }
+        st = parse_body(parser, &(*node)->loop.condition);
+        ERR_CHECK(st);
+        st = parse_do_group(parser, &(*node)->loop.body);
+    }
+    else if(is_reserved(parser, "for")) {
+        consume(parser);
+        st = parse_for(parser, node);
+    }
+    else if(is_reserved(parser, "case")) {
+        consume(parser);
+        st = parse_case(parser, node);
+    }
+    else if(is_list_end(parser) || is_reserved(parser, "in")) {
+        return syntax_error(parser);
+    }
+    else {
+        return parse_simple_command(parser, node);
+    }
+
+    ERR_CHECK(st);
+    return parse_trailing_redirections(parser, *node);
+} // parse_command
+
+
+/**
+ * @brief       Parses [!] command [| command]...
+ */
+static StatusEnum parse_pipeline(ParserPtr parser, NodePtr* node) {
+    StatusEnum st = peek(parser);
+    ERR_CHECK(st);
+
+    uint8_t negate = is_reserved(parser, "!");
+    if(negate) {
+        consume(parser);
+    }
+
+    NodePtr command;
+    st = parse_command(parser, &command);
+    ERR_CHECK(st);
+
+    NodePtr pipeline = NULL;
+    uint32_t capacity = 0;
+    while(1) {
+        st = peek(parser);
+        ERR_CHECK(st);
+        if(parser->token.type != TOKEN_PIPE) {
+            break;
+        }
+        consume(parser);
+
+        if(pipeline == NULL) {
+            pipeline = node_new(parser->arena, NODE_PIPELINE);
+            NodePtr* first = (pipeline == NULL) ? NULL :
+                (NodePtr*) vector_push(parser->arena, (void**) &pipeline->list.items,
+                                       &pipeline->list.count, &capacity, sizeof(NodePtr));
+            if(first == NULL) {
+                return ERROR_MALLOC_FAILURE;
+            }
+            *first = command;
+        }
+
+        st = skip_newlines(parser);
+        ERR_CHECK(st);
+        NodePtr* next = (NodePtr*) vector_push(parser->arena, (void**) &pipeline->list.items,
+                                               &pipeline->list.count, &capacity, sizeof(NodePtr));
+        if(next == NULL) {
+            return ERROR_MALLOC_FAILURE;
+        }
+        st = parse_command(parser, next);
+        ERR_CHECK(st);
+    }
+    *node = (pipeline != NULL) ? pipeline : command;
+
+    if(negate) {
+        NodePtr not_node = node_new(parser->arena, NODE_NOT);
+        if(not_node == NULL) {
+            return ERROR_MALLOC_FAILURE;
+        }
+        not_node->unary.body = *node;
+        *node = not_node;
+    }
+    return SUCCESS;
+} // parse_pipeline
+
+
+/**
+ * @brief       Parses pipeline [&& pipeline | || pipeline]...
+ */
+static StatusEnum parse_and_or(ParserPtr parser, NodePtr* node) {
+    StatusEnum st = parse_pipeline(parser, node);
+    ERR_CHECK(st);
+
+    while(1) {
+        st = peek(parser);
+        ERR_CHECK(st);
+        TokenTypeEnum type = parser->token.type;
+        if(type != TOKEN_AND_IF && type != TOKEN_OR_IF) {
+            return SUCCESS;
+        }
+        consume(parser);
+
+        NodePtr binary = node_new(parser->arena, (type == TOKEN_AND_IF) ? NODE_AND : NODE_OR);
+        if(binary == NULL) {
+            return ERROR_MALLOC_FAILURE;
+        }
+        binary->binary.left = *node;
+        st = skip_newlines(parser);
+        ERR_CHECK(st);
+        st = parse_pipeline(parser, &binary->binary.right);
+        ERR_CHECK(st);
+        *node = binary;
+    }
+} // parse_and_or
+
+
+/**
+ * @brief       Parses commands separated by ; & or newlines
+ *
+ * @param parser parser
+ * @param top_level 1 stops after newline, 0 continues until a closing reserved word
+ * @param node  output tree, NULL for empty list
+ */
+static StatusEnum parse_list(ParserPtr parser, uint8_t top_level, NodePtr* node) {
+    NodePtr* items = NULL;
+    uint32_t count = 0;
+    uint32_t capacity = 0;
+    StatusEnum st;
+
+    while(1) {
+        st = (top_level) ? peek(parser) : skip_newlines(parser);
+        ERR_CHECK(st);
+        if(parser->token.type == TOKEN_EOF || (!top_level && is_list_end(parser))) {
+            break;
+        }
+        if(parser->token.type == TOKEN_NEWLINE) {
+            consume(parser);
+            break;
+        }
+
+        uint32_t start = parser->token.offset;
+        NodePtr command;
+        st = parse_and_or(parser, &command);
+        ERR_CHECK(st);
+
+        st = peek(parser);
+        ERR_CHECK(st);
+        uint8_t separated = 1U;
+        if(parser->token.type == TOKEN_BG) {
+            NodePtr background = node_new(parser->arena, NODE_BACKGROUND);
+            if(background == NULL) {
+                return ERROR_MALLOC_FAILURE;
+            }
+            const char* text = parser->lexer->input + start;
+            uint32_t length = parser->token.offset - start;
+            while(length > 0 && (text[length - 1] == ' ' || text[length - 1] == '\t')) {
+                length--;
+            }
+            background->unary.body = command;
+            background->unary.text = arenaStrndup(parser->arena, text, length);
+            if(background->unary.text == NULL) {
+                return ERROR_MALLOC_FAILURE;
+            }
+            command = background;
+            consume(parser);
+        }
+        else if(parser->token.type == TOKEN_SEMI) {
+            consume(parser);
+        }
+        else if(parser->token.type != TOKEN_NEWLINE) {
+            separated = 0U;
+        }
+
+        NodePtr* slot = (NodePtr*) vector_push(parser->arena, (void**) &items, &count, &capacity, sizeof(NodePtr));
+        if(slot == NULL) {
+            return ERROR_MALLOC_FAILURE;
+        }
+        *slot = command;
+
+        // without separator only end of the list may follow
+        if(!separated) {
+            if(parser->token.type != TOKEN_EOF && (top_level || !is_list_end(parser))) {
+                return syntax_error(parser);
+            }
+            break;
+        }
+    }
+
+    if(count <= 1) {
+        *node = (count == 1) ? items[0] : NULL;
+        return SUCCESS;
+    }
+    *node = node_new(parser->arena, NODE_SEQUENCE);
+    if(*node == NULL) {
+        return ERROR_MALLOC_FAILURE;
+    }
+    (*node)->list.items = items;
+    (*node)->list.count = count;
+    return SUCCESS;
+} // parse_list
+
+
+/**
+ * @brief       Initializes parser reading tokens from lexer
+ *
+ * @param parser parser which will be initialized
+ * @param lexer token source
+ * @param arena arena for nodes, it is not reset by the parser
+ */
+void parser_init(ParserPtr parser, LexerPtr lexer, ArenaPtr arena) {
+    parser->lexer = lexer;
+    parser->arena = arena;
+    parser->has_token = 0U;
+    parser->heredocs = NULL;
+    parser->heredoc_count = 0;
+    parser->heredoc_capacity = 0;
+} // parser_init
+
+
+/**
+ * @brief       Parses one complete command (one line of commands)
+ *
+ *              Whole compound commands are parsed at once even when they span
+ *              many lines, the terminating newline is consumed and nothing
+ *              after it is read. Reserved words are recognized only in
+ *              command position
+ *
+ * @param parser parser
+ * @param node  output tree, NULL at the end of input
+ * @return      SUCCESS, ERROR_SHELL_MISUSE on syntax error (reported to stderr),
+ *              ERROR_MALLOC_FAILURE
+ */
+StatusEnum parse_complete_command(ParserPtr parser, NodePtr* node) {
+    *node = NULL;
+    // the vector lived in the arena of the previous command line
+    parser->heredocs = NULL;
+    parser->heredoc_count = 0;
+    parser->heredoc_capacity = 0;
+    StatusEnum st = peek(parser);
+    ERR_CHECK(st);
+
+    // empty line
+    if(parser->token.type == TOKEN_NEWLINE) {
+        consume(parser);
+        return SUCCESS;
+    }
+    if(parser->token.type == TOKEN_EOF) {
+        return SUCCESS;
+    }
+    return parse_list(parser, 1U, node);
+} // parse_complete_command
+
+
+/**
+ * @brief       Tells whether all input in the lexer buffer was consumed
+ * @return      1 when no token is pending and buffer is exhausted, 0 otherwise
+ */
+uint8_t parser_at_end(ParserPtr parser) {
+    if(parser->has_token) {
+        return (parser->token.type == TOKEN_EOF) ? 1U : 0U;
+    }
+    return (parser->lexer->position >= parser->lexer->length) ? 1U : 0U;
+} // parser_at_end
+
+
+/**
+ * @brief       Copies array of words with their text into arena
+ */
+static StatusEnum copy_words(WordPtr words, uint32_t count, ArenaPtr arena, WordPtr* copy) {
+    *copy = NULL;
+    if(count == 0) {
+        return SUCCESS;
+    }
+    *copy = (WordPtr) arenaAlloc(arena, sizeof(Word) * count);
+    if(*copy == NULL) {
+        return ERROR_MALLOC_FAILURE;
+    }
+    for(uint32_t i = 0; i < count; i++) {
+        (*copy)[i] = words[i];
+        (*copy)[i].text = arenaStrndup(arena, words[i].text, words[i].length);
+        if((*copy)[i].text == NULL) {
+            return ERROR_MALLOC_FAILURE;
+        }
+        StatusEnum st = arith_copy_word(words[i].arithmetic, (*copy)[i].text, arena, &(*copy)[i].arithmetic);
+        ERR_CHECK(st);
+    }
+    return SUCCESS;
+} // copy_words
+
+
+/**
+ * @brief       Deep copies tree into another arena
+ *
+ *              Used for function bodies which have to outlive the command line
+ *
+ * @param node  tree to copy, may be NULL
+ * @param arena destination arena
+ * @param copy  output copy
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+StatusEnum ast_copy(NodePtr node, ArenaPtr arena, NodePtr* copy) {
+    *copy = NULL;
+    if(node == NULL) {
+        return SUCCESS;
+    }
+
+    NodePtr result = (NodePtr) arenaAlloc(arena, sizeof(Node));
+    if(result == NULL) {
+        return ERROR_MALLOC_FAILURE;
+    }
+    *result = *node;
+    *copy = result;
+
+    StatusEnum st = SUCCESS;
+    RedirectionNodePtr* tail = &result->redirections;
+    for(RedirectionNodePtr r = node->redirections; r != NULL; r = r->next) {
+        RedirectionNodePtr redirection = (RedirectionNodePtr) arenaAlloc(arena, sizeof(RedirectionNode));
+        if(redirection == NULL) {
+            return ERROR_MALLOC_FAILURE;
+        }
+        *redirection = *r;
+        redirection->target.text = arenaStrndup(arena, r->target.text, r->target.length);
+        if(redirection->target.text == NULL) {
+            return ERROR_MALLOC_FAILURE;
+        }
+        st = arith_copy_word(r->target.arithmetic, redirection->target.text, arena, &redirection->target.arithmetic);
+        ERR_CHECK(st);
+        if(r->body.text != NULL) {
+            redirection->body.text = arenaStrndup(arena, r->body.text, r->body.length);
+            if(redirection->body.text == NULL) {
+                return ERROR_MALLOC_FAILURE;
+            }
+        }
+        *tail = redirection;
+        tail = &redirection->next;
+    }
+    *tail = NULL;
+
+    switch(node->type) {
+        case NODE_SIMPLE:
+            st = copy_words(node->simple.words, node->simple.word_count, arena, &result->simple.words);
+            ERR_CHECK(st);
+            return copy_words(node->simple.assignments, node->simple.assignment_count, arena,
+                              &result->simple.assignments);
+
+        case NODE_PIPELINE:
+        case NODE_SEQUENCE:
+            result->list.items = (NodePtr*) arenaAlloc(arena, sizeof(NodePtr) * node->list.count);
+            if(result->list.items == NULL) {
+                return ERROR_MALLOC_FAILURE;
+            }
+            for(uint32_t i = 0; i < node->list.count && st == SUCCESS; i++) {
+                st = ast_copy(node->list.items[i], arena, &result->list.items[i]);
+            }
+            return st;
+
+        case NODE_AND:
+        case NODE_OR:
+            st = ast_copy(node->binary.left, arena, &result->binary.left);
+            ERR_CHECK(st);
+            return ast_copy(node->binary.right, arena, &result->binary.right);
+
+        case NODE_BACKGROUND:
+            result->unary.text = arenaStrndup(arena, node->unary.text, strlen(node->unary.text));
+            if(result->unary.text == NULL) {
+                return ERROR_MALLOC_FAILURE;
+            }
+            return ast_copy(node->unary.body, arena, &result->unary.body);
+
+        case NODE_NOT:
+        case NODE_SUBSHELL:
+        case NODE_GROUP:
+            return ast_copy(node->unary.body, arena, &result->unary.body);
+
+        case NODE_IF:
+            st = ast_copy(node->conditional.condition, arena, &result->conditional.condition);
+            ERR_CHECK(st);
+            st = ast_copy(node->conditional.then_body, arena, &result->conditional.then_body);
+            ERR_CHECK(st);
+            return ast_copy(node->conditional.else_body, arena, &result->conditional.else_body);
+
+        case NODE_WHILE:
+        case NODE_UNTIL:
+            st = ast_copy(node->loop.condition, arena, &result->loop.condition);
+            ERR_CHECK(st);
+            return ast_copy(node->loop.body, arena, &result->loop.body);
+
+        case NODE_FOR:
+            result->for_loop.name = arenaStrndup(arena, node->for_loop.name, strlen(node->for_loop.name));
+            if(result->for_loop.name == NULL) {
+                return ERROR_MALLOC_FAILURE;
+            }
+            st = copy_words(node->for_loop.words, node->for_loop.word_count, arena, &result->for_loop.words);
+            ERR_CHECK(st);
+            return ast_copy(node->for_loop.body, arena, &result->for_loop.body);
+
+        case NODE_CASE: {
+            result->case_command.subject.text = arenaStrndup(arena, node->case_command.subject.text,
+                                                             node->case_command.subject.length);
+            if(result->case_command.subject.text == NULL) {
+                return ERROR_MALLOC_FAILURE;
+            }
+            st = arith_copy_word(node->case_command.subject.arithmetic, result->case_command.subject.text, arena,
+                                 &result->case_command.subject.arithmetic);
+            ERR_CHECK(st);
+            CaseItemPtr* item_tail = &result->case_command.items;
+            for(CaseItemPtr item = node->case_command.items; item != NULL; item = item->next) {
+                CaseItemPtr item_copy = (CaseItemPtr) arenaAlloc(arena, sizeof(CaseItem));
+                if(item_copy == NULL) {
+                    return ERROR_MALLOC_FAILURE;
+                }
+                *item_copy = *item;
+                st = copy_words(item->patterns, item->pattern_count, arena, &item_copy->patterns);
+                ERR_CHECK(st);
+                st = ast_copy(item->body, arena, &item_copy->body);
+                ERR_CHECK(st);
+                *item_tail = item_copy;
+                item_tail = &item_copy->next;
+            }
+            *item_tail = NULL;
+            return SUCCESS;
+        }
+
+        case NODE_FUNCTION:
+            result->function.name = arenaStrndup(arena, node->function.name, strlen(node->function.name));
+            if(result->function.name == NULL) {
+                return ERROR_MALLOC_FAILURE;
+            }
+            return ast_copy(node->function.body, arena, &result->function.body);
+    }
+    return SUCCESS;
+} // ast_copy
@@ -0,0 +1,170 @@
+#ifndef PARSER_H
+#define PARSER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../utils/error.h"
+#include "../data_structures/arena.h"
+#include "../lexer/lexer.h"
+#include "arith.h"
+
+// kinds of AST nodes
+typedef enum {
+    NODE_SIMPLE,        // words, assignments and redirections
+    NODE_PIPELINE,      // command | command ...
+    NODE_NOT,           // ! pipeline
+    NODE_AND,           // left && right
+    NODE_OR,            // left || right
+    NODE_SEQUENCE,      // commands separated by ; or newline
+    NODE_BACKGROUND,    // command &
+    NODE_SUBSHELL,      // ( list )
+    NODE_GROUP,         // { list; }
+    NODE_IF,            // if list; then list; [elif ...] [else list;] fi
+    NODE_WHILE,         // while list; do list; done
+    NODE_UNTIL,         // until list; do list; done
+    NODE_FOR,           // for name [in words]; do list; done
+    NODE_CASE,          // case word in pattern) list;; ... esac
+    NODE_FUNCTION       // name() compound-command
+} NodeTypeEnum;
+
+
+// word contains * ? or [...] and may be a pathname pattern, next to the TOKEN_FLAG_* bits
+#define WORD_FLAG_GLOB      0x08U
+
+
+/*  Word of the source kept for expansion at run time, words with flags 0
+    need no expansion and text is their final value */
+typedef struct word {
+    char* text;             // NUL terminated raw text, quotes are kept
+    uint32_t length;
+    uint32_t flags;         // TOKEN_FLAG_QUOTED, TOKEN_FLAG_EXPAND, TOKEN_FLAG_ARITH, WORD_FLAG_GLOB
+    ArithExpansionPtr arithmetic;   // compiled $(( )) of text
+} Word, *WordPtr;
+
+
+//
+typedef struct redirection_node {
+    struct redirection_node* next;
+    TokenTypeEnum type;         // redirector token TOKEN_LESS ... TOKEN_TLESS
+    int32_t io_number;          // redirected descriptor, -1 for the redirector default
+    Word target;
+    Word body;                  // here-document text read after the line, only for << <<-
+} RedirectionNode, *RedirectionNodePtr;
+
+
+//
+typedef struct case_item {
+    struct case_item* next;
+    WordPtr patterns;           // alternatives separated by |
+    uint32_t pattern_count;
+    struct node* body;          // NULL for empty item
+} CaseItem, *CaseItemPtr;
+
+
+/*  Node of the syntax tree, all nodes and words of one command line come
+    from one arena, function bodies are copied to an arena of their own */
+typedef struct node {
+    NodeTypeEnum type;
+    RedirectionNodePtr redirections;    // of simple and compound commands, in source order
+    union {
+        struct {
+            WordPtr words;
+            uint32_t word_count;
+            WordPtr assignments;        // NAME=value words preceding the command name
+            uint32_t assignment_count;
+        } simple;
+        struct {
+            struct node** items;
+            uint32_t count;
+        } list;                 // PIPELINE, SEQUENCE
+        struct {
+            struct node* left;
+            struct node* right;
+        } binary;               // AND, OR
+        struct {
+            struct node* body;
+            char* text;         // BACKGROUND: source of the command, listed by jobs
+        } unary;                // NOT, BACKGROUND, SUBSHELL, GROUP
+        struct {
+            struct node* condition;
+            struct node* then_body;
+            struct node* else_body;     // NULL without else, elif is nested IF
+        } conditional;
+        struct {
+            struct node* condition;
+            struct node* body;
+        } loop;                 // WHILE, UNTIL
+        struct {
+            char* name;
+            WordPtr words;
+            uint32_t word_count;
+            uint8_t has_in;     // without `in` positional parameters are used
+            struct node* body;
+        } for_loop;
+        struct {
+            Word subject;
+            CaseItemPtr items;
+        } case_command;
+        struct {
+            char* name;
+            struct node* body;
+        } function;
+    };
+} Node, *NodePtr;
+
+
+//
+typedef struct parser {
+    LexerPtr lexer;
+    ArenaPtr arena;             // nodes are allocated from here
+    Token token;                // lookahead token
+    uint8_t has_token;          // token holds a token not consumed yet
+    RedirectionNodePtr* heredocs;   // here-documents whose bodies follow the next newline
+    uint32_t heredoc_count;
+    uint32_t heredoc_capacity;
+} Parser, *ParserPtr;
+
+
+/**
+ * @brief       Initializes parser reading tokens from lexer
+ *
+ * @param parser parser which will be initialized
+ * @param lexer token source
+ * @param arena arena for nodes, it is not reset by the parser
+ */
+void parser_init(ParserPtr parser, LexerPtr lexer, ArenaPtr arena);
+
+/**
+ * @brief       Parses one complete command (one line of commands)
+ *
+ *              Whole compound commands are parsed at once even when they span
+ *              many lines, the terminating newline is consumed and nothing
+ *              after it is read. Reserved words are recognized only in
+ *              command position
+ *
+ * @param parser parser
+ * @param node  output tree, NULL at the end of input
+ * @return      SUCCESS, ERROR_SHELL_MISUSE on syntax error (reported to stderr),
+ *              ERROR_MALLOC_FAILURE
+ */
+StatusEnum parse_complete_command(ParserPtr parser, NodePtr* node);
+
+/**
+ * @brief       Tells whether all input in the lexer buffer was consumed
+ * @return      1 when no token is pending and buffer is exhausted, 0 otherwise
+ */
+uint8_t parser_at_end(ParserPtr parser);
+
+/**
+ * @brief       Deep copies tree into another arena
+ *
+ *              Used for function bodies which have to outlive the command line
+ *
+ * @param node  tree to copy, may be NULL
+ * @param arena destination arena
+ * @param copy  output copy
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+StatusEnum ast_copy(NodePtr node, ArenaPtr arena, NodePtr* copy);
+
+#endif
@@ -1,36 +1,441 @@
 #include "shell.h"
 
+// bytes read by readline are appended to a buffer growing by this step
+#define INTERACTIVE_BUFFER_STEP 256U
 
+// lines typed for one complete command, continuation lines are appended
+typedef struct interactive_input {
+    char* buffer;
+    size_t length;
+    size_t capacity;
+} InteractiveInput, *InteractiveInputPtr;
+
+// maximum number of phases measured by CYPRSH_STARTUP_PROFILE=1
+#define STARTUP_PHASES 8U
+
+// durations of startup phases, reported once the first command is read
+typedef struct startup_profile {
+    const char* names[STARTUP_PHASES];
+    uint64_t micros[STARTUP_PHASES];
+    uint32_t count;
+    uint64_t last;              // end of previous phase
+    uint8_t enabled;
+} StartupProfile;
+
+static StartupProfile startup_profile;
+// loaded by readline hook once the first prompt is shown
+static HistoryPtr deferred_history = NULL;
+
+
+/**
+ * @brief       Monotonic clock in microseconds
+ */
+static uint64_t monotonic_micros(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000U + (uint64_t)now.tv_nsec / 1000U;
+} // monotonic_micros
+
+
+/**
+ * @brief       Records time since the end of the previous phase
+ */
+static void startup_phase(const char* name) {
+    if(!startup_profile.enabled || startup_profile.count == STARTUP_PHASES) {
+        return;
+    }
+    uint64_t now = monotonic_micros();
+    startup_profile.names[startup_profile.count] = name;
+    startup_profile.micros[startup_profile.count++] = now - startup_profile.last;
+    startup_profile.last = now;
+} // startup_phase
+
+
+/**
+ * @brief       Starts next phase now, time spent waiting for the user is not counted
+ */
+static void startup_resume(void) {
+    if(startup_profile.enabled) {
+        startup_profile.last = monotonic_micros();
+    }
+} // startup_resume
+
+
+/**
+ * @brief       Prints recorded phases to stderr, only the first call does
+ */
+static void startup_report(void) {
+    if(!startup_profile.enabled) {
+        return;
+    }
+    startup_profile.enabled = 0U;
+    uint64_t total = 0;
+    for(uint32_t i = 0; i < startup_profile.count; i++) {
+        output_printf(STDERR_FILENO, "%s: startup: %-8s %8" PRIu64 " us\n", SHELL_NAME,
+                      startup_profile.names[i], startup_profile.micros[i]);
+        total += startup_profile.micros[i];
+    }
+    output_printf(STDERR_FILENO, "%s: startup: %-8s %8" PRIu64 " us\n", SHELL_NAME, "total", total);
+} // startup_report
+
+
+int main(int argc, char **argv, char** environ) {
+    const char* profile = getenv(STARTUP_PROFILE_VARIABLE);
+    if(profile != NULL && strcmp(profile, "1") == 0) {
+        startup_profile.enabled = 1U;
+        startup_profile.last = monotonic_micros();
+    }
+
+    // options come before the script name
+    uint8_t dump_bytecode = 0U;
+    if(argc >= 2 && strcmp(argv[1], SHELL_OPTION_DUMP_BYTECODE) == 0) {
+        dump_bytecode = 1U;
+        argv++;
+        argc--;
+    }
 
-uint32_t main(uint32_t argc, char **argv, char** environ) {
     int32_t file_descriptor = 0; // default stdin
-    if(argc == 2) {
-        open_file(argv[1], O_RDONLY, &file_descriptor);
+    if(argc >= 2) {
+        // commands of the script must not inherit it or lose it to a redirection
+        StatusEnum st = open_file(argv[1], O_RDONLY | O_CLOEXEC, &file_descriptor);
+        if(st != SUCCESS) {
+            output_flush();
+            return st;
+        }
+        file_descriptor = move_fd_above(file_descriptor, SHELL_FD_BASE);
+        if(file_descriptor == -1) {
+            print_errno(argv[1]);
+            output_flush();
+            return ERROR_DEFAULT;
+        }
+    }
+
+    ShellState shell;
+    StatusEnum st = shell_state_init(&shell, environ);
+    if(st != SUCCESS) {
+        return st;
+    }
+    shell.dump_bytecode = dump_bytecode;
+    startup_phase("state");
+    // script name and its arguments
+    if(argc >= 2) {
+        shell.script_name = argv[1];
+        shell.positional = argv + 2;
+        shell.positional_count = (uint32_t)(argc - 2);
+    }
+
+    st = run_shell(file_descriptor, &shell);
+    int32_t status = (st == SUCCESS || shell.exiting) ? shell.last_status : (int32_t)st;
+
+    output_flush();
+    shell_state_dispose(&shell);
+    close(file_descriptor);
+    return status;
+}
+
+
+/**
+ * @brief       Parses, compiles and executes complete commands until the lexer
+ *              runs out of input
+ *
+ *              Each complete command is parsed into a tree and compiled into
+ *              bytecode first, so compound commands run from the flat code and
+ *              their text is read only once
+ *
+ * @param shell shell state
+ * @param lexer token source
+ * @param single_line 1 stops when the lexer buffer is consumed instead of refilling it
+ * @param input script input, compacted between commands and shared with them on stdin,
+ *              NULL for other sources
+ * @return      SUCCESS, ERROR_SHELL_MISUSE on syntax error, ERROR_MALLOC_FAILURE
+ */
+static StatusEnum run_commands(ShellStatePtr shell, LexerPtr lexer, uint8_t single_line, InputSourcePtr input) {
+    Parser parser;
+    parser_init(&parser, lexer, &shell->command_arena);
+    // nested runs (command substitution) keep what their caller allocated
+    ArenaMark mark = arenaMark(&shell->command_arena);
+
+    StatusEnum st = SUCCESS;
+    while(!shell->exiting) {
+        // everything allocated for one command line is dropped at once
+        arenaRelease(&shell->command_arena, mark);
+        // nothing refers to the text of finished commands, a piped script is not kept whole
+        if(input != NULL && !parser.has_token) {
+            size_t dropped = input_compact(input, lexer->position);
+            if(dropped > 0) {
+                lexer->input = input->buffer + input->start;
+                lexer->length = input->length - input->start;
+                lexer->position -= dropped;
+            }
+        }
+
+        NodePtr node;
+        st = parse_complete_command(&parser, &node);
+        if(st != SUCCESS) {
+            shell->last_status = st;
+            break;
+        }
 
-        
+        if(node != NULL) {
+            ProgramPtr program;
+            st = compile_program(node, &shell->command_arena, &program);
+            if(st != SUCCESS) {
+                break;
+            }
+            if(shell->dump_bytecode) {
+                output_flush();
+                program_dump(program, &shell->command_arena, stderr);
+            }
+            // a command reading stdin gets what follows it in the script
+            if(input != NULL && !parser.has_token) {
+                input_sync_before(input, lexer->position);
+                st = vm_run(shell, program);
+                lexer->position = input_sync_after(input, lexer->position);
+            }
+            else {
+                st = vm_run(shell, program);
+            }
+            if(st != SUCCESS) {
+                break;
+            }
+        }
+        else if(parser.has_token && parser.token.type == TOKEN_EOF) {
+            break;
+        }
+
+        if(single_line && parser_at_end(&parser)) {
+            break;
+        }
+    }
+    arenaRelease(&shell->command_arena, mark);
+    return st;
+} // run_commands
+
+
+/**
+ * @brief       Parses and executes shell code from a string
+ *
+ * @param shell shell state
+ * @param text  shell code, it does not have to be NUL terminated
+ * @param length length of text
+ * @return      SUCCESS, ERROR_SHELL_MISUSE on syntax error, ERROR_MALLOC_FAILURE
+ */
+StatusEnum run_string(ShellStatePtr shell, const char* text, size_t length) {
+    Lexer lexer;
+    StatusEnum st = lexer_init(&lexer, text, length);
+    ERR_CHECK(st);
+    return run_commands(shell, &lexer, 0U, NULL);
+} // run_string
+
+
+/**
+ * @brief       Runs non interactive script from file descriptor
+ *
+ *              Regular files are mapped and lexed straight from the mapping,
+ *              pipes are read in large blocks as the lexer asks for more input.
+ *              A script on stdin leaves the lines after each command to it
+ *
+ * @param file_descriptor script input
+ * @param shell shell state
+ * @return      status of the script
+ */
+static StatusEnum run_script(int32_t file_descriptor, ShellStatePtr shell) {
+    InputSource input;
+    StatusEnum st = input_open(&input, file_descriptor);
+    if(st != SUCCESS) {
+        input_close(&input);
+        return st;
+    }
+
+    Lexer lexer;
+    st = lexer_init(&lexer, input.buffer + input.start, input.length - input.start);
+    if(st != SUCCESS) {
+        input_close(&input);
+        return st;
     }
+    if(!input.eof) {
+        lexer_set_refill(&lexer, input_lexer_refill, &input);
+    }
+
+    st = run_commands(shell, &lexer, 0U, &input);
 
-    HashTable env_table; 
-    populateEnvTable(&env_table, environ);
-        
+    input_close(&input);
+    return st;
+} // run_script
 
-    run_shell(file_descriptor, &env_table);
 
-    hashTableDispose(&env_table);
+/**
+ * @brief       Runs $HOME/.cyprshrc if there is one
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+static StatusEnum source_rc(ShellStatePtr shell) {
+    char* home = NULL;
+    if(shell_get_variable(shell, "HOME", &home) != SUCCESS || home == NULL || *home == '\0') {
+        return SUCCESS;
+    }
+    char path[PATH_MAX];
+    int length = snprintf(path, sizeof(path), "%s/%s", home, SHELL_RC_FILE);
+    if(length < 0 || (size_t)length >= sizeof(path)) {
+        return SUCCESS;
+    }
+    int32_t file_descriptor = open(path, O_RDONLY | O_CLOEXEC);
+    if(file_descriptor == -1) {
+        return SUCCESS;
+    }
+    StatusEnum st = run_script(file_descriptor, shell);
     close(file_descriptor);
+    // errors inside of the file are reported by the commands
+    return (st == ERROR_MALLOC_FAILURE) ? st : SUCCESS;
+} // source_rc
+
+
+/**
+ * @brief       Appends text and a newline to the interactive buffer
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+static StatusEnum interactive_append(InteractiveInputPtr input, const char* line) {
+    size_t length = strlen(line);
+    if(input->length + length + 1 > input->capacity) {
+        size_t capacity = input->length + length + 1 + INTERACTIVE_BUFFER_STEP;
+        char* buffer = (char*) realloc(input->buffer, capacity);
+        if(buffer == NULL) {
+            return ERROR_MALLOC_FAILURE;
+        }
+        input->buffer = buffer;
+        input->capacity = capacity;
+    }
+    memcpy(input->buffer + input->length, line, length);
+    input->length += length;
+    input->buffer[input->length++] = '\n';
+    return SUCCESS;
+} // interactive_append
+
+
+/**
+ * @brief       Lexer refill reading continuation line of unfinished command
+ */
+static StatusEnum interactive_refill(void* context, const char** input, size_t* length) {
+    InteractiveInputPtr interactive = (InteractiveInputPtr) context;
+    output_flush();
+    char* line = readline(SHELL_CONTINUATION_PROMPT);
+    if(line == NULL) {
+        return SUCCESS;
+    }
+    StatusEnum st = interactive_append(interactive, line);
+    free(line);
+    ERR_CHECK(st);
+
+    *input = interactive->buffer;
+    *length = interactive->length;
+    return SUCCESS;
+} // interactive_refill
+
+
+/**
+ * @brief       Readline hook loading history after the first prompt is shown
+ *
+ *              Runs before the first key is read, so history is complete
+ *              for every key while the prompt does not wait for the file
+ */
+static int load_deferred_history(void) {
+    rl_pre_input_hook = NULL;
+    startup_phase("prompt");
+    // a partial load on malloc failure only loses old entries
+    history_load(deferred_history);
+    // readline took the history position before the entries were added
+    using_history();
+    startup_phase("history");
     return 0;
-}
+} // load_deferred_history
+
+
+/**
+ * @brief       Reads commands with readline until end of input
+ *
+ *              Unfinished compound commands and quotes continue on next
+ *              lines, the whole command is stored in history as one entry.
+ *              History and the rc file are left until the prompt is shown
+ *              and the first command is read
+ *
+ * @param shell shell state
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+static StatusEnum run_interactive(ShellStatePtr shell) {
+    History history;
+    StatusEnum st = history_open(&history, HISTORY_FILE_PATH);
+    if(st != SUCCESS) {
+        history_close(&history);
+        return st;
+    }
+    deferred_history = &history;
+    rl_pre_input_hook = load_deferred_history;
+    startup_phase("open");
+    output_flush();
+
+    InteractiveInput input = {NULL, 0, 0};
+    uint8_t rc_sourced = 0U;
+    char* line;
+    while(!shell->exiting && (line = readline(SHELL_PROMPT)) != NULL) {
+        input.length = 0;
+        st = interactive_append(&input, line);
+        free(line);
+        if(st != SUCCESS) {
+            break;
+        }
+        if(!rc_sourced) {
+            rc_sourced = 1U;
+            startup_resume();
+            st = source_rc(shell);
+            startup_phase("rc");
+            startup_report();
+            output_flush();
+            if(st != SUCCESS || shell->exiting) {
+                break;
+            }
+        }
+
+        Lexer lexer;
+        st = lexer_init(&lexer, input.buffer, input.length);
+        // syntax errors only end the current command
+        if(st == SUCCESS) {
+            lexer_set_refill(&lexer, interactive_refill, &input);
+            st = run_commands(shell, &lexer, 1U, NULL);
+        }
+        // finished background jobs and output of the command appear before the next prompt
+        jobs_notify(&shell->jobs);
+        output_flush();
+
+        if(input.length > 1) {
+            input.buffer[input.length - 1] = '\0';
+            if(history_add(&history, input.buffer) != SUCCESS) {
+                st = ERROR_MALLOC_FAILURE;
+            }
+        }
+        if(st == ERROR_MALLOC_FAILURE) {
+            break;
+        }
+        st = SUCCESS;
+    }
+    startup_report();
+    free(input.buffer);
+    rl_pre_input_hook = NULL;
+    deferred_history = NULL;
+    history_close(&history);
+    return st;
+} // run_interactive
 
 
-StatusEnum run_shell(int32_t file_descriptor, HashTablePtr env_table) {
+StatusEnum run_shell(int32_t file_descriptor, ShellStatePtr shell) {
     // non-execute mode
     if(isatty(file_descriptor)) {
-        create_file(HISTORY_FILE_PATH);
-        using_history();
-        read_history(HISTORY_FILE_PATH);
-        readline("cyprSH>");
+        return run_interactive(shell);
     }
-    fdopen();
 
-    // load history file or create it if it does not exist
-}
\ No newline at end of file
+    startup_report();
+    StatusEnum st = run_script(file_descriptor, shell);
+    // failed ${name?word} or $(( )) ends a non-interactive shell with the status it set
+    if(st == ERROR_FATAL_EXPANSION) {
+        shell->exiting = 1U;
+    }
+    return st;
+}
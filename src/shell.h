@@ -1,9 +1,40 @@
+#ifndef SHELL_H
+#define SHELL_H
+
 #include "./utils/file.h"
+#include "./utils/input.h"
+#include "./utils/history.h"
 #include "./data_structures/htab.h"
 #include "./utils/env.h"
+#include "./lexer/lexer.h"
+#include "./exec/exec.h"
+#include "./exec/vm.h"
+#include "./exec/variables.h"
+#include "./parser/parser.h"
+#include <time.h>
+#include <inttypes.h>
 #include <readline/readline.h>
 #include <readline/history.h>
 
 #define HISTORY_FILE_PATH "./CyprSH_history"
+#define SHELL_PROMPT "cyprSH>"
+#define SHELL_CONTINUATION_PROMPT "> "
+#define SHELL_OPTION_DUMP_BYTECODE "--dump-bytecode"
+// sourced from $HOME before the first command of an interactive shell
+#define SHELL_RC_FILE ".cyprshrc"
+// set to 1 to print how long each startup phase took
+#define STARTUP_PROFILE_VARIABLE "CYPRSH_STARTUP_PROFILE"
+
+StatusEnum run_shell(int32_t file_descriptior, ShellStatePtr shell);
+
+/**
+ * @brief       Parses and executes shell code from a string
+ *
+ * @param shell shell state
+ * @param text  shell code, it does not have to be NUL terminated
+ * @param length length of text
+ * @return      SUCCESS, ERROR_SHELL_MISUSE on syntax error, ERROR_MALLOC_FAILURE
+ */
+StatusEnum run_string(ShellStatePtr shell, const char* text, size_t length);
 
-StatusEnum run_shell(int32_t file_descriptior, HashTablePtr env_table);
\ No newline at end of file
+#endif
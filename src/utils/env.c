@@ -3,9 +3,16 @@
  */
 #include "env.h"
 
+// first size of envp and dirty key vectors
+#define ENV_EXPORT_MIN_CAPACITY 16U
+
 
 /**
- *  @brief
+ * @brief       Creates env table from the environment of the process, all of it is exported
+ *
+ * @param env_table table passed by address
+ * @param environ environment of the shell process
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
  */
 StatusEnum populateEnvTable(HashTablePtr env_table, char** environ) {
     if(env_table == NULL || environ == NULL) {
@@ -27,6 +34,9 @@ StatusEnum populateEnvTable(HashTablePtr env_table, char** environ) {
         // insert into hashmap
         *value = '\0';
         st = hashTableInsert(env_table, *environ, value + 1);
+        if(st == SUCCESS) {
+            hashTableFindItem(env_table, *environ)->flags |= ENV_EXPORTED;
+        }
         *value = '=';
 
         if(st != SUCCESS){
@@ -37,4 +47,412 @@ StatusEnum populateEnvTable(HashTablePtr env_table, char** environ) {
         environ++;
     }
     return st;
-}
\ No newline at end of file
+}
+
+
+/**
+ * @brief       Allocates "KEY=VALUE" string
+ * @return      new string, NULL on malloc failure
+ */
+static char* envEntryNew(const char* key, const char* value) {
+    size_t key_length = strlen(key);
+    size_t value_length = strlen(value);
+    char* entry = (char*) malloc(key_length + value_length + 2);
+    if(entry == NULL) {
+        return NULL;
+    }
+    memcpy(entry, key, key_length);
+    entry[key_length] = '=';
+    memcpy(entry + key_length + 1, value, value_length + 1);
+    return entry;
+} // envEntryNew
+
+
+/**
+ * @brief       Records slot of key in the index
+ * @param slot  index in envp, -1 while the key has no entry
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+static StatusEnum envExportIndex(EnvExportPtr env_export, const char* key, int64_t slot) {
+    HashTableItemPtr item = hashTableFindItem(&env_export->slots, key);
+    if(item == NULL) {
+        StatusEnum st = hashTableInsert(&env_export->slots, key, "");
+        ERR_CHECK(st);
+        item = hashTableFindItem(&env_export->slots, key);
+    }
+    item->number = slot;
+    return SUCCESS;
+} // envExportIndex
+
+
+/**
+ * @brief       Frees cached strings, vector itself is kept
+ */
+static void envExportClear(EnvExportPtr env_export) {
+    for(uint32_t i = 0; i < env_export->count; i++) {
+        free(env_export->envp[i]);
+    }
+    env_export->count = 0;
+    env_export->envp[0] = NULL;
+    env_export->dirty_count = 0;
+} // envExportClear
+
+
+/**
+ * @brief       Makes room for one more envp entry and the NULL terminator
+ */
+static StatusEnum envExportReserve(EnvExportPtr env_export) {
+    if(env_export->count + 2 <= env_export->capacity) {
+        return SUCCESS;
+    }
+    uint32_t new_capacity = env_export->capacity * 2;
+    char** new_envp = (char**) realloc(env_export->envp, sizeof(char*) * new_capacity);
+    if(new_envp == NULL) {
+        return ERROR_MALLOC_FAILURE;
+    }
+    env_export->envp = new_envp;
+    env_export->capacity = new_capacity;
+    return SUCCESS;
+} // envExportReserve
+
+
+/**
+ * @brief       Serializes whole env table into envp
+ */
+static StatusEnum envExportRebuild(EnvExportPtr env_export, HashTablePtr env_table) {
+    envExportClear(env_export);
+    hashTableDtor(&env_export->slots);
+    StatusEnum st = hashTableCtor(&env_export->slots);
+    ERR_CHECK(st);
+
+    uint32_t position = 0;
+    char* key;
+    char* value;
+    while(hashTableIterate(env_table, &position, &key, &value)) {
+        if(!envIsExported(env_table, key)) {
+            continue;
+        }
+        st = envExportReserve(env_export);
+        ERR_CHECK(st);
+        char* entry = envEntryNew(key, value);
+        if(entry == NULL) {
+            return ERROR_MALLOC_FAILURE;
+        }
+        env_export->envp[env_export->count++] = entry;
+        env_export->envp[env_export->count] = NULL;
+        st = envExportIndex(env_export, key, env_export->count - 1);
+        ERR_CHECK(st);
+    }
+    env_export->full_rebuild = 0U;
+    return SUCCESS;
+} // envExportRebuild
+
+
+/**
+ * @brief       Brings envp slot of one key in line with the env table
+ *
+ *              Clears the dirty flag of the key, key may be freed on the way
+ */
+static StatusEnum envExportSync(EnvExportPtr env_export, HashTablePtr env_table, const char* key) {
+    HashTableItemPtr index = hashTableFindItem(&env_export->slots, key);
+    int64_t slot = index->number;
+    char* value = NULL;
+
+    // key was removed or is not exported, move last entry into its slot
+    if(!envIsExported(env_table, key) || hashTableGetValue(env_table, key, &value) != SUCCESS) {
+        if(slot != -1) {
+            free(env_export->envp[slot]);
+            env_export->envp[slot] = env_export->envp[--env_export->count];
+            env_export->envp[env_export->count] = NULL;
+            if(slot < env_export->count) {
+                // key of the moved entry ends at its =
+                char* moved = env_export->envp[slot];
+                char* equals = strchr(moved, '=');
+                *equals = '\0';
+                HashTableItemPtr item = hashTableFindItem(&env_export->slots, moved);
+                *equals = '=';
+                item->number = slot;
+            }
+        }
+        hashTableRemove(&env_export->slots, key);
+        return SUCCESS;
+    }
+
+    char* entry = envEntryNew(key, value);
+    if(entry == NULL) {
+        return ERROR_MALLOC_FAILURE;
+    }
+
+    if(slot != -1) {
+        free(env_export->envp[slot]);
+        env_export->envp[slot] = entry;
+        index->flags &= ~ENV_SLOT_DIRTY;
+        return SUCCESS;
+    }
+
+    StatusEnum st = envExportReserve(env_export);
+    if(st != SUCCESS) {
+        free(entry);
+        return st;
+    }
+    index->number = env_export->count;
+    index->flags &= ~ENV_SLOT_DIRTY;
+    env_export->envp[env_export->count++] = entry;
+    env_export->envp[env_export->count] = NULL;
+    return SUCCESS;
+} // envExportSync
+
+
+/**
+ * @brief       Remembers that key changed since the last snapshot
+ *
+ *              Every key is listed once however often it changes, the list
+ *              holds the key of its slots index item so nothing is copied
+ */
+static void envExportMarkDirty(EnvExportPtr env_export, const char* key) {
+    env_export->generation++;
+    if(env_export->full_rebuild) {
+        return;
+    }
+
+    HashTableItemPtr index = hashTableFindItem(&env_export->slots, key);
+    if(index != NULL && (index->flags & ENV_SLOT_DIRTY)) {
+        return;
+    }
+
+    // once more keys changed than are exported, rebuilding everything is cheaper
+    if(env_export->dirty_count >= env_export->count + ENV_EXPORT_MIN_CAPACITY) {
+        env_export->full_rebuild = 1U;
+        return;
+    }
+
+    if(env_export->dirty_count == env_export->dirty_capacity) {
+        uint32_t new_capacity = env_export->dirty_capacity * 2;
+        const char** new_dirty = (const char**) realloc(env_export->dirty, sizeof(char*) * new_capacity);
+        if(new_dirty == NULL) {
+            env_export->full_rebuild = 1U;
+            return;
+        }
+        env_export->dirty = new_dirty;
+        env_export->dirty_capacity = new_capacity;
+    }
+
+    // new key waits in the index without an envp entry
+    if(index == NULL) {
+        if(envExportIndex(env_export, key, -1) != SUCCESS) {
+            env_export->full_rebuild = 1U;
+            return;
+        }
+        index = hashTableFindItem(&env_export->slots, key);
+    }
+    index->flags |= ENV_SLOT_DIRTY;
+    env_export->dirty[env_export->dirty_count++] = index->key;
+} // envExportMarkDirty
+
+
+/**
+ * @brief       Initializes export vector and serializes whole env table into it
+ *
+ * @param env_export export vector passed by address
+ * @param env_table table the vector is derived from
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+StatusEnum envExportCtor(EnvExportPtr env_export, HashTablePtr env_table) {
+    if(env_export == NULL || env_table == NULL) {
+        return ERROR_DEFAULT;
+    }
+
+    memset(env_export, 0, sizeof(*env_export));
+    env_export->capacity = ENV_EXPORT_MIN_CAPACITY;
+    env_export->envp = (char**) malloc(sizeof(char*) * env_export->capacity);
+    env_export->dirty_capacity = ENV_EXPORT_MIN_CAPACITY;
+    env_export->dirty = (const char**) malloc(sizeof(char*) * env_export->dirty_capacity);
+    if(env_export->envp == NULL || env_export->dirty == NULL) {
+        envExportDtor(env_export);
+        return ERROR_MALLOC_FAILURE;
+    }
+    env_export->envp[0] = NULL;
+
+    StatusEnum st = hashTableCtor(&env_export->unset_exports);
+    if(st != SUCCESS) {
+        envExportDtor(env_export);
+        return st;
+    }
+    st = envExportRebuild(env_export, env_table);
+    if(st != SUCCESS) {
+        envExportDtor(env_export);
+    }
+    return st;
+} // envExportCtor
+
+
+/**
+ * @brief       Frees export vector and all cached strings
+ */
+void envExportDtor(EnvExportPtr env_export) {
+    if(env_export == NULL) {
+        return;
+    }
+    if(env_export->envp != NULL) {
+        envExportClear(env_export);
+    }
+    hashTableDtor(&env_export->slots);
+    hashTableDtor(&env_export->unset_exports);
+    free(env_export->envp);
+    free(env_export->dirty);
+    env_export->envp = NULL;
+    env_export->dirty = NULL;
+    env_export->capacity = 0;
+    env_export->dirty_capacity = 0;
+} // envExportDtor
+
+
+/**
+ * @brief       Sets variable in env table, an exported one is marked changed for the export vector
+ *
+ * @param env_table environment table
+ * @param env_export export vector derived from env_table
+ * @param key   variable name
+ * @param value new value
+ * @return      SUCCESS or status of hashTableInsert
+ */
+StatusEnum envSet(HashTablePtr env_table, EnvExportPtr env_export, const char* key, const char* value) {
+    StatusEnum st = hashTableInsert(env_table, key, value);
+    ERR_CHECK(st);
+
+    // the attribute survives reassignment, a new name may have been exported before
+    HashTableItemPtr item = hashTableFindItem(env_table, key);
+    if(!(item->flags & ENV_EXPORTED) && env_export->unset_exports.currentSize > 0 &&
+       hashTableFindItem(&env_export->unset_exports, key) != NULL) {
+        hashTableRemove(&env_export->unset_exports, key);
+        item->flags |= ENV_EXPORTED;
+    }
+    if(item->flags & ENV_EXPORTED) {
+        envExportMarkDirty(env_export, key);
+    }
+    return SUCCESS;
+} // envSet
+
+
+/**
+ * @brief       Gives variable the export attribute
+ *
+ *              Name which is not set yet is exported once it is assigned
+ *
+ * @param env_table environment table
+ * @param env_export export vector derived from env_table
+ * @param key   variable name
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+StatusEnum envExport(HashTablePtr env_table, EnvExportPtr env_export, const char* key) {
+    HashTableItemPtr item = hashTableFindItem(env_table, key);
+    if(item == NULL) {
+        return hashTableInsert(&env_export->unset_exports, key, "");
+    }
+    if(!(item->flags & ENV_EXPORTED)) {
+        item->flags |= ENV_EXPORTED;
+        envExportMarkDirty(env_export, key);
+    }
+    return SUCCESS;
+} // envExport
+
+
+/**
+ * @brief       Tells whether variable is passed to commands
+ *
+ * @param env_table environment table
+ * @param key   variable name
+ * @return      1 when key is set and exported, 0 otherwise
+ */
+uint8_t envIsExported(HashTablePtr env_table, const char* key) {
+    HashTableItemPtr item = hashTableFindItem(env_table, key);
+    return (item != NULL && (item->flags & ENV_EXPORTED)) ? 1U : 0U;
+} // envIsExported
+
+
+/**
+ * @brief       Marks key changed for the export vector after its item was updated directly
+ *
+ * @param env_export export vector
+ * @param key   variable name
+ */
+void envMarkChanged(EnvExportPtr env_export, const char* key) {
+    envExportMarkDirty(env_export, key);
+} // envMarkChanged
+
+
+/**
+ * @brief       Removes variable with its export attribute from env table, an exported
+ *              one is marked changed for the export vector
+ *
+ * @param env_table environment table
+ * @param env_export export vector derived from env_table
+ * @param key   variable name
+ * @return      SUCCESS or status of hashTableRemove
+ */
+StatusEnum envUnset(HashTablePtr env_table, EnvExportPtr env_export, const char* key) {
+    uint8_t exported = envIsExported(env_table, key);
+    StatusEnum st = hashTableRemove(env_table, key);
+    ERR_CHECK(st);
+    if(env_export->unset_exports.currentSize > 0) {
+        hashTableRemove(&env_export->unset_exports, key);
+    }
+    if(exported) {
+        envExportMarkDirty(env_export, key);
+    }
+    return SUCCESS;
+} // envUnset
+
+
+/**
+ * @brief       Returns envp for execve matching exported variables of env table
+ *
+ *              When nothing changed since the last call cached vector is returned
+ *              right away, otherwise only changed keys are reserialized
+ *
+ * @param env_export export vector
+ * @param env_table table the vector is derived from
+ * @param envp  output NULL terminated vector, valid until next change
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+StatusEnum envGetEnvp(EnvExportPtr env_export, HashTablePtr env_table, char*** envp) {
+    if(env_export == NULL || env_table == NULL || envp == NULL) {
+        return ERROR_DEFAULT;
+    }
+
+    if(env_export->built_generation != env_export->generation) {
+        StatusEnum st = SUCCESS;
+        if(!env_export->full_rebuild) {
+            for(uint32_t i = 0; i < env_export->dirty_count && st == SUCCESS; i++) {
+                st = envExportSync(env_export, env_table, env_export->dirty[i]);
+            }
+            env_export->dirty_count = 0;
+            // synced keys lost their flags, a failed sync is retried by a rebuild
+            env_export->full_rebuild = (st != SUCCESS) ? 1U : 0U;
+        }
+        if(env_export->full_rebuild) {
+            st = envExportRebuild(env_export, env_table);
+        }
+        ERR_CHECK(st);
+        env_export->built_generation = env_export->generation;
+    }
+
+    *envp = env_export->envp;
+    return SUCCESS;
+} // envGetEnvp
+
+
+/**
+ * @brief       Finds entry of key in the vector returned by the last envGetEnvp()
+ *
+ * @param env_export export vector
+ * @param key   variable name
+ * @return      index of the entry, -1 when key has none
+ */
+int64_t envEntryIndex(EnvExportPtr env_export, const char* key) {
+    HashTableItemPtr index = hashTableFindItem(&env_export->slots, key);
+    if(index == NULL || index->number < 0 || index->number >= env_export->count) {
+        return -1;
+    }
+    return index->number;
+} // envEntryIndex
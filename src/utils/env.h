@@ -1,4 +1,125 @@
+#ifndef ENV_H
+#define ENV_H
+
 #include "error.h"
 #include "../data_structures/htab.h"
 
-StatusEnum populateEnvTable(HashTablePtr env_table, char** environ);
\ No newline at end of file
+// flag of slots index item whose key is in the dirty list
+#define ENV_SLOT_DIRTY 0x0100U
+// flag of env table item which is passed to commands
+#define ENV_EXPORTED 0x0200U
+
+/*  envp vector for execve derived from the exported variables of the env
+    table, every "KEY=VALUE" string is cached and only keys changed since the last snapshot are
+    reserialized, unchanged environment is handed out in O(1) */
+typedef struct env_export {
+    char** envp;                // NULL terminated "KEY=VALUE" vector
+    uint32_t count;
+    uint32_t capacity;
+    HashTable slots;            // key -> index of its entry in envp (-1 if none), kept in the item number
+    const char** dirty;         // keys changed since last snapshot, point to keys of slots
+    uint32_t dirty_count;
+    uint32_t dirty_capacity;
+    HashTable unset_exports;    // names exported before they were set
+    uint8_t full_rebuild;       // too many changes, rebuild from table
+    uint64_t generation;        // bumped by every envSet/envUnset
+    uint64_t built_generation;  // generation envp corresponds to
+} EnvExport, *EnvExportPtr;
+
+/**
+ * @brief       Creates env table from the environment of the process, all of it is exported
+ *
+ * @param env_table table passed by address
+ * @param environ environment of the shell process
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+StatusEnum populateEnvTable(HashTablePtr env_table, char** environ);
+
+/**
+ * @brief       Initializes export vector and serializes whole env table into it
+ *
+ * @param env_export export vector passed by address
+ * @param env_table table the vector is derived from
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+StatusEnum envExportCtor(EnvExportPtr env_export, HashTablePtr env_table);
+
+/**
+ * @brief       Frees export vector and all cached strings
+ */
+void envExportDtor(EnvExportPtr env_export);
+
+/**
+ * @brief       Sets variable in env table, an exported one is marked changed for the export vector
+ *
+ * @param env_table environment table
+ * @param env_export export vector derived from env_table
+ * @param key   variable name
+ * @param value new value
+ * @return      SUCCESS or status of hashTableInsert
+ */
+StatusEnum envSet(HashTablePtr env_table, EnvExportPtr env_export, const char* key, const char* value);
+
+/**
+ * @brief       Gives variable the export attribute
+ *
+ *              Name which is not set yet is exported once it is assigned
+ *
+ * @param env_table environment table
+ * @param env_export export vector derived from env_table
+ * @param key   variable name
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+StatusEnum envExport(HashTablePtr env_table, EnvExportPtr env_export, const char* key);
+
+/**
+ * @brief       Tells whether variable is passed to commands
+ *
+ * @param env_table environment table
+ * @param key   variable name
+ * @return      1 when key is set and exported, 0 otherwise
+ */
+uint8_t envIsExported(HashTablePtr env_table, const char* key);
+
+/**
+ * @brief       Marks key changed for the export vector after its item was updated directly
+ *
+ * @param env_export export vector
+ * @param key   variable name
+ */
+void envMarkChanged(EnvExportPtr env_export, const char* key);
+
+/**
+ * @brief       Removes variable with its export attribute from env table, an exported
+ *              one is marked changed for the export vector
+ *
+ * @param env_table environment table
+ * @param env_export export vector derived from env_table
+ * @param key   variable name
+ * @return      SUCCESS or status of hashTableRemove
+ */
+StatusEnum envUnset(HashTablePtr env_table, EnvExportPtr env_export, const char* key);
+
+/**
+ * @brief       Returns envp for execve matching exported variables of env table
+ *
+ *              When nothing changed since the last call cached vector is returned
+ *              right away, otherwise only changed keys are reserialized
+ *
+ * @param env_export export vector
+ * @param env_table table the vector is derived from
+ * @param envp  output NULL terminated vector, valid until next change
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+StatusEnum envGetEnvp(EnvExportPtr env_export, HashTablePtr env_table, char*** envp);
+
+/**
+ * @brief       Finds entry of key in the vector returned by the last envGetEnvp()
+ *
+ * @param env_export export vector
+ * @param key   variable name
+ * @return      index of the entry, -1 when key has none
+ */
+int64_t envEntryIndex(EnvExportPtr env_export, const char* key);
+
+#endif
@@ -1,7 +1,20 @@
 #include "error.h"
+#include "output.h"
 #include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
 
 
 void print_errno(const char *path) {
-    fprintf(stderr, "%s: %s\n", path, strerror(errno));
+    output_printf(STDERR_FILENO, "%s: %s\n", path, strerror(errno));
+}
+
+
+void print_error(const char* format, ...) {
+    char message[1024];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+    output_printf(STDERR_FILENO, SHELL_NAME ": %s\n", message);
 }
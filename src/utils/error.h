@@ -1,3 +1,6 @@
+#ifndef ERROR_H
+#define ERROR_H
+
 #include <errno.h>
 
 #define ERR_CHECK(status) do { \
@@ -13,10 +16,20 @@ typedef enum return_values {
     ERROR_MALLOC_FAILURE=3,
     ERROR_INT_OVERFLOW=4,
     ERROR_INDEX_OUT_OF_BOUNDS=5,
+    ERROR_FATAL_EXPANSION=6,    // ${name?word} or $(( )) failed, a non-interactive shell exits
     ERROR_COMM_CANNOT_EXEC=126,
     ERROR_COMMAND_NOT_FOUND=127,
 } StatusEnum;
 
 void print_errno(const char *path);
 
-void print_error(void);
\ No newline at end of file
+// prefix of all shell diagnostics
+#define SHELL_NAME "cyprsh"
+
+/**
+ * @brief       Prints shell diagnostic "cyprsh: <message>" to stderr
+ * @param format printf like format of the message
+ */
+void print_error(const char* format, ...);
+
+#endif
@@ -1,39 +1,264 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
 #include "file.h"
 
-StatusEnum open_file(const char* path, uint32_t flag, int32_t* file_descriptor) {
-    *file_descriptor = open(path, flag, 0644);
-    if(*file_descriptor != -1) {
-        return;
-    }
-    print_errno(path);
+// copies of pipe data which file_read_line() looks at before taking the line out of the pipe
+static int32_t peek_pipe[2] = {-1, -1};
+
+
+/**
+ * @brief       Maps errno of failed open() to shell exit status
+ */
+static StatusEnum open_errno_status(void) {
     if(errno == EACCES || errno == EISDIR) {
-        error = EXIT_COMM_CANNOT_EXEC;
+        return ERROR_COMM_CANNOT_EXEC;
     }
     else if(errno == ENOENT || errno == ENOTDIR) {
-        error = EXIT_COMMAND_NOT_FOUND;
+        return ERROR_COMMAND_NOT_FOUND;
     }
-    else {
-        error = EXIT_ERROR;
+    return ERROR_DEFAULT;
+} // open_errno_status
+
+
+StatusEnum open_file(const char* path, uint32_t flag, int32_t* file_descriptor) {
+    *file_descriptor = open(path, flag, 0644);
+    if(*file_descriptor != -1) {
+        return SUCCESS;
     }
+    print_errno(path);
+    return open_errno_status();
 }
 
 
-void create_file(const char* path) {
-    uint32_t file_descriptor = open(path, O_CREAT | O_EXCL, 0644); // owner rw any other r
+StatusEnum create_file(const char* path) {
+    int32_t file_descriptor = open(path, O_CREAT | O_EXCL, 0644); // owner rw any other r
     if(file_descriptor >= 0) {
         close(file_descriptor); // also close it we just want to create it
-        return;
+        return SUCCESS;
     }
-    else if(file_descriptor == -1) {
-        print_errno(path);
-        if(errno == EACCES || errno == EISDIR) {
-            error = EXIT_COMM_CANNOT_EXEC;
+    // already existing file is fine
+    if(errno == EEXIST) {
+        return SUCCESS;
+    }
+    print_errno(path);
+    return open_errno_status();
+}
+
+
+/**
+ * @brief       Creates pipe whose both ends are closed on exec
+ *
+ * @param fds   output read end fds[0] and write end fds[1]
+ * @return      SUCCESS, ERROR_DEFAULT (reported to stderr)
+ */
+StatusEnum open_pipe(int32_t fds[2]) {
+    if(pipe2(fds, O_CLOEXEC) == -1) {
+        print_errno(SHELL_NAME);
+        return ERROR_DEFAULT;
+    }
+    return SUCCESS;
+} // open_pipe
+
+
+/**
+ * @brief       Moves descriptor to minimum or above, the new one is closed on exec
+ *
+ *              Keeps low descriptors free for redirections of the user
+ *
+ * @param fd    descriptor, -1 is passed through
+ * @param minimum lowest acceptable number
+ * @return      descriptor, -1 on failure with errno set (fd is closed)
+ */
+int32_t move_fd_above(int32_t fd, int32_t minimum) {
+    if(fd == -1 || fd >= minimum) {
+        return fd;
+    }
+    int32_t moved = fcntl(fd, F_DUPFD_CLOEXEC, minimum);
+    int32_t saved_errno = errno;
+    close(fd);
+    errno = saved_errno;
+    return moved;
+} // move_fd_above
+
+
+/**
+ * @brief       Enlarges pipe buffer so a writer in the shell can hand over
+ *              large blocks with few writes and wakeups of the reader
+ *
+ *              Best effort, the pipe keeps its size when the limit of the
+ *              system (/proc/sys/fs/pipe-max-size) does not allow it
+ *
+ * @param fd    either end of the pipe
+ * @param size  wanted capacity in bytes
+ */
+void pipe_grow(int32_t fd, int32_t size) {
+    // EPERM above the limit and EBUSY when data does not fit leave the pipe as it was
+    fcntl(fd, F_SETPIPE_SZ, size);
+} // pipe_grow
+
+
+/**
+ * @brief       Closes peek pipe inherited by a forked child, it gets its own
+ */
+static void peek_pipe_forget(void) {
+    if(peek_pipe[0] != -1) {
+        close(peek_pipe[0]);
+        close(peek_pipe[1]);
+        peek_pipe[0] = -1;
+        peek_pipe[1] = -1;
+    }
+} // peek_pipe_forget
+
+
+/**
+ * @brief       Copies data waiting in a pipe without taking it out
+ *
+ *              tee() duplicates the pipe buffer into the peek pipe which is
+ *              then read, the source keeps the data for the read which
+ *              takes only the bytes up to the newline
+ *
+ * @param fd    pipe
+ * @param buffer output copy of the data
+ * @param size  size of buffer
+ * @return      number of bytes, 0 on end of file, -1 on error with errno set
+ */
+static ssize_t peek_pipe_data(int32_t fd, char* buffer, size_t size) {
+    if(peek_pipe[0] == -1) {
+        static uint8_t registered = 0U;
+        if(!registered) {
+            pthread_atfork(NULL, NULL, peek_pipe_forget);
+            registered = 1U;
+        }
+        int32_t fds[2];
+        if(pipe2(fds, O_CLOEXEC) == -1) {
+            return -1;
+        }
+        // user redirections must not close it behind our back
+        peek_pipe[0] = move_fd_above(fds[0], SHELL_FD_BASE);
+        peek_pipe[1] = move_fd_above(fds[1], SHELL_FD_BASE);
+        if(peek_pipe[0] == -1 || peek_pipe[1] == -1) {
+            close(peek_pipe[0]);
+            close(peek_pipe[1]);
+            peek_pipe[0] = -1;
+            peek_pipe[1] = -1;
+            return -1;
+        }
+    }
+
+    // blocks until the writer gives something or closes the pipe
+    ssize_t copied = tee(fd, peek_pipe[1], size, 0);
+    if(copied <= 0) {
+        return copied;
+    }
+    for(ssize_t got = 0; got < copied;) {
+        ssize_t n = read(peek_pipe[0], buffer + got, (size_t)(copied - got));
+        if(n <= 0) {
+            if(n < 0 && errno == EINTR) {
+                continue;
+            }
+            // the peek pipe can't be trusted to be empty any more
+            peek_pipe_forget();
+            errno = EIO;
+            return -1;
+        }
+        got += n;
+    }
+    return copied;
+} // peek_pipe_data
+
+
+/**
+ * @brief       Appends next line of descriptor including its newline to buffer
+ *
+ *              Nothing after the newline is taken away from the descriptor,
+ *              which other commands of the script may read next. Regular
+ *              files are read in blocks and the offset is moved back to just
+ *              after the newline, pipes and sockets are peeked first and then
+ *              only the line is read out. Other descriptors (terminals) are
+ *              read a byte at a time
+ *
+ * @param fd    descriptor
+ * @param line  malloc'd buffer, grown as needed, there is always room for a NUL
+ * @param length number of bytes in buffer, updated
+ * @param capacity size of buffer, updated
+ * @return      SUCCESS, ERROR_DEFAULT on end of file or error, ERROR_MALLOC_FAILURE
+ */
+StatusEnum file_read_line(int32_t fd, char** line, size_t* length, size_t* capacity) {
+    struct stat info;
+    mode_t mode = (fstat(fd, &info) == 0) ? info.st_mode : 0;
+    uint8_t regular = S_ISREG(mode) ? 1U : 0U;
+    uint8_t peek_fifo = S_ISFIFO(mode) ? 1U : 0U;
+    uint8_t peek_socket = S_ISSOCK(mode) ? 1U : 0U;
+
+    for(;;) {
+        if(*length + FILE_LINE_BLOCK_SIZE + 1 > *capacity) {
+            size_t grown_capacity = (*capacity == 0) ? FILE_LINE_BLOCK_SIZE : *capacity * 2;
+            while(*length + FILE_LINE_BLOCK_SIZE + 1 > grown_capacity) {
+                grown_capacity *= 2;
+            }
+            char* grown = (char*) realloc(*line, grown_capacity);
+            if(grown == NULL) {
+                return ERROR_MALLOC_FAILURE;
+            }
+            *line = grown;
+            *capacity = grown_capacity;
+        }
+
+        char* space = *line + *length;
+        ssize_t n;
+        if(regular) {
+            n = read(fd, space, FILE_LINE_BLOCK_SIZE);
+        }
+        else if(peek_fifo) {
+            n = peek_pipe_data(fd, space, FILE_LINE_BLOCK_SIZE);
         }
-        else if(errno == ENOTDIR || errno == ENOENT) {
-            error = EXIT_COMMAND_NOT_FOUND;
+        else if(peek_socket) {
+            n = recv(fd, space, FILE_LINE_BLOCK_SIZE, MSG_PEEK);
         }
         else {
-            error = EXIT_ERROR;
+            n = read(fd, space, 1);
+        }
+        if(n < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            // non blocking descriptors and the like, single bytes still work
+            if((peek_fifo || peek_socket) && errno != EAGAIN) {
+                peek_fifo = 0U;
+                peek_socket = 0U;
+                continue;
+            }
+            return ERROR_DEFAULT;
+        }
+        if(n == 0) {
+            return ERROR_DEFAULT;
+        }
+
+        char* newline = (char*) memchr(space, '\n', (size_t)n);
+        size_t used = (newline != NULL) ? (size_t)(newline - space) + 1 : (size_t)n;
+        if(regular && used < (size_t)n) {
+            lseek(fd, (off_t)used - (off_t)n, SEEK_CUR);
+        }
+        else if(peek_fifo || peek_socket) {
+            // take out exactly what was used, the bytes are the same ones
+            for(size_t taken = 0; taken < used;) {
+                ssize_t got = read(fd, space + taken, used - taken);
+                if(got <= 0) {
+                    if(got < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    return ERROR_DEFAULT;
+                }
+                taken += (size_t)got;
+            }
+        }
+        *length += used;
+        if(newline != NULL) {
+            return SUCCESS;
         }
     }
-}
\ No newline at end of file
+} // file_read_line
@@ -1,8 +1,67 @@
+#ifndef FILE_H
+#define FILE_H
+
 #include <stdint.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include "error.h"
 
-void open_file(const char* path, __uint32_t flag, int32_t* file_descriptor);
+// descriptors opened by the shell itself are kept at or above this number
+#define SHELL_FD_BASE 10
+// bytes read or peeked at once by file_read_line(), what follows the newline is given back
+#define FILE_LINE_BLOCK_SIZE 4096U
+
+StatusEnum open_file(const char* path, uint32_t flag, int32_t* file_descriptor);
+
+StatusEnum create_file(const char* name_path);
+
+/**
+ * @brief       Creates pipe whose both ends are closed on exec
+ *
+ * @param fds   output read end fds[0] and write end fds[1]
+ * @return      SUCCESS, ERROR_DEFAULT (reported to stderr)
+ */
+StatusEnum open_pipe(int32_t fds[2]);
+
+/**
+ * @brief       Moves descriptor to minimum or above, the new one is closed on exec
+ *
+ *              Keeps low descriptors free for redirections of the user
+ *
+ * @param fd    descriptor, -1 is passed through
+ * @param minimum lowest acceptable number
+ * @return      descriptor, -1 on failure with errno set (fd is closed)
+ */
+int32_t move_fd_above(int32_t fd, int32_t minimum);
+
+/**
+ * @brief       Enlarges pipe buffer so a writer in the shell can hand over
+ *              large blocks with few writes and wakeups of the reader
+ *
+ *              Best effort, the pipe keeps its size when the limit of the
+ *              system (/proc/sys/fs/pipe-max-size) does not allow it
+ *
+ * @param fd    either end of the pipe
+ * @param size  wanted capacity in bytes
+ */
+void pipe_grow(int32_t fd, int32_t size);
+
+/**
+ * @brief       Appends next line of descriptor including its newline to buffer
+ *
+ *              Nothing after the newline is taken away from the descriptor,
+ *              which other commands of the script may read next. Regular
+ *              files are read in blocks and the offset is moved back to just
+ *              after the newline, pipes and sockets are peeked first and then
+ *              only the line is read out. Other descriptors (terminals) are
+ *              read a byte at a time
+ *
+ * @param fd    descriptor
+ * @param line  malloc'd buffer, grown as needed, there is always room for a NUL
+ * @param length number of bytes in buffer, updated
+ * @param capacity size of buffer, updated
+ * @return      SUCCESS, ERROR_DEFAULT on end of file or error, ERROR_MALLOC_FAILURE
+ */
+StatusEnum file_read_line(int32_t fd, char** line, size_t* length, size_t* capacity);
 
-void create_file(const char* name_path);
\ No newline at end of file
+#endif
@@ -0,0 +1,435 @@
+/**
+ * Persistent history of interactive sessions
+ *
+ * The file is only ever appended to by sessions, loading maps it and reads
+ * the newest entries from its end, so neither start nor exit of a shell
+ * costs time proportional to the size of the file
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <readline/readline.h>
+#include <readline/history.h>
+#include "history.h"
+#include "../data_structures/htab.h"
+
+// suffix of the temporary file written by compaction, completed by mkostemp()
+#define HISTORY_TEMP_SUFFIX ".XXXXXX"
+
+
+/**
+ * @brief       Makes entry buffer hold at least size bytes
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+static StatusEnum history_reserve(HistoryPtr history, size_t size) {
+    if(size <= history->capacity) {
+        return SUCCESS;
+    }
+    size_t capacity = (history->capacity > 0) ? history->capacity : 256U;
+    while(capacity < size) {
+        capacity *= 2;
+    }
+    char* buffer = (char*) realloc(history->buffer, capacity);
+    if(buffer == NULL) {
+        return ERROR_MALLOC_FAILURE;
+    }
+    history->buffer = buffer;
+    history->capacity = capacity;
+    return SUCCESS;
+} // history_reserve
+
+
+/**
+ * @brief       Opens history file for appending and reading
+ * @return      descriptor, -1 on failure with errno set
+ */
+static int32_t history_file_open(const char* path) {
+    return open(path, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+} // history_file_open
+
+
+/**
+ * @brief       Locks history file, interrupted calls are retried
+ * @return      0, -1 on failure
+ */
+static int history_lock(int32_t fd, int operation) {
+    int result;
+    while((result = flock(fd, operation)) == -1 && errno == EINTR) {
+    }
+    return result;
+} // history_lock
+
+
+/**
+ * @brief       Checks whether the path still names the opened file
+ *
+ *              Compaction of another session renames a new file over it
+ *
+ * @param history opened history
+ * @param file  output status of the opened file
+ * @return      1 when the descriptor is current, 0 when it has to be reopened
+ */
+static uint8_t history_current(HistoryPtr history, struct stat* file) {
+    struct stat named;
+    if(fstat(history->file_descriptor, file) == -1 || stat(history->path, &named) == -1) {
+        return 0U;
+    }
+    return (named.st_ino == file->st_ino && named.st_dev == file->st_dev) ? 1U : 0U;
+} // history_current
+
+
+/**
+ * @brief       Replaces descriptor by a new one of the path, lock of the old one is released
+ */
+static void history_reopen(HistoryPtr history) {
+    int32_t fd = history_file_open(history->path);
+    close(history->file_descriptor);
+    history->file_descriptor = fd;
+} // history_reopen
+
+
+/**
+ * @brief       Finds start of entry which ends at given offset
+ *
+ *              Entries end at newlines which do not follow a backslash
+ *
+ * @param data  file contents
+ * @param end   offset of the newline closing the entry or end of data
+ * @return      offset of the first byte of the entry
+ */
+static size_t entry_start(const char* data, size_t end) {
+    const char* newline;
+    while((newline = (const char*) memrchr(data, '\n', end)) != NULL) {
+        size_t offset = (size_t)(newline - data);
+        if(offset == 0 || data[offset - 1] != '\\') {
+            return offset + 1;
+        }
+        end = offset;
+    }
+    return 0;
+} // entry_start
+
+
+/**
+ * @brief       Offset just past the last entry, a missing final newline is tolerated
+ */
+static size_t data_end(const char* data, size_t size) {
+    return (size > 0 && data[size - 1] == '\n') ? size - 1 : size;
+} // data_end
+
+
+/**
+ * @brief       Maps whole history file read only
+ * @return      mapping, NULL when the file is empty or can't be mapped
+ */
+static char* history_map(int32_t fd, size_t* size) {
+    struct stat info;
+    if(fstat(fd, &info) == -1 || info.st_size <= 0) {
+        return NULL;
+    }
+    void* mapping = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(mapping == MAP_FAILED) {
+        return NULL;
+    }
+    *size = (size_t)info.st_size;
+    return (char*) mapping;
+} // history_map
+
+
+/**
+ * @brief       Opens history file, it is created if it does not exist
+ *
+ *              Nothing is read yet, a file which can't be opened is
+ *              reported and the session then keeps history in memory only
+ *
+ * @param history history which will be initialized
+ * @param path  history file
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+StatusEnum history_open(HistoryPtr history, const char* path) {
+    history->buffer = NULL;
+    history->capacity = 0;
+    history->file_descriptor = -1;
+    using_history();
+    stifle_history(HISTORY_LOAD_ENTRIES);
+
+    // relative path is resolved now, later cd must not move the history
+    if(path[0] == '/') {
+        history->path = strdup(path);
+    }
+    else {
+        char* directory = getcwd(NULL, 0);
+        if(directory == NULL) {
+            history->path = strdup(path);
+        }
+        else if(asprintf(&history->path, "%s/%s", directory, path) == -1) {
+            history->path = NULL;
+        }
+        free(directory);
+    }
+    if(history->path == NULL) {
+        return ERROR_MALLOC_FAILURE;
+    }
+
+    history->file_descriptor = history_file_open(history->path);
+    if(history->file_descriptor == -1) {
+        print_errno(history->path);
+    }
+    return SUCCESS;
+} // history_open
+
+
+/**
+ * @brief       Adds newest HISTORY_LOAD_ENTRIES entries of the file to readline
+ *
+ *              The file is mapped and searched backwards from its end, so
+ *              only the pages holding the loaded entries are read
+ *
+ * @param history opened history
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+StatusEnum history_load(HistoryPtr history) {
+    if(history->file_descriptor == -1) {
+        return SUCCESS;
+    }
+    size_t size = 0;
+    char* data = history_map(history->file_descriptor, &size);
+    if(data == NULL) {
+        return SUCCESS;
+    }
+
+    size_t end = data_end(data, size);
+    size_t start = end;
+    for(uint32_t count = 0; count < HISTORY_LOAD_ENTRIES && start > 0; count++) {
+        start = entry_start(data, (count == 0) ? end : start - 1);
+    }
+
+    // decode forward, backslash newline joins lines of one entry
+    StatusEnum st = SUCCESS;
+    size_t length = 0;
+    for(size_t position = start; position < end && st == SUCCESS;) {
+        const char* newline = (const char*) memchr(data + position, '\n', end - position);
+        size_t line_end = (newline != NULL) ? (size_t)(newline - data) : end;
+        size_t line_length = line_end - position;
+        uint8_t joined = (newline != NULL && line_length > 0 && data[line_end - 1] == '\\') ? 1U : 0U;
+
+        st = history_reserve(history, length + line_length + 1);
+        if(st != SUCCESS) {
+            break;
+        }
+        memcpy(history->buffer + length, data + position, line_length - joined);
+        length += line_length - joined;
+        position = line_end + 1;
+        if(joined) {
+            history->buffer[length++] = '\n';
+            continue;
+        }
+        history->buffer[length] = '\0';
+        if(length > 0) {
+            add_history(history->buffer);
+        }
+        length = 0;
+    }
+    munmap(data, size);
+    return st;
+} // history_load
+
+
+/**
+ * @brief       Rewrites history file with its newest unique entries
+ *
+ *              The newest occurrence of a repeated entry is kept. The result
+ *              is written to a temporary file in the same directory which is
+ *              renamed over the history, so readers never see a partial file.
+ *              Failures leave the file as it was
+ *
+ * @param history opened history
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE, ERROR_DEFAULT
+ */
+static StatusEnum history_compact(HistoryPtr history) {
+    struct stat file;
+    if(history_lock(history->file_descriptor, LOCK_EX) == -1) {
+        return ERROR_DEFAULT;
+    }
+    // another session may have done it while we waited for the lock
+    if(!history_current(history, &file) || (size_t)file.st_size <= HISTORY_COMPACT_SIZE) {
+        history_reopen(history);
+        return SUCCESS;
+    }
+
+    size_t size = 0;
+    char* data = history_map(history->file_descriptor, &size);
+    if(data == NULL) {
+        history_lock(history->file_descriptor, LOCK_UN);
+        return ERROR_DEFAULT;
+    }
+
+    // kept entries as start and end offsets, newest first
+    size_t* kept = (size_t*) malloc(HISTORY_FILE_ENTRIES * 2 * sizeof(size_t));
+    char* output = (char*) malloc(HISTORY_COMPACT_SIZE / 2);
+    HashTable seen;
+    StatusEnum st = (kept == NULL || output == NULL) ? ERROR_MALLOC_FAILURE : hashTableCtor(&seen);
+    if(st != SUCCESS) {
+        free(kept);
+        free(output);
+        munmap(data, size);
+        history_lock(history->file_descriptor, LOCK_UN);
+        return st;
+    }
+
+    uint32_t count = 0;
+    size_t total = 0;
+    size_t end = data_end(data, size);
+    while(end > 0 && count < HISTORY_FILE_ENTRIES) {
+        size_t start = entry_start(data, end);
+        size_t length = end - start;
+        if(length > 0 && total + length + 1 <= HISTORY_COMPACT_SIZE / 2) {
+            st = history_reserve(history, length + 1);
+            if(st != SUCCESS) {
+                break;
+            }
+            memcpy(history->buffer, data + start, length);
+            history->buffer[length] = '\0';
+            char* value;
+            if(hashTableGetValue(&seen, history->buffer, &value) != SUCCESS) {
+                st = hashTableInsert(&seen, history->buffer, "");
+                if(st != SUCCESS) {
+                    break;
+                }
+                kept[count * 2] = start;
+                kept[count * 2 + 1] = end;
+                count++;
+                total += length + 1;
+            }
+        }
+        else if(length + 1 <= HISTORY_COMPACT_SIZE / 2) {
+            break;
+        }
+        end = (start > 0) ? start - 1 : 0;
+    }
+    hashTableDtor(&seen);
+
+    // oldest first again
+    size_t written = 0;
+    for(uint32_t i = count; st == SUCCESS && i > 0; i--) {
+        size_t length = kept[i * 2 - 1] - kept[i * 2 - 2];
+        memcpy(output + written, data + kept[i * 2 - 2], length);
+        written += length;
+        output[written++] = '\n';
+    }
+    free(kept);
+    munmap(data, size);
+
+    char* temporary = NULL;
+    int32_t fd = -1;
+    if(st == SUCCESS) {
+        st = (asprintf(&temporary, "%s" HISTORY_TEMP_SUFFIX, history->path) == -1) ? ERROR_MALLOC_FAILURE : SUCCESS;
+    }
+    if(st == SUCCESS) {
+        fd = mkostemp(temporary, O_CLOEXEC);
+        st = (fd == -1) ? ERROR_DEFAULT : SUCCESS;
+    }
+    if(st == SUCCESS) {
+        fchmod(fd, file.st_mode & 0777);
+        st = (write(fd, output, written) != (ssize_t)written || fsync(fd) == -1 || rename(temporary, history->path) == -1) ? ERROR_DEFAULT : SUCCESS;
+        if(st != SUCCESS) {
+            unlink(temporary);
+        }
+    }
+    if(fd != -1) {
+        close(fd);
+    }
+    free(temporary);
+    free(output);
+
+    if(st == SUCCESS) {
+        history_reopen(history);
+    }
+    else if(history->file_descriptor != -1) {
+        history_lock(history->file_descriptor, LOCK_UN);
+    }
+    return st;
+} // history_compact
+
+
+/**
+ * @brief       Appends encoded entry with one write under a shared lock
+ * @return      new size of the file, 0 when the entry was not saved
+ */
+static size_t history_append(HistoryPtr history, size_t length) {
+    while(history->file_descriptor != -1) {
+        struct stat file;
+        if(history_lock(history->file_descriptor, LOCK_SH) == -1) {
+            return 0;
+        }
+        if(!history_current(history, &file)) {
+            history_reopen(history);
+            continue;
+        }
+
+        size_t size = (size_t)file.st_size;
+        ssize_t written = write(history->file_descriptor, history->buffer, length);
+        history_lock(history->file_descriptor, LOCK_UN);
+        return (written == (ssize_t)length) ? size + length : 0;
+    }
+    return 0;
+} // history_append
+
+
+/**
+ * @brief       Adds entry to readline and appends it to the history file
+ *
+ * @param history opened history
+ * @param entry command as typed, lines separated by newlines
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+StatusEnum history_add(HistoryPtr history, const char* entry) {
+    add_history(entry);
+    if(history->file_descriptor == -1) {
+        return SUCCESS;
+    }
+
+    // every newline may get a backslash, one more byte for a trailing space and the final newline
+    size_t entry_length = strlen(entry);
+    StatusEnum st = history_reserve(history, entry_length * 2 + 2);
+    ERR_CHECK(st);
+    size_t length = 0;
+    for(size_t i = 0; i < entry_length; i++) {
+        if(entry[i] == '\n') {
+            history->buffer[length++] = '\\';
+        }
+        history->buffer[length++] = entry[i];
+    }
+    // a trailing backslash would join the next entry
+    if(length > 0 && history->buffer[length - 1] == '\\') {
+        history->buffer[length++] = ' ';
+    }
+    history->buffer[length++] = '\n';
+
+    if(history_append(history, length) > HISTORY_COMPACT_SIZE) {
+        st = history_compact(history);
+    }
+    return (st == ERROR_MALLOC_FAILURE) ? st : SUCCESS;
+} // history_add
+
+
+/**
+ * @brief       Closes history file and frees buffers
+ */
+void history_close(HistoryPtr history) {
+    if(history->file_descriptor != -1) {
+        close(history->file_descriptor);
+        history->file_descriptor = -1;
+    }
+    free(history->path);
+    free(history->buffer);
+    history->path = NULL;
+    history->buffer = NULL;
+    history->capacity = 0;
+} // history_close
@@ -0,0 +1,67 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "error.h"
+
+// newest entries put into the readline list when history is loaded
+#define HISTORY_LOAD_ENTRIES 1000U
+// file is compacted once it grows over this size
+#define HISTORY_COMPACT_SIZE (1024U * 1024U)
+// compaction keeps at most this many unique entries and half of the size above
+#define HISTORY_FILE_ENTRIES 10000U
+
+/*  History file shared by concurrent interactive sessions. Every session
+    appends only its own entries, each with a single O_APPEND write, so
+    entries of different sessions never interleave and the file is never
+    rewritten on exit. Entries are separated by newlines, a newline inside
+    of an entry is stored as backslash newline. The session which pushes
+    the file over HISTORY_COMPACT_SIZE rewrites it without duplicates under
+    an exclusive flock() and renames the result over it, appenders hold a
+    shared lock and reopen the path when its inode changed */
+typedef struct history {
+    char* path;                 // absolute, cd does not change the file
+    int32_t file_descriptor;    // O_RDWR | O_APPEND, -1 when history is not saved
+    char* buffer;               // encoded or decoded entry
+    size_t capacity;
+} History, *HistoryPtr;
+
+/**
+ * @brief       Opens history file, it is created if it does not exist
+ *
+ *              Nothing is read yet, a file which can't be opened is
+ *              reported and the session then keeps history in memory only
+ *
+ * @param history history which will be initialized
+ * @param path  history file
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+StatusEnum history_open(HistoryPtr history, const char* path);
+
+/**
+ * @brief       Adds newest HISTORY_LOAD_ENTRIES entries of the file to readline
+ *
+ *              The file is mapped and searched backwards from its end, so
+ *              only the pages holding the loaded entries are read
+ *
+ * @param history opened history
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+StatusEnum history_load(HistoryPtr history);
+
+/**
+ * @brief       Adds entry to readline and appends it to the history file
+ *
+ * @param history opened history
+ * @param entry command as typed, lines separated by newlines
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE
+ */
+StatusEnum history_add(HistoryPtr history, const char* entry);
+
+/**
+ * @brief       Closes history file and frees buffers
+ */
+void history_close(HistoryPtr history);
+
+#endif
@@ -0,0 +1,224 @@
+/**
+ * Script input for the lexer
+ *
+ * Regular files are mapped so the lexer reads straight from the page cache
+ * without any copies, pipes and terminals fall back to large block reads.
+ * A script on stdin leaves the rest of its input to commands reading stdin:
+ * the offset of a mapped file follows the lexer, anything else is read a
+ * line at a time the way the read builtin does
+ */
+#include "input.h"
+#include "file.h"
+
+
+/**
+ * @brief       Opens input over a file descriptor
+ *
+ *              Regular non empty files are mmap'd read only, other descriptors
+ *              get a heap buffer which is filled by input_read_block(). The
+ *              script starts at the current offset of the descriptor, stdin
+ *              is shared with the commands of the script
+ *
+ * @param input input source which will be initialized
+ * @param file_descriptor descriptor of the script, input does not close it
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE or ERROR_DEFAULT on failed syscalls
+ */
+StatusEnum input_open(InputSourcePtr input, int32_t file_descriptor) {
+    if(input == NULL) {
+        return ERROR_DEFAULT;
+    }
+
+    input->buffer = NULL;
+    input->length = 0;
+    input->capacity = 0;
+    input->start = 0;
+    input->file_descriptor = file_descriptor;
+    input->mapped = 0U;
+    input->eof = 0U;
+    input->shared = (file_descriptor == STDIN_FILENO) ? 1U : 0U;
+
+    struct stat info;
+    if(fstat(file_descriptor, &info) == -1) {
+        return ERROR_DEFAULT;
+    }
+
+    // map whole regular file, the lexer then never has to refill
+    off_t offset = S_ISREG(info.st_mode) ? lseek(file_descriptor, 0, SEEK_CUR) : 0;
+    if(S_ISREG(info.st_mode) && offset >= 0 && info.st_size > offset) {
+        void* mapping = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+        if(mapping != MAP_FAILED) {
+            madvise(mapping, (size_t)info.st_size, MADV_SEQUENTIAL);
+            input->buffer = (char*) mapping;
+            input->length = (size_t)info.st_size;
+            input->start = (size_t)offset;
+            input->mapped = 1U;
+            input->eof = 1U;
+            return SUCCESS;
+        }
+        // fall through to reading when mapping is not possible
+    }
+
+    input->buffer = (char*) malloc(INPUT_BLOCK_SIZE);
+    if(input->buffer == NULL) {
+        return ERROR_MALLOC_FAILURE;
+    }
+    input->capacity = INPUT_BLOCK_SIZE;
+    return input_read_block(input);
+} // input_open
+
+
+/**
+ * @brief       Appends next block of input to the buffer
+ *
+ *              Buffer may be moved by this call, length is unchanged and eof is set
+ *              when there is nothing more to read
+ *
+ * @param input input source
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE or ERROR_DEFAULT if read() fails
+ */
+StatusEnum input_read_block(InputSourcePtr input) {
+    if(input == NULL) {
+        return ERROR_DEFAULT;
+    }
+    if(input->eof) {
+        return SUCCESS;
+    }
+
+    // nothing after the line is taken away from the commands
+    if(input->shared) {
+        size_t length = input->length;
+        StatusEnum st = file_read_line(input->file_descriptor, &input->buffer, &input->length, &input->capacity);
+        if(st == ERROR_DEFAULT) {
+            // end of file, a last line without newline is still there
+            input->eof = (input->length == length) ? 1U : 0U;
+            return SUCCESS;
+        }
+        return st;
+    }
+
+    // keep at least one whole block free, grow geometrically
+    if(input->capacity - input->length < INPUT_BLOCK_SIZE) {
+        size_t new_capacity = input->capacity * 2;
+        char* new_buffer = (char*) realloc(input->buffer, new_capacity);
+        if(new_buffer == NULL) {
+            return ERROR_MALLOC_FAILURE;
+        }
+        input->buffer = new_buffer;
+        input->capacity = new_capacity;
+    }
+
+    ssize_t count;
+    do {
+        count = read(input->file_descriptor, input->buffer + input->length,
+                     input->capacity - input->length);
+    } while(count == -1 && errno == EINTR);
+
+    if(count == -1) {
+        return ERROR_DEFAULT;
+    }
+    if(count == 0) {
+        input->eof = 1U;
+    }
+    input->length += (size_t)count;
+    return SUCCESS;
+} // input_read_block
+
+
+/**
+ * @brief       Lexer refill callback reading next block from InputSource
+ *
+ * @param context InputSourcePtr
+ * @param buffer  updated pointer to start of input
+ * @param length  updated input length, unchanged on end of input
+ * @return      status of input_read_block()
+ */
+StatusEnum input_lexer_refill(void* context, const char** buffer, size_t* length) {
+    InputSourcePtr input = (InputSourcePtr) context;
+
+    StatusEnum st = input_read_block(input);
+    ERR_CHECK(st);
+
+    *buffer = input->buffer;
+    *length = input->length;
+    return SUCCESS;
+} // input_lexer_refill
+
+
+/**
+ * @brief       Drops consumed input in front of position from the heap buffer
+ *
+ *              Called at a command boundary where no token refers to the dropped
+ *              part, so a long running `cmd | cyprsh` keeps only what was not
+ *              parsed yet. Mapped input is left alone and prefixes shorter than
+ *              a block are kept until moving the rest pays off
+ *
+ * @param input input source
+ * @param position lexer position, relative to input->start
+ * @return      number of bytes dropped, the lexer position moves back by it
+ */
+size_t input_compact(InputSourcePtr input, size_t position) {
+    if(input->mapped || position < INPUT_BLOCK_SIZE) {
+        return 0;
+    }
+    size_t consumed = input->start + position;
+    memmove(input->buffer, input->buffer + consumed, input->length - consumed);
+    input->length -= consumed;
+    input->start = 0;
+    return position;
+} // input_compact
+
+
+/**
+ * @brief       Moves offset of shared mapped input to lexer position before a command runs
+ *
+ * @param input input source
+ * @param position lexer position right after the command, relative to input->start
+ */
+void input_sync_before(InputSourcePtr input, size_t position) {
+    if(input->shared && input->mapped) {
+        lseek(input->file_descriptor, (off_t)(input->start + position), SEEK_SET);
+    }
+} // input_sync_before
+
+
+/**
+ * @brief       Takes over offset of shared mapped input after a command ran
+ *
+ *              A command which read stdin moved the offset past what it read,
+ *              the script goes on from there
+ *
+ * @param input input source
+ * @param position lexer position given to input_sync_before()
+ * @return      position where the lexer continues
+ */
+size_t input_sync_after(InputSourcePtr input, size_t position) {
+    if(!input->shared || !input->mapped) {
+        return position;
+    }
+    off_t offset = lseek(input->file_descriptor, 0, SEEK_CUR);
+    if(offset < 0 || (size_t)offset < input->start) {
+        return position;
+    }
+    size_t moved = (size_t)offset - input->start;
+    return (moved <= input->length - input->start) ? moved : input->length - input->start;
+} // input_sync_after
+
+
+/**
+ * @brief       Unmaps or frees input buffer, file descriptor is left open
+ */
+void input_close(InputSourcePtr input) {
+    if(input == NULL || input->buffer == NULL) {
+        return;
+    }
+
+    if(input->mapped) {
+        munmap(input->buffer, input->length);
+    }
+    else {
+        free(input->buffer);
+    }
+    input->buffer = NULL;
+    input->length = 0;
+    input->capacity = 0;
+} // input_close
@@ -0,0 +1,107 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "error.h"
+
+// size of one read() when input can't be mapped (pipe, tty, empty file)
+#define INPUT_BLOCK_SIZE (64U * 1024U)
+
+/*  Script input, regular files are mapped read only and handed to lexer
+    as a whole, anything else is read in large blocks into a growing buffer.
+    A script on stdin shares the descriptor with its commands, it is read
+    a line at a time or its offset is kept where the lexer is, so a command
+    reading stdin gets the lines after it */
+typedef struct input_source {
+    char* buffer;               // mapping or heap buffer
+    size_t length;              // number of valid bytes in buffer
+    size_t capacity;            // size of heap buffer (0 when mapped)
+    size_t start;               // first byte of the script in buffer, file offset at open
+    int32_t file_descriptor;
+    uint8_t mapped;             // buffer comes from mmap
+    uint8_t eof;                // nothing more can be read
+    uint8_t shared;             // descriptor is stdin of the commands too
+} InputSource, *InputSourcePtr;
+
+/**
+ * @brief       Opens input over a file descriptor
+ *
+ *              Regular non empty files are mmap'd read only, other descriptors
+ *              get a heap buffer which is filled by input_read_block(). The
+ *              script starts at the current offset of the descriptor, stdin
+ *              is shared with the commands of the script
+ *
+ * @param input input source which will be initialized
+ * @param file_descriptor descriptor of the script, input does not close it
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE or ERROR_DEFAULT on failed syscalls
+ */
+StatusEnum input_open(InputSourcePtr input, int32_t file_descriptor);
+
+/**
+ * @brief       Appends next block of input to the buffer
+ *
+ *              Buffer may be moved by this call, length is unchanged and eof is set
+ *              when there is nothing more to read. Shared descriptors are read
+ *              one line at a time
+ *
+ * @param input input source
+ * @return      SUCCESS, ERROR_MALLOC_FAILURE or ERROR_DEFAULT if read() fails
+ */
+StatusEnum input_read_block(InputSourcePtr input);
+
+/**
+ * @brief       Lexer refill callback reading next block from InputSource
+ *
+ * @param context InputSourcePtr
+ * @param buffer  updated pointer to start of input
+ * @param length  updated input length, unchanged on end of input
+ * @return      status of input_read_block()
+ */
+StatusEnum input_lexer_refill(void* context, const char** buffer, size_t* length);
+
+/**
+ * @brief       Drops consumed input in front of position from the heap buffer
+ *
+ *              Called at a command boundary where no token refers to the dropped
+ *              part, so a long running `cmd | cyprsh` keeps only what was not
+ *              parsed yet. Mapped input is left alone and prefixes shorter than
+ *              a block are kept until moving the rest pays off
+ *
+ * @param input input source
+ * @param position lexer position, relative to input->start
+ * @return      number of bytes dropped, the lexer position moves back by it
+ */
+size_t input_compact(InputSourcePtr input, size_t position);
+
+/**
+ * @brief       Moves offset of shared mapped input to lexer position before a command runs
+ *
+ * @param input input source
+ * @param position lexer position right after the command, relative to input->start
+ */
+void input_sync_before(InputSourcePtr input, size_t position);
+
+/**
+ * @brief       Takes over offset of shared mapped input after a command ran
+ *
+ *              A command which read stdin moved the offset past what it read,
+ *              the script goes on from there
+ *
+ * @param input input source
+ * @param position lexer position given to input_sync_before()
+ * @return      position where the lexer continues
+ */
+size_t input_sync_after(InputSourcePtr input, size_t position);
+
+/**
+ * @brief       Unmaps or frees input buffer, file descriptor is left open
+ */
+void input_close(InputSourcePtr input);
+
+#endif
@@ -0,0 +1,164 @@
+/**
+ * Buffered output of the shell process
+ *
+ * A loop of builtins writing to stdout costs one write per 64 KiB instead
+ * of one per call, stdio is not used so nothing else keeps a second copy
+ * of pending output that would have to be flushed separately
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include "output.h"
+
+// pending output, all of it goes to output_fd
+static char output_buffer[OUTPUT_BUFFER_SIZE];
+static size_t output_length = 0;
+static int32_t output_fd = STDOUT_FILENO;
+// errno of the first failed write since the last output_flush(), 0 if none
+static int32_t output_error = 0;
+
+
+/**
+ * @brief       Writes all vectors, short writes and interrupts are retried
+ *
+ *              Failed writes drop the data like stdio does, the error is kept
+ *              for the next output_flush() to return
+ */
+static void write_vectors(int32_t fd, struct iovec* vectors, int count) {
+    while(count > 0) {
+        ssize_t written = writev(fd, vectors, count);
+        if(written < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            if(output_error == 0) {
+                output_error = errno;
+            }
+            return;
+        }
+
+        size_t left = (size_t)written;
+        while(count > 0 && left >= vectors->iov_len) {
+            left -= vectors->iov_len;
+            vectors++;
+            count--;
+        }
+        if(count > 0) {
+            vectors->iov_base = (char*)vectors->iov_base + left;
+            vectors->iov_len -= left;
+        }
+    }
+} // write_vectors
+
+
+/**
+ * @brief       Writes out everything collected so far
+ *
+ *              Called before anything else may write to descriptors 1 and 2
+ *              or before they change
+ *
+ * @return      SUCCESS, ERROR_DEFAULT when a write since the last flush failed,
+ *              errno is set to its error
+ */
+StatusEnum output_flush(void) {
+    if(output_length > 0) {
+        struct iovec vector = {output_buffer, output_length};
+        output_length = 0;
+        write_vectors(output_fd, &vector, 1);
+    }
+    if(output_error != 0) {
+        errno = output_error;
+        output_error = 0;
+        return ERROR_DEFAULT;
+    }
+    return SUCCESS;
+} // output_flush
+
+
+/**
+ * @brief       Appends bytes for descriptor
+ *
+ *              Large data and data which does not fit is written together
+ *              with the buffer by a single writev() without being copied
+ *
+ * @param fd    STDOUT_FILENO or STDERR_FILENO
+ * @param data  bytes to write
+ * @param length number of bytes
+ */
+void output_write(int32_t fd, const char* data, size_t length) {
+    if(fd != output_fd) {
+        output_flush();
+        output_fd = fd;
+    }
+    if(length < OUTPUT_DIRECT_SIZE && length <= OUTPUT_BUFFER_SIZE - output_length) {
+        memcpy(output_buffer + output_length, data, length);
+        output_length += length;
+        return;
+    }
+
+    struct iovec vectors[2] = {
+        {output_buffer, output_length},
+        {(void*)data, length}
+    };
+    output_length = 0;
+    write_vectors(fd, (vectors[0].iov_len > 0) ? vectors : vectors + 1, (vectors[0].iov_len > 0) ? 2 : 1);
+} // output_write
+
+
+/**
+ * @brief       Appends NUL terminated string for descriptor
+ */
+void output_string(int32_t fd, const char* string) {
+    output_write(fd, string, strlen(string));
+} // output_string
+
+
+/**
+ * @brief       Appends one character for descriptor
+ */
+void output_char(int32_t fd, char c) {
+    if(fd == output_fd && output_length < OUTPUT_BUFFER_SIZE) {
+        output_buffer[output_length++] = c;
+        return;
+    }
+    output_write(fd, &c, 1);
+} // output_char
+
+
+/**
+ * @brief       Appends printf formatted text for descriptor
+ */
+void output_printf(int32_t fd, const char* format, ...) {
+    if(fd != output_fd) {
+        output_flush();
+        output_fd = fd;
+    }
+
+    // formatted straight into the free part of the buffer when it fits
+    va_list args;
+    va_start(args, format);
+    size_t space = OUTPUT_BUFFER_SIZE - output_length;
+    int length = vsnprintf(output_buffer + output_length, space, format, args);
+    va_end(args);
+    if(length < 0) {
+        return;
+    }
+    if((size_t)length < space) {
+        output_length += (size_t)length;
+        return;
+    }
+
+    output_flush();
+    char* text = (char*) malloc((size_t)length + 1);
+    if(text == NULL) {
+        return;
+    }
+    va_start(args, format);
+    vsnprintf(text, (size_t)length + 1, format, args);
+    va_end(args);
+    output_write(fd, text, (size_t)length);
+    free(text);
+} // output_printf
@@ -0,0 +1,60 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include "error.h"
+
+// bytes collected before the buffer is written out
+#define OUTPUT_BUFFER_SIZE (64U * 1024U)
+// larger writes are not copied into the buffer, they go out with it by writev
+#define OUTPUT_DIRECT_SIZE (16U * 1024U)
+
+/*  Output of builtins and diagnostics of the shell for descriptors 1 and 2.
+    Both share one buffer so their relative order is kept, switching the
+    descriptor writes out what was collected for the other one. The buffer
+    is written only by output_flush() (before fork, spawn, redirection and
+    blocking reads), when it fills up and when the descriptor changes. Failed
+    writes are remembered until the next output_flush() returns them */
+
+/**
+ * @brief       Appends bytes for descriptor
+ *
+ *              Large data and data which does not fit is written together
+ *              with the buffer by a single writev() without being copied
+ *
+ * @param fd    STDOUT_FILENO or STDERR_FILENO
+ * @param data  bytes to write
+ * @param length number of bytes
+ */
+void output_write(int32_t fd, const char* data, size_t length);
+
+/**
+ * @brief       Appends NUL terminated string for descriptor
+ */
+void output_string(int32_t fd, const char* string);
+
+/**
+ * @brief       Appends one character for descriptor
+ */
+void output_char(int32_t fd, char c);
+
+/**
+ * @brief       Appends printf formatted text for descriptor
+ */
+void output_printf(int32_t fd, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief       Writes out everything collected so far
+ *
+ *              Called before anything else may write to descriptors 1 and 2
+ *              or before they change
+ *
+ * @return      SUCCESS, ERROR_DEFAULT when a write since the last flush failed,
+ *              errno is set to its error
+ */
+StatusEnum output_flush(void);
+
+#endif
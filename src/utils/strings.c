@@ -20,6 +20,37 @@ char* strdup(const char* src) {
     return copy;
 }
 
-char* read_line(FILE* input) {
+/**
+ * @brief       Returns pointer past the longest variable name at start of word
+ */
+static const char* skip_name(const char* word) {
+    if(word == NULL || !(*word == '_' || (*word >= 'a' && *word <= 'z') || (*word >= 'A' && *word <= 'Z'))) {
+        return word;
+    }
+    word++;
+    while(*word == '_' || (*word >= 'a' && *word <= 'z') ||
+          (*word >= 'A' && *word <= 'Z') || (*word >= '0' && *word <= '9')) {
+        word++;
+    }
+    return word;
+} // skip_name
+
+
+/**
+ * @brief       Checks whether word is NAME=value assignment
+ * @return      1 if it is an assignment, 0 otherwise
+ */
+uint8_t is_assignment(const char* word) {
+    const char* end = skip_name(word);
+    return (end != word && *end == '=') ? 1U : 0U;
+} // is_assignment
+
 
-}
\ No newline at end of file
+/**
+ * @brief       Checks whether whole word is a valid variable name
+ * @return      1 if it is a name, 0 otherwise
+ */
+uint8_t is_name(const char* word) {
+    const char* end = skip_name(word);
+    return (end != word && *end == '\0') ? 1U : 0U;
+} // is_name
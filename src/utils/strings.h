@@ -1,3 +1,6 @@
+#ifndef STRINGS_H
+#define STRINGS_H
+
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -5,4 +8,18 @@
 
 uint8_t streq(const char* str1, const char* str2);
 
-char* strdup(const char* src);
\ No newline at end of file
+char* strdup(const char* src);
+
+/**
+ * @brief       Checks whether word is NAME=value assignment
+ * @return      1 if it is an assignment, 0 otherwise
+ */
+uint8_t is_assignment(const char* word);
+
+/**
+ * @brief       Checks whether whole word is a valid variable name
+ * @return      1 if it is a name, 0 otherwise
+ */
+uint8_t is_name(const char* word);
+
+#endif
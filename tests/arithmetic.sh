@@ -0,0 +1,24 @@
+#!/bin/sh
+# Tests of arithmetic expansion
+#
+# usage: tests/arithmetic.sh [shell]
+
+. "$(dirname "$0")/lib.sh"
+
+check "division by zero ends the script" 1 "cyprsh: 1/0: division by 0" \
+'echo $((1/0)); echo after'
+
+check "syntax error ends the script" 1 "cyprsh: 1+: arithmetic syntax error" \
+'echo $((1+)); echo after'
+
+check "invalid operand ends the script" 1 "cyprsh: 1+: arithmetic syntax error" \
+'x="1+"; echo $((x * 2)); echo after'
+
+check "error in an assignment ends the script" 1 "cyprsh: i/0: division by 0" \
+'i=1; i=$((i/0)); echo after'
+
+check "error in a pipeline stage ends only the stage" 0 "cyprsh: 1/0: division by 0
+after" \
+'echo $((1/0)) | cat; echo after'
+
+finish
@@ -0,0 +1,18 @@
+#!/bin/sh
+# Tests of launching commands
+#
+# usage: tests/exec.sh [shell]
+
+. "$(dirname "$0")/lib.sh"
+
+check "command not found goes to redirected stderr" 0 "st=127" \
+'nosuch 2>/dev/null; echo st=$?'
+
+check "command not found is written to the redirection file" 0 "st=127
+cyprsh: nosuch: command not found" \
+'nosuch 2>err.txt; echo st=$?; cat err.txt'
+
+check "file which can't be executed goes to redirected stderr" 0 "st=126" \
+'echo "echo hi" > noexec; chmod -x noexec; ./noexec 2>/dev/null; echo st=$?'
+
+finish
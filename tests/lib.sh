@@ -0,0 +1,32 @@
+# Helpers of the test scripts in tests/
+#
+# A test script sources this file with the shell under test as $1, calls
+# check for every case and ends with finish. Cases run as script files in
+# a scratch directory $scratch which is removed at exit
+
+shell=$(cd "$(dirname "${1:-build/cyprsh}")" && pwd)/$(basename "${1:-build/cyprsh}")
+scratch=$(mktemp -d) || exit 1
+trap 'rm -rf "$scratch"' EXIT
+failures=0
+cases=0
+
+# check name expected_status expected_output script
+# stdout and stderr of the script are compared together
+check() {
+    cases=$((cases + 1))
+    printf '%s\n' "$4" > "$scratch/case.sh"
+    output=$(cd "$scratch" && "$shell" case.sh 2>&1)
+    status=$?
+    if [ "$status" != "$2" ] || [ "$output" != "$3" ]; then
+        failures=$((failures + 1))
+        echo "FAIL: $1"
+        echo "  status $status, expected $2"
+        printf '  output:\n%s\n  expected:\n%s\n' "$output" "$3"
+    fi
+}
+
+# prints summary of the script, fails when a case failed
+finish() {
+    echo "$(basename "$0" .sh): $((cases - failures))/$cases passed"
+    [ "$failures" -eq 0 ]
+}
@@ -0,0 +1,23 @@
+#!/bin/sh
+# Tests of builtin utilities
+#
+# usage: tests/utilities.sh [shell]
+
+. "$(dirname "$0")/lib.sh"
+
+check "read drops NUL bytes" 0 "[ab]" \
+'printf '\''a\0b\n'\'' | { read x; echo "[$x]"; }'
+
+check "read -r drops NUL bytes" 0 "[a\b]" \
+'printf '\''a\\\0b\n'\'' | { read -r x; echo "[$x]"; }'
+
+check "read takes an escaped character after a NUL byte" 0 "[a b]" \
+'printf '\''a\0\\ b\n'\'' | { IFS= read x; echo "[$x]"; }'
+
+check "basename strips directory and suffix" 0 "file" \
+'basename -- /dir/file.txt .txt'
+
+check "basename rejects extra operand" 1 "cyprsh: basename: extra operand 'c'" \
+'basename a b c'
+
+finish
@@ -0,0 +1,54 @@
+#!/bin/sh
+# Tests of variable scopes and the environment of started commands
+#
+# usage: tests/variables.sh [shell]
+
+. "$(dirname "$0")/lib.sh"
+
+check "export of a local leaves the global alone" 0 "[]" \
+'f() { local X=in; export X; }
+f
+X=later
+sh -c '\''echo "[$X]"'\'''
+
+check "exported local reaches a child of the function" 0 "X=in" \
+'f() { local X=in; export X; env | grep "^X="; }
+f'
+
+check "local of an exported name is exported" 0 "in" \
+'export X=out
+f() { local X=in; printenv X; }
+f'
+
+check "prefix of a function call reaches its commands" 0 "pre
+[]" \
+'f() { sh -c '\''echo "$Z"'\''; }
+Z=pre f
+sh -c '\''echo "[$Z]"'\'''
+
+check "prefix of a command overrides an exported local" 0 "cmd" \
+'f() { local X=in; export X; X=cmd printenv X; }
+f'
+
+check "script without #! gets exported locals" 0 "in" \
+'echo '\''echo "$X"'\'' > script; chmod +x script
+f() { local X=in; export X; ./script; }
+f'
+
+check "unset local keeps the outer variable hidden" 0 "[]
+[]
+out" \
+'v=out
+f() { local v; unset v; echo "[$v]"; printenv v; echo "[${v-}]"; }
+export v
+f
+echo "$v"'
+
+check "unset local can be assigned again" 0 "2
+out" \
+'v=out
+f() { local v=1; unset v; v=2; echo "$v"; }
+f
+echo "$v"'
+
+finish